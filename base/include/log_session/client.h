@@ -26,6 +26,12 @@ namespace Genode {
 
 		size_t write(String const &string) {
 			return call<Rpc_write>(string); }
+
+		Dataspace_capability ring_buffer() {
+			return call<Rpc_ring_buffer>(); }
+
+		Signal_context_capability ring_buffer_sigh() {
+			return call<Rpc_ring_buffer_sigh>(); }
 	};
 }
 
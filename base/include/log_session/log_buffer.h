@@ -0,0 +1,174 @@
+/*
+ * \brief  Ring buffer of log messages shared by LOG client and server
+ * \author Genode Labs
+ * \date   2014-02-26
+ */
+
+/*
+ * Copyright (C) 2014 Genode Labs GmbH
+ *
+ * This file is part of the Genode OS framework, which is distributed
+ * under the terms of the GNU General Public License version 2.
+ */
+
+#ifndef _INCLUDE__LOG_SESSION__LOG_BUFFER_H_
+#define _INCLUDE__LOG_SESSION__LOG_BUFFER_H_
+
+#include <base/stdint.h>
+
+namespace Genode { class Log_buffer; }
+
+
+/**
+ * Ring buffer residing in a dataspace provided by the LOG server
+ *
+ * The client appends messages as null-terminated strings and the server
+ * consumes them. Each side modifies only its own position within the ring,
+ * so that no lock is needed. The client informs the server only about
+ * messages appended to an empty buffer. For this reason, both sides
+ * re-read the position of the other side after publishing their own
+ * position. Positions read from the shared memory are checked because the
+ * other side may be malicious.
+ */
+class Genode::Log_buffer
+{
+	private:
+
+		struct Header
+		{
+			uint32_t volatile head;  /* modified by the client only */
+			uint32_t volatile tail;  /* modified by the server only */
+		};
+
+		Header *_header;
+		char   *_data;
+		size_t  _capacity;
+
+		static void _memory_barrier() { __sync_synchronize(); }
+
+		size_t _used(size_t head, size_t tail) const {
+			return (head + _capacity - tail) % _capacity; }
+
+	public:
+
+		/**
+		 * Constructor for an unusable buffer
+		 */
+		Log_buffer() : _header(0), _data(0), _capacity(0) { }
+
+		/**
+		 * Constructor
+		 *
+		 * \param base  local address of the dataspace
+		 * \param size  size of the dataspace
+		 */
+		Log_buffer(void *base, size_t size)
+		:
+			_header((Header *)base), _data((char *)base + sizeof(Header)),
+			_capacity(size > sizeof(Header) ? size - sizeof(Header) : 0)
+		{
+			if (!_capacity)
+				_header = 0;
+		}
+
+		bool valid() const { return _header != 0; }
+
+		/**
+		 * Reset positions, called by the server before handing out the buffer
+		 */
+		void reset() { _header->head = _header->tail = 0; }
+
+
+		/*********************
+		 ** Client side API **
+		 *********************/
+
+		/**
+		 * Append message
+		 *
+		 * \param was_empty  set to true if the server must be informed
+		 *                   about the message
+		 *
+		 * \return  false if the message does not fit into the buffer
+		 */
+		bool append(char const *msg, size_t len, bool &was_empty)
+		{
+			size_t const head = _header->head;
+			size_t const tail = _header->tail;
+
+			if (head >= _capacity || tail >= _capacity)
+				return false;
+
+			/* keep one byte free to distinguish a full from an empty buffer */
+			if (len + 1 > _capacity - 1 - _used(head, tail))
+				return false;
+
+			size_t pos = head;
+			for (size_t i = 0; i < len; i++, pos = (pos + 1) % _capacity)
+				_data[pos] = msg[i];
+			_data[pos] = 0;
+
+			_memory_barrier();
+			_header->head = (pos + 1) % _capacity;
+			_memory_barrier();
+
+			/* the server may have consumed all messages meanwhile */
+			was_empty = (_header->tail == head);
+			return true;
+		}
+
+
+		/*********************
+		 ** Server side API **
+		 *********************/
+
+		/**
+		 * Consume all messages
+		 *
+		 * \param line  buffer for one message, messages exceeding its size
+		 *              are split
+		 * \param fn    functor called with the arguments
+		 *              'char const *line, size_t len' for each message
+		 */
+		template <typename FN>
+		void drain(char *line, size_t line_size, FN const &fn)
+		{
+			for (;;) {
+				size_t const head = _header->head;
+				size_t       tail = _header->tail;
+
+				/* reset buffer corrupted by the client */
+				if (head >= _capacity || tail >= _capacity) {
+					_header->tail = head < _capacity ? head : 0;
+					return;
+				}
+
+				if (tail == head)
+					return;
+
+				while (tail != head) {
+
+					/* copy message to protect it from being modified */
+					size_t len = 0;
+					for (; tail != head && len < line_size - 1;
+					     tail = (tail + 1) % _capacity) {
+						char const c = _data[tail];
+						if (!c) {
+							tail = (tail + 1) % _capacity;
+							break;
+						}
+						line[len++] = c;
+					}
+					line[len] = 0;
+
+					fn((char const *)line, len);
+				}
+
+				_memory_barrier();
+				_header->tail = tail;
+				_memory_barrier();
+			}
+		}
+};
+
+#endif /* _INCLUDE__LOG_SESSION__LOG_BUFFER_H_ */
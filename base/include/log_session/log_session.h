@@ -17,7 +17,9 @@
 #include <base/capability.h>
 #include <base/stdint.h>
 #include <base/rpc_args.h>
+#include <dataspace/capability.h>
 #include <session/session.h>
+#include <signal_session/signal_session.h>
 
 namespace Genode {
 
@@ -36,13 +38,35 @@ namespace Genode {
 		 */
 		virtual size_t write(String const &string) = 0;
 
+		/**
+		 * Request ring buffer for writing messages without RPC
+		 *
+		 * The layout of the dataspace is defined by 'Log_buffer'. Messages
+		 * written via 'write' are output after the messages contained in
+		 * the ring buffer.
+		 *
+		 * \return  dataspace of the ring buffer, or an invalid capability
+		 *          if the server does not support a ring buffer
+		 */
+		virtual Dataspace_capability ring_buffer() {
+			return Dataspace_capability(); }
+
+		/**
+		 * Request signal context for informing the server about messages
+		 * appended to the empty ring buffer
+		 */
+		virtual Signal_context_capability ring_buffer_sigh() {
+			return Signal_context_capability(); }
+
 
 		/*********************
 		 ** RPC declaration **
 		 *********************/
 
 		GENODE_RPC(Rpc_write, size_t, write, String const &);
-		GENODE_RPC_INTERFACE(Rpc_write);
+		GENODE_RPC(Rpc_ring_buffer, Dataspace_capability, ring_buffer);
+		GENODE_RPC(Rpc_ring_buffer_sigh, Signal_context_capability, ring_buffer_sigh);
+		GENODE_RPC_INTERFACE(Rpc_write, Rpc_ring_buffer, Rpc_ring_buffer_sigh);
 	};
 }
 
@@ -15,7 +15,8 @@
 #ifndef _INCLUDE__UTIL__BIT_ALLOCATOR_H_
 #define _INCLUDE__UTIL__BIT_ALLOCATOR_H_
 
-#include <util/bit_array.h>
+#include <util/bit_tree.h>
+#include <util/misc_math.h>
 
 namespace Genode {
 
@@ -24,52 +25,51 @@ namespace Genode {
 	{
 		protected:
 
-			addr_t          _next;
-			Bit_array<BITS> _array;
+			Bit_tree<BITS> _tree;
 
 			void _reserve(addr_t bit_start, size_t const num)
 			{
-				if (!num) return;
-
-				_array.set(bit_start, num);
+				for (addr_t i = bit_start; i < bit_start + num; i++)
+					_tree.reserve(i);
 			}
 
 		public:
 
 			class Out_of_indices : Exception {};
 
-			Bit_allocator() : _next(0) { }
-
 			addr_t alloc(size_t const num_log2 = 0)
 			{
 				addr_t const step = 1UL << num_log2;
-				addr_t max = ~0UL;
+				addr_t index = 0;
 
-				do {
-					try {
-						/* throws exception if array is accessed outside bounds */
-						for (addr_t i = _next & ~(step - 1); i < max; i += step) {
-							if (_array.get(i, step))
-								continue;
+				/* single index, found via the summary levels of the tree */
+				if (step == 1) {
+					if (!_tree.first_free(index))
+						throw Out_of_indices();
 
-							_array.set(i, step);
-							_next = i + step;
-							return i;
-						}
-					} catch (typename Bit_array<BITS>::Invalid_index_access) { }
+					_tree.reserve(index);
+					return index;
+				}
 
-					max = _next;
-					_next = 0;
+				/* naturally aligned range of indices */
+				for (addr_t pos = 0; _tree.next_free(pos, index); ) {
 
-				} while (max != 0);
+					addr_t const start = align_addr(index, num_log2);
+					if (_tree.range_free(start, step)) {
+						_reserve(start, step);
+						return start;
+					}
+					pos = start + step;
+				}
 
 				throw Out_of_indices();
 			}
 
 			void free(addr_t const bit_start, size_t const num_log2 = 0)
 			{
-				_array.clear(bit_start, 1UL << num_log2);
-				_next = bit_start;
+				addr_t const num = 1UL << num_log2;
+				for (addr_t i = bit_start; i < bit_start + num; i++)
+					_tree.release(i);
 			}
 	};
 }
@@ -0,0 +1,315 @@
+/*
+ * \brief  Hierarchical bitmap with find-first-set lookup
+ * \author Genode Labs
+ * \date   2014-01-08
+ *
+ * The bottom level of the tree holds one bit per index, which is set if the
+ * index is free. Each bit of a higher level summarizes one word of the level
+ * below and is set if that word contains at least one free index. Looking up
+ * the first free index thereby costs one find-first-set operation per level,
+ * independent of the occupancy of the bitmap.
+ */
+
+/*
+ * Copyright (C) 2014 Genode Labs GmbH
+ *
+ * This file is part of the Genode OS framework, which is distributed
+ * under the terms of the GNU General Public License version 2.
+ */
+
+#ifndef _INCLUDE__UTIL__BIT_TREE_H_
+#define _INCLUDE__UTIL__BIT_TREE_H_
+
+#include <base/exception.h>
+#include <base/stdint.h>
+#include <util/noncopyable.h>
+#include <util/string.h>
+
+namespace Genode {
+
+	class Bit_tree_base;
+	template <unsigned> class Bit_tree;
+}
+
+
+/**
+ * Hierarchical bitmap operating on caller-provided word storage
+ *
+ * The storage must be dimensioned via 'words_needed'. The bitmap is used
+ * for allocators whose number of indices is known only at runtime.
+ */
+class Genode::Bit_tree_base : Noncopyable
+{
+	public:
+
+		enum {
+			BITS_PER_WORD_LOG2 = sizeof(addr_t) == 8 ? 6 : 5,
+			BITS_PER_WORD      = 1 << BITS_PER_WORD_LOG2,
+			MAX_LEVELS         = 4,
+		};
+
+		class Invalid_index : public Exception { };
+
+	private:
+
+		addr_t  *_words;                /* storage of all levels  */
+		addr_t   _bits;                 /* number of indices      */
+		unsigned _levels;               /* number of levels       */
+		addr_t  *_level[MAX_LEVELS];    /* first word per level   */
+		addr_t   _num_words[MAX_LEVELS];
+
+		static addr_t _words_for(addr_t bits) {
+			return (bits + BITS_PER_WORD - 1) >> BITS_PER_WORD_LOG2; }
+
+		static unsigned _ffs(addr_t word) { return __builtin_ctzl(word); }
+
+		static addr_t _bit(addr_t index) {
+			return 1UL << (index & (BITS_PER_WORD - 1)); }
+
+		/**
+		 * Mark index as used at the given level and propagate upwards
+		 */
+		void _clear(unsigned level, addr_t index)
+		{
+			for (; level < _levels; level++) {
+				addr_t &word = _level[level][index >> BITS_PER_WORD_LOG2];
+				word &= ~_bit(index);
+
+				/* word still contains free bits, summary is unaffected */
+				if (word)
+					return;
+
+				index >>= BITS_PER_WORD_LOG2;
+			}
+		}
+
+		/**
+		 * Mark index as free at the given level and propagate upwards
+		 */
+		void _set(unsigned level, addr_t index)
+		{
+			for (; level < _levels; level++) {
+				addr_t &word = _level[level][index >> BITS_PER_WORD_LOG2];
+				bool const was_empty = !word;
+				word |= _bit(index);
+
+				/* summary bit is already set */
+				if (!was_empty)
+					return;
+
+				index >>= BITS_PER_WORD_LOG2;
+			}
+		}
+
+		/**
+		 * Descend from a word at 'level' to the first free bottom-level index
+		 */
+		addr_t _descend(unsigned level, addr_t word_idx) const
+		{
+			for (;;) {
+				addr_t const index = (word_idx << BITS_PER_WORD_LOG2)
+				                   + _ffs(_level[level][word_idx]);
+				if (level == 0)
+					return index;
+
+				level--;
+				word_idx = index;
+			}
+		}
+
+	public:
+
+		/**
+		 * Return number of words needed to manage 'bits' indices
+		 */
+		static addr_t words_needed(addr_t bits)
+		{
+			addr_t sum = 0;
+			for (addr_t n = bits; ; ) {
+				n    = _words_for(n);
+				sum += n;
+				if (n <= 1)
+					return sum;
+			}
+		}
+
+		/**
+		 * Constructor
+		 *
+		 * \param words  storage of at least 'words_needed(bits)' words
+		 * \param bits   number of managed indices
+		 *
+		 * All indices are initially free.
+		 */
+		Bit_tree_base(addr_t *words, addr_t bits)
+		: _words(words), _bits(bits), _levels(0)
+		{
+			addr_t *level_start = _words;
+			for (addr_t n = bits; ; ) {
+
+				if (_levels == MAX_LEVELS)
+					throw Invalid_index();
+
+				addr_t const num_words = _words_for(n);
+
+				_level[_levels]     = level_start;
+				_num_words[_levels] = num_words;
+				_levels++;
+
+				/* mark the 'n' valid bits of this level as free */
+				memset(level_start, 0, num_words * sizeof(addr_t));
+				for (addr_t i = 0; i < n >> BITS_PER_WORD_LOG2; i++)
+					level_start[i] = ~0UL;
+				if (n & (BITS_PER_WORD - 1))
+					level_start[n >> BITS_PER_WORD_LOG2] = _bit(n) - 1;
+
+				level_start += num_words;
+				n = num_words;
+				if (n <= 1)
+					break;
+			}
+		}
+
+		addr_t bits() const { return _bits; }
+
+		/**
+		 * Return true if index is free
+		 */
+		bool free(addr_t index) const
+		{
+			if (index >= _bits)
+				throw Invalid_index();
+
+			return _level[0][index >> BITS_PER_WORD_LOG2] & _bit(index);
+		}
+
+		/**
+		 * Mark index as used
+		 */
+		void reserve(addr_t index)
+		{
+			if (index >= _bits)
+				throw Invalid_index();
+
+			_clear(0, index);
+		}
+
+		/**
+		 * Mark index as free
+		 */
+		void release(addr_t index)
+		{
+			if (index >= _bits)
+				throw Invalid_index();
+
+			_set(0, index);
+		}
+
+		/**
+		 * Lookup lowest free index
+		 *
+		 * \param index  resulting index
+		 * \return       false if no index is free
+		 */
+		bool first_free(addr_t &index) const
+		{
+			if (!_bits || !_level[_levels - 1][0])
+				return false;
+
+			index = _descend(_levels - 1, 0);
+			return true;
+		}
+
+		/**
+		 * Lookup lowest free index greater or equal to 'start'
+		 *
+		 * \return  false if no such index is free
+		 */
+		bool next_free(addr_t start, addr_t &index) const
+		{
+			if (start >= _bits)
+				return false;
+
+			/*
+			 * Ascend until a word with a free bit at or after the
+			 * position of interest is found, then descend to the
+			 * first free bottom-level index within this word.
+			 */
+			addr_t pos = start;
+			for (unsigned level = 0; level < _levels; level++) {
+
+				addr_t const word_idx = pos >> BITS_PER_WORD_LOG2;
+				if (word_idx >= _num_words[level])
+					return false;
+
+				addr_t const mask = ~(_bit(pos) - 1);
+				addr_t const word = _level[level][word_idx] & mask;
+
+				if (word) {
+					addr_t const found = (word_idx << BITS_PER_WORD_LOG2)
+					                   + _ffs(word);
+					index = level ? _descend(level - 1, found) : found;
+					return true;
+				}
+
+				/* continue with next word of the current level */
+				pos = word_idx + 1;
+			}
+			return false;
+		}
+
+		/**
+		 * Return true if all indices in range are free
+		 */
+		bool range_free(addr_t index, addr_t num) const
+		{
+			if (index + num > _bits || index + num < index)
+				return false;
+
+			for (addr_t i = index; i < index + num; ) {
+
+				addr_t const word = _level[0][i >> BITS_PER_WORD_LOG2];
+
+				/* whole word within range */
+				if ((i & (BITS_PER_WORD - 1)) == 0 && i + BITS_PER_WORD <= index + num) {
+					if (word != ~0UL)
+						return false;
+					i += BITS_PER_WORD;
+					continue;
+				}
+
+				if (!(word & _bit(i)))
+					return false;
+				i++;
+			}
+			return true;
+		}
+};
+
+
+/**
+ * Hierarchical bitmap with statically dimensioned storage
+ */
+template <unsigned BITS>
+class Genode::Bit_tree : public Bit_tree_base
+{
+	private:
+
+		enum {
+			W  = BITS_PER_WORD,
+			L0 = (BITS + W - 1) / W,
+			L1 = L0 > 1 ? (L0 + W - 1) / W : 0,
+			L2 = L1 > 1 ? (L1 + W - 1) / W : 0,
+			L3 = L2 > 1 ? (L2 + W - 1) / W : 0,
+		};
+
+		static_assert(L3 <= 1, "Bit tree exceeds maximum number of levels");
+
+		addr_t _storage[L0 + L1 + L2 + L3];
+
+	public:
+
+		Bit_tree() : Bit_tree_base(_storage, BITS) { }
+};
+
+#endif /* _INCLUDE__UTIL__BIT_TREE_H_ */
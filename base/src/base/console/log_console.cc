@@ -12,6 +12,8 @@
  */
 
 #include <log_session/connection.h>
+#include <log_session/log_buffer.h>
+#include <dataspace/client.h>
 #include <base/printf.h>
 #include <base/console.h>
 #include <base/lock.h>
@@ -27,18 +29,144 @@ class Log_console : public Console
 {
 	private:
 
-		enum { _BUF_SIZE = 216 };
+		enum {
+			_BUF_SIZE = 216,
+
+			/*
+			 * Number of messages written via RPC before asking the server
+			 * for a ring buffer, which spares components that print only
+			 * a few messages the setup of the ring buffer
+			 */
+			_RING_SETUP_THRESHOLD = 16,
+		};
 
 		Log_connection _log;
 		char           _buf[_BUF_SIZE];
 		unsigned       _num_chars;
 		Lock           _lock;
 
+		/*
+		 * Ring buffer shared with the LOG server, if supported by the
+		 * server
+		 */
+		Log_buffer                _ring;
+		void                     *_ring_base;
+		Signal_context_capability _ring_sigh;
+
+		unsigned _rpc_writes;  /* messages written via RPC so far    */
+		bool     _ring_probed; /* server was asked for a ring buffer */
+
+		/*
+		 * Actions requested by '_write', which are performed after
+		 * releasing '_lock' because they may produce diagnostic output
+		 */
+		bool _submit_pending;
+		bool _setup_pending;
+
+		/**
+		 * Drop the ring buffer of a previous LOG session
+		 */
+		void _reset_ring()
+		{
+			_ring = Log_buffer();
+
+			if (_ring_base) {
+				try { env()->rm_session()->detach(_ring_base); } catch (...) { }
+				_ring_base = 0;
+			}
+
+			_rpc_writes  = 0;
+			_ring_probed = false;
+		}
+
+		/**
+		 * Obtain ring buffer from the server, called without '_lock' held
+		 */
+		void _setup_ring()
+		{
+			Signal_context_capability sigh;
+			void *base = 0;
+			size_t size = 0;
+
+			try {
+				Dataspace_capability ds = _log.ring_buffer();
+				if (!ds.valid())
+					return;
+
+				sigh = _log.ring_buffer_sigh();
+				if (!sigh.valid())
+					return;
+
+				size = Dataspace_client(ds).size();
+				base = env()->rm_session()->attach(ds);
+			} catch (...) { return; }
+
+			Lock::Guard lock_guard(_lock);
+
+			_ring_base = base;
+			_ring_sigh = sigh;
+			_ring      = Log_buffer(base, size);
+		}
+
+		/**
+		 * Inform the server about the non-empty ring buffer, called
+		 * without '_lock' held
+		 */
+		void _submit()
+		{
+			try {
+				Signal_transmitter(_ring_sigh).submit();
+				return;
+			} catch (...) { }
+
+			/*
+			 * Let the RPC flush the ring buffer and refrain from using it
+			 * in the future.
+			 */
+			Lock::Guard lock_guard(_lock);
+			_ring = Log_buffer();
+			_log.write("");
+		}
+
+		/**
+		 * Perform the actions requested by '_write' while '_lock' was held
+		 */
+		void _complete_write(bool submit, bool setup)
+		{
+			if (submit) _submit();
+			if (setup)  _setup_ring();
+		}
+
+		/**
+		 * Output null-terminated string, called with '_lock' held
+		 *
+		 * \return  number of written characters
+		 */
+		size_t _write(char const *s, size_t len)
+		{
+			bool was_empty = false;
+			if (_ring.valid() && _ring.append(s, len, was_empty)) {
+
+				if (was_empty)
+					_submit_pending = true;
+
+				return len;
+			}
+
+			if (!_ring_probed && ++_rpc_writes >= _RING_SETUP_THRESHOLD) {
+				_ring_probed   = true;
+				_setup_pending = true;
+			}
+
+			/* fall back to RPC, which outputs the content of the ring first */
+			return _log.write(s);
+		}
+
 		void _flush()
 		{
 			/* null-terminate string */
 			_buf[_num_chars] = 0;
-			_log.write(_buf);
+			_write(_buf, _num_chars);
 
 			/* restart with empty buffer */
 			_num_chars = 0;
@@ -65,7 +193,8 @@ class Log_console : public Console
 		 */
 		Log_console()
 		:
-			_num_chars(0)
+			_num_chars(0), _ring_base(0), _rpc_writes(0), _ring_probed(false),
+			_submit_pending(false), _setup_pending(false)
 		{ }
 
 		/**
@@ -73,14 +202,36 @@ class Log_console : public Console
 		 */
 		void vprintf(const char *format, va_list list)
 		{
-			Lock::Guard lock_guard(_lock);
-			Console::vprintf(format, list);
+			bool submit = false, setup = false;
+			{
+				Lock::Guard lock_guard(_lock);
+				Console::vprintf(format, list);
+
+				submit = _submit_pending; _submit_pending = false;
+				setup  = _setup_pending;  _setup_pending  = false;
+			}
+			_complete_write(submit, setup);
 		}
 
 		/**
-		 * Return LOG session interface
+		 * Output null-terminated string
+		 *
+		 * \return  number of written characters
 		 */
-		Log_session *log_session() { return &_log; }
+		size_t write(char const *s)
+		{
+			size_t written = 0;
+			bool submit = false, setup = false;
+			{
+				Lock::Guard lock_guard(_lock);
+				written = _write(s, strlen(s));
+
+				submit = _submit_pending; _submit_pending = false;
+				setup  = _setup_pending;  _setup_pending  = false;
+			}
+			_complete_write(submit, setup);
+			return written;
+		}
 
 		/**
 		 * Re-establish LOG session
@@ -95,6 +246,7 @@ class Log_console : public Console
 			 * has no valid capability to the original LOG session anyway.
 			 */
 			new (&_log) Log_connection;
+			_reset_ring();
 		}
 };
 
@@ -123,7 +275,7 @@ Log_console *stdout_log_console()
  */
 extern "C" int stdout_write(const char *s)
 {
-	return stdout_log_console()->log_session()->write(s);
+	return stdout_log_console()->write(s);
 }
 
 
@@ -2,6 +2,12 @@
  * \brief   Low level disk I/O module using a Block session
  * \author  Christian Prochaska
  * \date    2011-05-30
+ *
+ * FatFs reads the file-allocation table sector by sector while following
+ * cluster chains, and file content at most cluster by cluster. Therefore,
+ * the sectors of the FAT are kept in a cache, and sequential reads of file
+ * content are served from a read-ahead buffer, which is filled by large
+ * Block requests.
  */
 
 /*
@@ -15,6 +21,7 @@
 #include <base/allocator_avl.h>
 #include <base/printf.h>
 #include <block_session/connection.h>
+#include <file_system/page_cache.h>
 
 /* Ffat includes */
 extern "C" {
@@ -31,6 +38,204 @@ static size_t _blk_size = 0;
 static Block::sector_t _blk_cnt  = 0;
 static Block::Session::Tx::Source *_source;
 
+enum {
+	TX_BUF_SIZE    = 512*1024,
+	MAX_PACKET     = 128*1024,
+	FAT_CACHE_SIZE = 256*1024,
+	READ_AHEAD     = 128*1024,
+};
+
+
+/**
+ * Transfer sectors synchronously
+ */
+static bool _transfer(Block::Packet_descriptor::Opcode op, Block::sector_t sector,
+                      size_t count, char *buf)
+{
+	while (count) {
+		size_t const n = min(count, (size_t)MAX_PACKET / _blk_size);
+
+		Block::Packet_descriptor p(_source->alloc_packet(n*_blk_size), op, sector, n);
+		if (op == Block::Packet_descriptor::WRITE)
+			memcpy(_source->packet_content(p), buf, n*_blk_size);
+
+		_source->submit_packet(p);
+		p = _source->get_acked_packet();
+
+		bool const ok = p.succeeded();
+		if (ok && op == Block::Packet_descriptor::READ)
+			memcpy(buf, _source->packet_content(p), n*_blk_size);
+
+		_source->release_packet(p);
+		if (!ok)
+			return false;
+
+		sector += n;
+		count  -= n;
+		buf    += n*_blk_size;
+	}
+	return true;
+}
+
+
+/**
+ * Sectors of the file-allocation tables
+ *
+ * The FAT region is cached as one node of a page cache, which is addressed
+ * by the byte offset within the region.
+ */
+struct Fat_cache
+{
+	Block::sector_t const first;
+	Block::sector_t const count;
+
+	File_system::Page_cache cache;
+
+	Fat_cache(Block::sector_t first, Block::sector_t count)
+	: first(first), count(count), cache(*env()->heap(), FAT_CACHE_SIZE) { }
+
+	bool contains(Block::sector_t sector, size_t n) const {
+		return sector >= first && sector + n <= first + count; }
+
+	bool overlaps(Block::sector_t sector, size_t n) const {
+		return sector < first + count && sector + n > first; }
+
+	bool read(Block::sector_t sector, size_t n, char *buf)
+	{
+		bool ok = true;
+
+		size_t const len = n*_blk_size;
+		size_t const res = cache.read(0, buf, len, (sector - first)*_blk_size,
+			[&] (char *dst, size_t len, File_system::seek_off_t offset) -> size_t {
+
+				Block::sector_t const s = first + offset/_blk_size;
+				size_t          const c = min((Block::sector_t)(len/_blk_size),
+				                              first + count - s);
+
+				if (!_transfer(Block::Packet_descriptor::READ, s, c, dst)) {
+					ok = false;
+					return 0;
+				}
+				return c*_blk_size;
+			});
+
+		return ok && res == len;
+	}
+
+	void invalidate(Block::sector_t sector, size_t n)
+	{
+		if (overlaps(sector, n))
+			cache.invalidate(0, (sector - min(sector, first))*_blk_size, n*_blk_size);
+	}
+};
+
+static Fat_cache *_fat_cache;
+
+
+/**
+ * Buffer for reading sequentially accessed sectors in advance
+ */
+struct Read_ahead
+{
+	char           *buf;
+	size_t    const max;     /* capacity in sectors */
+	Block::sector_t start;
+	size_t          count;   /* valid sectors */
+	Block::sector_t next;    /* sector following the last read */
+
+	Read_ahead()
+	:
+		buf((char *)env()->heap()->alloc(READ_AHEAD)),
+		max(READ_AHEAD / _blk_size), start(0), count(0), next(~(Block::sector_t)0)
+	{ }
+
+	bool read(Block::sector_t sector, size_t n, char *dst)
+	{
+		bool const sequential = sector == next;
+		next = sector + n;
+
+		if (sector < start || sector + n > start + count) {
+
+			if (!sequential || n >= max || sector + n > _blk_cnt)
+				return _transfer(Block::Packet_descriptor::READ, sector, n, dst);
+
+			start = sector;
+			count = min((Block::sector_t)max, _blk_cnt - sector);
+			if (!_transfer(Block::Packet_descriptor::READ, start, count, buf)) {
+				count = 0;
+				return false;
+			}
+		}
+
+		memcpy(dst, buf + (sector - start)*_blk_size, n*_blk_size);
+		return true;
+	}
+
+	void invalidate(Block::sector_t sector, size_t n)
+	{
+		if (sector < start + count && sector + n > start)
+			count = 0;
+	}
+};
+
+static Read_ahead *_read_ahead;
+
+
+/**
+ * Locate the file-allocation tables via the boot sector
+ *
+ * Like FatFs, we look for a FAT boot sector at sector 0 or at the start of
+ * the first partition.
+ */
+static void _init_fat_cache()
+{
+	if (_blk_size < 512 || _blk_size > File_system::Page_cache::PAGE_SIZE)
+		return;
+
+	unsigned char * const bs = (unsigned char *)env()->heap()->alloc(_blk_size);
+
+	struct Boot_sector
+	{
+		static unsigned word(unsigned char const *p)  { return p[0] | p[1] << 8; }
+		static unsigned dword(unsigned char const *p) { return word(p) | word(p + 2) << 16; }
+
+		static bool fat(unsigned char const *bs)
+		{
+			return word(bs + 510) == 0xaa55
+			    && (strcmp((char const *)bs + 0x36, "FAT", 3) == 0
+			     || strcmp((char const *)bs + 0x52, "FAT", 3) == 0);
+		}
+	};
+
+	Block::sector_t base = 0;
+	bool found = _transfer(Block::Packet_descriptor::READ, 0, 1, (char *)bs)
+	          && Boot_sector::fat(bs);
+
+	if (!found && Boot_sector::word(bs + 510) == 0xaa55) {
+		base  = Boot_sector::dword(bs + 0x1c6);
+		found = base < _blk_cnt
+		     && _transfer(Block::Packet_descriptor::READ, base, 1, (char *)bs)
+		     && Boot_sector::fat(bs);
+	}
+
+	if (found) {
+		unsigned const reserved = Boot_sector::word(bs + 14);
+		unsigned const num_fats = bs[16];
+		unsigned       fat_size = Boot_sector::word(bs + 22);
+		if (!fat_size)
+			fat_size = Boot_sector::dword(bs + 36);
+
+		_fat_cache = new (env()->heap())
+			Fat_cache(base + reserved, (Block::sector_t)num_fats*fat_size);
+
+		if (verbose)
+			PDBG("caching FAT at sectors %llu..%llu", _fat_cache->first,
+			     _fat_cache->first + _fat_cache->count - 1);
+	}
+
+	env()->heap()->free(bs, _blk_size);
+}
+
 
 extern "C" DSTATUS disk_initialize (BYTE drv)
 {
@@ -50,7 +255,8 @@ extern "C" DSTATUS disk_initialize (BYTE drv)
 	}
 
 	try {
-		_block_connection = new (Genode::env()->heap()) Block::Connection(&_block_alloc);
+		_block_connection = new (Genode::env()->heap())
+			Block::Connection(&_block_alloc, TX_BUF_SIZE);
 	} catch(...) {
 		PERR("could not open block connection");
 		return STA_NOINIT;
@@ -75,6 +281,9 @@ extern "C" DSTATUS disk_initialize (BYTE drv)
 		PDBG("We have %llu blocks with a size of %zu bytes",
 		     _blk_cnt, _blk_size);
 
+	_read_ahead = new (env()->heap()) Read_ahead;
+	_init_fat_cache();
+
 	initialized = true;
 
 	return 0;
@@ -103,29 +312,16 @@ extern "C" DRESULT disk_read(BYTE drv, BYTE *buff, DWORD sector, BYTE count)
 		return RES_ERROR;
 	}
 
-	/* allocate packet-descriptor for reading */
-	Block::Packet_descriptor p(_source->alloc_packet(_blk_size),
-	                           Block::Packet_descriptor::READ, sector, count);
-	_source->submit_packet(p);
-	p = _source->get_acked_packet();
+	bool const ok = (_fat_cache && _fat_cache->contains(sector, count))
+	              ? _fat_cache->read(sector, count, (char *)buff)
+	              : _read_ahead->read(sector, count, (char *)buff);
 
 	/* check for success of operation */
-	if (!p.succeeded()) {
+	if (!ok) {
 		PERR("Could not read block(s)");
-		_source->release_packet(p);
 		return RES_ERROR;
 	}
 
-	memcpy(buff, _source->packet_content(p), count * _blk_size);
-
-#if 0
-	PDBG("read() successful, contents of buff = \n");
-
-	for (unsigned int i = 0; i < count * _blk_size; i++)
-		PDBG("%8x: %2x %c", i, buff[i], buff[i] >= 32 ? buff[i] : '-');
-#endif
-
-	_source->release_packet(p);
 	return RES_OK;
 }
 
@@ -142,23 +338,17 @@ extern "C" DRESULT disk_write(BYTE drv, const BYTE *buff, DWORD sector, BYTE cou
 		return RES_ERROR;
 	}
 
-	/* allocate packet-descriptor for writing */
-	Block::Packet_descriptor p(_source->alloc_packet(_blk_size),
-	                           Block::Packet_descriptor::WRITE, sector, count);
-
-	memcpy(_source->packet_content(p), buff, count * _blk_size);
-
-	_source->submit_packet(p);
-	p = _source->get_acked_packet();
+	/* drop cached content before it becomes outdated */
+	if (_fat_cache)
+		_fat_cache->invalidate(sector, count);
+	_read_ahead->invalidate(sector, count);
 
 	/* check for success of operation */
-	if (!p.succeeded()) {
+	if (!_transfer(Block::Packet_descriptor::WRITE, sector, count, (char *)buff)) {
 		PERR("Could not write block(s)");
-		_source->release_packet(p);
 		return RES_ERROR;
 	}
 
-	_source->release_packet(p);
 	return RES_OK;
 }
 #endif /* _READONLY */
@@ -16,6 +16,7 @@
 #include <base/printf.h>
 #include <file_system_session/connection.h>
 #include <os/path.h>
+#include <util/list.h>
 
 /* libc includes */
 #include <errno.h>
@@ -47,14 +48,144 @@ enum { PATH_MAX_LEN = 256 };
 typedef Genode::Path<PATH_MAX_LEN> Canonical_path;
 
 
+typedef File_system::Session::Tx::Source Source;
+
+
 static File_system::Session *file_system()
 {
+	enum { TX_BUF_SIZE = 256*1024, TX_QUEUE_SIZE = 64 };
+
 	static Genode::Allocator_avl tx_buffer_alloc(Genode::env()->heap());
-	static File_system::Connection fs(tx_buffer_alloc);
+	static File_system::Connection fs(tx_buffer_alloc, TX_BUF_SIZE, "",
+	                                  TX_QUEUE_SIZE);
 	return &fs;
 }
 
 
+/**
+ * Number of packets submitted by all contexts and not yet acknowledged
+ */
+static unsigned packets_in_flight;
+
+
+/**
+ * Read requests of a file handle, including those issued ahead of time
+ *
+ * The requests cover consecutive ranges of the file in the order of their
+ * submission. The first request is the one to be consumed next.
+ */
+class Read_ahead
+{
+	public:
+
+		enum { MAX_PACKETS = 8 };
+
+		struct Request
+		{
+			File_system::Packet_descriptor packet;
+			bool                           done;
+			Genode::size_t                 consumed;  /* bytes copied out */
+
+			File_system::seek_off_t position() const {
+				return packet.position() + consumed; }
+
+			File_system::seek_off_t end() const {
+				return packet.position() + packet.size(); }
+		};
+
+	private:
+
+		Request  _request[MAX_PACKETS];
+		unsigned _first;
+		unsigned _count;
+
+		Request &_at(unsigned i) { return _request[(_first + i)%MAX_PACKETS]; }
+
+		/* bulk-buffer space occupied by the requests of all handles */
+		static Genode::size_t &_occupied()
+		{
+			static Genode::size_t bytes;
+			return bytes;
+		}
+
+	public:
+
+		Read_ahead() : _first(0), _count(0) { }
+
+		static Genode::size_t occupied() { return _occupied(); }
+
+		bool empty() const { return _count == 0; }
+		bool full()  const { return _count == MAX_PACKETS; }
+
+		Request &first() { return _at(0); }
+		Request &last()  { return _at(_count - 1); }
+
+		void add(File_system::Packet_descriptor packet)
+		{
+			Request &r = _at(_count++);
+			r.packet   = packet;
+			r.done     = false;
+			r.consumed = 0;
+
+			_occupied() += packet.size();
+		}
+
+		/**
+		 * Record acknowledgement of a request
+		 *
+		 * \return false if the packet does not belong to a request
+		 */
+		bool complete(File_system::Packet_descriptor const &packet)
+		{
+			for (unsigned i = 0; i < _count; i++) {
+				Request &r = _at(i);
+				if (!r.done && r.packet.offset() == packet.offset()) {
+					r.packet = packet;
+					r.done   = true;
+
+					/* a failed request ends the file */
+					if (!packet.succeeded())
+						r.packet.length(0);
+					return true;
+				}
+			}
+			return false;
+		}
+
+		/**
+		 * Release first request
+		 */
+		void remove_first(Source &source)
+		{
+			_occupied() -= first().packet.size();
+			source.release_packet(first().packet);
+			_first = (_first + 1)%MAX_PACKETS;
+			_count--;
+		}
+};
+
+
+/**
+ * Mapping of a file dataspace
+ *
+ * Used to distinguish attached dataspaces from copies of the file content
+ * in anonymous memory.
+ */
+struct Mapping : Genode::List<Mapping>::Element
+{
+	void * const addr;
+
+	Mapping(void *addr) : addr(addr) { }
+};
+
+
+static Genode::List<Mapping> *mappings()
+{
+	static Genode::List<Mapping> list;
+	return &list;
+}
+
+
 struct Node_handle_guard
 {
 	File_system::Node_handle handle;
@@ -84,24 +215,49 @@ class Plugin_context : public Libc::Plugin_context,
 		 */
 		off_t _seek_offset;
 
+		/**
+		 * End of the last read, used to detect sequential access
+		 */
+		off_t _read_end;
+
 	public:
 
-		bool in_flight;
+		/* number of write packets not yet acknowledged */
+		unsigned writes_in_flight;
+
+		/* error of a write not yet reported to the application */
+		int write_error;
+
+		Read_ahead read_ahead;
 
 		Plugin_context(File_system::File_handle handle)
 		: _type(TYPE_FILE), _node_handle(handle), _fd_flags(0),
-		  _status_flags(0), _seek_offset(~0), in_flight(false) { }
+		  _status_flags(0), _seek_offset(~0), _read_end(0),
+		  writes_in_flight(0), write_error(0) { }
 
 		Plugin_context(File_system::Dir_handle handle)
 		: _type(TYPE_DIR), _node_handle(handle), _fd_flags(0),
-		  _status_flags(0), _seek_offset(0), in_flight(false) { }
+		  _status_flags(0), _seek_offset(0), _read_end(0),
+		  writes_in_flight(0), write_error(0) { }
 
 		Plugin_context(File_system::Symlink_handle handle)
 		: _type(TYPE_SYMLINK), _node_handle(handle), _fd_flags(0),
-		  _status_flags(0), _seek_offset(~0), in_flight(false) { }
+		  _status_flags(0), _seek_offset(~0), _read_end(0),
+		  writes_in_flight(0), write_error(0) { }
 
 		File_system::Node_handle node_handle() const { return _node_handle; }
 
+		/**
+		 * Return true if reading ahead is worthwhile
+		 *
+		 * Directory entries and symlinks are not read ahead. Files are read
+		 * ahead if the current read continues the previous one.
+		 */
+		bool sequential() const {
+			return _type == TYPE_FILE && _seek_offset == _read_end; }
+
+		void read_end(off_t end) { _read_end = end; }
+
 		/**
 		 * Set/get file descriptor flags
 		 */
@@ -155,14 +311,28 @@ static inline Plugin_context *context(Libc::File_descriptor *fd)
 }
 
 
-static void wait_for_acknowledgement(File_system::Session::Tx::Source &source)
+static void wait_for_acknowledgement(Source &source)
 {
 	::File_system::Packet_descriptor packet = source.get_acked_packet();
-	
+
 	if (verbose)
 		PDBG("got acknowledgement for packet of size %zd", packet.size());
 
-	static_cast<Plugin_context *>(packet.ref())->in_flight = false;
+	packets_in_flight--;
+
+	Plugin_context &context = *static_cast<Plugin_context *>(packet.ref());
+
+	/* the payload of reads is kept until consumed */
+	if (packet.operation() == File_system::Packet_descriptor::READ
+	 && context.read_ahead.complete(packet))
+		return;
+
+	if (packet.operation() == File_system::Packet_descriptor::WRITE) {
+		context.writes_in_flight--;
+
+		if (!packet.succeeded() || packet.length() < packet.size())
+			context.write_error = EIO;
+	}
 
 	source.release_packet(packet);
 }
@@ -175,13 +345,79 @@ static void wait_for_acknowledgement(File_system::Session::Tx::Source &source)
  * This function should be called prior enqueing new packets into the
  * packet stream to free up space in the bulk buffer.
  */
-static void collect_acknowledgements(File_system::Session::Tx::Source &source)
+static void collect_acknowledgements(Source &source)
 {
 	while (source.ack_avail())
 		wait_for_acknowledgement(source);
 }
 
 
+/**
+ * Allocate packet, waiting for acknowledgements if the buffer is exhausted
+ *
+ * If no packet is in flight, the size of the packet is reduced until it
+ * fits. Hence, the returned packet may be smaller than requested.
+ */
+static File_system::Packet_descriptor alloc_packet(Source &source,
+                                                   Genode::size_t size)
+{
+	for (;;) {
+		try { return source.alloc_packet(size); }
+		catch (Source::Packet_alloc_failed) { }
+
+		if (packets_in_flight)
+			wait_for_acknowledgement(source);
+		else if (size > 1)
+			size /= 2;
+	}
+}
+
+
+/**
+ * Submit packet of the given context
+ */
+static void submit_packet(Source &source, Plugin_context &context,
+                          File_system::Packet_descriptor packet)
+{
+	if (packet.operation() == File_system::Packet_descriptor::WRITE)
+		context.writes_in_flight++;
+	else
+		context.read_ahead.add(packet);
+
+	packets_in_flight++;
+	source.submit_packet(packet);
+}
+
+
+/**
+ * Drop read requests, e.g., because the file is accessed elsewhere
+ */
+static void discard_read_ahead(Source &source, Plugin_context &context)
+{
+	while (!context.read_ahead.empty()) {
+		while (!context.read_ahead.first().done)
+			wait_for_acknowledgement(source);
+		context.read_ahead.remove_first(source);
+	}
+}
+
+
+/**
+ * Wait until all writes of the context are processed by the server
+ *
+ * \return  error of a write, or 0 if all writes succeeded
+ */
+static int flush_writes(Source &source, Plugin_context &context)
+{
+	while (context.writes_in_flight)
+		wait_for_acknowledgement(source);
+
+	int const error = context.write_error;
+	context.write_error = 0;
+	return error;
+}
+
+
 static void obtain_stat_for_node(File_system::Node_handle node_handle,
                                  struct stat *buf)
 {
@@ -217,6 +453,61 @@ class Plugin : public Libc::Plugin
 {
 	private:
 
+		enum {
+			READ_PACKETS_PER_BUFFER = 16, /* read request size as fraction
+			                                 of the bulk buffer            */
+			READ_AHEAD_PACKETS      = 4,  /* requests issued beyond the
+			                                 range read by the application */
+			WRITE_PACKETS_PER_BUFFER = 8,
+		};
+
+		/**
+		 * Issue read requests for the remaining range of a read call
+		 *
+		 * For sequential access, the requests extend beyond the range by
+		 * 'READ_AHEAD_PACKETS'. Requests ahead are issued only if the
+		 * requests of all handles leave most of the bulk buffer to other
+		 * operations.
+		 */
+		void _issue_reads(Source &source, Plugin_context &ctx,
+		                  size_t remaining, bool sequential)
+		{
+			size_t const chunk = source.bulk_buffer_size()/READ_PACKETS_PER_BUFFER;
+
+			File_system::seek_off_t const start = ctx.seek_offset();
+			File_system::seek_off_t const end   = start + remaining
+				+ (sequential ? READ_AHEAD_PACKETS*chunk : 0);
+
+			while (!ctx.read_ahead.full()) {
+
+				File_system::seek_off_t const pos = ctx.read_ahead.empty()
+				                                  ? start : ctx.read_ahead.last().end();
+				if (pos >= end)
+					return;
+
+				size_t const size = Genode::min((size_t)(end - pos), chunk);
+
+				bool const ahead = pos >= start + remaining;
+				if (ahead && Read_ahead::occupied() + size > source.bulk_buffer_size()/4)
+					return;
+
+				File_system::Packet_descriptor raw;
+				if (ctx.read_ahead.empty()) {
+					raw = alloc_packet(source, size);
+				} else {
+					try { raw = source.alloc_packet(size); }
+					catch (Source::Packet_alloc_failed) { return; }
+				}
+
+				submit_packet(source, ctx,
+				              File_system::Packet_descriptor(raw,
+				                  static_cast<File_system::Packet_ref *>(&ctx),
+				                  ctx.node_handle(),
+				                  File_system::Packet_descriptor::READ,
+				                  raw.size(), pos));
+			}
+		}
+
 		::off_t _file_size(Libc::File_descriptor *fd)
 		{
 			struct stat stat_buf;
@@ -287,18 +578,21 @@ class Plugin : public Libc::Plugin
 
 		int close(Libc::File_descriptor *fd)
 		{
+			Source &source = *file_system()->tx();
+
 			/* wait for the completion of all operations of the context */
-			while (context(fd)->in_flight) {
-				if (verbose)
-					PDBG("wait_for_acknowledgement");
-				wait_for_acknowledgement(*file_system()->tx());
-			}
+			discard_read_ahead(source, *context(fd));
+			int const error = flush_writes(source, *context(fd));
 
 			file_system()->close(context(fd)->node_handle());
 
 			Genode::destroy(Genode::env()->heap(), context(fd));
 			Libc::file_descriptor_allocator()->free(fd);
 
+			if (error) {
+				errno = error;
+				return -1;
+			}
 			return 0;
 		}
 
@@ -314,6 +608,11 @@ class Plugin : public Libc::Plugin
 
 		int fstat(Libc::File_descriptor *fd, struct stat *buf)
 		{
+			/* let the size reflect the queued writes */
+			Source &source = *file_system()->tx();
+			while (context(fd)->writes_in_flight)
+				wait_for_acknowledgement(source);
+
 			try {
 				obtain_stat_for_node(context(fd)->node_handle(), buf);
 				return 0;
@@ -335,9 +634,14 @@ class Plugin : public Libc::Plugin
 
 		int fsync(Libc::File_descriptor *fd)
 		{
-			if (verbose)
-				PDBG("not implemented");
-			return -1;
+			int const error = flush_writes(*file_system()->tx(), *context(fd));
+			if (error) {
+				errno = error;
+				return -1;
+			}
+
+			file_system()->sync();
+			return 0;
 		}
 
 		int ftruncate(Libc::File_descriptor *fd, ::off_t length)
@@ -346,6 +650,12 @@ class Plugin : public Libc::Plugin
 			File_system::File_handle &file_handle =
 			    static_cast<File_system::File_handle&>(node_handle);
 
+			/* apply queued writes before truncating */
+			Source &source = *file_system()->tx();
+			discard_read_ahead(source, *context(fd));
+			while (context(fd)->writes_in_flight)
+				wait_for_acknowledgement(source);
+
 			try {
 				file_system()->truncate(file_handle, length);
 			} catch (File_system::Invalid_handle) {
@@ -563,70 +873,69 @@ class Plugin : public Libc::Plugin
 
 		ssize_t read(Libc::File_descriptor *fd, void *buf, ::size_t count)
 		{
-			File_system::Session::Tx::Source &source = *file_system()->tx();
-
-			size_t const max_packet_size = source.bulk_buffer_size() / 2;
-
-			size_t remaining_count = count;
-
-			if (context(fd)->seek_offset() == ~0)
-				context(fd)->seek_offset(0);
+			Source &source = *file_system()->tx();
+			Plugin_context &ctx = *context(fd);
 
-			while (remaining_count) {
+			if (ctx.write_error) {
+				errno = ctx.write_error;
+				ctx.write_error = 0;
+				return -1;
+			}
 
-				collect_acknowledgements(source);
+			if (ctx.seek_offset() == ~0)
+				ctx.seek_offset(0);
 
-				size_t curr_packet_size = Genode::min(remaining_count, max_packet_size);
+			collect_acknowledgements(source);
 
-				/*
-				 * XXX handle 'Packet_alloc_failed' exception'
-				 */
-				File_system::Packet_descriptor
-					packet(source.alloc_packet(curr_packet_size),
-					       static_cast<File_system::Packet_ref *>(context(fd)),
-					       context(fd)->node_handle(),
-					       File_system::Packet_descriptor::READ,
-					       curr_packet_size,
-					       context(fd)->seek_offset());
+			bool const sequential = ctx.sequential();
 
-				/* mark context as having an operation in flight */
-				context(fd)->in_flight = true;
+			/* requests issued ahead are useful only if the access continues */
+			if (!sequential || (!ctx.read_ahead.empty()
+			 && ctx.read_ahead.first().position() != (File_system::seek_off_t)ctx.seek_offset()))
+				discard_read_ahead(source, ctx);
 
-				/* pass packet to server side */
-				source.submit_packet(packet);
+			size_t remaining_count = count;
 
-				do {
-					packet = source.get_acked_packet();
-					static_cast<Plugin_context *>(packet.ref())->in_flight = false;
-				} while (context(fd)->in_flight);
+			while (remaining_count) {
 
-				context(fd)->in_flight = false;
+				_issue_reads(source, ctx, remaining_count, sequential);
 
-				/*
-				 * XXX check if acked packet belongs to request,
-				 *     needed for thread safety
-				 */
+				Read_ahead::Request &r = ctx.read_ahead.first();
+				while (!r.done)
+					wait_for_acknowledgement(source);
 
-				size_t read_num_bytes = Genode::min(packet.length(), curr_packet_size);
+				size_t const available = r.packet.length() > r.consumed
+				                       ? r.packet.length() - r.consumed : 0;
+				size_t const read_num_bytes = Genode::min(available, remaining_count);
 
 				/* copy-out payload into destination buffer */
-				memcpy(buf, source.packet_content(packet), read_num_bytes);
+				memcpy(buf, source.packet_content(r.packet) + r.consumed, read_num_bytes);
 
-				source.release_packet(packet);
+				r.consumed += read_num_bytes;
 
 				/* prepare next iteration */
-				context(fd)->advance_seek_offset(read_num_bytes);
+				ctx.advance_seek_offset(read_num_bytes);
 				buf = (void *)((Genode::addr_t)buf + read_num_bytes);
 				remaining_count -= read_num_bytes;
 
+				if (r.consumed < r.packet.length())
+					continue;
+
 				/*
 				 * If we received less bytes than requested, we reached the end
 				 * of the file.
 				 */
-				if (read_num_bytes < curr_packet_size)
+				bool const end_of_file = r.packet.length() < r.packet.size();
+
+				ctx.read_ahead.remove_first(source);
+
+				if (end_of_file) {
+					discard_read_ahead(source, ctx);
 					break;
+				}
 			}
 
+			ctx.read_end(ctx.seek_offset());
 			return count - remaining_count;
 		}
 
@@ -724,6 +1033,9 @@ class Plugin : public Libc::Plugin
 
 				ssize_t res = write(fd, oldpath, strlen(oldpath) + 1);
 
+				if (flush_writes(*file_system()->tx(), *context))
+					res = -1;
+
 				Libc::file_descriptor_allocator()->free(fd);
 				destroy(Genode::env()->heap(), context);
 
@@ -748,45 +1060,55 @@ class Plugin : public Libc::Plugin
 
 		ssize_t write(Libc::File_descriptor *fd, const void *buf, ::size_t count)
 		{
-			File_system::Session::Tx::Source &source = *file_system()->tx();
+			Source &source = *file_system()->tx();
+			Plugin_context &ctx = *context(fd);
+
+			/* report failure of a previous write */
+			if (ctx.write_error) {
+				errno = ctx.write_error;
+				ctx.write_error = 0;
+				return -1;
+			}
 
-			size_t const max_packet_size = source.bulk_buffer_size() / 2;
+			collect_acknowledgements(source);
+
+			/* data read ahead may be outdated by the write */
+			discard_read_ahead(source, ctx);
+
+			size_t const max_packet_size =
+				source.bulk_buffer_size() / WRITE_PACKETS_PER_BUFFER;
 
 			size_t remaining_count = count;
 
+			/*
+			 * The write returns once the data is queued. Failures are
+			 * reported by the next operation on the file handle.
+			 */
 			while (remaining_count) {
 
-				collect_acknowledgements(source);
+				File_system::Packet_descriptor raw =
+					alloc_packet(source, Genode::min(remaining_count, max_packet_size));
 
-				size_t curr_packet_size = Genode::min(remaining_count, max_packet_size);
+				size_t const curr_packet_size = raw.size();
 
-				try {
-					File_system::Packet_descriptor
-						packet(source.alloc_packet(curr_packet_size),
-							   static_cast<File_system::Packet_ref *>(context(fd)),
-							   context(fd)->node_handle(),
-							   File_system::Packet_descriptor::WRITE,
-							   curr_packet_size,
-							   context(fd)->seek_offset());
-
-					/* mark context as having an operation in flight */
-					context(fd)->in_flight = true;
-
-					/* copy-in payload into packet */
-					memcpy(source.packet_content(packet), buf, curr_packet_size);
-
-					/* pass packet to server side */
-					source.submit_packet(packet);
-
-					/* prepare next iteration */
-					context(fd)->advance_seek_offset(curr_packet_size);
-					buf = (void *)((Genode::addr_t)buf + curr_packet_size);
-					remaining_count -= curr_packet_size;
-				} catch (File_system::Session::Tx::Source::Packet_alloc_failed) {
-					do {
-						wait_for_acknowledgement(source);
-					} while (context(fd)->in_flight);
-				}
+				File_system::Packet_descriptor
+					packet(raw,
+					       static_cast<File_system::Packet_ref *>(&ctx),
+					       ctx.node_handle(),
+					       File_system::Packet_descriptor::WRITE,
+					       curr_packet_size,
+					       ctx.seek_offset());
+
+				/* copy-in payload into packet */
+				memcpy(source.packet_content(packet), buf, curr_packet_size);
+
+				/* pass packet to server side */
+				submit_packet(source, ctx, packet);
+
+				/* prepare next iteration */
+				ctx.advance_seek_offset(curr_packet_size);
+				buf = (void *)((Genode::addr_t)buf + curr_packet_size);
+				remaining_count -= curr_packet_size;
 			}
 
 			if (verbose)
@@ -797,18 +1119,60 @@ class Plugin : public Libc::Plugin
 		void *mmap(void *addr_in, ::size_t length, int prot, int flags,
 		           Libc::File_descriptor *fd, ::off_t offset)
 		{
-			if (prot != PROT_READ) {
-				PERR("mmap for prot=%x not supported", prot);
-				errno = EACCES;
-				return (void *)-1;
-			}
-
 			if (addr_in != 0) {
 				PERR("mmap for predefined address not supported");
 				errno = EINVAL;
 				return (void *)-1;
 			}
 
+			bool const writeable = prot & PROT_WRITE;
+			bool const shared    = flags & MAP_SHARED;
+
+			/* let the file reflect the queued writes */
+			Source &source = *file_system()->tx();
+			discard_read_ahead(source, *context(fd));
+			while (context(fd)->writes_in_flight)
+				wait_for_acknowledgement(source);
+
+			/*
+			 * Attach the file content provided by the file system, unless a
+			 * private copy is needed because the mapping may be modified.
+			 */
+			Genode::Dataspace_capability ds;
+			if (!writeable || shared) {
+				File_system::Node_handle node_handle = context(fd)->node_handle();
+				File_system::File_handle &file_handle =
+				    static_cast<File_system::File_handle&>(node_handle);
+
+				try {
+					ds = file_system()->dataspace(file_handle, offset + length,
+				                                       writeable);
+				} catch (File_system::Permission_denied) {
+					errno = EACCES;
+					return (void *)-1;
+				} catch (...) { }
+			}
+
+			if (ds.valid()) {
+				try {
+					void *addr = Genode::env()->rm_session()->attach(ds, length, offset,
+					                                                 false, (Genode::addr_t)0,
+					                                                 prot & PROT_EXEC);
+					mappings()->insert(new (Genode::env()->heap()) Mapping(addr));
+					return addr;
+				} catch (...) {
+					PERR("mmap could not attach file dataspace");
+					errno = ENOMEM;
+					return (void *)-1;
+				}
+			}
+
+			if (writeable && shared) {
+				PERR("shared writeable mapping not supported by file system");
+				errno = ENODEV;
+				return (void *)-1;
+			}
+
 			void *addr = Libc::mem_alloc()->alloc(length, PAGE_SHIFT);
 			if (addr == (void *)-1) {
 				errno = ENOMEM;
@@ -827,6 +1191,16 @@ class Plugin : public Libc::Plugin
 
 		int munmap(void *addr, ::size_t)
 		{
+			for (Mapping *m = mappings()->first(); m; m = m->next()) {
+				if (m->addr != addr)
+					continue;
+
+				Genode::env()->rm_session()->detach(addr);
+				mappings()->remove(m);
+				Genode::destroy(Genode::env()->heap(), m);
+				return 0;
+			}
+
 			Libc::mem_alloc()->free(addr);
 			return 0;
 		}
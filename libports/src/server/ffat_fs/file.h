@@ -45,7 +45,12 @@ namespace File_system {
 				if (seek_offset == (seek_off_t)(~0))
 					seek_offset = _ffat_fil.fsize;
 
-				FRESULT res = f_lseek(&_ffat_fil, seek_offset);
+				/*
+				 * Seeking follows the cluster chain, which is not needed if
+				 * the file is accessed sequentially.
+				 */
+				FRESULT res = seek_offset == _ffat_fil.fptr
+				            ? FR_OK : f_lseek(&_ffat_fil, seek_offset);
 
 				switch(res) {
 					case FR_OK:
@@ -111,7 +116,12 @@ namespace File_system {
 				if (seek_offset == (seek_off_t)(~0))
 					seek_offset = _ffat_fil.fsize;
 
-				FRESULT res = f_lseek(&_ffat_fil, seek_offset);
+				/*
+				 * Seeking follows the cluster chain, which is not needed if
+				 * the file is accessed sequentially.
+				 */
+				FRESULT res = seek_offset == _ffat_fil.fptr
+				            ? FR_OK : f_lseek(&_ffat_fil, seek_offset);
 
 				switch(res) {
 					case FR_OK:
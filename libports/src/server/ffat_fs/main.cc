@@ -12,12 +12,16 @@
  */
 
 /* Genode includes */
+#include <file_system/page_cache.h>
 #include <file_system_session/rpc_object.h>
 #include <root/component.h>
 #include <cap_session/connection.h>
 #include <os/attached_rom_dataspace.h>
 #include <os/config.h>
+#include <os/reporter.h>
 #include <os/session_policy.h>
+#include <timer_session/connection.h>
+#include <util/volatile_object.h>
 #include <util/xml_node.h>
 
 /* local includes */
@@ -45,6 +49,15 @@ static Lock _ffat_lock;
 typedef Lock_guard<Lock> Ffat_lock_guard;
 
 
+/*
+ * Cache of file content shared by all sessions, zero if not configured
+ *
+ * Files are identified by their first cluster. Because clusters of
+ * removed files are reused, the cache is flushed on 'unlink'.
+ */
+static File_system::Page_cache *_page_cache;
+
+
 static bool const verbose = false;
 #define PDBGV(...) if (verbose) PDBG(__VA_ARGS__)
 
@@ -91,15 +104,31 @@ namespace File_system {
 
 				Ffat_lock_guard ffat_lock_guard(_ffat_lock);
 
+				/* empty files have no cluster and are not cached */
+				File *file = dynamic_cast<File *>(&node);
+				Page_cache::Node_id const file_id =
+					(_page_cache && file) ? file->ffat_fil()->org_clust : 0;
+
 				switch (packet.operation()) {
 
 					case Packet_descriptor::READ:
 						PDBGV("READ");
-						res_length = node.read((char *)content, length, offset);
+						if (file_id && offset != (seek_off_t)(~0))
+							res_length = _page_cache->read(file_id, (char *)content,
+							                               length, offset,
+								[&] (char *dst, size_t len, seek_off_t off) {
+									return node.read(dst, len, off); });
+						else
+							res_length = node.read((char *)content, length, offset);
 						break;
 
 					case Packet_descriptor::WRITE:
 						PDBGV("WRITE");
+						if (file_id && offset == (seek_off_t)(~0))
+							_page_cache->invalidate(file_id);
+						else if (file_id)
+							_page_cache->invalidate(file_id, offset, length);
+
 						res_length = node.write((char const *)content, length, offset);
 						break;
 				}
@@ -172,11 +201,13 @@ namespace File_system {
 			/**
 			 * Constructor
 			 */
-			Session_component(size_t tx_buf_size, Rpc_entrypoint &ep,
+			Session_component(size_t tx_buf_size, unsigned tx_queue_size,
+			                  Rpc_entrypoint &ep,
 			                  Signal_receiver &sig_rec,
 			                  Directory &root, bool writable)
 			:
-				Session_rpc_object(env()->ram_session()->alloc(tx_buf_size), ep),
+				Session_rpc_object(env()->ram_session()->alloc(tx_buf_size), ep,
+				                   tx_queue_size),
 				_root(root),
 				_writable(writable),
 				_process_packet_dispatcher(sig_rec, *this,
@@ -672,6 +703,8 @@ namespace File_system {
 
 				switch(res) {
 					case FR_OK:
+						if (_page_cache)
+							_page_cache->invalidate_all();
 						break;
 					case FR_NO_FILE:
 					case FR_NO_PATH:
@@ -717,6 +750,9 @@ namespace File_system {
 
 				using namespace Ffat;
 
+				if (_page_cache && file->ffat_fil()->org_clust)
+					_page_cache->invalidate(file->ffat_fil()->org_clust);
+
 				/* 'f_truncate()' truncates to the current seek pointer */
 
 				FRESULT res = f_lseek(file->ffat_fil(), size);
@@ -963,6 +999,8 @@ namespace File_system {
 					Arg_string::find_arg(args, "ram_quota"  ).ulong_value(0);
 				size_t tx_buf_size =
 					Arg_string::find_arg(args, "tx_buf_size").ulong_value(0);
+				unsigned tx_queue_size =
+					Arg_string::find_arg(args, "tx_queue_size").ulong_value(Session::TX_QUEUE_SIZE);
 
 				/*
 				 * Check if donated ram quota suffices for session data,
@@ -975,7 +1013,7 @@ namespace File_system {
 					throw Root::Quota_exceeded();
 				}
 				return new (md_alloc())
-					Session_component(tx_buf_size, _channel_ep, _sig_rec,
+					Session_component(tx_buf_size, tx_queue_size, _channel_ep, _sig_rec,
 					                  *session_root_dir, writeable);
 			}
 
@@ -999,6 +1037,32 @@ namespace File_system {
 };
 
 
+/**
+ * Periodic report of the cache statistics
+ */
+struct Page_cache_reporter
+{
+	File_system::Page_cache &cache;
+
+	Reporter          reporter { "page_cache" };
+	Timer::Connection timer;
+
+	Signal_dispatcher<Page_cache_reporter> dispatcher;
+
+	void handle_timeout(unsigned) { cache.report(reporter); }
+
+	Page_cache_reporter(Signal_receiver &sig_rec, File_system::Page_cache &cache)
+	:
+		cache(cache),
+		dispatcher(sig_rec, *this, &Page_cache_reporter::handle_timeout)
+	{
+		reporter.enabled(true);
+		timer.sigh(dispatcher);
+		timer.trigger_periodic(1000*1000);
+	}
+};
+
+
 int main(int, char **)
 {
 	using namespace File_system;
@@ -1024,6 +1088,20 @@ int main(int, char **)
 
 	static File_system::Root root(ep, sliced_heap, sig_rec, root_dir);
 
+	/* cache file content if configured */
+	static Lazy_volatile_object<Page_cache_reporter> cache_reporter;
+	try {
+		Xml_node cache = config()->xml_node().sub_node("cache");
+
+		Number_of_bytes size = 0;
+		cache.attribute("size").value(&size);
+
+		_page_cache = new (env()->heap()) Page_cache(*env()->heap(), size);
+
+		if (cache.attribute("report").has_value("yes"))
+			cache_reporter.construct(sig_rec, *_page_cache);
+	} catch (...) { }
+
 	env()->parent()->announce(ep.manage(&root));
 
 	for (;;) {
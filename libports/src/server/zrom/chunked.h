@@ -0,0 +1,67 @@
+/*
+ * \brief  Format of chunked compressed ROM modules
+ * \author Genode Labs
+ * \date   2014-02-20
+ */
+
+/*
+ * Copyright (C) 2014 Genode Labs GmbH
+ *
+ * This file is part of the Genode OS framework, which is distributed
+ * under the terms of the GNU General Public License version 2.
+ */
+
+#ifndef _CHUNKED_H_
+#define _CHUNKED_H_
+
+/* Genode includes */
+#include <base/stdint.h>
+
+namespace Chunked {
+
+	using Genode::uint32_t;
+	using Genode::uint64_t;
+
+	/**
+	 * Header at the beginning of a chunked module
+	 *
+	 * The content is split into chunks of 'chunk_size' bytes, each
+	 * compressed as individual zlib stream. The header is followed by a
+	 * table of 'num_chunks + 1' offsets of the compressed chunks relative
+	 * to the beginning of the module, the last offset marking the end of
+	 * the last chunk. All values are stored in little-endian byte order.
+	 */
+	struct Header
+	{
+		char     magic[4];    /* "ZRMC" */
+		uint32_t chunk_size;  /* multiple of the page size */
+		uint64_t size;        /* size of the uncompressed content */
+		uint32_t num_chunks;
+		uint32_t reserved;
+
+		bool magic_valid() const
+		{
+			return magic[0] == 'Z' && magic[1] == 'R'
+			    && magic[2] == 'M' && magic[3] == 'C';
+		}
+
+		/**
+		 * Return true if the header describes a module of 'module_size'
+		 * bytes
+		 */
+		bool valid(Genode::size_t module_size, Genode::size_t page_size) const
+		{
+			if (!magic_valid() || !chunk_size || chunk_size % page_size)
+				return false;
+
+			if (num_chunks != (size + chunk_size - 1) / chunk_size)
+				return false;
+
+			/* offset table must reside within the module */
+			return num_chunks < module_size / sizeof(uint64_t)
+			    && sizeof(Header) + (num_chunks + 1)*sizeof(uint64_t) <= module_size;
+		}
+	} __attribute__((packed));
+}
+
+#endif /* _CHUNKED_H_ */
@@ -0,0 +1,649 @@
+/*
+ * \brief  ROM service providing decompressed ROM modules
+ * \author Genode Labs
+ * \date   2014-02-20
+ */
+
+/*
+ * Copyright (C) 2014 Genode Labs GmbH
+ *
+ * This file is part of the Genode OS framework, which is distributed
+ * under the terms of the GNU General Public License version 2.
+ */
+
+/* Genode includes */
+#include <base/printf.h>
+#include <base/sleep.h>
+#include <base/rpc_server.h>
+#include <cap_session/connection.h>
+#include <dataspace/client.h>
+#include <os/config.h>
+#include <rom_session/connection.h>
+#include <root/component.h>
+#include <rm_session/connection.h>
+#include <util/avl_string.h>
+#include <util/fifo.h>
+#include <util/misc_math.h>
+
+/* zlib includes */
+#include <zlib.h>
+
+/* local includes */
+#include "chunked.h"
+
+using namespace Genode;
+
+
+namespace Zrom {
+
+	enum { NAME_LEN = 128, PAGE_SIZE = 4096 };
+
+	static bool const verbose = false;
+
+	class Decompression_failed { };
+
+
+	/*****************************
+	 ** Decompression with zlib **
+	 *****************************/
+
+	static void *zalloc(void *, unsigned items, unsigned size)
+	{
+		void *ptr = 0;
+		return env()->heap()->alloc(items*size, &ptr) ? ptr : Z_NULL;
+	}
+
+	static void zfree(void *, void *ptr) { env()->heap()->free(ptr, 0); }
+
+	/**
+	 * Decompressor of a zlib or gzip stream
+	 */
+	class Inflater
+	{
+		private:
+
+			z_stream _z;
+			bool     _done;
+
+		public:
+
+			enum { ZLIB = 15, GZIP = 16 + 15 };
+
+			/**
+			 * Constructor
+			 *
+			 * \param format  window bits passed to zlib, 'ZLIB' or 'GZIP'
+			 *
+			 * \throw Decompression_failed
+			 */
+			Inflater(void const *src, size_t len, int format) : _done(false)
+			{
+				memset(&_z, 0, sizeof(_z));
+				_z.zalloc   = zalloc;
+				_z.zfree    = zfree;
+				_z.next_in  = (Bytef *)src;
+				_z.avail_in = len;
+
+				if (inflateInit2(&_z, format) != Z_OK)
+					throw Decompression_failed();
+			}
+
+			~Inflater() { inflateEnd(&_z); }
+
+			/**
+			 * Decompress subsequent part of the stream
+			 *
+			 * \return  number of bytes written to 'dst', which is less than
+			 *          'len' at the end of the stream only
+			 *
+			 * \throw Decompression_failed  stream is corrupt or truncated
+			 */
+			size_t inflate(void *dst, size_t len)
+			{
+				if (_done)
+					return 0;
+
+				_z.next_out  = (Bytef *)dst;
+				_z.avail_out = len;
+
+				while (_z.avail_out) {
+					int const res = ::inflate(&_z, Z_NO_FLUSH);
+
+					if (res == Z_STREAM_END) {
+						_done = true;
+						break;
+					}
+
+					/* no progress possible with the remaining input */
+					if (res != Z_OK)
+						throw Decompression_failed();
+				}
+				return len - _z.avail_out;
+			}
+	};
+
+
+	/*************
+	 ** Modules **
+	 *************/
+
+	typedef Avl_string<NAME_LEN> Module_base;
+
+	/**
+	 * ROM module obtained from the parent
+	 *
+	 * Modules are never destroyed because the content of the parent's ROM
+	 * modules does not change.
+	 */
+	class Module : public Module_base
+	{
+		protected:
+
+			Rom_connection _rom;
+			char const    *_content;
+			size_t const   _size;
+
+		public:
+
+			/**
+			 * Constructor
+			 *
+			 * \throw Rom_connection::Rom_connection_failed
+			 */
+			Module(char const *name)
+			:
+				Module_base(name), _rom(name),
+				_content(env()->rm_session()->attach(_rom.dataspace())),
+				_size(Dataspace_client(_rom.dataspace()).size())
+			{ }
+
+			virtual ~Module() { env()->rm_session()->detach(_content); }
+
+			char const *content() const { return _content; }
+			size_t      size()    const { return _size; }
+
+			/**
+			 * Return dataspace with decompressed content
+			 */
+			virtual Dataspace_capability dataspace() = 0;
+
+			/**
+			 * Module cache that holds modules in order to re-use them in
+			 * different sessions
+			 */
+			static Avl_tree<Avl_string_base> &cache()
+			{
+				static Avl_tree<Avl_string_base> avl;
+				return avl;
+			}
+
+			static Module *lookup(char const *name)
+			{
+				Avl_string_base *first = cache().first();
+				return static_cast<Module *>(first ? first->find_by_name(name) : 0);
+			}
+	};
+
+
+	/**
+	 * Uncompressed module, handed out unmodified
+	 */
+	struct Plain_module : Module
+	{
+		Plain_module(char const *name) : Module(name) { }
+
+		Dataspace_capability dataspace() { return _rom.dataspace(); }
+	};
+
+
+	/**
+	 * Gzip-compressed module, decompressed as a whole on the first request
+	 */
+	class Gzip_module : public Module
+	{
+		private:
+
+			Ram_dataspace_capability _ds;
+
+			/**
+			 * Move content to a new dataspace of 'size' bytes
+			 */
+			static Ram_dataspace_capability _resize(Ram_dataspace_capability ds,
+			                                        char *&addr, size_t used,
+			                                        size_t size)
+			{
+				Ram_dataspace_capability new_ds = env()->ram_session()->alloc(size);
+				char *new_addr = env()->rm_session()->attach(new_ds);
+
+				memcpy(new_addr, addr, used);
+
+				env()->rm_session()->detach(addr);
+				env()->ram_session()->free(ds);
+
+				addr = new_addr;
+				return new_ds;
+			}
+
+			/**
+			 * Decompress module into '_ds'
+			 *
+			 * The gzip trailer cannot be used to determine the size of the
+			 * content because the ROM dataspace of the parent may be padded.
+			 * Hence, the content is decompressed into a dataspace that is
+			 * enlarged as needed and trimmed at the end.
+			 */
+			void _decompress()
+			{
+				Inflater inflater(_content, _size, Inflater::GZIP);
+
+				size_t size = align_addr(4*_size, 12);
+				_ds = env()->ram_session()->alloc(size);
+				char *addr = env()->rm_session()->attach(_ds);
+
+				size_t used = 0;
+				try {
+					for (;;) {
+						used += inflater.inflate(addr + used, size - used);
+						if (used < size)
+							break;
+
+						_ds = _resize(_ds, addr, used, 2*size);
+						size *= 2;
+					}
+
+					size_t const trimmed = align_addr(max(used, (size_t)1), 12);
+					if (trimmed < size) {
+						_ds = _resize(_ds, addr, used, trimmed);
+						size = trimmed;
+					}
+				} catch (...) {
+					env()->rm_session()->detach(addr);
+					env()->ram_session()->free(_ds);
+					throw;
+				}
+
+				env()->rm_session()->detach(addr);
+
+				if (verbose)
+					PINF("decompressed %s: %zu -> %zu bytes", name(), _size, used);
+			}
+
+		public:
+
+			Gzip_module(char const *name) : Module(name) { _decompress(); }
+
+			~Gzip_module() { env()->ram_session()->free(_ds); }
+
+			static bool detect(Module const &module)
+			{
+				unsigned char const *c = (unsigned char const *)module.content();
+				return module.size() >= 2 && c[0] == 0x1f && c[1] == 0x8b;
+			}
+
+			Dataspace_capability dataspace() { return _ds; }
+	};
+
+
+	class Chunked_module;
+
+	/**
+	 * Chunk of a chunked module
+	 */
+	struct Chunk : Fifo<Chunk>::Element
+	{
+		Chunked_module          *module;
+		unsigned long            index;
+		Ram_dataspace_capability ds;
+
+		Chunk() : module(0), index(0) { }
+	};
+
+
+	/**
+	 * Decompressed chunks of all chunked modules
+	 *
+	 * Chunks are evicted in the order of their decompression if the size of
+	 * all chunks exceeds the budget. The cache is used by the pager thread
+	 * only.
+	 */
+	class Chunk_cache
+	{
+		private:
+
+			Fifo<Chunk>  _chunks;
+			size_t const _budget;
+			size_t       _used;
+
+		public:
+
+			Chunk_cache(size_t budget) : _budget(budget), _used(0) { }
+
+			/**
+			 * Evict chunks to make room for a chunk of 'size' bytes
+			 */
+			inline void make_room(size_t size);
+
+			void insert(Chunk &chunk, size_t size)
+			{
+				_chunks.enqueue(&chunk);
+				_used += size;
+			}
+	};
+
+
+	/**
+	 * Module consisting of individually compressed chunks
+	 *
+	 * The content is provided as managed dataspace. A chunk is decompressed
+	 * when the client accesses it for the first time and mapped into the
+	 * managed dataspace until evicted from the chunk cache.
+	 */
+	class Chunked_module : public Module, public Signal_context
+	{
+		private:
+
+			Chunk_cache &_chunk_cache;
+
+			Chunked::Header const &_header;
+			uint64_t        const *_offsets;
+
+			Chunk *_chunks;
+
+			Rm_connection _rm;
+
+			Chunked::Header const &_checked_header()
+			{
+				Chunked::Header const &header = *(Chunked::Header const *)_content;
+
+				if (!header.valid(_size, PAGE_SIZE)) {
+					PERR("invalid header of chunked module %s", name());
+					throw Decompression_failed();
+				}
+				return header;
+			}
+
+			/**
+			 * Decompress chunk into a new dataspace
+			 */
+			Ram_dataspace_capability _decompress(unsigned long index)
+			{
+				uint64_t const start = _offsets[index];
+				uint64_t const end   = _offsets[index + 1];
+
+				if (start > end || end > _size)
+					throw Decompression_failed();
+
+				size_t const expected = min((uint64_t)_header.chunk_size,
+				                            _header.size - index*_header.chunk_size);
+
+				Ram_dataspace_capability ds = env()->ram_session()->alloc(_header.chunk_size);
+				char *addr = env()->rm_session()->attach(ds);
+
+				try {
+					Inflater inflater(_content + start, end - start, Inflater::ZLIB);
+					if (inflater.inflate(addr, expected) != expected)
+						throw Decompression_failed();
+				} catch (...) {
+					env()->rm_session()->detach(addr);
+					env()->ram_session()->free(ds);
+					throw;
+				}
+
+				env()->rm_session()->detach(addr);
+				return ds;
+			}
+
+			void _attach(Ram_dataspace_capability ds, addr_t offset)
+			{
+				bool try_again;
+				do {
+					try_again = false;
+					try { _rm.attach_at(ds, offset); }
+
+					catch (Genode::Rm_session::Region_conflict) {
+						PERR("Region conflict - this should not happen"); }
+
+					catch (Genode::Rm_session::Out_of_metadata) {
+
+						/* give up if the error occurred a second time */
+						if (try_again)
+							break;
+
+						PINF("upgrading quota donation for RM session");
+						env()->parent()->upgrade(_rm.cap(), "ram_quota=32K");
+						try_again = true;
+					}
+				} while (try_again);
+			}
+
+		public:
+
+			Chunked_module(char const *name, Signal_receiver &receiver,
+			               Chunk_cache &chunk_cache)
+			:
+				Module(name), _chunk_cache(chunk_cache),
+				_header(_checked_header()),
+				_offsets((uint64_t const *)(_content + sizeof(Chunked::Header))),
+				_chunks(new (env()->heap()) Chunk[_header.num_chunks]),
+				_rm(0, align_addr(_header.num_chunks*(size_t)_header.chunk_size, 12))
+			{
+				for (unsigned i = 0; i < _header.num_chunks; i++) {
+					_chunks[i].module = this;
+					_chunks[i].index  = i;
+				}
+
+				_rm.fault_handler(receiver.manage(this));
+			}
+
+			static bool detect(Module const &module)
+			{
+				return module.size() >= sizeof(Chunked::Header)
+				    && ((Chunked::Header const *)module.content())->magic_valid();
+			}
+
+			Dataspace_capability dataspace() { return _rm.dataspace(); }
+
+			/**
+			 * Resolve fault of a client, called by the pager thread
+			 */
+			void handle_fault()
+			{
+				Rm_session::State state = _rm.state();
+
+				if (state.type == Rm_session::READY)
+					return;
+
+				unsigned long const index = state.addr / _header.chunk_size;
+
+				if (state.type == Rm_session::WRITE_FAULT || index >= _header.num_chunks) {
+					PERR("invalid access to %s at 0x%lx", name(), state.addr);
+					return;
+				}
+
+				Chunk &chunk = _chunks[index];
+
+				/* chunk got mapped meanwhile */
+				if (chunk.ds.valid())
+					return;
+
+				_chunk_cache.make_room(_header.chunk_size);
+
+				try { chunk.ds = _decompress(index); }
+				catch (...) {
+					PERR("could not decompress chunk %lu of %s", index, name());
+					return;
+				}
+
+				if (verbose)
+					PDBG("%s: decompressed chunk %lu", name(), index);
+
+				_attach(chunk.ds, index*_header.chunk_size);
+				_chunk_cache.insert(chunk, _header.chunk_size);
+			}
+
+			/**
+			 * Remove chunk from managed dataspace, called by the chunk cache
+			 */
+			void evict(Chunk &chunk)
+			{
+				_rm.detach((void *)(chunk.index*_header.chunk_size));
+				env()->ram_session()->free(chunk.ds);
+				chunk.ds = Ram_dataspace_capability();
+			}
+
+			size_t chunk_size() const { return _header.chunk_size; }
+	};
+
+
+	void Chunk_cache::make_room(size_t size)
+	{
+		while (_used + size > _budget && !_chunks.empty()) {
+			Chunk *chunk = _chunks.dequeue();
+			_used -= chunk->module->chunk_size();
+			chunk->module->evict(*chunk);
+		}
+	}
+
+
+	/*****************
+	 ** ROM service **
+	 *****************/
+
+	class Pager : public Thread<8192>
+	{
+		private:
+
+			Signal_receiver _receiver;
+
+		public:
+
+			Pager() : Thread("zrom_pager") { }
+
+			Signal_receiver &signal_receiver() { return _receiver; }
+
+			void entry()
+			{
+				while (true) {
+					try {
+						Signal signal = _receiver.wait_for_signal();
+
+						for (unsigned i = 0; i < signal.num(); i++)
+							static_cast<Chunked_module *>(signal.context())->handle_fault();
+					} catch (...) {
+						PDBG("unexpected error while waiting for signal");
+					}
+				}
+			}
+	};
+
+
+	class Rom_component : public Rpc_object<Rom_session>
+	{
+		private:
+
+			Module &_module;
+
+		public:
+
+			Rom_component(Module &module) : _module(module) { }
+
+			Rom_dataspace_capability dataspace() {
+				return static_cap_cast<Rom_dataspace>(_module.dataspace()); }
+
+			void sigh(Signal_context_capability) { }
+	};
+
+
+	typedef Root_component<Rom_component> Root_component;
+
+	class Root : public Root_component
+	{
+		private:
+
+			Signal_receiver &_receiver;
+			Chunk_cache     &_chunk_cache;
+
+			/**
+			 * Obtain module from the parent and detect its format
+			 */
+			Module *_create_module(char const *name)
+			{
+				Plain_module *plain = new (env()->heap()) Plain_module(name);
+
+				bool const gzip    = Gzip_module::detect(*plain);
+				bool const chunked = Chunked_module::detect(*plain);
+
+				if (!gzip && !chunked)
+					return plain;
+
+				destroy(env()->heap(), plain);
+
+				if (gzip)
+					return new (env()->heap()) Gzip_module(name);
+
+				return new (env()->heap()) Chunked_module(name, _receiver, _chunk_cache);
+			}
+
+		protected:
+
+			Rom_component *_create_session(const char *args)
+			{
+				char name[NAME_LEN];
+				Arg_string::find_arg(args, "filename").string(name, sizeof(name), "");
+
+				Module *module = Module::lookup(name);
+				if (!module) {
+					try { module = _create_module(name); }
+					catch (Rom_connection::Rom_connection_failed) {
+						throw Root::Invalid_args(); }
+					catch (...) {
+						PERR("could not decompress module %s", name);
+						throw Root::Unavailable();
+					}
+
+					Module::cache().insert(module);
+				}
+
+				return new (md_alloc()) Rom_component(*module);
+			}
+
+		public:
+
+			Root(Rpc_entrypoint &ep, Allocator &md_alloc,
+			     Signal_receiver &receiver, Chunk_cache &chunk_cache)
+			:
+				Root_component(&ep, &md_alloc),
+				_receiver(receiver), _chunk_cache(chunk_cache)
+			{ }
+	};
+}
+
+
+int main()
+{
+	using namespace Zrom;
+
+	/* size of the decompressed chunks of all chunked modules */
+	Number_of_bytes cache_size = 4*1024*1024;
+	try {
+		config()->xml_node().sub_node("cache").attribute("size").value(&cache_size); }
+	catch (...) { }
+
+	static Chunk_cache chunk_cache(cache_size);
+
+	/* start pager thread */
+	static Pager pager;
+	pager.start();
+
+	/* initialize ROM service */
+	enum { STACK_SIZE = 8*1024 };
+	static Cap_connection cap;
+	static Rpc_entrypoint ep(&cap, STACK_SIZE, "zrom_ep");
+
+	static Sliced_heap sliced_heap(env()->ram_session(), env()->rm_session());
+	static Zrom::Root root(ep, sliced_heap, pager.signal_receiver(), chunk_cache);
+	env()->parent()->announce(ep.manage(&root));
+
+	sleep_forever();
+	return 0;
+}
@@ -0,0 +1,3 @@
+TARGET = zrom
+SRC_CC = main.cc
+LIBS   = base config libc zlib
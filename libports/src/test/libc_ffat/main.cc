@@ -53,11 +53,16 @@ int main(int argc, char *argv[])
 	size_t      pattern_size  = strlen(pattern) + 1;
 
 	unsigned int iterations = 1;
+	bool         test_rename = false;
 
 	try {
 		Genode::config()->xml_node().sub_node("iterations").attribute("value").value(&iterations);
 	} catch(...) { }
 
+	try {
+		test_rename = Genode::config()->xml_node().sub_node("rename").attribute("value").has_value("yes");
+	} catch(...) { }
+
 	for (unsigned int i = 0; i < iterations; i++) {
 
 		/* create directory (short name) */
@@ -100,6 +105,16 @@ int main(int argc, char *argv[])
 			printf("file content is correct\n");
 		}
 
+		/* rename the file within the same directory and back */
+		if (test_rename) {
+			char const *file_name5 = "test5.tst";
+			CALL_AND_CHECK(ret, rename(file_name, file_name5), ret == 0, "file_name=%s", file_name);
+			CALL_AND_CHECK(ret, stat(file_name5, &stat_buf),
+			               (ret == 0) && ((size_t)stat_buf.st_size == pattern_size),
+			               "file_name=%s", file_name5);
+			CALL_AND_CHECK(ret, rename(file_name5, file_name), ret == 0, "file_name=%s", file_name5);
+		}
+
 		/* test 'pread()' and 'pwrite()' */
 		CALL_AND_CHECK(fd, open(file_name2, O_CREAT | O_WRONLY), fd >= 0, "file_name=%s", file_name2);
 		/* write "a single line of" */
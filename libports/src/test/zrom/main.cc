@@ -0,0 +1,61 @@
+/*
+ * \brief  Test for the zrom service
+ * \author Genode Labs
+ * \date   2014-02-20
+ */
+
+/*
+ * Copyright (C) 2014 Genode Labs GmbH
+ *
+ * This file is part of the Genode OS framework, which is distributed
+ * under the terms of the GNU General Public License version 2.
+ */
+
+#include <base/printf.h>
+#include <os/attached_rom_dataspace.h>
+
+
+enum { PATTERN_SIZE = 256*1024 };
+
+
+/**
+ * Check that ROM module contains the pattern generated by the run script
+ *
+ * The pattern consists of 32-bit words, each holding its index.
+ */
+static bool check_pattern(char const *name)
+{
+	Genode::Attached_rom_dataspace rom(name);
+
+	if (rom.size() < PATTERN_SIZE) {
+		PERR("%s: unexpected size %zu", name, rom.size());
+		return false;
+	}
+
+	Genode::uint32_t const *words = rom.local_addr<Genode::uint32_t const>();
+
+	for (unsigned i = 0; i < PATTERN_SIZE/sizeof(*words); i++)
+		if (words[i] != i) {
+			PERR("%s: unexpected content at offset 0x%zx", name, i*sizeof(*words));
+			return false;
+		}
+
+	Genode::printf("%s: content is valid\n", name);
+	return true;
+}
+
+
+int main(int argc, char **argv)
+{
+	Genode::printf("--- test-zrom started ---\n");
+
+	char const *modules[] = { "plain.bin", "gzip.bin", "chunked.bin",
+	                          "gzip.bin", "chunked.bin" };
+
+	for (unsigned i = 0; i < sizeof(modules)/sizeof(*modules); i++)
+		if (!check_pattern(modules[i]))
+			return -1;
+
+	Genode::printf("--- test-zrom finished ---\n");
+	return 0;
+}
@@ -1,3 +1,3 @@
-TARGET = test-block_bench
+TARGET = test-zrom
 SRC_CC = main.cc
 LIBS   = base
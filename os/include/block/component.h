@@ -16,10 +16,12 @@
 #define _INCLUDE__BLOCK__COMPONENT_H_
 
 #include <root/component.h>
+#include <util/bit_allocator.h>
 #include <os/signal_rpc_dispatcher.h>
 #include <os/server.h>
 #include <block_session/rpc_object.h>
 #include <block/driver.h>
+#include <block/scheduler.h>
 
 namespace Block {
 
@@ -66,6 +68,10 @@ class Block::Session_component_base
 class Block::Session_component : public Block::Session_component_base,
                                  public Block::Session_rpc_object
 {
+	public:
+
+		enum { MAX_REQUESTS = Driver::MAX_QUEUE_DEPTH };
+
 	private:
 
 		addr_t                               _rq_phys;
@@ -73,9 +79,24 @@ class Block::Session_component : public Block::Session_component_base,
 		Signal_rpc_member<Session_component> _sink_submit;
 		bool                                 _req_queue_full;
 		bool                                 _ack_queue_full;
-		Packet_descriptor                    _p_to_handle;
+		bool                                 _processing;
 		unsigned                             _p_in_fly;
 
+		/*
+		 * Requests taken from the submit queue but not yet passed to the
+		 * driver
+		 */
+		Scheduler _scheduler;
+
+		/*
+		 * Requests submitted to the driver, indexed by their tag
+		 */
+		Packet_descriptor           _request[MAX_REQUESTS];
+		Scheduler::Batch            _batch[MAX_REQUESTS];
+		Bit_allocator<MAX_REQUESTS> _tags;
+		unsigned                    _requests_in_driver;
+		unsigned const              _queue_depth;
+
 		/**
 		 * Acknowledge a packet already handled
 		 */
@@ -96,56 +117,67 @@ class Block::Session_component : public Block::Session_component_base,
 			       < _driver.block_count(); }
 
 		/**
-		 * Handle a single request
+		 * Release tag of a request no longer processed by the driver
+		 */
+		void _release(Driver::Tag tag)
+		{
+			_request[tag] = Packet_descriptor();
+			_tags.free(tag);
+			_requests_in_driver--;
+		}
+
+		/**
+		 * Acknowledge all packets of a batch
+		 */
+		void _complete(Scheduler::Batch batch, bool success)
+		{
+			_scheduler.complete(batch, [&] (Scheduler::Request &r) {
+				r.packet.succeeded(success);
+				_ack_packet(r.packet);
+			});
+		}
+
+		/**
+		 * Queue a single request
 		 */
 		void _handle_packet(Packet_descriptor packet)
 		{
-			_p_to_handle = packet;
-			_p_to_handle.succeeded(false);
+			packet.succeeded(false);
 
 			/* ignore invalid packets */
-			if (!packet.valid() || !_range_check(_p_to_handle)) {
-				_ack_packet(_p_to_handle);
+			if (!packet.valid() || !_range_check(packet)) {
+				_ack_packet(packet);
 				return;
 			}
 
+			_scheduler.enqueue(Scheduler::Request(packet,
+			                                      tx_sink()->packet_content(packet)));
+		}
+
+		/**
+		 * Pass a batch of requests to the driver
+		 *
+		 * \return  false if the driver is congested
+		 */
+		bool _submit(Scheduler::Batch batch, Scheduler::Request const &r)
+		{
+			Driver::Tag const tag = _tags.alloc();
+			_request[tag] = r.packet;
+			_batch[tag]   = batch;
+			_requests_in_driver++;
+
 			try {
-				switch (_p_to_handle.operation()) {
-
-				case Block::Packet_descriptor::READ:
-					if (_driver.dma_enabled())
-						_driver.read_dma(packet.block_number(),
-						                 packet.block_count(),
-						                 _rq_phys + packet.offset(),
-						                 _p_to_handle);
-					else
-						_driver.read(packet.block_number(),
-						             packet.block_count(),
-						             tx_sink()->packet_content(packet),
-						             _p_to_handle);
-					break;
-
-				case Block::Packet_descriptor::WRITE:
-					if (_driver.dma_enabled())
-						_driver.write_dma(packet.block_number(),
-						                  packet.block_count(),
-						                  _rq_phys + packet.offset(),
-						                  _p_to_handle);
-					else
-						_driver.write(packet.block_number(),
-						              packet.block_count(),
-						              tx_sink()->packet_content(packet),
-						              _p_to_handle);
-					break;
-
-				default:
-					throw Driver::Io_error();
-				}
+				_driver.submit(tag, _request[tag], r.buffer,
+				               _rq_phys + r.packet.offset());
 			} catch (Driver::Request_congestion) {
+				_release(tag);
 				_req_queue_full = true;
+				return false;
 			} catch (Driver::Io_error) {
-				_ack_packet(_p_to_handle);
+				_release(tag);
+				_complete(batch, false);
 			}
+			return true;
 		}
 
 		/**
@@ -153,16 +185,44 @@ class Block::Session_component : public Block::Session_component_base,
 		 */
 		void _packet_avail(unsigned)
 		{
+			/* requests completed synchronously must not recurse */
+			if (_processing)
+				return;
+
+			_processing = true;
+
 			/*
 			 * as long as more packets are available, and we're able to ack
-			 * them, and the driver's request queue isn't full,
-			 * direct the packet request to the driver backend
+			 * them, take them out of the submit queue
 			 */
 			for (_ack_queue_full = (_p_in_fly >= tx_sink()->ack_slots_free());
-			     !_req_queue_full && !_ack_queue_full
+			     !_ack_queue_full && !_scheduler.full()
 			     && tx_sink()->packet_avail();
 				 _ack_queue_full = (++_p_in_fly >= tx_sink()->ack_slots_free()))
 				_handle_packet(tx_sink()->get_packet());
+
+			/*
+			 * as long as the driver's request queue isn't full, direct
+			 * the scheduled requests to the driver backend
+			 */
+			while (!_req_queue_full && _requests_in_driver < _queue_depth
+			    && _scheduler.dispatch([&] (Scheduler::Batch batch,
+			                                Scheduler::Request const &r) {
+			           return _submit(batch, r); }));
+
+			_processing = false;
+		}
+
+		/**
+		 * Resume packet processing after the completion of a request
+		 */
+		void _resume()
+		{
+			if (_processing)
+				return;
+
+			_req_queue_full = false;
+			_packet_avail(0);
 		}
 
 		/**
@@ -188,7 +248,13 @@ class Block::Session_component : public Block::Session_component_base,
 		  _sink_ack(ep, *this, &Session_component::_ready_to_ack),
 		  _sink_submit(ep, *this, &Session_component::_packet_avail),
 		  _req_queue_full(false),
-		  _p_in_fly(0)
+		  _ack_queue_full(false),
+		  _processing(false),
+		  _p_in_fly(0),
+		  _scheduler(_driver.block_size(), _driver.scheduling()),
+		  _requests_in_driver(0),
+		  _queue_depth(max(1U, min(_driver.queue_depth(),
+		                           (unsigned)MAX_REQUESTS)))
 		{
 			_tx.sigh_ready_to_ack(_sink_ack);
 			_tx.sigh_packet_avail(_sink_submit);
@@ -196,33 +262,55 @@ class Block::Session_component : public Block::Session_component_base,
 			_driver.session = this;
 		}
 
+		/**
+		 * Complete a request submitted via 'Driver::submit'
+		 *
+		 * \param tag      tag of the request
+		 * \param success  indicated whether the processing was successful
+		 */
+		void complete(Driver::Tag tag, bool success = true)
+		{
+			Scheduler::Batch const batch = _batch[tag];
+			_release(tag);
+
+			_complete(batch, success);
+			_resume();
+		}
+
+		/**
+		 * Resume processing of client requests
+		 *
+		 * Drivers that rejected a request with 'Request_congestion' call
+		 * this function once they are able to accept requests again.
+		 */
+		void wake_up() { _resume(); }
+
 		/**
 		 * Acknowledges a packet processed by the driver to the client
 		 *
 		 * \param packet   the packet to acknowledge
 		 * \param success  indicated whether the processing was successful
 		 *
+		 * This function is used by drivers that do not track the tags of
+		 * their requests. The request is looked up by the packet's
+		 * position within the packet stream, which costs a scan of the
+		 * requests in flight.
+		 *
 		 * \throw Ack_congestion
 		 */
 		void ack_packet(Packet_descriptor &packet, bool success = true)
 		{
+			for (unsigned i = 0; i < MAX_REQUESTS; i++)
+				if (_request[i].valid()
+				 && _request[i].offset()       == packet.offset()
+				 && _request[i].block_number() == packet.block_number()) {
+					complete(i, success);
+					return;
+				}
+
 			packet.succeeded(success);
 			_ack_packet(packet);
-
-			if (!_req_queue_full && !_ack_queue_full)
-				return;
-
-			/*
-			 * when the driver's request queue was full,
-			 * handle last unprocessed packet taken out of submit queue
-			 */
-			if (_req_queue_full) {
-				_req_queue_full = false;
-				_handle_packet(_p_to_handle);
-			}
-
-			/* resume packet processing */
-			_packet_avail(0);
+			_resume();
 		}
 
 
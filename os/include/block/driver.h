@@ -22,6 +22,7 @@
 
 #include <ram_session/ram_session.h>
 #include <block_session/block_session.h>
+#include <block/scheduler.h>
 
 namespace Block {
 	class Session_component;
@@ -38,12 +39,40 @@ struct Block::Driver
 	Session_component * session; /* single session component of the driver
 	                              * might get used to acknowledge requests */
 
+	enum { MAX_QUEUE_DEPTH = Session::TX_QUEUE_SIZE };
+
+	/**
+	 * Tag identifying a request submitted via 'submit'
+	 */
+	typedef unsigned Tag;
+
 	/**
 	 * Exceptions
 	 */
 	class Io_error           : public ::Genode::Exception { };
 	class Request_congestion : public ::Genode::Exception { };
 
+	/**
+	 * Request maximum number of requests processed concurrently
+	 *
+	 * The session component keeps up to this number of requests in
+	 * flight. Drivers of devices with a hardware command queue should
+	 * return its depth. 'Request_congestion' remains supported for
+	 * drivers that cannot tell their limit in advance.
+	 */
+	virtual unsigned queue_depth() { return MAX_QUEUE_DEPTH; }
+
+	/**
+	 * Request parameters of the I/O scheduler of the session
+	 *
+	 * By default, requests are passed to the driver one by one in the
+	 * order of their submission. Drivers that benefit from large
+	 * transfers or from ascending block numbers return a policy with a
+	 * maximum transfer size or a deadline. A merged request covers the
+	 * payloads of its members, which are adjacent in the packet buffer.
+	 */
+	virtual Scheduler::Policy scheduling() { return Scheduler::Policy(); }
+
 	/**
 	 * Request block size for driver and medium
 	 */
@@ -59,6 +88,49 @@ struct Block::Driver
 	 */
 	virtual Session::Operations ops() = 0;
 
+	/**
+	 * Submit request
+	 *
+	 * \param tag     tag of the request, unique among all requests in flight
+	 * \param packet  packet descriptor from the client
+	 * \param buffer  local address of the request's payload
+	 * \param phys    physical address of the payload, valid if DMA is enabled
+	 *
+	 * \throw Request_congestion
+	 * \throw Io_error
+	 *
+	 * The driver reports the completion of the request by calling
+	 * 'Session_component::complete' with the tag, possibly from within
+	 * this function. The default implementation forwards the request to
+	 * the read and write functions below, which acknowledge the packet via
+	 * 'Session_component::ack_packet' instead.
+	 */
+	virtual void submit(Tag                tag,
+	                    Packet_descriptor &packet,
+	                    char              *buffer,
+	                    Genode::addr_t     phys)
+	{
+		switch (packet.operation()) {
+
+		case Packet_descriptor::READ:
+			if (dma_enabled())
+				read_dma(packet.block_number(), packet.block_count(), phys, packet);
+			else
+				read(packet.block_number(), packet.block_count(), buffer, packet);
+			return;
+
+		case Packet_descriptor::WRITE:
+			if (dma_enabled())
+				write_dma(packet.block_number(), packet.block_count(), phys, packet);
+			else
+				write(packet.block_number(), packet.block_count(), buffer, packet);
+			return;
+
+		default:
+			throw Io_error();
+		}
+	}
+
 	/**
 	 * Read from medium
 	 *
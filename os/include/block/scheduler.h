@@ -0,0 +1,333 @@
+/*
+ * \brief  I/O scheduler for block requests
+ * \author Genode Labs
+ * \date   2014-01-29
+ */
+
+/*
+ * Copyright (C) 2014 Genode Labs GmbH
+ *
+ * This file is part of the Genode OS framework, which is distributed
+ * under the terms of the GNU General Public License version 2.
+ */
+
+#ifndef _INCLUDE__BLOCK__SCHEDULER_H_
+#define _INCLUDE__BLOCK__SCHEDULER_H_
+
+#include <base/exception.h>
+#include <util/bit_allocator.h>
+#include <block_session/block_session.h>
+
+namespace Block { class Scheduler; }
+
+
+/**
+ * Queue of block requests, which are passed on in batches
+ *
+ * A batch consists of requests of the same operation covering consecutive
+ * blocks, which are transferred as one request. Batches are formed in the
+ * order of their block numbers (one-way elevator). A request overtaken by
+ * 'deadline' batches is passed on next, regardless of its position.
+ * Requests overlapping an older write, or writes overlapping an older
+ * request, are not passed on before the older request.
+ */
+class Block::Scheduler
+{
+	public:
+
+		enum { MAX_REQUESTS = Session::TX_QUEUE_SIZE };
+
+		/**
+		 * Scheduling parameters
+		 */
+		struct Policy
+		{
+			/* maximum size of a batch in bytes, 0 disables merging */
+			Genode::size_t max_transfer;
+
+			/* number of batches allowed to overtake a request, 0 keeps
+			 * the submission order */
+			unsigned deadline;
+
+			Policy(Genode::size_t max_transfer = 0, unsigned deadline = 0)
+			: max_transfer(max_transfer), deadline(deadline) { }
+		};
+
+		/**
+		 * Request as submitted by the client
+		 */
+		struct Request
+		{
+			Packet_descriptor packet;
+			char             *buffer;   /* local address of the payload */
+
+			Request() : buffer(0) { }
+
+			Request(Packet_descriptor packet, char *buffer)
+			: packet(packet), buffer(buffer) { }
+		};
+
+		/**
+		 * Identifier of a batch passed on via 'dispatch'
+		 */
+		typedef unsigned Batch;
+
+		class Full : public Genode::Exception { };
+
+	private:
+
+		struct Entry : Request
+		{
+			unsigned long seq;      /* arrival number                   */
+			unsigned long stamp;    /* batches dispatched before arrival */
+			Entry        *older;    /* neighbours in arrival order       */
+			Entry        *newer;
+			Entry        *next;     /* next member of the batch          */
+			bool          queued;
+
+			Entry() : seq(0), stamp(0), older(0), newer(0), next(0), queued(false) { }
+
+			sector_t first() const { return packet.block_number(); }
+			sector_t end()   const { return packet.block_number() + packet.block_count(); }
+			bool     write() const { return packet.operation() == Packet_descriptor::WRITE; }
+		};
+
+		Genode::size_t const               _block_size;
+		Policy const                       _policy;
+		bool const                         _contiguous;
+		Entry                              _entry[MAX_REQUESTS];
+		Genode::Bit_allocator<MAX_REQUESTS> _slots;
+		unsigned                           _used;
+		unsigned                           _writes;   /* queued writes */
+		Entry                             *_oldest;
+		Entry                             *_newest;
+		unsigned long                      _seq;
+		unsigned long                      _dispatched;
+		sector_t                           _head;     /* end of last batch */
+
+		void _unqueue(Entry &e)
+		{
+			if (e.older) e.older->newer = e.newer; else _oldest = e.newer;
+			if (e.newer) e.newer->older = e.older; else _newest = e.older;
+
+			e.older = e.newer = 0;
+			e.queued = false;
+			if (e.write()) _writes--;
+		}
+
+		/**
+		 * Insert entry according to its arrival number
+		 */
+		void _queue(Entry &e)
+		{
+			Entry *older = _newest;
+			while (older && older->seq > e.seq)
+				older = older->older;
+
+			e.older = older;
+			e.newer = older ? older->newer : _oldest;
+			if (e.older) e.older->newer = &e; else _oldest = &e;
+			if (e.newer) e.newer->older = &e; else _newest = &e;
+
+			e.queued = true;
+			if (e.write()) _writes++;
+		}
+
+		static bool _overlap(Entry const &a, Entry const &b) {
+			return a.first() < b.end() && b.first() < a.end(); }
+
+		/**
+		 * Return true if no older request must be passed on before 'e'
+		 */
+		bool _eligible(Entry const &e) const
+		{
+			if (!_writes)
+				return true;
+
+			for (Entry const *o = e.older; o; o = o->older)
+				if ((o->write() || e.write()) && _overlap(*o, e))
+					return false;
+			return true;
+		}
+
+		Entry *_select()
+		{
+			if (!_oldest || !_policy.deadline
+			 || _dispatched - _oldest->stamp >= _policy.deadline)
+				return _oldest;
+
+			Entry *ahead = 0, *lowest = 0;
+			for (Entry *e = _oldest; e; e = e->newer) {
+				if (!_eligible(*e))
+					continue;
+
+				if (e->first() >= _head && (!ahead || e->first() < ahead->first()))
+					ahead = e;
+				if (!lowest || e->first() < lowest->first())
+					lowest = e;
+			}
+			return ahead ? ahead : lowest;
+		}
+
+		bool _fits_payload(Entry const &e) const {
+			return e.packet.size() == e.packet.block_count()*_block_size; }
+
+		/**
+		 * Return true if 'b' can follow 'a' within a batch
+		 */
+		bool _adjacent(Entry const &a, Entry const &b) const
+		{
+			if (a.end() != b.first())
+				return false;
+
+			return !_contiguous
+			    || (_fits_payload(a) && _fits_payload(b)
+			        && a.packet.offset() + (Genode::off_t)a.packet.size()
+			           == b.packet.offset());
+		}
+
+	public:
+
+		/**
+		 * Constructor
+		 *
+		 * \param block_size  size of a block in bytes
+		 * \param policy      scheduling parameters
+		 * \param contiguous  merge only requests whose payloads are adjacent
+		 *                    in the packet buffer, which is required if a
+		 *                    batch is transferred from the buffer directly
+		 */
+		Scheduler(Genode::size_t block_size, Policy const &policy,
+		          bool contiguous = true)
+		:
+			_block_size(block_size), _policy(policy), _contiguous(contiguous),
+			_used(0), _writes(0), _oldest(0), _newest(0), _seq(0),
+			_dispatched(0), _head(0)
+		{ }
+
+		bool full()  const { return _used == MAX_REQUESTS; }
+		bool empty() const { return !_oldest; }
+
+		/**
+		 * Queue request
+		 *
+		 * \throw Full
+		 */
+		void enqueue(Request const &request)
+		{
+			if (full())
+				throw Full();
+
+			Entry &e = _entry[_slots.alloc()];
+			static_cast<Request &>(e) = request;
+			e.seq   = _seq++;
+			e.stamp = _dispatched;
+			e.next  = 0;
+			_used++;
+
+			_queue(e);
+		}
+
+		/**
+		 * Pass on next batch
+		 *
+		 * \param submit  functor called with the batch identifier and a
+		 *                request covering all blocks of the batch, it
+		 *                returns false if the batch cannot be accepted
+		 *
+		 * \return  true if a batch was accepted
+		 *
+		 * The payload of the covering request is the payload of its first
+		 * member, which is valid for the whole batch in contiguous mode.
+		 * The members of an accepted batch must be completed via 'complete',
+		 * possibly from within 'submit'.
+		 */
+		template <typename FN>
+		bool dispatch(FN const &submit)
+		{
+			Entry *first = _select();
+			if (!first)
+				return false;
+
+			Entry *last = first;
+			Genode::size_t bytes = first->packet.block_count()*_block_size;
+			_unqueue(*first);
+
+			/* merge requests of the same operation adjacent to the batch */
+			for (bool merged = true; merged; ) {
+				merged = false;
+
+				for (Entry *e = _oldest; e; e = e->newer) {
+
+					Genode::size_t const size = e->packet.block_count()*_block_size;
+					if (e->packet.operation() != first->packet.operation()
+					 || bytes + size > _policy.max_transfer || !_eligible(*e))
+						continue;
+
+					if (_adjacent(*last, *e)) {
+						_unqueue(*e);
+						last->next = e;
+						last = e;
+					} else if (_adjacent(*e, *first)) {
+						_unqueue(*e);
+						e->next = first;
+						first = e;
+					} else
+						continue;
+
+					bytes += size;
+					merged = true;
+					break;
+				}
+			}
+
+			Request batch(Packet_descriptor(Packet_descriptor(first->packet.offset(), bytes),
+			                                first->packet.operation(),
+			                                first->first(), bytes / _block_size),
+			              first->buffer);
+
+			if (!submit((Batch)(first - _entry), batch)) {
+				for (Entry *e = first, *next; e; e = next) {
+					next = e->next;
+					e->next = 0;
+					_queue(*e);
+				}
+				return false;
+			}
+
+			_dispatched++;
+			_head = last->end();
+			return true;
+		}
+
+		/**
+		 * Call 'fn' for each member of a batch in the order of their blocks
+		 */
+		template <typename FN>
+		void for_each_member(Batch batch, FN const &fn)
+		{
+			for (Entry *e = &_entry[batch]; e; e = e->next)
+				fn(static_cast<Request &>(*e));
+		}
+
+		/**
+		 * Complete batch
+		 *
+		 * The functor 'fn' is called for each member of the batch, after
+		 * which the request is removed from the scheduler.
+		 */
+		template <typename FN>
+		void complete(Batch batch, FN const &fn)
+		{
+			for (Entry *e = &_entry[batch], *next; e; e = next) {
+				next = e->next;
+				e->next = 0;
+				fn(static_cast<Request &>(*e));
+
+				_slots.free(e - _entry);
+				_used--;
+			}
+		}
+};
+
+#endif /* _INCLUDE__BLOCK__SCHEDULER_H_ */
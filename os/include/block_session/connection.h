@@ -22,6 +22,12 @@ namespace Block {
 
 	struct Connection : Genode::Connection<Session>, Session_client
 	{
+		/*
+		 * Quota for the meta data of the session at the server, which
+		 * keeps track of all requests of the packet stream
+		 */
+		enum { RAM_QUOTA = 64*1024 };
+
 		/**
 		 * Constructor
 		 *
@@ -35,7 +41,7 @@ namespace Block {
 		:
 			Genode::Connection<Session>(
 				session("ram_quota=%zd, tx_buf_size=%zd, label=\"%s\"",
-				        3*4096 + tx_buf_size, tx_buf_size, label)),
+				        RAM_QUOTA + tx_buf_size, tx_buf_size, label)),
 			Session_client(cap(), tx_block_alloc) { }
 	};
 }
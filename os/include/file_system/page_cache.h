@@ -0,0 +1,450 @@
+/*
+ * \brief  Cache of file content shared by the sessions of a file system
+ * \author Genode Labs
+ * \date   2014-02-14
+ */
+
+/*
+ * Copyright (C) 2014 Genode Labs GmbH
+ *
+ * This file is part of the Genode OS framework, which is distributed
+ * under the terms of the GNU General Public License version 2.
+ */
+
+#ifndef _INCLUDE__FILE_SYSTEM__PAGE_CACHE_H_
+#define _INCLUDE__FILE_SYSTEM__PAGE_CACHE_H_
+
+/* Genode includes */
+#include <base/allocator.h>
+#include <base/lock.h>
+#include <file_system_session/file_system_session.h>
+#include <os/reporter.h>
+#include <util/string.h>
+
+namespace File_system { class Page_cache; }
+
+
+/**
+ * Cache of file pages with least-recently-used replacement
+ *
+ * Pages are identified by a node ID chosen by the file-system server,
+ * which must be the same for all sessions accessing the node, and the page
+ * index within the node. The server reads through the cache and
+ * invalidates the affected pages whenever it modifies a node. The cache
+ * may be used by multiple threads. The backend is accessed without
+ * holding the lock of the cache.
+ */
+class File_system::Page_cache
+{
+	public:
+
+		typedef Genode::uint64_t Node_id;
+
+		enum { PAGE_SIZE = 4096 };
+
+	private:
+
+		typedef Genode::uint64_t uint64_t;
+
+		enum { MAX_RUN = 16 };  /* pages read from the backend at once */
+
+		/**
+		 * Node excluded from caching
+		 */
+		struct Uncached
+		{
+			Node_id   node;
+			Uncached *next;
+		};
+
+		struct Page
+		{
+			Node_id  node;
+			uint64_t index;
+			size_t   valid;  /* less than PAGE_SIZE at the end of the node */
+
+			Page *hash_next;
+			Page *lru_prev, *lru_next;
+
+			char data[PAGE_SIZE];
+		};
+
+		Genode::Allocator &_alloc;
+		Genode::Lock       _lock;
+
+		unsigned const _max_pages;
+		unsigned       _num_pages;
+
+		unsigned const _num_buckets;
+		Page         **_buckets;
+
+		/* most recently used page first */
+		Page *_lru_first;
+		Page *_lru_last;
+
+		/*
+		 * Number of invalidations, used to detect content read from the
+		 * backend while being modified
+		 */
+		unsigned long _invalidations;
+
+		unsigned long _hits, _misses, _evictions;
+
+		/* counters at the time of the last report */
+		unsigned long _reported_hits, _reported_misses;
+
+		Uncached *_uncached;
+
+		bool _is_uncached(Node_id node)
+		{
+			Genode::Lock::Guard guard(_lock);
+
+			for (Uncached *u = _uncached; u; u = u->next)
+				if (u->node == node)
+					return true;
+			return false;
+		}
+
+		Page *&_bucket(Node_id node, uint64_t index) {
+			return _buckets[(node*31 + index) % _num_buckets]; }
+
+		Page *_lookup(Node_id node, uint64_t index)
+		{
+			for (Page *p = _bucket(node, index); p; p = p->hash_next)
+				if (p->node == node && p->index == index)
+					return p;
+			return 0;
+		}
+
+		void _lru_unlink(Page *p)
+		{
+			if (p->lru_prev) p->lru_prev->lru_next = p->lru_next;
+			else             _lru_first = p->lru_next;
+			if (p->lru_next) p->lru_next->lru_prev = p->lru_prev;
+			else             _lru_last = p->lru_prev;
+		}
+
+		void _lru_insert_first(Page *p)
+		{
+			p->lru_prev = 0;
+			p->lru_next = _lru_first;
+			if (_lru_first) _lru_first->lru_prev = p;
+			else            _lru_last = p;
+			_lru_first = p;
+		}
+
+		void _remove(Page *p)
+		{
+			for (Page **e = &_bucket(p->node, p->index); *e; e = &(*e)->hash_next)
+				if (*e == p) {
+					*e = p->hash_next;
+					break;
+				}
+			_lru_unlink(p);
+			_num_pages--;
+		}
+
+		/**
+		 * Provide page for new content, evict least recently used page
+		 */
+		Page *_alloc_page()
+		{
+			if (_num_pages < _max_pages) {
+				Page *p = 0;
+				if (_alloc.alloc(sizeof(Page), &p))
+					return p;
+			}
+
+			Page *p = _lru_last;
+			if (!p)
+				return 0;
+
+			_remove(p);
+			_evictions++;
+			return p;
+		}
+
+		void _insert(Node_id node, uint64_t index, char const *data, size_t valid)
+		{
+			/* update page that was read again because it was partly valid */
+			Page *p = _lookup(node, index);
+			if (p) {
+				p->valid = valid;
+				Genode::memcpy(p->data, data, valid);
+				return;
+			}
+
+			p = _alloc_page();
+			if (!p)
+				return;
+
+			p->node  = node;
+			p->index = index;
+			p->valid = valid;
+			Genode::memcpy(p->data, data, valid);
+
+			Page *&bucket = _bucket(node, index);
+			p->hash_next = bucket;
+			bucket = p;
+
+			_lru_insert_first(p);
+			_num_pages++;
+		}
+
+		/**
+		 * Copy cached page to 'dst'
+		 *
+		 * \return  number of bytes copied, or -1 if the page is not cached
+		 */
+		long _read_cached(Node_id node, uint64_t index, size_t page_offset,
+		                  char *dst, size_t len)
+		{
+			Page *p = _lookup(node, index);
+			if (!p)
+				return -1;
+
+			/*
+			 * The node may have been extended since a partly valid page at
+			 * its end was cached, so the page cannot tell the end of the
+			 * node.
+			 */
+			if (p->valid < PAGE_SIZE && page_offset + len > p->valid)
+				return -1;
+
+			_lru_unlink(p);
+			_lru_insert_first(p);
+
+			size_t const n = page_offset < p->valid
+			               ? Genode::min(len, p->valid - page_offset) : 0;
+			Genode::memcpy(dst, p->data + page_offset, n);
+			return n;
+		}
+
+	public:
+
+		/**
+		 * Constructor
+		 *
+		 * \param alloc  allocator used for the pages
+		 * \param size   maximum amount of cached content in bytes
+		 */
+		Page_cache(Genode::Allocator &alloc, size_t size)
+		:
+			_alloc(alloc),
+			_max_pages(size / PAGE_SIZE), _num_pages(0),
+			_num_buckets(Genode::max(_max_pages, 1U)),
+			_buckets((Page **)alloc.alloc(_num_buckets*sizeof(Page *))),
+			_lru_first(0), _lru_last(0),
+			_invalidations(0), _hits(0), _misses(0), _evictions(0),
+			_reported_hits(0), _reported_misses(0), _uncached(0)
+		{
+			for (unsigned i = 0; i < _num_buckets; i++)
+				_buckets[i] = 0;
+		}
+
+		~Page_cache()
+		{
+			while (Page *p = _lru_first) {
+				_remove(p);
+				_alloc.free(p, sizeof(Page));
+			}
+			_alloc.free(_buckets, _num_buckets*sizeof(Page *));
+
+			while (Uncached *u = _uncached) {
+				_uncached = u->next;
+				_alloc.free(u, sizeof(Uncached));
+			}
+		}
+
+		/**
+		 * Read node content
+		 *
+		 * \param fill  functor for reading from the backend, called with
+		 *              the arguments 'char *dst, size_t len,
+		 *              seek_off_t offset' and returning the number of
+		 *              bytes read
+		 *
+		 * \return  number of bytes read, which is less than 'len' at the
+		 *          end of the node only
+		 */
+		template <typename FN>
+		size_t read(Node_id node, char *dst, size_t len, seek_off_t offset,
+		            FN const &fill)
+		{
+			if (_is_uncached(node))
+				return fill(dst, len, offset);
+
+			size_t done = 0;
+
+			while (done < len) {
+
+				seek_off_t const pos   = offset + done;
+				uint64_t   const index = pos / PAGE_SIZE;
+				size_t     const page_offset = pos % PAGE_SIZE;
+
+				unsigned long invalidations;
+				{
+					Genode::Lock::Guard guard(_lock);
+
+					long const n = _read_cached(node, index, page_offset,
+					                            dst + done, len - done);
+					if (n >= 0) {
+						_hits++;
+						done += n;
+
+						/* page at the end of the node */
+						if (page_offset + n < PAGE_SIZE)
+							break;
+						continue;
+					}
+
+					invalidations = _invalidations;
+				}
+
+				/* read run of pages from the backend */
+				size_t const pages = Genode::min((size_t)MAX_RUN,
+					(page_offset + len - done + PAGE_SIZE - 1) / PAGE_SIZE);
+
+				char *buf = 0;
+				if (!_alloc.alloc(pages*PAGE_SIZE, &buf))
+					return done + fill(dst + done, len - done, pos);
+
+				size_t const res = fill(buf, pages*PAGE_SIZE, index*PAGE_SIZE);
+
+				size_t const n = res > page_offset
+				               ? Genode::min(len - done, res - page_offset) : 0;
+				Genode::memcpy(dst + done, buf + page_offset, n);
+				done += n;
+
+				{
+					Genode::Lock::Guard guard(_lock);
+
+					_misses += pages;
+
+					/* drop content that may have been modified meanwhile */
+					if (invalidations == _invalidations)
+						for (size_t i = 0; i*PAGE_SIZE < res; i++)
+							_insert(node, index + i, buf + i*PAGE_SIZE,
+							        Genode::min((size_t)PAGE_SIZE, res - i*PAGE_SIZE));
+				}
+
+				_alloc.free(buf, pages*PAGE_SIZE);
+
+				/* end of the node */
+				if (res < pages*PAGE_SIZE)
+					break;
+			}
+
+			return done;
+		}
+
+		/**
+		 * Invalidate cached content of the byte range of a node
+		 */
+		void invalidate(Node_id node, seek_off_t offset, file_size_t len)
+		{
+			Genode::Lock::Guard guard(_lock);
+
+			_invalidations++;
+
+			if (!len)
+				return;
+
+			uint64_t const first = offset / PAGE_SIZE;
+			uint64_t const last  = len > ~offset
+			                     ? ~(uint64_t)0 : (offset + len - 1) / PAGE_SIZE;
+
+			/* look up each page of small ranges, scan all pages otherwise */
+			if (last - first < _num_pages) {
+				for (uint64_t i = first; i <= last; i++)
+					if (Page *p = _lookup(node, i)) {
+						_remove(p);
+						_alloc.free(p, sizeof(Page));
+					}
+				return;
+			}
+
+			for (Page *p = _lru_first, *next = 0; p; p = next) {
+				next = p->lru_next;
+				if (p->node == node && p->index >= first && p->index <= last) {
+					_remove(p);
+					_alloc.free(p, sizeof(Page));
+				}
+			}
+		}
+
+		/**
+		 * Invalidate all cached content of a node
+		 */
+		void invalidate(Node_id node) { invalidate(node, 0, ~(file_size_t)0); }
+
+		/**
+		 * Invalidate the whole cache, e.g., if node IDs are reused
+		 */
+		void invalidate_all()
+		{
+			Genode::Lock::Guard guard(_lock);
+
+			_invalidations++;
+
+			while (Page *p = _lru_first) {
+				_remove(p);
+				_alloc.free(p, sizeof(Page));
+			}
+		}
+
+		/**
+		 * Exclude node from caching
+		 *
+		 * This is needed for nodes modified without the server noticing,
+		 * e.g., via a writeable dataspace handed out to a client.
+		 */
+		void exclude(Node_id node)
+		{
+			if (_is_uncached(node))
+				return;
+
+			invalidate(node);
+
+			Genode::Lock::Guard guard(_lock);
+
+			Uncached *u = 0;
+			if (!_alloc.alloc(sizeof(Uncached), &u))
+				return;
+
+			u->node   = node;
+			u->next   = _uncached;
+			_uncached = u;
+
+			/* drop pages of reads in progress */
+			_invalidations++;
+		}
+
+		/**
+		 * Report statistics if they changed since the last report
+		 */
+		void report(Genode::Reporter &reporter)
+		{
+			if (_hits == _reported_hits && _misses == _reported_misses)
+				return;
+
+			_reported_hits   = _hits;
+			_reported_misses = _misses;
+
+			Genode::Reporter::Xml_generator xml(reporter, [&] () {
+				xml.attribute("hits",      (long)_hits);
+				xml.attribute("misses",    (long)_misses);
+				xml.attribute("evictions", (long)_evictions);
+				xml.attribute("used",      (long)used());
+				xml.attribute("capacity",  (long)capacity());
+			});
+		}
+
+		unsigned long hits()      const { return _hits; }
+		unsigned long misses()    const { return _misses; }
+		unsigned long evictions() const { return _evictions; }
+		size_t        used()      const { return _num_pages*PAGE_SIZE; }
+		size_t        capacity()  const { return _max_pages*PAGE_SIZE; }
+};
+
+#endif /* _INCLUDE__FILE_SYSTEM__PAGE_CACHE_H_ */
@@ -34,12 +34,15 @@ namespace File_system {
 			 * \param session          session capability
 			 * \param tx_buffer_alloc  allocator used for managing the
 			 *                         transmission buffer
+			 * \param tx_queue_size    number of packets in flight as
+			 *                         requested at session creation
 			 */
 			Session_client(Session_capability  session,
-			               Range_allocator    &tx_buffer_alloc)
+			               Range_allocator    &tx_buffer_alloc,
+			               unsigned            tx_queue_size = TX_QUEUE_SIZE)
 			:
 				Rpc_client<Session>(session),
-				_tx(call<Rpc_tx_cap>(), &tx_buffer_alloc)
+				_tx(call<Rpc_tx_cap>(), &tx_buffer_alloc, tx_queue_size)
 			{ }
 
 
@@ -109,6 +112,12 @@ namespace File_system {
 			{
 				call<Rpc_sync>();
 			}
+
+			Dataspace_capability dataspace(File_handle file, file_size_t size,
+			                               bool writeable)
+			{
+				return call<Rpc_dataspace>(file, size, writeable);
+			}
 	};
 }
 
@@ -28,15 +28,18 @@ namespace File_system {
 		 * \param tx_buffer_alloc  allocator used for managing the
 		 *                         transmission buffer
 		 * \param tx_buf_size      size of transmission buffer in bytes
+		 * \param tx_queue_size    maximum number of packets in flight
 		 */
 		Connection(Range_allocator &tx_block_alloc,
 		           size_t           tx_buf_size = 128*1024,
-		           const char      *label = "")
+		           const char      *label = "",
+		           unsigned         tx_queue_size = TX_QUEUE_SIZE)
 		:
 			Genode::Connection<Session>(
-				session("ram_quota=%zd, tx_buf_size=%zd, label=\"%s\"",
-				        4*1024*sizeof(long) + tx_buf_size, tx_buf_size, label)),
-			Session_client(cap(), tx_block_alloc) { }
+				session("ram_quota=%zd, tx_buf_size=%zd, tx_queue_size=%u, label=\"%s\"",
+				        4*1024*sizeof(long) + tx_buf_size, tx_buf_size,
+				        tx_queue_size, label)),
+			Session_client(cap(), tx_block_alloc, tx_queue_size) { }
 	};
 }
 
@@ -15,6 +15,7 @@
 #define _INCLUDE__FILE_SYSTEM_SESSION__FILE_SYSTEM_SESSION_H_
 
 #include <base/exception.h>
+#include <dataspace/capability.h>
 #include <os/packet_stream.h>
 #include <packet_stream_tx/packet_stream_tx.h>
 #include <session/session.h>
@@ -189,10 +190,16 @@ namespace File_system {
 
 	struct Session : public Genode::Session
 	{
-		enum { TX_QUEUE_SIZE = 16 };
+		/*
+		 * The number of packets in flight is negotiated via the
+		 * 'tx_queue_size' session argument. If the argument is absent,
+		 * 'TX_QUEUE_SIZE' is used. Larger values are limited to
+		 * 'MAX_TX_QUEUE_SIZE'.
+		 */
+		enum { TX_QUEUE_SIZE = 16, MAX_TX_QUEUE_SIZE = 256 };
 
 		typedef Packet_stream_policy<File_system::Packet_descriptor,
-		                             TX_QUEUE_SIZE, TX_QUEUE_SIZE,
+		                             MAX_TX_QUEUE_SIZE, MAX_TX_QUEUE_SIZE,
 		                             char> Tx_policy;
 
 		typedef Packet_stream_tx::Channel<Tx_policy> Tx;
@@ -289,6 +296,32 @@ namespace File_system {
 		 */
 		virtual void sync() { PWRN("sync() not implemented!"); }
 
+		/**
+		 * Request dataspace holding the content of a file
+		 *
+		 * \param size       minimum size of the dataspace
+		 * \param writeable  modifications of the dataspace content must
+		 *                   apply to the file
+		 *
+		 * \return  dataspace starting at file offset 0, or an invalid
+		 *          capability if the file system does not support mapping
+		 *          files or cannot protect the file from modifications
+		 *          via a dataspace requested without write access
+		 *
+		 * \throw Invalid_handle
+		 * \throw Permission_denied   file must not be modified
+		 * \throw Size_limit_reached  file cannot be provided as a
+		 *                            dataspace of 'size' bytes
+		 * \throw No_space
+		 *
+		 * The dataspace content is coherent with the content transferred
+		 * via the packet stream. Modifications of a writeable dataspace do
+		 * not change the length of the file.
+		 */
+		virtual Dataspace_capability dataspace(File_handle, file_size_t size,
+		                                       bool writeable) {
+			return Dataspace_capability(); }
+
 
 		/*******************
 		 ** RPC interface **
@@ -327,6 +360,10 @@ namespace File_system {
 		                 GENODE_TYPE_LIST(Invalid_handle),
 		                 Node_handle, Signal_context_capability);
 		GENODE_RPC(Rpc_sync, void, sync);
+		GENODE_RPC_THROW(Rpc_dataspace, Dataspace_capability, dataspace,
+		                 GENODE_TYPE_LIST(Invalid_handle, Permission_denied,
+		                                  Size_limit_reached, No_space),
+		                 File_handle, file_size_t, bool);
 
 		/*
 		 * Manual type-list definition, needed because the RPC interface
@@ -346,8 +383,9 @@ namespace File_system {
 		        Meta::Type_tuple<Rpc_move,
 		        Meta::Type_tuple<Rpc_sigh,
 		        Meta::Type_tuple<Rpc_sync,
+		        Meta::Type_tuple<Rpc_dataspace,
 		                         Meta::Empty>
-		        > > > > > > > > > > > > Rpc_functions;
+		        > > > > > > > > > > > > > Rpc_functions;
 	};
 }
 
@@ -34,9 +34,12 @@ namespace File_system {
 			 * \param tx_ds  dataspace used as communication buffer
 			 *               for the tx packet stream
 			 * \param ep     entry point used for packet-stream channel
+			 * \param tx_queue_size  number of packets in flight as
+			 *                       requested by the client
 			 */
-			Session_rpc_object(Dataspace_capability tx_ds, Rpc_entrypoint &ep)
-			: _tx(tx_ds, ep) { }
+			Session_rpc_object(Dataspace_capability tx_ds, Rpc_entrypoint &ep,
+			                   unsigned tx_queue_size = TX_QUEUE_SIZE)
+			: _tx(tx_ds, ep, tx_queue_size) { }
 
 			/**
 			 * Return capability to packet-stream channel
@@ -18,9 +18,11 @@
 #include <nic_session/rpc_object.h>
 #include <base/allocator_avl.h>
 #include <util/arg_string.h>
+#include <util/misc_math.h>
 #include <base/rpc_server.h>
 #include <root/component.h>
 #include <nic/driver.h>
+#include <nic/offload.h>
 
 enum { VERBOSE_RX = false };
 
@@ -42,15 +44,20 @@ namespace Nic {
 			{
 				private:
 
-					Tx::Sink *_tx_sink;
-					Driver   &_driver;
+					Tx::Sink       *_tx_sink;
+					Driver         &_driver;
+					Genode::size_t  _max_frame_size;
+					unsigned        _offload;
 
 				public:
 
-					Tx_thread(Tx::Sink *tx_sink, Driver &driver)
+					Tx_thread(Tx::Sink *tx_sink, Driver &driver,
+					          Genode::size_t mtu, unsigned offload)
 					:
 						Genode::Thread<TX_STACK_SIZE>("tx"),
-						_tx_sink(tx_sink), _driver(driver)
+						_tx_sink(tx_sink), _driver(driver),
+						_max_frame_size(Session::frame_size(mtu)),
+						_offload(offload)
 					{
 						start();
 					}
@@ -68,8 +75,26 @@ namespace Nic {
 								continue;
 							}
 
-							_driver.tx(_tx_sink->packet_content(packet),
-							           packet.size());
+							/* ignore offloads the client did not negotiate */
+							packet.restrict_offload(_offload);
+
+							char const *content = _tx_sink->packet_content(packet);
+							unsigned const offload = packet.offload();
+
+							/*
+							 * Drop frames exceeding the negotiated MTU, except
+							 * for large segments split by the driver
+							 */
+							if (offload & Packet_descriptor::GSO_TCPV4) {
+								_driver.tx_offload(content, packet.size(), packet);
+							} else if (packet.size() > _max_frame_size) {
+								PWRN("drop packet of size %zd exceeding MTU",
+								     packet.size());
+							} else if (offload) {
+								_driver.tx_offload(content, packet.size(), packet);
+							} else {
+								_driver.tx(content, packet.size());
+							}
 
 							/* acknowledge packet to the client */
 							if (!_tx_sink->ready_to_ack())
@@ -79,6 +104,49 @@ namespace Nic {
 					}
 			} _tx_thread;
 
+			Genode::size_t _negotiate_mtu(Genode::size_t mtu)
+			{
+				_mtu = Genode::min(Genode::max(mtu, (Genode::size_t)Session::MIN_MTU),
+				                   _driver.mtu());
+				return _mtu;
+			}
+
+			unsigned _negotiate_offload(unsigned offload)
+			{
+				_offload = offload & _driver.offload();
+				return _offload;
+			}
+
+			/**
+			 * Release rx packets acknowledged by the client
+			 */
+			void _release_acked_rx_packets()
+			{
+				while (_rx.source()->ack_avail())
+					_rx.source()->release_packet(_rx.source()->get_acked_packet());
+			}
+
+			/**
+			 * Allocator of rx packets for segmenting large rx packets
+			 */
+			struct Rx_segment_alloc : Segment_alloc
+			{
+				Rx::Source        *source;
+				Packet_descriptor  packet;
+
+				Rx_segment_alloc(Rx::Source *source) : source(source) { }
+
+				char *alloc(Genode::size_t size)
+				{
+					try {
+						packet = source->alloc_packet(size);
+						return source->packet_content(packet);
+					} catch (Rx::Source::Packet_alloc_failed) { return 0; }
+				}
+
+				void submit() { source->submit_packet(packet); }
+			};
+
 			void dump()
 			{
 				using namespace Genode;
@@ -103,11 +171,19 @@ namespace Nic {
 			 * \param rx_buf_size        buffer size for rx channel
 			 * \param rx_block_alloc     rx block allocator
 			 * \param ep                 entry point used for packet stream
+			 * \param mtu                MTU proposed by the client
+			 * \param offload            offload flags proposed by the client
+			 *
+			 * The effective MTU of the session is the minimum of the MTU
+			 * proposed by the client and the MTU supported by the driver.
+			 * Likewise, only offloads supported by the driver are accepted.
 			 */
 			Session_component(Genode::size_t          tx_buf_size,
 			                  Genode::size_t          rx_buf_size,
 			                  Nic::Driver_factory    &driver_factory,
-			                  Genode::Rpc_entrypoint &ep)
+			                  Genode::Rpc_entrypoint &ep,
+			                  Genode::size_t          mtu     = DEFAULT_MTU,
+			                  unsigned                offload = 0)
 			:
 				Genode::Allocator_avl(Genode::env()->heap()),
 				Session_rpc_object(Genode::env()->ram_session()->alloc(tx_buf_size),
@@ -115,7 +191,8 @@ namespace Nic {
 				                   static_cast<Genode::Range_allocator *>(this), ep),
 				_driver_factory(driver_factory),
 				_driver(*driver_factory.create(*this)),
-				_tx_thread(_tx.sink(), _driver)
+				_tx_thread(_tx.sink(), _driver, _negotiate_mtu(mtu),
+				           _negotiate_offload(offload))
 			{ }
 
 			/**
@@ -142,12 +219,7 @@ namespace Nic {
 			void submit()
 			{
 				/* check for acknowledgements from the client */
-				while (_rx.source()->ack_avail()) {
-					Packet_descriptor packet = _rx.source()->get_acked_packet();
-
-					/* free packet buffer */
-					_rx.source()->release_packet(packet);
-				}
+				_release_acked_rx_packets();
 
 				dump();
 
@@ -157,6 +229,37 @@ namespace Nic {
 				_curr_rx_packet = Packet_descriptor();
 			}
 
+			void submit(Genode::size_t size, Packet_descriptor const &meta)
+			{
+				_release_acked_rx_packets();
+
+				typedef Packet_descriptor Packet;
+
+				char * const content = _rx.source()->packet_content(_curr_rx_packet);
+				Packet packet(_curr_rx_packet.offset(),
+				              Genode::min(size, _curr_rx_packet.size()));
+
+				/* invalidate rx packet descriptor */
+				_curr_rx_packet = Packet_descriptor();
+
+				/* complete offloads not accepted by the client */
+				unsigned const offload = meta.offload();
+				if ((offload & Packet::GSO_TCPV4) && !(_offload & Packet::GSO_TCPV4)) {
+					Rx_segment_alloc alloc(_rx.source());
+					if (!segment_tcpv4(content, packet.size(), meta, alloc))
+						PWRN("segmentation of rx packet failed");
+					_rx.source()->release_packet(packet);
+					return;
+				}
+
+				if ((offload & Packet::CSUM_PARTIAL) && !(_offload & Packet::CSUM_PARTIAL))
+					complete_checksum(content, packet.size(), meta);
+				else
+					packet.offload(meta);
+
+				_rx.source()->submit_packet(packet);
+			}
+
 
 			/****************************
 			 ** Nic::Session interface **
@@ -197,6 +300,10 @@ namespace Nic {
 					Arg_string::find_arg(args, "tx_buf_size").ulong_value(0);
 				Genode::size_t rx_buf_size =
 					Arg_string::find_arg(args, "rx_buf_size").ulong_value(0);
+				Genode::size_t mtu =
+					Arg_string::find_arg(args, "mtu").ulong_value(Session::DEFAULT_MTU);
+				unsigned offload =
+					Arg_string::find_arg(args, "offload").ulong_value(0);
 
 				/* delete ram quota by the memory needed for the session */
 				Genode::size_t session_size = max((Genode::size_t)4096, sizeof(Session_component)
@@ -220,7 +327,7 @@ namespace Nic {
 				return new (md_alloc()) Session_component(tx_buf_size,
 				                                          rx_buf_size,
 				                                          _driver_factory,
-				                                          _ep);
+				                                          _ep, mtu, offload);
 			}
 
 		public:
@@ -33,6 +33,18 @@ namespace Nic {
 		 * Submit packet to client
 		 */
 		virtual void submit() = 0;
+
+		/**
+		 * Submit packet to client
+		 *
+		 * \param size  number of bytes used of the allocated buffer
+		 * \param meta  offload information of the packet
+		 *
+		 * This function allows a driver to receive directly into a buffer
+		 * of the maximum frame size. Offloads that were not accepted by the
+		 * client are completed before the packet is submitted.
+		 */
+		virtual void submit(Genode::size_t size, Packet_descriptor const &meta) = 0;
 	};
 
 
@@ -46,6 +58,11 @@ namespace Nic {
 		 */
 		virtual Mac_address mac_address() = 0;
 
+		/**
+		 * Return maximum transmission unit supported by the network interface
+		 */
+		virtual Genode::size_t mtu() { return Session::DEFAULT_MTU; }
+
 		/**
 		 * Transmit packet
 		 *
@@ -57,6 +74,25 @@ namespace Nic {
 		 * length (in the worst case, 3 bytes after the packet end).
 		 */
 		virtual void tx(char const *packet, Genode::size_t size) = 0;
+
+		/**
+		 * Return offload flags supported by the driver
+		 *
+		 * A driver that supports offloads must implement 'tx_offload'.
+		 */
+		virtual unsigned offload() { return 0; }
+
+		/**
+		 * Transmit packet carrying offload information
+		 *
+		 * \param packet start of packet
+		 * \param size   packet size
+		 * \param meta   offload information, limited to the offloads
+		 *               reported by 'offload()'
+		 */
+		virtual void tx_offload(char const *packet, Genode::size_t size,
+		                        Packet_descriptor const &meta) {
+			tx(packet, size); }
 	};
 
 
@@ -0,0 +1,223 @@
+/*
+ * \brief  Software fallback for NIC-packet offloads
+ * \author Genode Labs
+ * \date   2014-01-14
+ *
+ * Packets carrying offload flags (see 'Nic::Packet_descriptor::Offload') must
+ * be completed before they are handed to a peer that does not accept the
+ * respective offload, e.g., a network adaptor. The functions in this file
+ * perform this work in software.
+ */
+
+/*
+ * Copyright (C) 2014 Genode Labs GmbH
+ *
+ * This file is part of the Genode OS framework, which is distributed
+ * under the terms of the GNU General Public License version 2.
+ */
+
+#ifndef _INCLUDE__NIC__OFFLOAD_H_
+#define _INCLUDE__NIC__OFFLOAD_H_
+
+#include <util/string.h>
+#include <util/misc_math.h>
+#include <nic_session/nic_session.h>
+
+namespace Nic {
+
+	/**
+	 * Interface for allocating the backing store of segments
+	 */
+	struct Segment_alloc
+	{
+		/**
+		 * Allocate buffer for segment
+		 *
+		 * \return  buffer, or 0 if the allocation failed
+		 */
+		virtual char *alloc(Genode::size_t) = 0;
+
+		/**
+		 * Submit the segment allocated last
+		 */
+		virtual void submit() = 0;
+	};
+
+
+	/**
+	 * Accessors for the protocol headers used by the offload functions
+	 */
+	namespace Offload {
+
+		using Genode::uint8_t;
+		using Genode::uint16_t;
+		using Genode::uint32_t;
+		using Genode::size_t;
+
+		enum {
+			ETH_HEADER     = 14,
+			ETH_TYPE       = 12,
+			ETH_TYPE_IPV4  = 0x0800,
+			IP_TOTAL_LEN   = 2,
+			IP_ID          = 4,
+			IP_PROTOCOL    = 9,
+			IP_CHECKSUM    = 10,
+			IP_SRC         = 12,
+			IP_PROTO_TCP   = 6,
+			TCP_SEQ        = 4,
+			TCP_DATA_OFF   = 12,
+			TCP_FLAGS      = 13,
+			TCP_CHECKSUM   = 16,
+			TCP_FIN        = 0x01,
+			TCP_PSH        = 0x08,
+			TCP_CWR        = 0x80,
+		};
+
+		inline uint16_t get16(uint8_t const *p) { return (p[0] << 8) | p[1]; }
+
+		inline uint32_t get32(uint8_t const *p) {
+			return (get16(p) << 16) | get16(p + 2); }
+
+		inline void set16(uint8_t *p, uint16_t v) { p[0] = v >> 8; p[1] = v; }
+
+		inline void set32(uint8_t *p, uint32_t v) {
+			set16(p, v >> 16); set16(p + 2, v); }
+
+		/**
+		 * Add data to ones' complement sum
+		 *
+		 * The sum is not folded, which is fine for data up to 128 KiB.
+		 */
+		inline uint32_t sum(uint32_t sum, uint8_t const *data, size_t len)
+		{
+			for (; len > 1; len -= 2, data += 2)
+				sum += get16(data);
+
+			if (len)
+				sum += data[0] << 8;
+
+			return sum;
+		}
+
+		/**
+		 * Fold ones' complement sum to checksum
+		 */
+		inline uint16_t checksum(uint32_t sum)
+		{
+			while (sum >> 16)
+				sum = (sum & 0xffff) + (sum >> 16);
+
+			return ~sum;
+		}
+	}
+
+
+	/**
+	 * Complete transport-layer checksum of a 'CSUM_PARTIAL' packet
+	 *
+	 * \return  false if the offload information does not match the packet
+	 */
+	inline bool complete_checksum(char *packet, Genode::size_t size,
+	                              Packet_descriptor const &meta)
+	{
+		using namespace Offload;
+
+		size_t const start = meta.csum_start();
+		size_t const field = start + meta.csum_offset();
+		if (start >= size || field + 2 > size)
+			return false;
+
+		uint8_t * const data = (uint8_t *)packet;
+		set16(data + field, checksum(sum(0, data + start, size - start)));
+		return true;
+	}
+
+
+	/**
+	 * Split a 'GSO_TCPV4' packet into segments
+	 *
+	 * Each segment carries a copy of the Ethernet, IP, and TCP headers of the
+	 * large packet with adjusted length, IP identification, TCP sequence
+	 * number, and flags. The IP and TCP checksums of the segments are
+	 * computed completely.
+	 *
+	 * \return  false if the packet is malformed or a segment could not
+	 *          be allocated
+	 */
+	inline bool segment_tcpv4(char const *packet, Genode::size_t size,
+	                          Packet_descriptor const &meta,
+	                          Segment_alloc &alloc)
+	{
+		using namespace Offload;
+
+		uint8_t const * const data = (uint8_t const *)packet;
+
+		if (size < ETH_HEADER + 20 || get16(data + ETH_TYPE) != ETH_TYPE_IPV4)
+			return false;
+
+		/*
+		 * The header lengths are taken from the packet, which may stem
+		 * from an untrusted client. The fields written into each segment
+		 * must lie within the copied headers.
+		 */
+		uint8_t const * const ip     = data + ETH_HEADER;
+		size_t          const ip_len = (ip[0] & 0xf)*4;
+		if (ip[IP_PROTOCOL] != IP_PROTO_TCP || ip_len < 20
+		 || ETH_HEADER + ip_len + 20 > size)
+			return false;
+
+		uint8_t const * const tcp     = ip + ip_len;
+		size_t          const tcp_len = (tcp[TCP_DATA_OFF] >> 4)*4;
+		size_t          const hdr_len = ETH_HEADER + ip_len + tcp_len;
+		size_t          const mss     = meta.gso_size();
+		if (tcp_len < 20 || hdr_len > size || !mss)
+			return false;
+
+		size_t   const payload = size - hdr_len;
+		uint32_t const seq     = get32(tcp + TCP_SEQ);
+		uint16_t const id      = get16(ip + IP_ID);
+
+		size_t offset = 0;
+		for (unsigned i = 0; ; i++) {
+
+			size_t const len = Genode::min(mss, payload - offset);
+
+			uint8_t *seg = (uint8_t *)alloc.alloc(hdr_len + len);
+			if (!seg)
+				return false;
+
+			Genode::memcpy(seg, data, hdr_len);
+			Genode::memcpy(seg + hdr_len, data + hdr_len + offset, len);
+
+			/* IP header */
+			uint8_t *seg_ip = seg + ETH_HEADER;
+			set16(seg_ip + IP_TOTAL_LEN, ip_len + tcp_len + len);
+			set16(seg_ip + IP_ID, id + i);
+			set16(seg_ip + IP_CHECKSUM, 0);
+			set16(seg_ip + IP_CHECKSUM, checksum(sum(0, seg_ip, ip_len)));
+
+			/* TCP header, FIN and PSH belong to the last segment only */
+			bool const last = offset + len == payload;
+			uint8_t *seg_tcp = seg_ip + ip_len;
+			set32(seg_tcp + TCP_SEQ, seq + offset);
+			if (!last)
+				seg_tcp[TCP_FLAGS] &= ~(TCP_FIN | TCP_PSH);
+			if (offset)
+				seg_tcp[TCP_FLAGS] &= ~TCP_CWR;
+
+			/* TCP checksum including the pseudo header */
+			uint32_t s = sum(0, seg_ip + IP_SRC, 8);
+			s += IP_PROTO_TCP + tcp_len + len;
+			set16(seg_tcp + TCP_CHECKSUM, 0);
+			set16(seg_tcp + TCP_CHECKSUM, checksum(sum(s, seg_tcp, tcp_len + len)));
+
+			alloc.submit();
+
+			offset += len;
+			if (last)
+				return true;
+		}
+	}
+}
+
+#endif /* _INCLUDE__NIC__OFFLOAD_H_ */
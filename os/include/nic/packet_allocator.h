@@ -4,10 +4,12 @@
  * \date   2012-07-30
  *
  * This allocator can be used with a nic session. It is *not* required though.
+ * Free packets are tracked by a hierarchical bitmap, which keeps the cost of
+ * an allocation independent of the occupancy of the packet buffer.
  */
 
 /*
- * Copyright (C) 2012-2013 Genode Labs GmbH
+ * Copyright (C) 2012-2014 Genode Labs GmbH
  *
  * This file is part of the Genode OS framework, which is distributed
  * under the terms of the GNU General Public License version 2.
@@ -17,7 +19,8 @@
 #define _INCLUDE__NIC__PACKET_ALLOCATOR__
 
 #include <base/allocator.h>
-#include <util/string.h>
+#include <util/bit_tree.h>
+#include <util/volatile_object.h>
 
 namespace Nic {
 
@@ -25,12 +28,19 @@ namespace Nic {
 	{
 		private:
 
+			typedef Genode::Bit_tree_base Bit_tree;
+
 			Genode::Allocator *_md_alloc;   /* meta-data allocator */
 			unsigned           _block_size; /* network packet size */
 			Genode::addr_t     _base;       /* allocation base */
-			unsigned          *_free;       /* free list */
-			int                _curr_idx;   /* current index in free list */
-			int                _count;      /* number of elements */
+			Genode::addr_t    *_words;      /* bitmap of free packets */
+			Genode::size_t     _count;      /* number of elements */
+			Genode::size_t     _used;       /* number of allocated elements */
+
+			Genode::Lazy_volatile_object<Bit_tree> _free;
+
+			Genode::size_t _words_size() const {
+				return sizeof(Genode::addr_t) * Bit_tree::words_needed(_count); }
 
 		public:
 
@@ -44,14 +54,19 @@ namespace Nic {
 			 */
 			Packet_allocator(Genode::Allocator *md_alloc,
 			                 unsigned block_size = DEFAULT_PACKET_SIZE)
-			: _md_alloc(md_alloc), _block_size(block_size), _base(0), _free(0),
-			  _curr_idx(0), _count(0)
+			: _md_alloc(md_alloc), _block_size(block_size), _base(0), _words(0),
+			  _count(0), _used(0)
 			{}
 
+			/**
+			 * Return size of the packets handed out by the allocator
+			 */
+			unsigned block_size() const { return _block_size; }
+
 			~Packet_allocator()
 			{
-				if (_free)
-					_md_alloc->free(_free, sizeof(unsigned) * (_count / 32));
+				if (_words)
+					_md_alloc->free(_words, _words_size());
 			}
 
 
@@ -61,14 +76,18 @@ namespace Nic {
 
 			int add_range(Genode::addr_t base, Genode::size_t size)
 			{
-				if (_count)
+				if (_count || size < _block_size)
 					return -1;
 
 				_base  = base;
 				_count = size / _block_size;
-				_free  = (unsigned *)_md_alloc->alloc(sizeof(unsigned) * (_count / 32));
 
-				Genode::memset(_free, 0xff, sizeof(unsigned) * (_count / 32));
+				if (!_md_alloc->alloc(_words_size(), &_words)) {
+					_count = 0;
+					return -1;
+				}
+
+				_free.construct(_words, _count);
 				return 0;
 			}
 
@@ -77,43 +96,38 @@ namespace Nic {
 				                             : Alloc_return::RANGE_CONFLICT; }
 
 			bool alloc(Genode::size_t size, void **out_addr)
-			{ 
-				int free_cnt = _count / 32;
-
-				for (register int i = 0; i < free_cnt; i++) {
-
-					if (_free[_curr_idx] != 0) {
-						unsigned msb = Genode::log2(_free[_curr_idx]);
-						int elem_idx = (_curr_idx * 32) + msb;
-
-						if (elem_idx < _count) {
-							_free[_curr_idx] ^= (1 << msb);
-							*out_addr = reinterpret_cast<void *>(_base + (_block_size * elem_idx));
-							return true;
-						}
-					}
-
-					_curr_idx = (_curr_idx + 1) % free_cnt;
-				}
-				return false;
+			{
+				Genode::addr_t elem_idx = 0;
+				if (size > _block_size || !_count || !_free->first_free(elem_idx))
+					return false;
+
+				_free->reserve(elem_idx);
+				_used++;
+				*out_addr = reinterpret_cast<void *>(_base + (_block_size * elem_idx));
+				return true;
 			}
 
 			void free(void *addr)
 			{
 				Genode::addr_t a = reinterpret_cast<Genode::addr_t>(addr);
 
-				int elem_idx = (a - _base) / _block_size;
-				if (elem_idx >= _count)
+				Genode::addr_t elem_idx = (a - _base) / _block_size;
+				if (a < _base || elem_idx >= _count || _free->free(elem_idx))
 					return;
 
-				_curr_idx = elem_idx / 32;
-				_free[_curr_idx] |= (1 << (elem_idx % 32));
+				_free->release(elem_idx);
+				_used--;
 			}
 
 			void free(void *addr, Genode::size_t) { free(addr); }
 
 			bool need_size_for_free() const override { return false; }
 
+			Genode::size_t avail() { return (_count - _used) * _block_size; }
+
+			bool valid_addr(Genode::addr_t addr) {
+				return addr >= _base && addr < _base + _count * _block_size; }
+
 
 			/*********************
 			 ** Dummy functions **
@@ -121,8 +135,6 @@ namespace Nic {
 
 			Genode::size_t overhead(Genode::size_t) {  return 0;}
 			int remove_range(Genode::addr_t, Genode::size_t) { return 0;}
-			Genode::size_t avail() { return 0; }
-			bool valid_addr(Genode::addr_t) { return 0; }
 			Alloc_return alloc_addr(Genode::size_t, Genode::addr_t) {
 				return Alloc_return(Alloc_return::OUT_OF_METADATA); }
 	};
@@ -0,0 +1,173 @@
+/*
+ * \brief  Packet allocator with size classes for NIC-session packet streams
+ * \author Genode Labs
+ * \date   2014-01-10
+ *
+ * The packet buffer is partitioned into regions, each managed by a
+ * 'Nic::Packet_allocator' with a distinct packet size. Small packets such as
+ * TCP acknowledgements do not occupy a full-sized slot, and sessions with a
+ * jumbo-frame MTU obtain slots large enough for a whole frame. Like the
+ * 'Nic::Packet_allocator', the use of this allocator is optional.
+ */
+
+/*
+ * Copyright (C) 2014 Genode Labs GmbH
+ *
+ * This file is part of the Genode OS framework, which is distributed
+ * under the terms of the GNU General Public License version 2.
+ */
+
+#ifndef _INCLUDE__NIC__SIZE_CLASS_PACKET_ALLOCATOR_H_
+#define _INCLUDE__NIC__SIZE_CLASS_PACKET_ALLOCATOR_H_
+
+#include <util/misc_math.h>
+#include <nic/packet_allocator.h>
+#include <nic_session/nic_session.h>
+
+namespace Nic { class Size_class_packet_allocator; }
+
+
+class Nic::Size_class_packet_allocator : public Genode::Range_allocator
+{
+	public:
+
+		enum {
+			SMALL_PACKET_SIZE = 64,
+			LARGE_PACKET_SIZE = Packet_allocator::DEFAULT_PACKET_SIZE,
+			JUMBO_PACKET_SIZE = 9216,
+
+			/* fraction of the buffer dedicated to small packets */
+			SMALL_SHARE_LOG2  = 4,
+		};
+
+	private:
+
+		enum { SMALL, LARGE, JUMBO, MAX_CLASSES };
+
+		Genode::size_t const _mtu;
+		unsigned       const _num_classes;
+
+		Genode::Lazy_volatile_object<Packet_allocator> _class[MAX_CLASSES];
+
+		static Genode::size_t _valid_mtu(Genode::size_t mtu) {
+			return Genode::min(mtu, (Genode::size_t)Session::MAX_MTU); }
+
+		static bool _jumbo(Genode::size_t mtu) {
+			return Session::frame_size(mtu) > LARGE_PACKET_SIZE; }
+
+	public:
+
+		/**
+		 * Constructor
+		 *
+		 * \param md_alloc  meta-data allocator
+		 * \param mtu       maximum transmission unit of the session, a jumbo
+		 *                  class is provided only if the MTU exceeds the
+		 *                  default packet size
+		 */
+		Size_class_packet_allocator(Genode::Allocator *md_alloc,
+		                            Genode::size_t     mtu = Session::DEFAULT_MTU)
+		:
+			_mtu(_valid_mtu(mtu)), _num_classes(_jumbo(_mtu) ? 3 : 2)
+		{
+			_class[SMALL].construct(md_alloc, (unsigned)SMALL_PACKET_SIZE);
+			_class[LARGE].construct(md_alloc, (unsigned)LARGE_PACKET_SIZE);
+
+			if (_num_classes > JUMBO)
+				_class[JUMBO].construct(md_alloc, (unsigned)JUMBO_PACKET_SIZE);
+		}
+
+		Genode::size_t mtu() const { return _mtu; }
+
+
+		/*******************************
+		 ** Range-allocator interface **
+		 *******************************/
+
+		/**
+		 * Partition the buffer among the size classes
+		 *
+		 * One sixteenth of the buffer is reserved for small packets. The
+		 * remainder is split evenly between the large and jumbo classes, or
+		 * used for large packets only if the session has no jumbo MTU.
+		 */
+		int add_range(Genode::addr_t base, Genode::size_t size)
+		{
+			Genode::size_t const small = size >> SMALL_SHARE_LOG2;
+			Genode::size_t const jumbo = _num_classes > JUMBO
+			                           ? (size - small) / 2 : 0;
+			Genode::size_t const large = size - small - jumbo;
+
+			if (_class[SMALL]->add_range(base, small)
+			 || _class[LARGE]->add_range(base + small, large))
+				return -1;
+
+			if (jumbo && _class[JUMBO]->add_range(base + small + large, jumbo))
+				return -1;
+
+			return 0;
+		}
+
+		Alloc_return alloc_aligned(Genode::size_t size, void **out_addr, int) {
+			return alloc(size, out_addr) ? Alloc_return::OK
+			                             : Alloc_return::RANGE_CONFLICT; }
+
+		/**
+		 * Allocate packet from the smallest fitting class
+		 *
+		 * If the class is exhausted, the allocation falls back to the
+		 * next larger class.
+		 */
+		bool alloc(Genode::size_t size, void **out_addr)
+		{
+			for (unsigned i = 0; i < _num_classes; i++)
+				if (size <= _class[i]->block_size()
+				 && _class[i]->alloc(size, out_addr))
+					return true;
+
+			return false;
+		}
+
+		void free(void *addr)
+		{
+			Genode::addr_t const a = reinterpret_cast<Genode::addr_t>(addr);
+
+			for (unsigned i = 0; i < _num_classes; i++)
+				if (_class[i]->valid_addr(a)) {
+					_class[i]->free(addr);
+					return;
+				}
+		}
+
+		void free(void *addr, Genode::size_t) { free(addr); }
+
+		bool need_size_for_free() const override { return false; }
+
+		Genode::size_t avail()
+		{
+			Genode::size_t sum = 0;
+			for (unsigned i = 0; i < _num_classes; i++)
+				sum += _class[i]->avail();
+			return sum;
+		}
+
+		bool valid_addr(Genode::addr_t addr)
+		{
+			for (unsigned i = 0; i < _num_classes; i++)
+				if (_class[i]->valid_addr(addr))
+					return true;
+			return false;
+		}
+
+
+		/*********************
+		 ** Dummy functions **
+		 *********************/
+
+		Genode::size_t overhead(Genode::size_t) {  return 0;}
+		int remove_range(Genode::addr_t, Genode::size_t) { return 0;}
+		Alloc_return alloc_addr(Genode::size_t, Genode::addr_t) {
+			return Alloc_return(Alloc_return::OUT_OF_METADATA); }
+};
+
+#endif /* _INCLUDE__NIC__SIZE_CLASS_PACKET_ALLOCATOR_H_ */
@@ -51,6 +51,10 @@ namespace Nic {
 
 			Mac_address mac_address() { return call<Rpc_mac_address>(); }
 
+			Genode::size_t mtu() { return call<Rpc_mtu>(); }
+
+			unsigned offload() { return call<Rpc_offload>(); }
+
 			Tx *tx_channel() { return &_tx; }
 			Rx *rx_channel() { return &_rx; }
 			Tx::Source *tx() { return _tx.source(); }
@@ -29,15 +29,23 @@ namespace Nic {
 		 *                         transmission buffer
 		 * \param tx_buf_size      size of transmission buffer in bytes
 		 * \param rx_buf_size      size of reception buffer in bytes
+		 * \param mtu              proposed maximum transmission unit,
+		 *                         the effective value is reported by 'mtu()'
+		 * \param offload          offload flags the client is able to handle,
+		 *                         the accepted flags are reported by
+		 *                         'offload()'
 		 */
 		Connection(Genode::Range_allocator *tx_block_alloc,
 		           Genode::size_t           tx_buf_size,
-		           Genode::size_t           rx_buf_size)
+		           Genode::size_t           rx_buf_size,
+		           Genode::size_t           mtu     = Session::DEFAULT_MTU,
+		           unsigned                 offload = 0)
 		:
 			Genode::Connection<Session>(
-				session("ram_quota=%zd, tx_buf_size=%zd, rx_buf_size=%zd",
+				session("ram_quota=%zd, tx_buf_size=%zd, rx_buf_size=%zd, "
+				        "mtu=%zd, offload=%u",
 				        6*4096 + tx_buf_size + rx_buf_size,
-				        tx_buf_size, rx_buf_size)),
+				        tx_buf_size, rx_buf_size, mtu, offload)),
 			Session_client(cap(), tx_block_alloc)
 		{ }
 	};
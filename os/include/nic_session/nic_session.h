@@ -17,7 +17,7 @@
  */
 
 /*
- * Copyright (C) 2009-2013 Genode Labs GmbH
+ * Copyright (C) 2009-2014 Genode Labs GmbH
  *
  * This file is part of the Genode OS framework, which is distributed
  * under the terms of the GNU General Public License version 2.
@@ -37,10 +37,144 @@ namespace Nic {
 
 	struct Mac_address { char addr[6]; };
 
+
+	/**
+	 * Network packet with offload information
+	 *
+	 * The offload flags allow for handing over packets that still require
+	 * per-segment work, which is skipped if the packet never reaches a wire.
+	 * A packet may carry offload flags only if the flags were accepted for
+	 * the session (see 'Session::offload').
+	 */
+	class Packet_descriptor : public ::Packet_descriptor
+	{
+		public:
+
+			enum Offload {
+
+				/*
+				 * The transport-layer checksum is not computed. The checksum
+				 * field at 'csum_start() + csum_offset()' holds the
+				 * pseudo-header sum only. The checksum is completed by
+				 * computing the ones' complement sum from 'csum_start()' to
+				 * the end of the packet.
+				 */
+				CSUM_PARTIAL = 1 << 0,
+
+				/*
+				 * The packet is a TCP/IPv4 segment larger than the MTU,
+				 * which must be split into segments carrying at most
+				 * 'gso_size()' bytes of payload each. The flag implies
+				 * 'CSUM_PARTIAL'.
+				 */
+				GSO_TCPV4    = 1 << 1,
+			};
+
+		private:
+
+			Genode::uint16_t _offload;
+			Genode::uint16_t _csum_start;
+			Genode::uint16_t _csum_offset;
+			Genode::uint16_t _gso_size;
+
+		public:
+
+			/**
+			 * Constructor
+			 */
+			Packet_descriptor(Genode::off_t offset = 0, Genode::size_t size = 0)
+			:
+				::Packet_descriptor(offset, size),
+				_offload(0), _csum_start(0), _csum_offset(0), _gso_size(0)
+			{ }
+
+			/**
+			 * Constructor for packets without offload information
+			 */
+			Packet_descriptor(::Packet_descriptor p)
+			:
+				::Packet_descriptor(p.offset(), p.size()),
+				_offload(0), _csum_start(0), _csum_offset(0), _gso_size(0)
+			{ }
+
+			unsigned         offload()     const { return _offload;     }
+			Genode::uint16_t csum_start()  const { return _csum_start;  }
+			Genode::uint16_t csum_offset() const { return _csum_offset; }
+			Genode::uint16_t gso_size()    const { return _gso_size;    }
+
+			/**
+			 * Mark transport-layer checksum as not computed
+			 *
+			 * \param start   offset of the checksummed data within the packet
+			 * \param offset  offset of the checksum field relative to 'start'
+			 */
+			void csum_partial(Genode::uint16_t start, Genode::uint16_t offset)
+			{
+				_offload    |= CSUM_PARTIAL;
+				_csum_start  = start;
+				_csum_offset = offset;
+			}
+
+			/**
+			 * Mark packet as large TCP segment
+			 *
+			 * \param mss  maximum payload per resulting segment
+			 */
+			void gso_tcpv4(Genode::uint16_t mss)
+			{
+				_offload  |= GSO_TCPV4;
+				_gso_size  = mss;
+			}
+
+			/**
+			 * Strip offload information, e.g., after completing the work
+			 */
+			void clear_offload() { _offload = 0; }
+
+			/**
+			 * Strip offload flags not negotiated for the session
+			 */
+			void restrict_offload(unsigned accepted) { _offload &= accepted; }
+
+			/**
+			 * Take over offload information of another packet
+			 */
+			void offload(Packet_descriptor const &other)
+			{
+				_offload     = other._offload;
+				_csum_start  = other._csum_start;
+				_csum_offset = other._csum_offset;
+				_gso_size    = other._gso_size;
+			}
+	};
+
+
 	struct Session : Genode::Session
 	{
 		enum { QUEUE_SIZE = 1024 };
 
+		/*
+		 * Maximum transmission unit
+		 *
+		 * The MTU denotes the maximum payload of an Ethernet frame. The
+		 * client proposes an MTU via the 'mtu' session argument. The
+		 * server may lower it to the value supported by the network
+		 * adaptor but not below 'MIN_MTU', the minimum MTU of IPv4. The
+		 * effective MTU can be requested via 'mtu()'.
+		 */
+		enum {
+			MIN_MTU           = 576,
+			DEFAULT_MTU       = 1500,
+			MAX_MTU           = 9000,
+			ETHERNET_OVERHEAD = 18,  /* header including VLAN tag */
+		};
+
+		/**
+		 * Return maximum frame size for the given MTU
+		 */
+		static Genode::size_t frame_size(Genode::size_t mtu) {
+			return mtu + ETHERNET_OVERHEAD; }
+
 		/*
 		 * Types used by the client stub code and server implementation
 		 *
@@ -62,6 +196,21 @@ namespace Nic {
 		 */
 		virtual Mac_address mac_address() = 0;
 
+		/**
+		 * Request maximum transmission unit negotiated for the session
+		 */
+		virtual Genode::size_t mtu() = 0;
+
+		/**
+		 * Request offload flags accepted for the session
+		 *
+		 * The client states the 'Packet_descriptor::Offload' flags it is
+		 * able to handle via the 'offload' session argument. The server
+		 * reduces the set to the offloads it supports. Only accepted
+		 * offloads may be used in either direction.
+		 */
+		virtual unsigned offload() = 0;
+
 		/**
 		 * Request packet-transmission channel
 		 */
@@ -88,10 +237,13 @@ namespace Nic {
 		 *******************/
 
 		GENODE_RPC(Rpc_mac_address, Mac_address, mac_address);
+		GENODE_RPC(Rpc_mtu, Genode::size_t, mtu);
+		GENODE_RPC(Rpc_offload, unsigned, offload);
 		GENODE_RPC(Rpc_tx_cap, Genode::Capability<Tx>, _tx_cap);
 		GENODE_RPC(Rpc_rx_cap, Genode::Capability<Rx>, _rx_cap);
 
-		GENODE_RPC_INTERFACE(Rpc_mac_address, Rpc_tx_cap, Rpc_rx_cap);
+		GENODE_RPC_INTERFACE(Rpc_mac_address, Rpc_mtu, Rpc_offload,
+		                     Rpc_tx_cap, Rpc_rx_cap);
 	};
 }
 
@@ -27,6 +27,9 @@ namespace Nic {
 			Packet_stream_tx::Rpc_object<Tx> _tx;
 			Packet_stream_rx::Rpc_object<Rx> _rx;
 
+			Genode::size_t _mtu;
+			unsigned       _offload;
+
 		public:
 
 			/**
@@ -39,13 +42,21 @@ namespace Nic {
 			 * \param rx_buffer_alloc  allocator used for managing the communication
 			 *                         buffer of the rx packet stream
 			 * \param ep               entry point used for packet-stream channels
+			 * \param mtu              maximum transmission unit of the session
+			 * \param offload          offload flags accepted for the session
 			 */
 			Session_rpc_object(Genode::Dataspace_capability  tx_ds,
 			                   Genode::Dataspace_capability  rx_ds,
 			                   Genode::Range_allocator      *rx_buffer_alloc,
-			                   Genode::Rpc_entrypoint       &ep)
+			                   Genode::Rpc_entrypoint       &ep,
+			                   Genode::size_t                mtu     = DEFAULT_MTU,
+			                   unsigned                      offload = 0)
 			:
-				_tx(tx_ds, ep), _rx(rx_ds, rx_buffer_alloc, ep) { }
+				_tx(tx_ds, ep), _rx(rx_ds, rx_buffer_alloc, ep),
+				_mtu(mtu), _offload(offload) { }
+
+			Genode::size_t mtu()     { return _mtu; }
+			unsigned       offload() { return _offload; }
 
 			Genode::Capability<Tx> _tx_cap() { return _tx.cap(); }
 			Genode::Capability<Rx> _rx_cap() { return _rx.cap(); }
@@ -124,6 +124,11 @@ class Packet_descriptor
 /**
  * Ring buffer shared between source and sink, containing packet descriptors
  *
+ * 'QUEUE_SIZE' is the maximum number of slots. The number of slots actually
+ * used is agreed on by source and sink when setting up the packet stream.
+ * It is passed to each operation by the respective side rather than stored
+ * in the shared buffer, which could be modified by the other side.
+ *
  * This class is private to the packet-stream interface.
  */
 template <typename PACKET_DESCRIPTOR, int QUEUE_SIZE>
@@ -135,12 +140,29 @@ class Packet_descriptor_queue
 		unsigned          _tail;
 		PACKET_DESCRIPTOR _queue[QUEUE_SIZE];
 
+		unsigned _used(unsigned size) { return (_head%size + size - _tail%size)%size; }
+
 	public:
 
 		typedef PACKET_DESCRIPTOR Packet_descriptor;
 
+		enum { MAX_SIZE = QUEUE_SIZE };
+
 		enum Role { PRODUCER, CONSUMER };
 
+		/**
+		 * Return number of slots limited to the supported range
+		 */
+		static unsigned valid_size(unsigned size) {
+			return Genode::max(2U, Genode::min(size, (unsigned)QUEUE_SIZE)); }
+
+		/**
+		 * Return space occupied by a queue with 'size' slots in bytes
+		 */
+		static Genode::size_t bytes(unsigned size) {
+			return sizeof(Packet_descriptor_queue)
+			     - (QUEUE_SIZE - size)*sizeof(PACKET_DESCRIPTOR); }
+
 		/**
 		 * Constructor
 		 *
@@ -149,11 +171,11 @@ class Packet_descriptor_queue
 		 * constructor must know the role of the instance to initialize only
 		 * those members that are driven by the respective role.
 		 */
-		Packet_descriptor_queue(Role role)
+		Packet_descriptor_queue(Role role, unsigned size)
 		{
 			if (role == PRODUCER) {
 				_head = 0;
-				Genode::memset(_queue, 0, sizeof(_queue));
+				Genode::memset(_queue, 0, size*sizeof(PACKET_DESCRIPTOR));
 			} else
 				_tail = 0;
 		}
@@ -164,12 +186,12 @@ class Packet_descriptor_queue
 		 * \return true on success, or
 		 *         false if queue is full
 		 */
-		bool add(PACKET_DESCRIPTOR packet)
+		bool add(PACKET_DESCRIPTOR packet, unsigned size)
 		{
-			if (full()) return false;
+			if (full(size)) return false;
 
-			_queue[_head%QUEUE_SIZE] = packet;
-			_head = (_head + 1)%QUEUE_SIZE;
+			_queue[_head%size] = packet;
+			_head = (_head + 1)%size;
 			return true;
 		}
 
@@ -178,40 +200,38 @@ class Packet_descriptor_queue
 		 *
 		 * \return  packet descriptor
 		 */
-		PACKET_DESCRIPTOR get()
+		PACKET_DESCRIPTOR get(unsigned size)
 		{
-			PACKET_DESCRIPTOR packet = _queue[_tail%QUEUE_SIZE];
-			_tail = (_tail + 1)%QUEUE_SIZE;
+			PACKET_DESCRIPTOR packet = _queue[_tail%size];
+			_tail = (_tail + 1)%size;
 			return packet;
 		}
 
 		/**
 		 * Return true if packet-descriptor queue is empty
 		 */
-		bool empty() { return _tail == _head; }
+		bool empty(unsigned size) { return _used(size) == 0; }
 
 		/**
 		 * Return true if packet-descriptor queue is full
 		 */
-		bool full() { return (_head + 1)%QUEUE_SIZE == _tail; }
+		bool full(unsigned size) { return _used(size) == size - 1; }
 
 		/**
 		 * Return true if a single element is stored in the queue
 		 */
-		bool single_element() { return (_tail + 1)%QUEUE_SIZE == _head; }
+		bool single_element(unsigned size) { return _used(size) == 1; }
 
 
 		/**
 		 * Return true if a single slot is left to be put into the queue
 		 */
-		bool single_slot_free() { return (_head + 2)%QUEUE_SIZE == _tail; }
+		bool single_slot_free(unsigned size) { return _used(size) == size - 2; }
 
 		/**
 		 * Return number of slots left to be put into the queue
 		 */
-		unsigned slots_free() {
-			return ((_tail > _head) ? _tail - _head
-			                        : QUEUE_SIZE - _head + _tail) - 1; }
+		unsigned slots_free(unsigned size) { return size - 1 - _used(size); }
 };
 
 
@@ -233,18 +253,21 @@ class Packet_descriptor_transmitter
 		/* facility to send ready-to-receive signals */
 		Genode::Signal_transmitter         _rx_ready;
 
-		Genode::Lock _tx_queue_lock;
-		TX_QUEUE    *_tx_queue;
+		Genode::Lock    _tx_queue_lock;
+		TX_QUEUE       *_tx_queue;
+		unsigned const  _tx_queue_size;
 
 	public:
 
 		/**
 		 * Constructor
+		 *
+		 * \param tx_queue_size  number of slots of the queue
 		 */
-		Packet_descriptor_transmitter(TX_QUEUE *tx_queue)
+		Packet_descriptor_transmitter(TX_QUEUE *tx_queue, unsigned tx_queue_size)
 		:
 			_tx_ready_cap(_tx_ready.manage(&_tx_ready_context)),
-			_tx_queue(tx_queue)
+			_tx_queue(tx_queue), _tx_queue_size(tx_queue_size)
 		{ }
 
 		~Packet_descriptor_transmitter()
@@ -265,7 +288,7 @@ class Packet_descriptor_transmitter
 		bool ready_for_tx()
 		{
 			Genode::Lock::Guard lock_guard(_tx_queue_lock);
-			return !_tx_queue->full();
+			return !_tx_queue->full(_tx_queue_size);
 		}
 
 		void tx(typename TX_QUEUE::Packet_descriptor packet)
@@ -274,7 +297,7 @@ class Packet_descriptor_transmitter
 
 			do {
 				/* block for signal if tx queue is full */
-				if (_tx_queue->full())
+				if (_tx_queue->full(_tx_queue_size))
 					_tx_ready.wait_for_signal();
 
 				/*
@@ -283,16 +306,16 @@ class Packet_descriptor_transmitter
 				 * if the queue insertion succeeds and retry if needed.
 				 */
 
-			} while (_tx_queue->add(packet) == false);
+			} while (_tx_queue->add(packet, _tx_queue_size) == false);
 
-			if (_tx_queue->single_element())
+			if (_tx_queue->single_element(_tx_queue_size))
 				_rx_ready.submit();
 		}
 
 		/**
 		 * Return number of slots left to be put into the tx queue
 		 */
-		unsigned tx_slots_free() { return _tx_queue->slots_free(); }
+		unsigned tx_slots_free() { return _tx_queue->slots_free(_tx_queue_size); }
 };
 
 
@@ -314,18 +337,21 @@ class Packet_descriptor_receiver
 		/* facility to send ready-to-transmit signals */
 		Genode::Signal_transmitter         _tx_ready;
 
-		Genode::Lock _rx_queue_lock;
-		RX_QUEUE    *_rx_queue;
+		Genode::Lock    _rx_queue_lock;
+		RX_QUEUE       *_rx_queue;
+		unsigned const  _rx_queue_size;
 
 	public:
 
 		/**
 		 * Constructor
+		 *
+		 * \param rx_queue_size  number of slots of the queue
 		 */
-		Packet_descriptor_receiver(RX_QUEUE *rx_queue)
+		Packet_descriptor_receiver(RX_QUEUE *rx_queue, unsigned rx_queue_size)
 		:
 			_rx_ready_cap(_rx_ready.manage(&_rx_ready_context)),
-			_rx_queue(rx_queue)
+			_rx_queue(rx_queue), _rx_queue_size(rx_queue_size)
 		{ }
 
 		~Packet_descriptor_receiver()
@@ -346,19 +372,19 @@ class Packet_descriptor_receiver
 		bool ready_for_rx()
 		{
 			Genode::Lock::Guard lock_guard(_rx_queue_lock);
-			return !_rx_queue->empty();
+			return !_rx_queue->empty(_rx_queue_size);
 		}
 
 		void rx(typename RX_QUEUE::Packet_descriptor *out_packet)
 		{
 			Genode::Lock::Guard lock_guard(_rx_queue_lock);
 
-			while (_rx_queue->empty())
+			while (_rx_queue->empty(_rx_queue_size))
 				_rx_ready.wait_for_signal();
 
-			*out_packet = _rx_queue->get();
+			*out_packet = _rx_queue->get(_rx_queue_size);
 
-			if (_rx_queue->single_slot_free())
+			if (_rx_queue->single_slot_free(_rx_queue_size))
 				_tx_ready.submit();
 		}
 };
@@ -461,6 +487,10 @@ template <typename PACKET_DESCRIPTOR,
           typename CONTENT_TYPE>
 struct Packet_stream_policy
 {
+	/* number of queue slots used unless a smaller number is agreed on */
+	enum { MAX_QUEUE_SIZE = SUBMIT_QUEUE_SIZE > ACK_QUEUE_SIZE
+	                      ? SUBMIT_QUEUE_SIZE : ACK_QUEUE_SIZE };
+
 	typedef CONTENT_TYPE Content_type;
 
 	typedef PACKET_DESCRIPTOR Packet_descriptor;
@@ -526,24 +556,33 @@ class Packet_stream_source : private Packet_stream_base
 		 *                      between source and sink
 		 * \param packet_alloc  allocator for managing packet allocation within
 		 *                      the shared communication buffer
+		 * \param queue_size    number of slots of the submit and ack queues,
+		 *                      must match the value used by the sink
 		 *
 		 * The 'packet_alloc' must not be pre-initialized. It will be
 		 * initialized by the constructor using dataspace-relative offsets
 		 * rather than pointers.
+		 *
+		 * The queue size is limited to the queue sizes of the policy.
 		 */
 		Packet_stream_source(Genode::Range_allocator      *packet_alloc,
-		                     Genode::Dataspace_capability  transport_ds_cap)
+		                     Genode::Dataspace_capability  transport_ds_cap,
+		                     unsigned queue_size = POLICY::MAX_QUEUE_SIZE)
 		:
 			Packet_stream_base(transport_ds_cap,
-			                   sizeof(Submit_queue),
-			                   sizeof(Ack_queue)),
+			                   Submit_queue::bytes(Submit_queue::valid_size(queue_size)),
+			                   Ack_queue::bytes(Ack_queue::valid_size(queue_size))),
 			_packet_alloc(packet_alloc),
 
 			/* construct packet-descriptor queues */
 			_submit_transmitter(new (_submit_queue_local_base(), this)
-			                    Submit_queue(Submit_queue::PRODUCER)),
+			                    Submit_queue(Submit_queue::PRODUCER,
+			                                 Submit_queue::valid_size(queue_size)),
+			                    Submit_queue::valid_size(queue_size)),
 			_ack_receiver(new (_ack_queue_local_base(), this)
-			              Ack_queue(Ack_queue::CONSUMER))
+			              Ack_queue(Ack_queue::CONSUMER,
+			                        Ack_queue::valid_size(queue_size)),
+			              Ack_queue::valid_size(queue_size))
 		{
 			/* initialize packet allocator */
 			_packet_alloc->add_range(_bulk_buffer_offset,
@@ -700,16 +739,25 @@ class Packet_stream_sink : private Packet_stream_base
 		 *
 		 * \param transport_ds  dataspace used for communication buffer shared between
 		 *                      source and sink
+		 * \param queue_size    number of slots of the submit and ack queues,
+		 *                      must match the value used by the source
 		 */
-		Packet_stream_sink(Genode::Dataspace_capability transport_ds)
+		Packet_stream_sink(Genode::Dataspace_capability transport_ds,
+		                   unsigned queue_size = POLICY::MAX_QUEUE_SIZE)
 		:
-			Packet_stream_base(transport_ds, sizeof(Submit_queue), sizeof(Ack_queue)),
+			Packet_stream_base(transport_ds,
+			                   Submit_queue::bytes(Submit_queue::valid_size(queue_size)),
+			                   Ack_queue::bytes(Ack_queue::valid_size(queue_size))),
 
 			/* construct packet-descriptor queues */
 			_submit_receiver(new (_submit_queue_local_base(), this)
-			                  Submit_queue(Submit_queue::CONSUMER)),
+			                  Submit_queue(Submit_queue::CONSUMER,
+			                               Submit_queue::valid_size(queue_size)),
+			                  Submit_queue::valid_size(queue_size)),
 			_ack_transmitter(new (_ack_queue_local_base(), this)
-			                 Ack_queue(Ack_queue::PRODUCER))
+			                 Ack_queue(Ack_queue::PRODUCER,
+			                           Ack_queue::valid_size(queue_size)),
+			                 Ack_queue::valid_size(queue_size))
 		{ }
 
 		/**
@@ -0,0 +1,234 @@
+/*
+ * \brief  Registry for sharing identical ROM content among dataspaces
+ * \author Genode Labs
+ * \date   2014-02-24
+ *
+ * ROM servers that copy file content into RAM dataspaces, such as
+ * 'tar_rom' or 'fs_rom', end up with multiple copies of the same content
+ * if a file is requested by several clients or is present under different
+ * names. The registry identifies content by its hash and size and hands
+ * out a single dataspace for all requests of identical content.
+ *
+ * ROM dataspaces are not protected against writes. A client may thereby
+ * modify content used by other clients. Sharing must hence be enabled only
+ * if all clients trust each other. Otherwise, the registry hands out a
+ * private dataspace for each request.
+ */
+
+/*
+ * Copyright (C) 2014 Genode Labs GmbH
+ *
+ * This file is part of the Genode OS framework, which is distributed
+ * under the terms of the GNU General Public License version 2.
+ */
+
+#ifndef _INCLUDE__OS__ROM_CONTENT_REGISTRY_H_
+#define _INCLUDE__OS__ROM_CONTENT_REGISTRY_H_
+
+#include <base/allocator.h>
+#include <base/env.h>
+#include <base/lock.h>
+#include <os/reporter.h>
+#include <util/list.h>
+#include <util/string.h>
+
+namespace Genode { class Rom_content_registry; }
+
+
+class Genode::Rom_content_registry
+{
+	public:
+
+		class Content : public List<Content>::Element
+		{
+			private:
+
+				friend class Rom_content_registry;
+
+				Ram_dataspace_capability const _ds;
+				size_t                   const _size;
+				uint64_t                 const _hash;
+				unsigned                       _users;
+
+				Content(Ram_dataspace_capability ds, size_t size, uint64_t hash)
+				: _ds(ds), _size(size), _hash(hash), _users(1) { }
+
+			public:
+
+				Dataspace_capability ds()   const { return _ds; }
+				size_t               size() const { return _size; }
+		};
+
+	private:
+
+		Allocator    &_md_alloc;
+		bool const    _sharing;
+		Lock          _lock;
+		List<Content> _contents;
+
+		size_t _used;    /* size of the content kept in dataspaces */
+		size_t _shared;  /* size of the content not copied due to sharing */
+
+		/**
+		 * Return FNV-1a hash of content
+		 */
+		static uint64_t _hash(void const *src, size_t size)
+		{
+			uint64_t hash = 0xcbf29ce484222325ULL;
+
+			unsigned char const *c = (unsigned char const *)src;
+			for (size_t i = 0; i < size; i++)
+				hash = (hash ^ c[i])*0x100000001b3ULL;
+
+			return hash;
+		}
+
+		/**
+		 * Look up content equal to 'size' bytes at 'src'
+		 */
+		Content *_lookup(void const *src, size_t size, uint64_t hash)
+		{
+			if (!_sharing)
+				return 0;
+
+			for (Content *c = _contents.first(); c; c = c->next()) {
+
+				if (c->_hash != hash || c->_size != size)
+					continue;
+
+				/* rule out hash collisions */
+				void const *addr = env()->rm_session()->attach(c->_ds);
+				bool const equal = memcmp(addr, src, size) == 0;
+				env()->rm_session()->detach(addr);
+
+				if (equal)
+					return c;
+			}
+			return 0;
+		}
+
+		Content &_share(Content &content)
+		{
+			content._users++;
+			_shared += content._size;
+			return content;
+		}
+
+		Content &_insert(Ram_dataspace_capability ds, size_t size, uint64_t hash)
+		{
+			Content *content = new (&_md_alloc) Content(ds, size, hash);
+			_contents.insert(content);
+			_used += size;
+			return *content;
+		}
+
+	public:
+
+		/**
+		 * Constructor
+		 *
+		 * \param md_alloc  allocator used for the meta data of the content
+		 * \param sharing   share identical content, or hand out a private
+		 *                  dataspace for each request
+		 */
+		Rom_content_registry(Allocator &md_alloc, bool sharing)
+		: _md_alloc(md_alloc), _sharing(sharing), _used(0), _shared(0) { }
+
+		/**
+		 * Obtain dataspace with a copy of 'size' bytes at 'src'
+		 *
+		 * The dataspace is allocated from the RAM session of the component
+		 * unless identical content is present already.
+		 *
+		 * \throw Ram_session::Alloc_failed
+		 */
+		Content &acquire(void const *src, size_t size)
+		{
+			Lock::Guard guard(_lock);
+
+			uint64_t const hash = _hash(src, size);
+
+			if (Content *content = _lookup(src, size, hash))
+				return _share(*content);
+
+			Ram_dataspace_capability ds = env()->ram_session()->alloc(size);
+
+			void *dst = env()->rm_session()->attach(ds);
+			memcpy(dst, src, size);
+			env()->rm_session()->detach(dst);
+
+			return _insert(ds, size, hash);
+		}
+
+		/**
+		 * Register dataspace filled with content by the caller
+		 *
+		 * If identical content is present already, the dataspace is freed
+		 * and the present content is returned instead.
+		 *
+		 * \param ds     dataspace allocated from the RAM session of the
+		 *               component, whose ownership is passed to the
+		 *               registry
+		 * \param local  local address of the dataspace
+		 * \param size   size of the content in bytes
+		 */
+		Content &acquire(Ram_dataspace_capability ds, void const *local, size_t size)
+		{
+			Lock::Guard guard(_lock);
+
+			uint64_t const hash = _hash(local, size);
+
+			if (Content *content = _lookup(local, size, hash)) {
+				env()->ram_session()->free(ds);
+				return _share(*content);
+			}
+
+			return _insert(ds, size, hash);
+		}
+
+		/**
+		 * Drop reference to content, freeing the dataspace of the last user
+		 */
+		void release(Content &content)
+		{
+			Lock::Guard guard(_lock);
+
+			if (--content._users) {
+				_shared -= content._size;
+				return;
+			}
+
+			_contents.remove(&content);
+			_used -= content._size;
+
+			env()->ram_session()->free(content._ds);
+			destroy(&_md_alloc, &content);
+		}
+
+		/**
+		 * Return size of the content kept in dataspaces
+		 */
+		size_t used() const { return _used; }
+
+		/**
+		 * Return amount of memory saved by sharing content
+		 */
+		size_t saved() const { return _shared; }
+
+		/**
+		 * Report the size of the content kept in dataspaces ('used') and
+		 * the amount of memory saved by sharing content ('saved')
+		 */
+		void report(Reporter &reporter) const
+		{
+			if (!reporter.is_enabled())
+				return;
+
+			Reporter::Xml_generator xml(reporter, [&] () {
+				xml.attribute("used",  (long)_used);
+				xml.attribute("saved", (long)_shared);
+			});
+		}
+};
+
+#endif /* _INCLUDE__OS__ROM_CONTENT_REGISTRY_H_ */
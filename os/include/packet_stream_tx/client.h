@@ -46,12 +46,16 @@ namespace Packet_stream_tx {
 			 *
 			 * \param buffer_alloc  allocator used for managing the
 			 *                      transmission buffer
+			 * \param queue_size    number of slots of the packet queues as
+			 *                      agreed on with the server
 			 */
 			Client(Genode::Capability<CHANNEL> channel_cap,
-			       Genode::Range_allocator *buffer_alloc)
+			       Genode::Range_allocator *buffer_alloc,
+			       unsigned queue_size = CHANNEL::Policy::MAX_QUEUE_SIZE)
 			:
 				Genode::Rpc_client<CHANNEL>(channel_cap),
-				_source(buffer_alloc, Base::template call<Rpc_dataspace>())
+				_source(buffer_alloc, Base::template call<Rpc_dataspace>(),
+				        queue_size)
 			{
 				/* wire data-flow signals for the packet transmitter */
 				_source.register_sigh_packet_avail(Base::template call<Rpc_packet_avail>());
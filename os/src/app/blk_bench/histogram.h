@@ -0,0 +1,127 @@
+/*
+ * \brief  Latency histogram
+ * \author Genode Labs
+ * \date   2014-02-03
+ */
+
+/*
+ * Copyright (C) 2014 Genode Labs GmbH
+ *
+ * This file is part of the Genode OS framework, which is distributed
+ * under the terms of the GNU General Public License version 2.
+ */
+
+#ifndef _HISTOGRAM_H_
+#define _HISTOGRAM_H_
+
+/* Genode includes */
+#include <base/stdint.h>
+#include <util/misc_math.h>
+#include <util/string.h>
+
+namespace Blk_bench { class Histogram; }
+
+
+/**
+ * Histogram of values with a relative precision of 1/8
+ *
+ * Values below 16 are counted exactly. Larger values are counted in
+ * buckets of eight per power of two, so the histogram covers the whole
+ * value range with a fixed number of counters.
+ */
+class Blk_bench::Histogram
+{
+	public:
+
+		typedef Genode::uint64_t Value;
+
+	private:
+
+		enum {
+			SUB_BITS    = 3,
+			SUBS        = 1 << SUB_BITS,
+			LINEAR      = 2*SUBS,
+			NUM_BUCKETS = LINEAR + (64 - SUB_BITS - 1)*SUBS,
+		};
+
+		unsigned long _bucket[NUM_BUCKETS];
+		unsigned long _count;
+		Value         _min;
+		Value         _max;
+		Value         _sum;
+
+		static unsigned _index(Value v)
+		{
+			if (v < LINEAR)
+				return v;
+
+			unsigned const msb = Genode::log2(v);
+			unsigned const sub = (v >> (msb - SUB_BITS)) & (SUBS - 1);
+			return LINEAR + (msb - SUB_BITS - 1)*SUBS + sub;
+		}
+
+		/**
+		 * Return largest value counted in bucket 'i'
+		 */
+		static Value _upper(unsigned i)
+		{
+			if (i < LINEAR)
+				return i;
+
+			unsigned const msb   = (i - LINEAR)/SUBS + SUB_BITS + 1;
+			unsigned const sub   = (i - LINEAR)%SUBS;
+			Value    const first = (Value)(SUBS + sub) << (msb - SUB_BITS);
+			return first + ((Value)1 << (msb - SUB_BITS)) - 1;
+		}
+
+	public:
+
+		Histogram() { reset(); }
+
+		void reset()
+		{
+			Genode::memset(_bucket, 0, sizeof(_bucket));
+			_count = 0;
+			_min   = ~(Value)0;
+			_max   = 0;
+			_sum   = 0;
+		}
+
+		void add(Value v)
+		{
+			_bucket[_index(v)]++;
+			_count++;
+			_sum += v;
+			_min  = Genode::min(_min, v);
+			_max  = Genode::max(_max, v);
+		}
+
+		unsigned long count() const { return _count; }
+		Value min()  const { return _count ? _min : 0; }
+		Value max()  const { return _max; }
+		Value mean() const { return _count ? _sum/_count : 0; }
+
+		/**
+		 * Return value not exceeded by the given share of all values
+		 *
+		 * \param per_10000  share in units of 0.01 percent
+		 */
+		Value percentile(unsigned per_10000) const
+		{
+			if (!_count)
+				return 0;
+
+			unsigned long const rank =
+				((Genode::uint64_t)_count*per_10000 + 9999)/10000;
+
+			unsigned long seen = 0;
+			for (unsigned i = 0; i < NUM_BUCKETS; i++) {
+				seen += _bucket[i];
+				if (seen >= rank && seen)
+					return Genode::min(_upper(i), _max);
+			}
+			return _max;
+		}
+};
+
+#endif /* _HISTOGRAM_H_ */
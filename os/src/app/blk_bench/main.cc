@@ -0,0 +1,545 @@
+/*
+ * \brief  Block-session benchmark
+ * \author Genode Labs
+ * \date   2014-02-03
+ *
+ * The benchmark runs the workloads given in its configuration one after
+ * another. Each workload keeps a configured number of requests in flight
+ * and measures the latency of each request. The throughput of each
+ * interval and the latency distribution are reported via a report session.
+ */
+
+/*
+ * Copyright (C) 2014 Genode Labs GmbH
+ *
+ * This file is part of the Genode OS framework, which is distributed
+ * under the terms of the GNU General Public License version 2.
+ */
+
+/* Genode includes */
+#include <base/allocator_avl.h>
+#include <base/printf.h>
+#include <block_session/connection.h>
+#include <os/config.h>
+#include <os/reporter.h>
+#include <os/server.h>
+#include <timer_session/connection.h>
+#include <trace/timestamp.h>
+
+/* local includes */
+#include "histogram.h"
+
+
+namespace Blk_bench {
+
+	using namespace Genode;
+
+	struct Workload;
+	struct Result;
+	class  Main;
+
+	typedef Block::Packet_descriptor Packet_descriptor;
+
+	enum { MAX_WORKLOADS = 16, MAX_QUEUE_DEPTH = Block::Session::TX_QUEUE_SIZE };
+}
+
+
+/**
+ * Workload as configured by a '<workload>' node
+ */
+struct Blk_bench::Workload
+{
+	char     name[32];
+	bool     random;        /* random instead of sequential block numbers */
+	unsigned read_percent;  /* share of read requests                     */
+	size_t   request_size;  /* bytes per request                          */
+	unsigned queue_depth;   /* requests in flight                         */
+	unsigned duration_ms;
+
+	Workload() { }
+
+	Workload(Xml_node node)
+	:
+		random(false), read_percent(100), request_size(4096),
+		queue_depth(1), duration_ms(5000)
+	{
+		strncpy(name, "unnamed", sizeof(name));
+
+		Number_of_bytes value;
+		try { node.attribute("name").value(name, sizeof(name)); } catch (...) { }
+		try { random = node.attribute("pattern").has_value("random"); } catch (...) { }
+		try { node.attribute("read_percent").value(&read_percent); } catch (...) { }
+		try { node.attribute("request_size").value(&value); request_size = value; } catch (...) { }
+		try { node.attribute("queue_depth").value(&queue_depth); } catch (...) { }
+		try { node.attribute("duration_ms").value(&duration_ms); } catch (...) { }
+
+		read_percent = min(read_percent, 100U);
+		queue_depth  = max(1U, min(queue_depth, (unsigned)MAX_QUEUE_DEPTH));
+	}
+};
+
+
+/**
+ * Outcome of a completed workload
+ */
+struct Blk_bench::Result
+{
+	Workload const *workload;
+	unsigned long   requests;
+	unsigned long   errors;
+	unsigned long   iops;
+	unsigned long   kib_per_sec;
+
+	/* latency in microseconds */
+	Histogram::Value min, mean, p50, p90, p99, p999, max;
+
+	Result() : workload(0) { }
+
+	Result(Workload const &workload, Histogram const &latency,
+	       unsigned long errors, Genode::uint64_t bytes, unsigned long ms)
+	:
+		workload(&workload), requests(latency.count()), errors(errors),
+		iops(ms ? latency.count()*1000UL/ms : 0),
+		kib_per_sec(ms ? bytes*1000/1024/ms : 0),
+		min(latency.min()), mean(latency.mean()),
+		p50(latency.percentile(5000)), p90(latency.percentile(9000)),
+		p99(latency.percentile(9900)), p999(latency.percentile(9990)),
+		max(latency.max())
+	{ }
+
+	void print() const
+	{
+		printf("%-16s %8lu IOPS %8lu KiB/s  latency us: min %llu mean %llu"
+		       " p50 %llu p90 %llu p99 %llu p99.9 %llu max %llu%s\n",
+		       workload->name, iops, kib_per_sec,
+		       (unsigned long long)min, (unsigned long long)mean,
+		       (unsigned long long)p50, (unsigned long long)p90,
+		       (unsigned long long)p99, (unsigned long long)p999,
+		       (unsigned long long)max, errors ? "  (errors)" : "");
+	}
+
+	void generate(Xml_generator &xml) const
+	{
+		xml.attribute("name",        workload->name);
+		xml.attribute("requests",    requests);
+		xml.attribute("errors",      errors);
+		xml.attribute("iops",        iops);
+		xml.attribute("kib_per_sec", kib_per_sec);
+		xml.node("latency", [&] () {
+			xml.attribute("unit", "us");
+			xml.attribute("min",  min);
+			xml.attribute("mean", mean);
+			xml.attribute("p50",  p50);
+			xml.attribute("p90",  p90);
+			xml.attribute("p99",  p99);
+			xml.attribute("p999", p999);
+			xml.attribute("max",  max);
+		});
+	}
+};
+
+
+class Blk_bench::Main
+{
+	private:
+
+		enum { TICK_MS = 100 };
+
+		/**
+		 * Packet buffer used for one request at a time
+		 */
+		struct Slot
+		{
+			Packet_descriptor packet;
+			Trace::Timestamp  submitted;
+			bool              busy;
+		};
+
+		Server::Entrypoint &_ep;
+
+		Workload _workload[MAX_WORKLOADS];
+		unsigned _num_workloads;
+		unsigned _interval_ms;
+		bool     _verbose;
+		bool     _reporting;
+
+		Allocator_avl              _block_alloc;
+		Block::Connection          _blk;
+		Block::sector_t            _blk_cnt;
+		size_t                     _blk_size;
+		Block::Session::Operations _blk_ops;
+
+		Timer::Connection _timer;
+		unsigned long     _ticks_per_ms;
+		Reporter          _reporter;
+
+		/* state of the current workload */
+		unsigned         _current;
+		bool             _running;
+		Slot             _slot[MAX_QUEUE_DEPTH];
+		unsigned         _in_flight;
+		Block::sector_t  _cursor;
+		Genode::uint64_t _random;
+		unsigned long    _start_ms;
+		unsigned long    _sample_ms;
+		Histogram        _latency;
+		unsigned long    _errors;
+		Genode::uint64_t _bytes;
+
+		/* throughput of the last interval */
+		unsigned long    _sample_requests;
+		Genode::uint64_t _sample_bytes;
+		unsigned long    _interval_iops;
+		unsigned long    _interval_kib_per_sec;
+
+		Result   _result[MAX_WORKLOADS];
+		unsigned _num_results;
+
+		Server::Signal_rpc_member<Main> _ack_dispatcher;
+		Server::Signal_rpc_member<Main> _submit_dispatcher;
+		Server::Signal_rpc_member<Main> _timer_dispatcher;
+
+		Block::Session::Tx::Source &_source() { return *_blk.tx(); }
+
+		void _read_config()
+		{
+			try {
+				Xml_node config = Genode::config()->xml_node();
+				try { config.attribute("interval_ms").value(&_interval_ms); } catch (...) { }
+				try { _verbose = config.attribute("verbose").has_value("yes"); } catch (...) { }
+				try { _reporting = config.attribute("report").has_value("yes"); } catch (...) { }
+
+				for (Xml_node node = config.sub_node("workload");
+				     _num_workloads < MAX_WORKLOADS; node = node.next("workload"))
+					_workload[_num_workloads++] = Workload(node);
+
+			} catch (...) { }
+
+			_interval_ms = max(_interval_ms, (unsigned)TICK_MS);
+		}
+
+		/**
+		 * Size of the packet buffer needed by the most demanding workload
+		 */
+		size_t _tx_buf_size()
+		{
+			_read_config();
+
+			size_t size = 0;
+			for (unsigned i = 0; i < _num_workloads; i++)
+				size = max(size, _workload[i].request_size*_workload[i].queue_depth);
+
+			/* account for the alignment of each packet */
+			return size + MAX_QUEUE_DEPTH*(1 << Packet_descriptor::PACKET_ALIGNMENT);
+		}
+
+		/**
+		 * Determine the frequency of the time-stamp counter
+		 */
+		void _calibrate()
+		{
+			unsigned long const ms = _timer.elapsed_ms();
+			Trace::Timestamp const ts = Trace::timestamp();
+
+			_timer.msleep(100);
+
+			unsigned long const elapsed = _timer.elapsed_ms() - ms;
+			_ticks_per_ms = max(1UL, (unsigned long)
+			                    ((Trace::timestamp() - ts)/max(1UL, elapsed)));
+		}
+
+		Histogram::Value _us(Trace::Timestamp ticks) {
+			return ticks*1000/_ticks_per_ms; }
+
+		Genode::uint64_t _rand()
+		{
+			/* xorshift */
+			_random ^= _random << 13;
+			_random ^= _random >> 7;
+			_random ^= _random << 17;
+			return _random;
+		}
+
+		Workload const &_wl() const { return _workload[_current]; }
+
+		Block::sector_t _next_block(Block::sector_t count)
+		{
+			Block::sector_t const positions = _blk_cnt / count;
+
+			if (_wl().random)
+				return (_rand() % positions)*count;
+
+			if (_cursor + count > _blk_cnt)
+				_cursor = 0;
+
+			Block::sector_t const nr = _cursor;
+			_cursor += count;
+			return nr;
+		}
+
+		void _submit()
+		{
+			Block::sector_t const count = _wl().request_size / _blk_size;
+
+			for (unsigned i = 0; _running && i < _wl().queue_depth; i++) {
+
+				Slot &slot = _slot[i];
+				if (slot.busy)
+					continue;
+
+				if (!_source().ready_to_submit())
+					return;
+
+				bool const read = _rand() % 100 < _wl().read_percent;
+
+				slot.busy      = true;
+				slot.submitted = Trace::timestamp();
+				_in_flight++;
+
+				_source().submit_packet(
+					Packet_descriptor(slot.packet,
+					                  read ? Packet_descriptor::READ
+					                       : Packet_descriptor::WRITE,
+					                  _next_block(count), count));
+			}
+		}
+
+		/**
+		 * Look up slot by the offset of its packet
+		 *
+		 * The slots are sorted by their offsets when allocated.
+		 */
+		Slot *_lookup(Packet_descriptor const &packet)
+		{
+			unsigned lo = 0, hi = _wl().queue_depth;
+			while (lo < hi) {
+				unsigned const mid = (lo + hi)/2;
+				off_t const offset = _slot[mid].packet.offset();
+
+				if (offset == packet.offset())
+					return &_slot[mid];
+
+				if (offset < packet.offset()) lo = mid + 1;
+				else                          hi = mid;
+			}
+			return 0;
+		}
+
+		void _handle_ack(unsigned)
+		{
+			while (_source().ack_avail()) {
+
+				Packet_descriptor const packet = _source().get_acked_packet();
+				Trace::Timestamp  const now    = Trace::timestamp();
+
+				Slot *slot = _lookup(packet);
+				if (!slot || !slot->busy) {
+					PERR("spurious acknowledgement");
+					continue;
+				}
+
+				slot->busy = false;
+				_in_flight--;
+
+				if (!packet.succeeded()) {
+					_errors++;
+					continue;
+				}
+
+				_latency.add(_us(now - slot->submitted));
+				_bytes += packet.size();
+			}
+
+			_submit();
+
+			if (!_running && !_in_flight)
+				_finish();
+		}
+
+		void _handle_submit(unsigned) { _submit(); }
+
+		void _sample(unsigned long now)
+		{
+			unsigned long const ms = now - _sample_ms;
+			if (!ms)
+				return;
+
+			_interval_iops        = (_latency.count() - _sample_requests)*1000UL/ms;
+			_interval_kib_per_sec = (_bytes - _sample_bytes)*1000/1024/ms;
+
+			_sample_ms       = now;
+			_sample_requests = _latency.count();
+			_sample_bytes    = _bytes;
+
+			if (_verbose)
+				printf("%-16s %6lu ms %8lu IOPS %8lu KiB/s\n", _wl().name,
+				       now - _start_ms, _interval_iops, _interval_kib_per_sec);
+
+			_report();
+		}
+
+		void _handle_timer(unsigned)
+		{
+			if (!_running)
+				return;
+
+			unsigned long const now = _timer.elapsed_ms();
+
+			if (now - _sample_ms >= _interval_ms)
+				_sample(now);
+
+			if (now - _start_ms >= _wl().duration_ms) {
+				_running = false;
+				if (!_in_flight)
+					_finish();
+			}
+		}
+
+		void _report()
+		{
+			if (!_reporter.is_enabled())
+				return;
+
+			Reporter::Xml_generator xml(_reporter, [&] () {
+
+				if (_running)
+					xml.node("workload", [&] () {
+						xml.attribute("name",        _wl().name);
+						xml.attribute("elapsed_ms",  _sample_ms - _start_ms);
+						xml.attribute("requests",    _latency.count());
+						xml.attribute("errors",      _errors);
+						xml.attribute("iops",        _interval_iops);
+						xml.attribute("kib_per_sec", _interval_kib_per_sec);
+					});
+
+				for (unsigned i = 0; i < _num_results; i++)
+					xml.node("result", [&] () { _result[i].generate(xml); });
+			});
+		}
+
+		bool _supported(Workload const &wl)
+		{
+			if (wl.request_size < _blk_size || wl.request_size % _blk_size) {
+				PWRN("%s: request size is not a multiple of the block size",
+				     wl.name);
+				return false;
+			}
+			if (wl.request_size / _blk_size > _blk_cnt) {
+				PWRN("%s: request size exceeds the device", wl.name);
+				return false;
+			}
+			if (wl.read_percent > 0 && !_blk_ops.supported(Packet_descriptor::READ)) {
+				PWRN("%s: device is not readable", wl.name);
+				return false;
+			}
+			if (wl.read_percent < 100 && !_blk_ops.supported(Packet_descriptor::WRITE)) {
+				PWRN("%s: device is not writeable", wl.name);
+				return false;
+			}
+			return true;
+		}
+
+		/**
+		 * Start workload, skipping those not supported by the device
+		 */
+		void _start(unsigned index)
+		{
+			for (_current = index; _current < _num_workloads; _current++)
+				if (_supported(_wl()))
+					break;
+
+			if (_current == _num_workloads) {
+				_report();
+				printf("benchmark finished\n");
+				return;
+			}
+
+			/* allocate packet buffers and sort them by offset */
+			for (unsigned i = 0; i < _wl().queue_depth; i++) {
+				Slot slot;
+				slot.packet = _source().alloc_packet(_wl().request_size);
+				slot.busy   = false;
+
+				/* payload of write requests */
+				memset(_source().packet_content(slot.packet), 0x5a,
+				       _wl().request_size);
+
+				unsigned j = i;
+				for (; j > 0 && _slot[j - 1].packet.offset() > slot.packet.offset(); j--)
+					_slot[j] = _slot[j - 1];
+				_slot[j] = slot;
+			}
+
+			_latency.reset();
+			_errors               = 0;
+			_bytes                = 0;
+			_cursor               = 0;
+			_in_flight            = 0;
+			_sample_requests      = 0;
+			_sample_bytes         = 0;
+			_interval_iops        = 0;
+			_interval_kib_per_sec = 0;
+			_start_ms = _sample_ms = _timer.elapsed_ms();
+			_running  = true;
+
+			_submit();
+		}
+
+		void _finish()
+		{
+			unsigned long const ms = _timer.elapsed_ms() - _start_ms;
+
+			Result &result = _result[_num_results++];
+			result = Result(_wl(), _latency, _errors, _bytes, ms);
+			result.print();
+
+			for (unsigned i = 0; i < _wl().queue_depth; i++)
+				_source().release_packet(_slot[i].packet);
+
+			_start(_current + 1);
+		}
+
+	public:
+
+		Main(Server::Entrypoint &ep)
+		:
+			_ep(ep), _num_workloads(0), _interval_ms(1000), _verbose(false),
+			_reporting(false),
+			_block_alloc(env()->heap()),
+			_blk(&_block_alloc, _tx_buf_size()),
+			_blk_cnt(0), _blk_size(0), _ticks_per_ms(1), _reporter("blk_bench"),
+			_current(0), _running(false), _in_flight(0), _cursor(0),
+			_random(0x2545f4914f6cdd1dULL), _start_ms(0), _sample_ms(0),
+			_errors(0), _bytes(0), _sample_requests(0), _sample_bytes(0),
+			_interval_iops(0), _interval_kib_per_sec(0), _num_results(0),
+			_ack_dispatcher(ep, *this, &Main::_handle_ack),
+			_submit_dispatcher(ep, *this, &Main::_handle_submit),
+			_timer_dispatcher(ep, *this, &Main::_handle_timer)
+		{
+			_blk.info(&_blk_cnt, &_blk_size, &_blk_ops);
+			printf("device with %llu blocks of %zu bytes\n",
+			       (unsigned long long)_blk_cnt, _blk_size);
+
+			_calibrate();
+			_reporter.enabled(_reporting);
+
+			_blk.tx_channel()->sigh_ack_avail(_ack_dispatcher);
+			_blk.tx_channel()->sigh_ready_to_submit(_submit_dispatcher);
+
+			_timer.sigh(_timer_dispatcher);
+			_timer.trigger_periodic(TICK_MS*1000);
+
+			_start(0);
+		}
+};
+
+
+/************
+ ** Server **
+ ************/
+
+namespace Server {
+	char const *name()             { return "blk_bench_ep";       }
+	size_t stack_size()            { return 4*1024*sizeof(long);  }
+	void construct(Entrypoint &ep) { static Blk_bench::Main main(ep); }
+}
@@ -0,0 +1,3 @@
+TARGET = blk_bench
+SRC_CC = main.cc
+LIBS   = base config server
@@ -59,6 +59,13 @@ class Ahci_driver_base : public Block::Driver
 
 		bool dma_enabled() { return true; }
 
+		/*
+		 * Each request costs a command round trip, so adjacent requests
+		 * are merged and passed in ascending order
+		 */
+		Block::Scheduler::Policy scheduling() {
+			return Block::Scheduler::Policy(1024*1024, 16); }
+
 		void read_dma(Block::sector_t           block_number,
 		              size_t                    block_count,
 		              addr_t                    phys,
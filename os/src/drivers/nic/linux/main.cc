@@ -4,15 +4,25 @@
  * \author Christian Helmuth
  * \date   2011-08-08
  *
- * Currently, we connect to tap0 only. Possbile candidates for configuration
- * options are:
+ * The TAP device and the number of its queues are configured via the
+ * 'tap' (default is tap0) and 'queues' (default is 1) attributes of the
+ * config node. The MTU announced to clients is set via the 'mtu' attribute.
  *
- * - TAP device to connect to (default is tap0)
- * - MAC address (default is 02-00-00-00-00-01)
+ * Frames are exchanged with the TAP device prefixed by a virtio-net header
+ * ('IFF_VNET_HDR'), which carries the checksum and segmentation offloads
+ * of the NIC session. Received frames are read directly into the packet
+ * buffer of the client and transmitted frames are written directly from
+ * the packet buffer of the client via scatter-gather I/O. Each TAP queue is
+ * served by a dedicated receive thread, which drains all pending frames
+ * per wakeup. Frames are transmitted via the first queue only, which keeps
+ * them in the order submitted by the client.
+ *
+ * A possible candidate for further configuration options is the MAC
+ * address (default is 02-00-00-00-00-01).
  */
 
 /*
- * Copyright (C) 2011-2013 Genode Labs GmbH
+ * Copyright (C) 2011-2014 Genode Labs GmbH
  *
  * This file is part of the Genode OS framework, which is distributed
  * under the terms of the GNU General Public License version 2.
@@ -20,21 +30,62 @@
 
 /* Genode */
 #include <base/sleep.h>
+#include <base/lock.h>
 #include <cap_session/connection.h>
 #include <nic/component.h>
+#include <os/config.h>
+#include <util/volatile_object.h>
 
 /* Linux */
+#include <errno.h>
 #include <unistd.h>
 #include <fcntl.h>
+#include <poll.h>
 #include <sys/ioctl.h>
+#include <sys/uio.h>
 #include <net/if.h>
 #include <linux/if_tun.h>
+#include <linux/virtio_net.h>
 
 
 class Linux_driver : public Nic::Driver
 {
+	public:
+
+		enum {
+			MAX_QUEUES = 8,
+
+			/* maximum number of frames received per wakeup and queue */
+			RX_BATCH   = 64,
+		};
+
+		struct Config
+		{
+			char           tap[IFNAMSIZ];
+			unsigned       queues;
+			Genode::size_t mtu;
+
+			Config() : queues(1), mtu(Nic::Session::DEFAULT_MTU)
+			{
+				Genode::strncpy(tap, "tap0", sizeof(tap));
+
+				try {
+					Genode::Xml_node config = Genode::config()->xml_node();
+					try { config.attribute("tap").value(tap, sizeof(tap)); } catch (...) { }
+					try { config.attribute("queues").value(&queues); } catch (...) { }
+					try { config.attribute("mtu").value(&mtu); } catch (...) { }
+				} catch (...) { }
+
+				queues = Genode::max(1U, Genode::min(queues, (unsigned)MAX_QUEUES));
+				mtu    = Genode::max((Genode::size_t)Nic::Session::MIN_MTU,
+				                     Genode::min(mtu, (Genode::size_t)Nic::Session::MAX_MTU));
+			}
+		};
+
 	private:
 
+		typedef Nic::Packet_descriptor Packet_descriptor;
+
 		struct Rx_thread : Genode::Thread<0x2000>
 		{
 			int          fd;
@@ -54,18 +105,34 @@ class Linux_driver : public Nic::Driver
 					FD_SET(fd, &rfds);
 					do { ret = select(fd + 1, &rfds, 0, 0, 0); } while (ret < 0);
 
-					/* inform driver about incoming packet */
+					/* inform driver about incoming packets */
 					driver.handle_irq(fd);
 				}
 			}
 		};
 
+		Config const          _config;
 		Nic::Mac_address      _mac_addr;
 		Nic::Rx_buffer_alloc &_alloc;
 
-		char      _packet_buffer[1514];  /* maximum ethernet packet length */
-		int       _tap_fd;
-		Rx_thread _rx_thread;
+		/*
+		 * Receive threads of all queues share the rx packet buffer of the
+		 * session
+		 */
+		Genode::Lock _rx_lock;
+
+		/* rx buffer allocated but not yet filled by a frame */
+		char *_rx_buffer;
+
+		/* buffer for frames dropped because the rx packet buffer is full */
+		char _drop_buffer[Nic::Session::MAX_MTU + Nic::Session::ETHERNET_OVERHEAD];
+
+		int _tap_fd[MAX_QUEUES];
+
+		Genode::Lazy_volatile_object<Rx_thread> _rx_thread[MAX_QUEUES];
+
+		Genode::size_t _frame_size() const {
+			return Nic::Session::frame_size(_config.mtu); }
 
 		int _setup_tap_fd()
 		{
@@ -80,8 +147,10 @@ class Linux_driver : public Nic::Driver
 				throw Genode::Exception();
 			}
 			Genode::memset(&ifr, 0, sizeof(ifr));
-			ifr.ifr_flags = IFF_TAP | IFF_NO_PI;
-			Genode::strncpy(ifr.ifr_name, "tap0", sizeof(ifr.ifr_name));
+			ifr.ifr_flags = IFF_TAP | IFF_NO_PI | IFF_VNET_HDR;
+			if (_config.queues > 1)
+				ifr.ifr_flags |= IFF_MULTI_QUEUE;
+			Genode::strncpy(ifr.ifr_name, _config.tap, sizeof(ifr.ifr_name));
 			ret = ioctl(fd, TUNSETIFF, (void *) &ifr);
 			if (ret != 0) {
 				PERR("could not configure /dev/net/tun: no virtual network emulation");
@@ -90,13 +159,78 @@ class Linux_driver : public Nic::Driver
 				throw Genode::Exception();
 			}
 
+			/*
+			 * Let the host pass frames with partial checksums. Large
+			 * segments are not accepted because rx buffers are limited to
+			 * the MTU.
+			 */
+			if (ioctl(fd, TUNSETOFFLOAD, TUN_F_CSUM) != 0)
+				PWRN("could not enable checksum offload on %s", _config.tap);
+
+			fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+
 			return fd;
 		}
 
+		/**
+		 * Receive one frame from the TAP device
+		 *
+		 * \return  false if no frame is pending
+		 */
+		bool _rx_frame(int fd)
+		{
+			virtio_net_hdr hdr;
+
+			if (!_rx_buffer) {
+				try {
+					_rx_buffer = (char *)_alloc.alloc(_frame_size());
+				} catch (Nic::Session::Rx::Source::Packet_alloc_failed) {
+
+					/* consume frame to prevent the queue from stalling */
+					iovec iov[2] = { { &hdr, sizeof(hdr) },
+					                 { _drop_buffer, sizeof(_drop_buffer) } };
+					return readv(fd, iov, 2) > 0;
+				}
+			}
+
+			iovec iov[2] = { { &hdr, sizeof(hdr) },
+			                 { _rx_buffer, _frame_size() } };
+
+			ssize_t ret = readv(fd, iov, 2);
+			if (ret < (ssize_t)sizeof(hdr))
+				return ret >= 0;
+
+			Packet_descriptor meta;
+			if (hdr.flags & VIRTIO_NET_HDR_F_NEEDS_CSUM)
+				meta.csum_partial(hdr.csum_start, hdr.csum_offset);
+
+			_rx_buffer = 0;
+			_alloc.submit(ret - sizeof(hdr), meta);
+			return true;
+		}
+
+		/**
+		 * Write frame to the TAP device, waiting until the device is writable
+		 */
+		void _write(iovec *iov, int count)
+		{
+			int const fd = _tap_fd[0];
+
+			while (writev(fd, iov, count) < 0) {
+				if (errno != EAGAIN && errno != EINTR) {
+					PWRN("could not transmit packet (errno=%d)", errno);
+					return;
+				}
+
+				pollfd pfd = { fd, POLLOUT, 0 };
+				poll(&pfd, 1, -1);
+			}
+		}
+
 	public:
 
 		Linux_driver(Nic::Rx_buffer_alloc &alloc)
-		: _alloc(alloc), _tap_fd(_setup_tap_fd()), _rx_thread(_tap_fd, *this)
+		: _alloc(alloc), _rx_buffer(0)
 		{
 			/* fake MAC address (unicast, locally managed) */
 			_mac_addr.addr[0] = 0x02;
@@ -106,7 +240,13 @@ class Linux_driver : public Nic::Driver
 			_mac_addr.addr[4] = 0x00;
 			_mac_addr.addr[5] = 0x01;
 
-			_rx_thread.start();
+			for (unsigned i = 0; i < _config.queues; i++)
+				_tap_fd[i] = _setup_tap_fd();
+
+			for (unsigned i = 0; i < _config.queues; i++) {
+				_rx_thread[i].construct(_tap_fd[i], *this);
+				_rx_thread[i]->start();
+			}
 		}
 
 
@@ -116,12 +256,61 @@ class Linux_driver : public Nic::Driver
 
 		Nic::Mac_address mac_address() { return _mac_addr; }
 
+		Genode::size_t mtu() { return _config.mtu; }
+
+		unsigned offload() {
+			return Packet_descriptor::CSUM_PARTIAL | Packet_descriptor::GSO_TCPV4; }
+
 		void tx(char const *packet, Genode::size_t size)
 		{
-			int ret;
+			virtio_net_hdr hdr;
+			Genode::memset(&hdr, 0, sizeof(hdr));
+
+			iovec iov[2] = { { &hdr, sizeof(hdr) }, { (void *)packet, size } };
+			_write(iov, 2);
+		}
+
+		void tx_offload(char const *packet, Genode::size_t size,
+		                Packet_descriptor const &meta)
+		{
+			virtio_net_hdr hdr;
+			Genode::memset(&hdr, 0, sizeof(hdr));
+
+			if (meta.offload() & Packet_descriptor::CSUM_PARTIAL) {
+				hdr.flags       = VIRTIO_NET_HDR_F_NEEDS_CSUM;
+				hdr.csum_start  = meta.csum_start();
+				hdr.csum_offset = meta.csum_offset();
+			}
 
-			/* blocking-write packet to TAP */
-			do { ret = write(_tap_fd, packet, size); } while (ret < 0);
+			if (meta.offload() & Packet_descriptor::GSO_TCPV4) {
+
+				enum { ETH_HDR = 14, MIN_IP_HDR = 20, MAX_IP_HDR = 60, MIN_TCP_HDR = 20 };
+
+				/*
+				 * The host needs the checksum start to locate the TCP header
+				 * and computes the checksums of all segments.
+				 */
+				Genode::size_t const tcp = meta.csum_start();
+				bool valid = (meta.offload() & Packet_descriptor::CSUM_PARTIAL)
+				          && tcp >= ETH_HDR + MIN_IP_HDR
+				          && tcp <= ETH_HDR + MAX_IP_HDR
+				          && tcp + MIN_TCP_HDR <= size;
+
+				/* the TCP header length is stored in its data-offset field */
+				Genode::size_t const tcp_len = valid
+				                             ? ((unsigned char)packet[tcp + 12] >> 4) * 4 : 0;
+				if (!valid || tcp_len < MIN_TCP_HDR || tcp + tcp_len > size) {
+					PWRN("drop malformed segmentation-offload packet");
+					return;
+				}
+
+				hdr.gso_type = VIRTIO_NET_HDR_GSO_TCPV4;
+				hdr.gso_size = meta.gso_size();
+				hdr.hdr_len  = tcp + tcp_len;
+			}
+
+			iovec iov[2] = { { &hdr, sizeof(hdr) }, { (void *)packet, size } };
+			_write(iov, 2);
 		}
 
 
@@ -129,18 +318,12 @@ class Linux_driver : public Nic::Driver
 		 ** Irq_activation interface **
 		 ******************************/
 
-		void handle_irq(int)
+		void handle_irq(int fd)
 		{
-			int ret;
-
-			/* blocking read incoming packet */
-			do {
-				ret = read(_tap_fd, _packet_buffer, sizeof(_packet_buffer));
-			} while (ret < 0);
+			Genode::Lock::Guard guard(_rx_lock);
 
-			void *buffer = _alloc.alloc(ret);
-			Genode::memcpy(buffer, _packet_buffer, ret);
-			_alloc.submit();
+			/* drain pending frames, the rx buffer is kept for the next call */
+			for (unsigned i = 0; i < RX_BATCH && _rx_frame(fd); i++);
 		}
 };
 
@@ -185,4 +368,3 @@ int main(int, char **)
 	sleep_forever();
 	return 0;
 }
-
@@ -1,4 +1,4 @@
 TARGET   = nic_drv
 REQUIRES = linux
-LIBS     = lx_hybrid
+LIBS     = lx_hybrid config
 SRC_CC   = main.cc
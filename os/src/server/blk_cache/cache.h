@@ -0,0 +1,382 @@
+/*
+ * \brief  Cache of block-device lines with LRU or ARC replacement
+ * \author Genode Labs
+ * \date   2014-01-27
+ */
+
+/*
+ * Copyright (C) 2014 Genode Labs GmbH
+ *
+ * This file is part of the Genode OS framework, which is distributed
+ * under the terms of the GNU General Public License version 2.
+ */
+
+#ifndef _BLK_CACHE__CACHE_H_
+#define _BLK_CACHE__CACHE_H_
+
+#include <base/allocator.h>
+#include <base/stdint.h>
+#include <util/misc_math.h>
+#include <util/noncopyable.h>
+#include <block_session/block_session.h>
+
+namespace Blk_cache {
+
+	using namespace Genode;
+
+	class Cache;
+}
+
+
+/**
+ * Directory of cache lines
+ *
+ * A line holds a fixed number of consecutive blocks of the device. The
+ * state of each block of a line is kept in bit masks, which allows for
+ * partially valid lines without read-modify-write cycles.
+ *
+ * With the ARC policy, lines seen once (T1) and lines seen repeatedly (T2)
+ * are kept in separate lists. The directory additionally remembers recently
+ * evicted lines (B1, B2) without their data. A hit on such a ghost line
+ * shifts the target size of T1 towards the list that would have kept the
+ * line. With the LRU policy, only T1 is used.
+ */
+class Blk_cache::Cache : Noncopyable
+{
+	public:
+
+		enum Policy { LRU, ARC };
+
+		typedef uint64_t Mask;
+
+		enum { MAX_LINE_BLOCKS = sizeof(Mask)*8 };
+
+		class Line
+		{
+			private:
+
+				friend class Cache;
+
+				Line           *_prev;       /* towards MRU end of list */
+				Line           *_next;       /* towards LRU end of list */
+				Line           *_hash_next;
+				unsigned        _list;
+				Block::sector_t _number;
+				char           *_data;       /* 0 for ghost lines */
+
+			public:
+
+				Mask     valid;    /* blocks holding device content      */
+				Mask     dirty;    /* blocks to be written back          */
+				Mask     loading;  /* blocks being read from the device  */
+				Mask     writing;  /* blocks being written to the device */
+				unsigned refs;     /* requests depending on the line     */
+
+				Line()
+				: _prev(0), _next(0), _hash_next(0), _list(0), _number(0),
+				  _data(0), valid(0), dirty(0), loading(0), writing(0), refs(0) { }
+
+				/**
+				 * Placement operator used to construct the directory
+				 */
+				void *operator new(size_t, void *addr) { return addr; }
+
+				Block::sector_t number() const { return _number; }
+				char           *data()   const { return _data;   }
+
+				bool evictable() const {
+					return !dirty && !loading && !writing && !refs; }
+		};
+
+	private:
+
+		enum { T1, T2, B1, B2, FREE, NUM_LISTS };
+
+		struct List
+		{
+			Line    *mru;
+			Line    *lru;
+			unsigned size;
+
+			List() : mru(0), lru(0), size(0) { }
+		};
+
+		Allocator      &_alloc;
+		Policy const    _policy;
+		size_t const    _line_size;
+		unsigned const  _lines;      /* number of lines with data */
+		unsigned const  _headers;    /* number of lines incl. ghosts */
+		unsigned        _buckets;
+		char           *_data;
+		unsigned        _unused;     /* data slots never assigned */
+		unsigned        _p;          /* target size of T1 */
+		unsigned long   _evictions;
+		Line           *_header;
+		Line          **_bucket;
+		List            _list[NUM_LISTS];
+
+		unsigned _size(unsigned list) const { return _list[list].size; }
+
+		unsigned _index(Block::sector_t number) const {
+			return (unsigned)(number ^ (number >> 16)) & (_buckets - 1); }
+
+		void _unlink(Line *l)
+		{
+			List &list = _list[l->_list];
+
+			if (l->_prev) l->_prev->_next = l->_next; else list.mru = l->_next;
+			if (l->_next) l->_next->_prev = l->_prev; else list.lru = l->_prev;
+
+			l->_prev = l->_next = 0;
+			list.size--;
+		}
+
+		void _push_mru(unsigned list, Line *l)
+		{
+			List &to = _list[list];
+
+			l->_list = list;
+			l->_prev = 0;
+			l->_next = to.mru;
+			if (to.mru) to.mru->_prev = l; else to.lru = l;
+			to.mru = l;
+			to.size++;
+		}
+
+		void _move(unsigned list, Line *l) { _unlink(l); _push_mru(list, l); }
+
+		void _hash_insert(Line *l)
+		{
+			Line *&head = _bucket[_index(l->_number)];
+			l->_hash_next = head;
+			head = l;
+		}
+
+		void _hash_remove(Line *l)
+		{
+			for (Line **n = &_bucket[_index(l->_number)]; *n; n = &(*n)->_hash_next)
+				if (*n == l) {
+					*n = l->_hash_next;
+					l->_hash_next = 0;
+					return;
+				}
+		}
+
+		Line *_find(Block::sector_t number) const
+		{
+			for (Line *l = _bucket[_index(number)]; l; l = l->_hash_next)
+				if (l->_number == number)
+					return l;
+			return 0;
+		}
+
+		/**
+		 * Return least recently used evictable line of list
+		 */
+		Line *_victim(unsigned list) const
+		{
+			for (Line *l = _list[list].lru; l; l = l->_prev)
+				if (l->evictable())
+					return l;
+			return 0;
+		}
+
+		/**
+		 * Select victim according to the ARC replacement rule
+		 *
+		 * If the preferred list holds no evictable line, the other list
+		 * is used.
+		 */
+		Line *_replace(bool ghost_hit_in_b2) const
+		{
+			unsigned const t1 = _size(T1);
+			bool const from_t1 = t1 && (t1 > _p || (ghost_hit_in_b2 && t1 == _p));
+
+			Line *v = _victim(from_t1 ? T1 : T2);
+			return v ? v : _victim(from_t1 ? T2 : T1);
+		}
+
+		/**
+		 * Drop data of line and move it to list
+		 *
+		 * \return  data slot formerly used by the line
+		 */
+		char *_evict(Line *l, unsigned list)
+		{
+			char *data = l->_data;
+
+			l->_data = 0;
+			l->valid = l->dirty = l->loading = l->writing = 0;
+			_move(list, l);
+			if (list == FREE)
+				_hash_remove(l);
+
+			_evictions++;
+			return data;
+		}
+
+		void _drop_lru(unsigned list)
+		{
+			Line *l = _list[list].lru;
+			if (!l) return;
+
+			_move(FREE, l);
+			_hash_remove(l);
+		}
+
+		/**
+		 * Obtain data slot for a new line
+		 *
+		 * \return  slot, or 0 if no line can be evicted
+		 */
+		char *_slot(bool ghost_hit, bool ghost_hit_in_b2)
+		{
+			if (_unused)
+				return _data + (_lines - _unused--)*_line_size;
+
+			if (_policy == LRU) {
+				Line *v = _victim(T1);
+				return v ? _evict(v, FREE) : 0;
+			}
+
+			/*
+			 * With T1 and B1 covering the whole cache size and B1 being
+			 * empty, the LRU line of T1 leaves the directory completely.
+			 */
+			if (!ghost_hit && _size(T1) + _size(B1) >= _lines && !_size(B1)) {
+				Line *v = _victim(T1);
+				if (!v) v = _victim(T2);
+				return v ? _evict(v, FREE) : 0;
+			}
+
+			Line *v = _replace(ghost_hit_in_b2);
+			return v ? _evict(v, v->_list == T1 ? B1 : B2) : 0;
+		}
+
+	public:
+
+		/**
+		 * Constructor
+		 *
+		 * \param alloc      allocator for the directory
+		 * \param policy     replacement policy
+		 * \param data       backing store of 'lines' times 'line_size' bytes
+		 * \param line_size  size of a line in bytes
+		 * \param lines      number of lines
+		 */
+		Cache(Allocator &alloc, Policy policy, char *data,
+		      size_t line_size, unsigned lines)
+		:
+			_alloc(alloc), _policy(policy), _line_size(line_size),
+			_lines(lines), _headers(policy == ARC ? 2*lines : lines),
+			_buckets(1), _data(data), _unused(lines), _p(0), _evictions(0)
+		{
+			while (_buckets < _headers)
+				_buckets <<= 1;
+
+			_alloc.alloc(_headers*sizeof(Line), &_header);
+			_alloc.alloc(_buckets*sizeof(Line *), &_bucket);
+
+			for (unsigned i = 0; i < _buckets; i++)
+				_bucket[i] = 0;
+
+			for (unsigned i = 0; i < _headers; i++)
+				_push_mru(FREE, new (&_header[i]) Line());
+		}
+
+		~Cache()
+		{
+			_alloc.free(_bucket, _buckets*sizeof(Line *));
+			_alloc.free(_header, _headers*sizeof(Line));
+		}
+
+		Policy        policy()    const { return _policy; }
+		unsigned      lines()     const { return _lines;  }
+		unsigned      resident()  const { return _size(T1) + _size(T2); }
+		unsigned long evictions() const { return _evictions; }
+
+		/**
+		 * Return line holding data, or 0 if the line is not cached
+		 */
+		Line *lookup(Block::sector_t number) const
+		{
+			Line *l = _find(number);
+			return l && l->_data ? l : 0;
+		}
+
+		/**
+		 * Return line, allocate it if not cached
+		 *
+		 * \param hit  set to true if the line was cached
+		 *
+		 * \return  line, or 0 if all lines are in use
+		 */
+		Line *acquire(Block::sector_t number, bool &hit)
+		{
+			Line *l = _find(number);
+
+			hit = l && l->_data;
+			if (hit) {
+				_move(_policy == ARC ? T2 : T1, l);
+				return l;
+			}
+
+			bool const ghost_hit = l != 0;
+			bool const in_b2     = ghost_hit && l->_list == B2;
+			unsigned const p     = _p;
+
+			/* adapt target size of T1 towards the list of the ghost hit */
+			if (ghost_hit && !in_b2)
+				_p = min(_lines, _p + max(_size(B2) / max(_size(B1), 1U), 1U));
+			if (in_b2) {
+				unsigned const delta = max(_size(B1) / max(_size(B2), 1U), 1U);
+				_p = _p > delta ? _p - delta : 0;
+			}
+
+			char *data = _slot(ghost_hit, in_b2);
+			if (!data) {
+				_p = p;
+				return 0;
+			}
+
+			if (ghost_hit) {
+				l->_data = data;
+				_move(T2, l);
+				return l;
+			}
+
+			/* keep directory within its bounds */
+			if (_policy == ARC) {
+				if (_size(T1) + _size(B1) >= _lines && _size(B1))
+					_drop_lru(B1);
+				else if (!_size(FREE))
+					_drop_lru(_size(B2) ? B2 : B1);
+			}
+
+			l = _list[FREE].lru;
+			l->_number = number;
+			l->_data   = data;
+			_move(T1, l);
+			_hash_insert(l);
+			return l;
+		}
+
+		/**
+		 * Call 'fn' for each line with data, least recently used first
+		 *
+		 * The iteration stops as soon as 'fn' returns false.
+		 */
+		template <typename FN>
+		void for_each_line(FN const &fn)
+		{
+			unsigned const lists[] = { T1, T2 };
+			for (unsigned i = 0; i < 2; i++)
+				for (Line *l = _list[lists[i]].lru, *prev; l; l = prev) {
+					prev = l->_prev;
+					if (!fn(*l))
+						return;
+				}
+		}
+};
+
+#endif /* _BLK_CACHE__CACHE_H_ */
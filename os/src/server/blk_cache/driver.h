@@ -0,0 +1,769 @@
+/*
+ * \brief  Block driver of the cache, backed by a block session
+ * \author Genode Labs
+ * \date   2014-01-27
+ */
+
+/*
+ * Copyright (C) 2014 Genode Labs GmbH
+ *
+ * This file is part of the Genode OS framework, which is distributed
+ * under the terms of the GNU General Public License version 2.
+ */
+
+#ifndef _BLK_CACHE__DRIVER_H_
+#define _BLK_CACHE__DRIVER_H_
+
+#include <base/allocator_avl.h>
+#include <base/printf.h>
+#include <block/component.h>
+#include <block/driver.h>
+#include <block_session/connection.h>
+#include <os/config.h>
+#include <os/reporter.h>
+#include <os/server.h>
+#include <util/bit_allocator.h>
+
+#include "cache.h"
+
+namespace Blk_cache {
+
+	struct Config;
+	class  Driver;
+}
+
+
+/**
+ * Configuration of the cache
+ */
+struct Blk_cache::Config
+{
+	size_t        size;         /* size of the cache in bytes           */
+	size_t        line_size;    /* size of a cache line in bytes        */
+	Cache::Policy policy;
+	size_t        read_ahead;   /* bytes read ahead on sequential reads */
+	unsigned      dirty_limit;  /* percentage of dirty lines            */
+	bool          report;
+	unsigned      report_interval_ms;
+
+	Config()
+	:
+		size(8*1024*1024), line_size(4096), policy(Cache::ARC),
+		read_ahead(128*1024), dirty_limit(50), report(false),
+		report_interval_ms(5000)
+	{
+		try {
+			Xml_node config = Genode::config()->xml_node();
+			Number_of_bytes value;
+
+			try { config.attribute("size").value(&value); size = value; } catch (...) { }
+			try { config.attribute("line_size").value(&value); line_size = value; } catch (...) { }
+			try { config.attribute("read_ahead").value(&value); read_ahead = value; } catch (...) { }
+			try { config.attribute("dirty_limit").value(&dirty_limit); } catch (...) { }
+			try { report = config.attribute("report").has_value("yes"); } catch (...) { }
+			try { config.attribute("report_interval_ms").value(&report_interval_ms); } catch (...) { }
+			try {
+				if (config.attribute("policy").has_value("lru"))
+					policy = Cache::LRU;
+			} catch (...) { }
+		} catch (...) { }
+
+		dirty_limit = min(dirty_limit, 100U);
+	}
+};
+
+
+/**
+ * Cache between the block-session client and the back-end block session
+ *
+ * Requests of the client are served from the cache whenever possible.
+ * Missing blocks are read from the back end in runs of consecutive blocks,
+ * and sequential reads trigger the loading of the subsequent blocks. Writes
+ * complete as soon as the data is in the cache. Dirty blocks are written
+ * back once their number exceeds the dirty limit, when lines are needed
+ * for new data, and on 'sync'.
+ */
+class Blk_cache::Driver : public Block::Driver
+{
+	public:
+
+		enum {
+			QUEUE_DEPTH  = 64,
+			BACKEND_BUF  = 4*1024*1024,
+			MAX_TRANSFER = 128*1024,
+			MAX_BACKEND  = Block::Session::TX_QUEUE_SIZE,
+		};
+
+	private:
+
+		typedef Block::Packet_descriptor Packet_descriptor;
+		typedef Block::sector_t          sector_t;
+		typedef Cache::Mask              Mask;
+		typedef Cache::Line              Line;
+
+		/**
+		 * Meta data of a packet in the bulk buffer of the back-end session
+		 */
+		struct Backend_tag { unsigned value; };
+
+		typedef Allocator_avl_tpl<Backend_tag> Backend_alloc;
+
+		/**
+		 * Request issued to the back end
+		 */
+		struct Backend_request
+		{
+			bool     write;
+			bool     ahead;  /* read ahead, not requested by the client */
+			sector_t first;
+			size_t   count;
+		};
+
+		/**
+		 * Read request of the client waiting for blocks of the back end
+		 */
+		struct Pending
+		{
+			bool              used;
+			Tag               tag;
+			Packet_descriptor packet;
+			char             *buffer;
+
+			Pending() : used(false), tag(0), buffer(0) { }
+		};
+
+		struct Stats
+		{
+			unsigned long hits;        /* blocks served from the cache  */
+			unsigned long misses;        /* blocks read on client request */
+			unsigned long read_ahead;    /* blocks read ahead             */
+			unsigned long write_back;    /* blocks written back           */
+			unsigned long write_errors;  /* blocks failed to write back   */
+			unsigned long syncs;
+
+			Stats()
+			: hits(0), misses(0), read_ahead(0), write_back(0), write_errors(0),
+			  syncs(0) { }
+		};
+
+		Config const                _config;
+		Backend_alloc               _backend_alloc;
+		Block::Connection           _backend;
+		sector_t                    _blk_cnt;
+		size_t                      _blk_size;
+		Block::Session::Operations  _ops;
+		size_t const                _line_blocks;
+		Ram_dataspace_capability    _data_ds;
+		char                       *_data;
+		Cache                       _cache;
+
+		Backend_request             _backend_req[MAX_BACKEND];
+		Bit_allocator<MAX_BACKEND>  _backend_tags;
+		unsigned                    _backend_in_flight;
+		unsigned                    _writes_in_flight;
+
+		Pending                     _pending[QUEUE_DEPTH];
+
+		unsigned long               _dirty_blocks;
+		unsigned long const         _dirty_limit;
+
+		sector_t                    _seq_next;   /* block following last read */
+		unsigned                    _seq_count;  /* number of sequential reads */
+		sector_t                    _ra_next;    /* end of read-ahead window   */
+
+		Stats                       _stats;
+		Reporter                    _reporter;
+
+		Server::Signal_rpc_member<Driver> _ack_dispatcher;
+		Server::Signal_rpc_member<Driver> _submit_dispatcher;
+
+		static size_t _clamp_line_blocks(size_t line_size, size_t blk_size) {
+			return max((size_t)1, min(line_size / blk_size,
+			                          (size_t)Cache::MAX_LINE_BLOCKS)); }
+
+		sector_t _line(sector_t blk) const { return blk / _line_blocks; }
+
+		/**
+		 * Return mask of the blocks of line 'l' within the given range
+		 */
+		Mask _mask(Line const &l, sector_t first, size_t count) const
+		{
+			sector_t const base = l.number()*_line_blocks;
+			sector_t const lo   = max(first, base) - base;
+			sector_t const hi   = min(first + count, base + _line_blocks) - base;
+
+			if (hi <= lo) return 0;
+
+			Mask const bits = hi - lo == Cache::MAX_LINE_BLOCKS
+			                ? ~(Mask)0 : ((Mask)1 << (hi - lo)) - 1;
+			return bits << lo;
+		}
+
+		static unsigned _popcount(Mask m)
+		{
+			unsigned n = 0;
+			for (; m; m &= m - 1) n++;
+			return n;
+		}
+
+		char *_block(Line const &l, sector_t blk) const {
+			return l.data() + (blk - l.number()*_line_blocks)*_blk_size; }
+
+		/**
+		 * Call 'fn' for each cached line covering the range of blocks
+		 */
+		template <typename FN>
+		void _for_each_line(sector_t first, size_t count, FN const &fn)
+		{
+			for (sector_t n = _line(first); n <= _line(first + count - 1); n++) {
+				Line *l = _cache.lookup(n);
+				if (l) fn(*l);
+			}
+		}
+
+		bool _all_valid(sector_t first, size_t count)
+		{
+			for (sector_t n = _line(first); n <= _line(first + count - 1); n++) {
+				Line *l = _cache.lookup(n);
+				if (!l) return false;
+
+				Mask const m = _mask(*l, first, count);
+				if ((l->valid & m) != m) return false;
+			}
+			return true;
+		}
+
+		/**
+		 * Pin the lines covering the range of blocks
+		 *
+		 * \return  false if not all lines could be allocated
+		 */
+		bool _pin(sector_t first, size_t count)
+		{
+			sector_t const last = _line(first + count - 1);
+
+			for (sector_t n = _line(first); n <= last; n++) {
+				bool hit;
+				Line *l = _cache.acquire(n, hit);
+				if (!l) {
+					for (sector_t i = _line(first); i < n; i++)
+						_cache.lookup(i)->refs--;
+					return false;
+				}
+				l->refs++;
+			}
+			return true;
+		}
+
+		void _unpin(sector_t first, size_t count) {
+			_for_each_line(first, count, [&] (Line &l) { l.refs--; }); }
+
+		/**
+		 * Copy blocks between the cache and a buffer of the client
+		 */
+		void _copy(sector_t first, size_t count, char *buffer, bool to_cache)
+		{
+			for (sector_t blk = first; blk < first + count; blk++) {
+				Line *l = _cache.lookup(_line(blk));
+				char *dst = buffer + (blk - first)*_blk_size;
+
+				if (to_cache)
+					memcpy(_block(*l, blk), dst, _blk_size);
+				else
+					memcpy(dst, _block(*l, blk), _blk_size);
+			}
+		}
+
+		/**
+		 * Issue request to the back end
+		 *
+		 * Written blocks are copied from the cache into the packet.
+		 *
+		 * \param ahead  request reads ahead of the client
+		 *
+		 * \return  false if the back-end session is congested
+		 */
+		bool _backend_io(bool write, sector_t first, size_t count,
+		                 bool ahead = false)
+		{
+			typedef Block::Session::Tx::Source::Packet_alloc_failed Alloc_failed;
+
+			if (!_backend.tx()->ready_to_submit())
+				return false;
+
+			unsigned tag;
+			try { tag = _backend_tags.alloc(); }
+			catch (Bit_allocator<MAX_BACKEND>::Out_of_indices) { return false; }
+
+			Packet_descriptor p;
+			try {
+				p = Packet_descriptor(_backend.dma_alloc_packet(count*_blk_size),
+				                      write ? Packet_descriptor::WRITE
+				                            : Packet_descriptor::READ,
+				                      first, count);
+			} catch (Alloc_failed) {
+				_backend_tags.free(tag);
+				return false;
+			}
+
+			Backend_tag t = { tag };
+			_backend_alloc.metadata((void *)p.offset(), t);
+
+			Backend_request r = { write, ahead, first, count };
+			_backend_req[tag] = r;
+			_backend_in_flight++;
+
+			if (write) {
+				_writes_in_flight++;
+				_copy(first, count, _backend.tx()->packet_content(p), false);
+
+				_for_each_line(first, count, [&] (Line &l) {
+					Mask const m = _mask(l, first, count);
+					l.writing |= m;
+					l.dirty   &= ~m;
+				});
+				_dirty_blocks   -= count;
+				_stats.write_back += count;
+			} else {
+				_for_each_line(first, count, [&] (Line &l) {
+					l.loading |= _mask(l, first, count); });
+			}
+
+			_backend.tx()->submit_packet(p);
+			return true;
+		}
+
+		/**
+		 * Read blocks of the range neither valid nor being loaded
+		 *
+		 * The lines of the range must be cached.
+		 *
+		 * \param ahead  request reads ahead of the client
+		 *
+		 * \return  number of blocks requested from the back end
+		 */
+		size_t _load(sector_t first, size_t count, bool ahead = false)
+		{
+			size_t const max_run = max((size_t)1, MAX_TRANSFER / _blk_size);
+			size_t loaded = 0;
+
+			sector_t run = 0;
+			size_t   len = 0;
+			for (sector_t blk = first; blk <= first + count; blk++) {
+
+				bool missing = false;
+				if (blk < first + count) {
+					Line *l = _cache.lookup(_line(blk));
+					Mask const m = l ? _mask(*l, blk, 1) : 0;
+					missing = l && !((l->valid | l->loading) & m);
+				}
+
+				if (missing && len < max_run) {
+					if (!len) run = blk;
+					len++;
+					continue;
+				}
+
+				if (len) {
+					if (!_backend_io(false, run, len, ahead))
+						return loaded;
+					loaded += len;
+				}
+
+				len = 0;
+				if (missing) { run = blk; len = 1; }
+			}
+			return loaded;
+		}
+
+		/**
+		 * Load blocks following a sequential read
+		 */
+		void _read_ahead(sector_t next)
+		{
+			size_t const window = _config.read_ahead / _blk_size;
+			if (!window || next >= _blk_cnt)
+				return;
+
+			sector_t const first = max(next, _ra_next);
+			sector_t const end   = min(next + window, _blk_cnt);
+			if (first >= end)
+				return;
+
+			/* do not touch lines already cached to keep their replacement state */
+			sector_t n;
+			for (n = _line(first); n <= _line(end - 1); n++) {
+				if (_cache.lookup(n))
+					continue;
+
+				bool hit;
+				if (!_cache.acquire(n, hit))
+					break;
+			}
+
+			sector_t const last = min(end, n*_line_blocks);
+			if (last <= first)
+				return;
+
+			size_t const loaded = _load(first, last - first, true);
+			_stats.read_ahead += loaded;
+			_ra_next = first + loaded;
+		}
+
+		/**
+		 * Write back dirty blocks, least recently used lines first
+		 *
+		 * \param target  number of dirty blocks to keep
+		 */
+		void _flush(unsigned long target)
+		{
+			_cache.for_each_line([&] (Line &l) {
+
+				if (_dirty_blocks <= target)
+					return false;
+
+				/* write runs of dirty blocks not yet being written */
+				sector_t const base = l.number()*_line_blocks;
+				for (unsigned i = 0; i < _line_blocks; ) {
+					Mask const candidate = l.dirty & ~l.writing;
+					if (!(candidate & ((Mask)1 << i))) { i++; continue; }
+
+					unsigned len = 1;
+					while (i + len < _line_blocks
+					    && (candidate & ((Mask)1 << (i + len))))
+						len++;
+
+					if (!_backend_io(true, base + i, len))
+						return false;
+
+					i += len;
+				}
+				return true;
+			});
+		}
+
+		void _complete_pending(Pending &p, bool success)
+		{
+			if (success)
+				_copy(p.packet.block_number(), p.packet.block_count(),
+				      p.buffer, false);
+
+			_unpin(p.packet.block_number(), p.packet.block_count());
+			p.used = false;
+			session->complete(p.tag, success);
+		}
+
+		/**
+		 * Complete read requests whose blocks arrived
+		 */
+		void _process_pending()
+		{
+			for (unsigned i = 0; i < QUEUE_DEPTH; i++) {
+				Pending &p = _pending[i];
+				if (!p.used)
+					continue;
+
+				sector_t const first = p.packet.block_number();
+				size_t   const count = p.packet.block_count();
+
+				if (_all_valid(first, count))
+					_complete_pending(p, true);
+				else
+					_load(first, count);
+			}
+		}
+
+		void _handle_ack(Packet_descriptor p)
+		{
+			Backend_tag *tag = _backend_alloc.metadata((void *)p.offset());
+			if (!tag) {
+				_backend.tx()->release_packet(p);
+				return;
+			}
+
+			Backend_request const r = _backend_req[tag->value];
+			_backend_tags.free(tag->value);
+			_backend_in_flight--;
+
+			if (r.write) {
+				_writes_in_flight--;
+
+				bool const failed = !p.succeeded();
+				if (failed) {
+					PERR("write back of blocks %llu-%llu failed, will retry",
+					     (unsigned long long)r.first,
+					     (unsigned long long)(r.first + r.count - 1));
+					_stats.write_errors += r.count;
+				}
+
+				/*
+				 * The client got the write acknowledged already, so blocks
+				 * failed to write back stay dirty to be written again by a
+				 * later flush. Blocks written by the client meanwhile are
+				 * dirty anyway.
+				 */
+				_for_each_line(r.first, r.count, [&] (Line &l) {
+					Mask const m = _mask(l, r.first, r.count);
+					l.writing &= ~m;
+					if (failed) {
+						_dirty_blocks += _popcount(m & ~l.dirty);
+						l.dirty |= m;
+					}
+				});
+
+				_backend.tx()->release_packet(p);
+				return;
+			}
+
+			char const *content = _backend.tx()->packet_content(p);
+			if (!r.ahead)
+				_stats.misses += r.count;
+
+			/* blocks written by the client meanwhile remain untouched */
+			for (sector_t blk = r.first; blk < r.first + r.count; blk++) {
+				Line *l = _cache.lookup(_line(blk));
+				if (!l) continue;
+
+				Mask const m = _mask(*l, blk, 1);
+				if (p.succeeded() && !(l->valid & m)) {
+					memcpy(_block(*l, blk), content + (blk - r.first)*_blk_size,
+					       _blk_size);
+					l->valid |= m;
+				}
+				l->loading &= ~m;
+			}
+			_backend.tx()->release_packet(p);
+
+			if (p.succeeded())
+				return;
+
+			/* fail client requests depending on the blocks */
+			for (unsigned i = 0; i < QUEUE_DEPTH; i++) {
+				Pending &pending = _pending[i];
+				sector_t const first = pending.packet.block_number();
+				if (pending.used && first < r.first + r.count
+				 && r.first < first + pending.packet.block_count())
+					_complete_pending(pending, false);
+			}
+		}
+
+		void _ack_avail(unsigned)
+		{
+			while (_backend.tx()->ack_avail())
+				_handle_ack(_backend.tx()->get_acked_packet());
+
+			_process_pending();
+
+			if (_dirty_blocks > _dirty_limit)
+				_flush(_dirty_limit / 2);
+
+			if (session)
+				session->wake_up();
+		}
+
+		void _ready_to_submit(unsigned) { _ack_avail(0); }
+
+		void _read(Tag tag, Packet_descriptor &packet, char *buffer)
+		{
+			sector_t const first = packet.block_number();
+			size_t   const count = packet.block_count();
+
+			if (!_pin(first, count)) {
+				_flush(0);
+				throw Request_congestion();
+			}
+
+			/* detect sequential access */
+			_seq_count = first == _seq_next ? _seq_count + 1 : 0;
+			_seq_next  = first + count;
+
+			if (_all_valid(first, count)) {
+				_stats.hits += count;
+				_copy(first, count, buffer, false);
+				_unpin(first, count);
+				session->complete(tag);
+			} else {
+				_load(first, count);
+
+				for (unsigned i = 0; i < QUEUE_DEPTH; i++) {
+					Pending &p = _pending[i];
+					if (p.used) continue;
+
+					p.used   = true;
+					p.tag    = tag;
+					p.packet = packet;
+					p.buffer = buffer;
+					break;
+				}
+			}
+
+			if (_seq_count)
+				_read_ahead(_seq_next);
+		}
+
+		void _write(Tag tag, Packet_descriptor &packet, char *buffer)
+		{
+			sector_t const first = packet.block_number();
+			size_t   const count = packet.block_count();
+
+			if (!_ops.supported(Packet_descriptor::WRITE))
+				throw Io_error();
+
+			if (!_pin(first, count)) {
+				_flush(0);
+				throw Request_congestion();
+			}
+
+			_copy(first, count, buffer, true);
+			_for_each_line(first, count, [&] (Line &l) {
+				Mask const m = _mask(l, first, count);
+				_dirty_blocks += _popcount(m & ~l.dirty);
+				l.valid |= m;
+				l.dirty |= m;
+			});
+			_unpin(first, count);
+
+			session->complete(tag);
+
+			if (_dirty_blocks > _dirty_limit)
+				_flush(_dirty_limit / 2);
+		}
+
+	public:
+
+		Driver(Server::Entrypoint &ep)
+		:
+			_backend_alloc(env()->heap()),
+			_backend(&_backend_alloc, BACKEND_BUF),
+			_blk_cnt(0), _blk_size(0),
+			_line_blocks((_backend.info(&_blk_cnt, &_blk_size, &_ops),
+			              _clamp_line_blocks(_config.line_size, _blk_size))),
+			_data_ds(env()->ram_session()->alloc(_config.size)),
+			_data(env()->rm_session()->attach(_data_ds)),
+			_cache(*env()->heap(), _config.policy, _data,
+			       _line_blocks*_blk_size,
+			       max((size_t)1, _config.size / (_line_blocks*_blk_size))),
+			_backend_in_flight(0), _writes_in_flight(0),
+			_dirty_blocks(0),
+			_dirty_limit((unsigned long)_cache.lines()*_line_blocks
+			             *_config.dirty_limit / 100),
+			_seq_next(~(sector_t)0), _seq_count(0), _ra_next(0),
+			_reporter("blk_cache"),
+			_ack_dispatcher(ep, *this, &Driver::_ack_avail),
+			_submit_dispatcher(ep, *this, &Driver::_ready_to_submit)
+		{
+			_backend.tx_channel()->sigh_ack_avail(_ack_dispatcher);
+			_backend.tx_channel()->sigh_ready_to_submit(_submit_dispatcher);
+
+			_reporter.enabled(_config.report);
+
+			PINF("cache of %u lines of %zu bytes, %s policy",
+			     _cache.lines(), _line_blocks*_blk_size,
+			     _config.policy == Cache::ARC ? "ARC" : "LRU");
+		}
+
+		~Driver()
+		{
+			sync();
+			env()->rm_session()->detach(_data);
+			env()->ram_session()->free(_data_ds);
+		}
+
+		unsigned report_interval_ms() const {
+			return _config.report ? _config.report_interval_ms : 0; }
+
+		/**
+		 * Report statistics
+		 */
+		void report()
+		{
+			if (!_reporter.is_enabled())
+				return;
+
+			Reporter::Xml_generator xml(_reporter, [&] () {
+				xml.attribute("hits",         _stats.hits);
+				xml.attribute("misses",       _stats.misses);
+				xml.attribute("read_ahead",   _stats.read_ahead);
+				xml.attribute("write_back",   _stats.write_back);
+				xml.attribute("write_errors", _stats.write_errors);
+				xml.attribute("syncs",        _stats.syncs);
+				xml.attribute("evictions",    _cache.evictions());
+				xml.attribute("dirty",        _dirty_blocks);
+				xml.attribute("resident",     _cache.resident());
+				xml.attribute("lines",        _cache.lines());
+			});
+		}
+
+
+		/*******************************
+		 **  Block::Driver interface  **
+		 *******************************/
+
+		size_t                     block_size()  { return _blk_size; }
+		sector_t                   block_count() { return _blk_cnt;  }
+		Block::Session::Operations ops()         { return _ops;      }
+
+		unsigned queue_depth() { return QUEUE_DEPTH; }
+
+		void submit(Tag tag, Packet_descriptor &packet, char *buffer, addr_t)
+		{
+			sector_t const first = packet.block_number();
+			size_t   const count = packet.block_count();
+
+			/* a request must fit into the cache as a whole */
+			if (!count || _line(first + count - 1) - _line(first) + 1 > _cache.lines()) {
+				PWRN("request of %zu blocks exceeds cache size", count);
+				throw Io_error();
+			}
+
+			switch (packet.operation()) {
+			case Packet_descriptor::READ:  _read(tag, packet, buffer);  return;
+			case Packet_descriptor::WRITE: _write(tag, packet, buffer); return;
+			default: throw Io_error();
+			}
+		}
+
+		/**
+		 * Write back all dirty blocks and synchronize the back end
+		 *
+		 * While waiting for the completion of the write back, the
+		 * acknowledgements of the back end are received synchronously.
+		 * Blocks that fail to be written back are not retried within the
+		 * same 'sync' but remain dirty.
+		 */
+		void sync()
+		{
+			_backend.tx_channel()->sigh_ack_avail(_backend.tx()->sigh_ack_avail());
+
+			unsigned long const write_errors = _stats.write_errors;
+
+			for (_flush(0); _dirty_blocks || _writes_in_flight; ) {
+				if (!_backend_in_flight) {
+					PERR("cannot write back %lu dirty blocks", _dirty_blocks);
+					break;
+				}
+				_handle_ack(_backend.tx()->get_acked_packet());
+
+				bool const failed = _stats.write_errors != write_errors;
+				if (!failed)
+					_flush(0);
+				else if (!_writes_in_flight)
+					break;
+			}
+
+			if (_stats.write_errors != write_errors)
+				PERR("sync incomplete, %lu blocks failed to write back, "
+				     "%lu dirty blocks kept", _stats.write_errors - write_errors,
+				     _dirty_blocks);
+
+			_backend.tx_channel()->sigh_ack_avail(_ack_dispatcher);
+
+			_backend.sync();
+			_stats.syncs++;
+
+			_process_pending();
+			report();
+		}
+};
+
+#endif /* _BLK_CACHE__DRIVER_H_ */
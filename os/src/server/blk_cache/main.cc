@@ -0,0 +1,82 @@
+/*
+ * \brief  Block cache placed between a block-session client and a driver
+ * \author Genode Labs
+ * \date   2014-01-27
+ */
+
+/*
+ * Copyright (C) 2014 Genode Labs GmbH
+ *
+ * This file is part of the Genode OS framework, which is distributed
+ * under the terms of the GNU General Public License version 2.
+ */
+
+#include <base/printf.h>
+#include <block/component.h>
+#include <os/server.h>
+#include <timer_session/connection.h>
+
+#include "driver.h"
+
+
+struct Main
+{
+	Server::Entrypoint &ep;
+
+	struct Factory : Block::Driver_factory
+	{
+		Server::Entrypoint &ep;
+		Blk_cache::Driver  *driver;
+
+		Factory(Server::Entrypoint &ep) : ep(ep), driver(0) { }
+
+		Block::Driver *create()
+		{
+			driver = new (Genode::env()->heap()) Blk_cache::Driver(ep);
+			return driver;
+		}
+
+		void destroy(Block::Driver *d)
+		{
+			driver = 0;
+			Genode::destroy(Genode::env()->heap(),
+			                static_cast<Blk_cache::Driver *>(d));
+		}
+	} factory;
+
+	Block::Root       root;
+	Timer::Connection timer;
+
+	void handle_timer(unsigned)
+	{
+		if (factory.driver)
+			factory.driver->report();
+	}
+
+	Server::Signal_rpc_member<Main> timer_dispatcher = {
+		ep, *this, &Main::handle_timer };
+
+	Main(Server::Entrypoint &ep)
+	: ep(ep), factory(ep), root(ep, Genode::env()->heap(), factory)
+	{
+		/* the report interval does not depend on the back end */
+		Blk_cache::Config const config;
+		if (config.report) {
+			timer.sigh(timer_dispatcher);
+			timer.trigger_periodic(config.report_interval_ms*1000UL);
+		}
+
+		Genode::env()->parent()->announce(ep.manage(root));
+	}
+};
+
+
+/************
+ ** Server **
+ ************/
+
+namespace Server {
+	char const *name()             { return "blk_cache_ep";      }
+	size_t stack_size()            { return 2*1024*sizeof(long); }
+	void construct(Entrypoint &ep) { static Main server(ep);     }
+}
@@ -0,0 +1,3 @@
+TARGET = blk_cache
+SRC_CC = main.cc
+LIBS   = base config server
@@ -20,7 +20,11 @@
 #include <base/rpc_server.h>
 #include <base/env.h>
 #include <base/printf.h>
+#include <os/config.h>
 #include <os/path.h>
+#include <os/reporter.h>
+#include <os/rom_content_registry.h>
+#include <util/list.h>
 
 
 /*********************************************
@@ -121,6 +125,349 @@ namespace File_system {
 }
 
 
+/***************************
+ ** Cache of file content **
+ ***************************/
+
+/**
+ * Content of files shared by all ROM sessions that request the same path
+ *
+ * Each entry holds the file content in a dataspace that is handed out to
+ * all sessions referring to the entry. The entry watches the file for
+ * changes. A changed entry is not handed out anymore and the sessions
+ * referring to it are informed, which then obtain a new entry with the
+ * current content. Entries no longer referred to by any session are kept
+ * until the size of all entries exceeds the budget of the cache, in which
+ * case the least recently used entry is dropped. Entries of different files
+ * with identical content share a single dataspace.
+ *
+ * Sharing is enabled only if configured because the dataspaces are not
+ * protected against writes. Otherwise, each session obtains an entry with
+ * a private copy of the content, which is dropped with the session.
+ *
+ * The cache is accessed by the RPC entrypoint and, for the delivery of
+ * file-change signals, by the main thread. Entries are created and
+ * destroyed by the entrypoint only.
+ */
+class Rom_cache
+{
+	public:
+
+		enum { PATH_MAX_LEN = 512 };
+		typedef Genode::Path<PATH_MAX_LEN> Path;
+
+		/**
+		 * Interface of a session referring to an entry
+		 */
+		struct Listener : Genode::List<Listener>::Element
+		{
+			/**
+			 * Called by the main thread when the file content changed
+			 */
+			virtual void content_changed() = 0;
+		};
+
+		class Entry : public Genode::List<Entry>::Element
+		{
+			private:
+
+				friend class Rom_cache;
+
+				Rom_cache                        &_cache;
+				Path const                        _path;
+				File_system::File_handle const    _handle;
+				Genode::Rom_content_registry::Content *_content;
+				Genode::size_t                    _size;
+				bool                              _stale;
+				unsigned long                     _last_use;
+				Genode::List<Listener>            _listeners;
+
+				Genode::Signal_dispatcher<Entry> _change_dispatcher;
+
+				void _changed(unsigned) { _cache._changed(*this); }
+
+				Entry(Rom_cache &cache, Path const &path,
+				      File_system::File_handle handle)
+				:
+					_cache(cache), _path(path.base()), _handle(handle), _content(0), _size(0),
+					_stale(false), _last_use(0),
+					_change_dispatcher(cache._sig_rec, *this, &Entry::_changed)
+				{ }
+
+			public:
+
+				Genode::Dataspace_capability ds() const {
+					return _content ? _content->ds() : Genode::Dataspace_capability(); }
+		};
+
+	private:
+
+		File_system::Session    &_fs;
+		Genode::Signal_receiver &_sig_rec;
+		Genode::Allocator       &_alloc;
+
+		bool           const _shared;
+		Genode::size_t const _budget;
+		Genode::size_t       _used;
+
+		unsigned long _use_count;
+
+		Genode::Lock        _lock;
+		Genode::List<Entry> _entries;
+
+		/*
+		 * Content of the entries, shared among entries of files with
+		 * identical content if sharing is enabled
+		 */
+		Genode::Rom_content_registry _registry;
+		Genode::Reporter            &_reporter;
+
+		/**
+		 * Signal-handling function called by the main thread
+		 */
+		void _changed(Entry &entry)
+		{
+			Genode::Lock::Guard guard(_lock);
+
+			entry._stale = true;
+
+			for (Listener *l = entry._listeners.first(); l; l = l->next())
+				l->content_changed();
+		}
+
+		/**
+		 * Return entry to be dropped, or 0 if no entry can be dropped
+		 */
+		Entry *_victim()
+		{
+			Entry *lru = 0;
+			for (Entry *e = _entries.first(); e; e = e->next()) {
+
+				if (e->_listeners.first())
+					continue;
+
+				if (e->_stale || !_shared)
+					return e;
+
+				if (!lru || e->_last_use < lru->_last_use)
+					lru = e;
+			}
+			return _used > _budget ? lru : 0;
+		}
+
+		/**
+		 * Drop changed and least recently used entries not referred to
+		 */
+		void _purge()
+		{
+			for (;;) {
+				Entry *e = 0;
+				{
+					Genode::Lock::Guard guard(_lock);
+
+					e = _victim();
+					if (!e)
+						return;
+
+					_entries.remove(e);
+					_used -= e->_size;
+				}
+
+				/*
+				 * The entry is destroyed without holding the lock because
+				 * the destruction of its signal dispatcher waits for the
+				 * completion of a signal handler currently executed by the
+				 * main thread.
+				 */
+				_fs.close(e->_handle);
+				if (e->_content)
+					_registry.release(*e->_content);
+				destroy(&_alloc, e);
+
+				_registry.report(_reporter);
+			}
+		}
+
+		/**
+		 * Read file content into a new dataspace of the entry
+		 *
+		 * \return  false if the dataspace could not be allocated
+		 */
+		bool _load(Entry &entry)
+		{
+			using namespace Genode;
+
+			Genode::size_t const file_size = _fs.status(entry._handle).size;
+
+			/* an empty file is represented by an invalid dataspace */
+			if (file_size == 0)
+				return true;
+
+			Ram_dataspace_capability ds;
+			try { ds = env()->ram_session()->alloc(file_size); }
+			catch (...) { return false; }
+
+			/* map dataspace locally and read content from file */
+			void *dst_addr = env()->rm_session()->attach(ds);
+			Genode::size_t const size = File_system::read(_fs, entry._handle,
+			                                              dst_addr, file_size);
+
+			/*
+			 * The file may have shrunk since its status was obtained. Keep
+			 * only the content actually read, so that the dataspace does
+			 * not reveal a wrong size.
+			 */
+			if (size < file_size) {
+				Ram_dataspace_capability shrunk;
+				void *shrunk_addr = 0;
+				if (size) {
+					try {
+						shrunk      = env()->ram_session()->alloc(size);
+						shrunk_addr = env()->rm_session()->attach(shrunk);
+					} catch (...) { }
+
+					if (shrunk_addr)
+						memcpy(shrunk_addr, dst_addr, size);
+				}
+
+				env()->rm_session()->detach(dst_addr);
+				env()->ram_session()->free(ds);
+
+				if (size && !shrunk_addr) {
+					if (shrunk.valid())
+						env()->ram_session()->free(shrunk);
+					return false;
+				}
+
+				/* an empty file is represented by an invalid dataspace */
+				if (!size)
+					return true;
+
+				ds       = shrunk;
+				dst_addr = shrunk_addr;
+			}
+
+			/*
+			 * With sharing enabled, the dataspace is dropped if the content
+			 * of another file is identical.
+			 */
+			entry._content = &_registry.acquire(ds, dst_addr, size);
+			env()->rm_session()->detach(dst_addr);
+
+			entry._size = size;
+			return true;
+		}
+
+	public:
+
+		/**
+		 * Constructor
+		 *
+		 * \param fs       file-system session to read the files from
+		 * \param sig_rec  signal receiver used to get notified about file
+		 *                 changes
+		 * \param alloc    allocator used for the entries
+		 * \param shared   share content among sessions
+		 * \param budget   size of the content kept in the cache while not
+		 *                 referred to by any session
+		 * \param reporter report of the memory saved by sharing content
+		 */
+		Rom_cache(File_system::Session &fs, Genode::Signal_receiver &sig_rec,
+		          Genode::Allocator &alloc, bool shared, Genode::size_t budget,
+		          Genode::Reporter &reporter)
+		:
+			_fs(fs), _sig_rec(sig_rec), _alloc(alloc), _shared(shared),
+			_budget(budget), _used(0), _use_count(0), _registry(alloc, shared),
+			_reporter(reporter)
+		{ }
+
+		/**
+		 * Obtain entry with the current content of a file
+		 *
+		 * \param open  functor called for opening the file if its content
+		 *              is not cached, returning the read-only file handle
+		 *              to be owned by the new entry
+		 *
+		 * \return  entry, or 0 if the file could not be opened or its
+		 *          content could not be stored
+		 */
+		template <typename FN>
+		Entry *acquire(Path const &path, Listener &listener, FN const &open)
+		{
+			_purge();
+
+			if (_shared) {
+				Genode::Lock::Guard guard(_lock);
+
+				for (Entry *e = _entries.first(); e; e = e->next())
+					if (!e->_stale && e->_path.equals(path)) {
+						e->_listeners.insert(&listener);
+						e->_last_use = ++_use_count;
+						return e;
+					}
+			}
+
+			File_system::File_handle const handle = open();
+			if (!handle.valid())
+				return 0;
+
+			Entry *entry = new (&_alloc) Entry(*this, path, handle);
+
+			/*
+			 * Make the entry known before watching the file so that a change
+			 * during the read is reflected to the listener. Other sessions
+			 * cannot look up the entry before it is complete because
+			 * 'acquire' is called by the entrypoint only.
+			 */
+			{
+				Genode::Lock::Guard guard(_lock);
+				_entries.insert(entry);
+				entry->_listeners.insert(&listener);
+				entry->_last_use = ++_use_count;
+			}
+
+			_fs.sigh(handle, entry->_change_dispatcher);
+
+			if (!_load(*entry)) {
+				PERR("couldn't allocate memory for file, empty result");
+				{
+					Genode::Lock::Guard guard(_lock);
+					entry->_stale = true;
+				}
+				release(*entry, listener);
+				return 0;
+			}
+
+			_registry.report(_reporter);
+
+			Genode::Lock::Guard guard(_lock);
+			_used += entry->_size;
+			return entry;
+		}
+
+		/**
+		 * Return true if the content of the entry is up to date
+		 */
+		bool current(Entry const &entry)
+		{
+			Genode::Lock::Guard guard(_lock);
+			return !entry._stale;
+		}
+
+		/**
+		 * Drop reference of a listener to an entry
+		 */
+		void release(Entry &entry, Listener &listener)
+		{
+			{
+				Genode::Lock::Guard guard(_lock);
+				entry._listeners.remove(&listener);
+			}
+			_purge();
+		}
+};
+
+
 /*****************
  ** ROM service **
  *****************/
@@ -128,14 +475,16 @@ namespace File_system {
 /**
  * A 'Rom_session_component' exports a single file of the file system
  */
-class Rom_session_component : public Genode::Rpc_object<Genode::Rom_session>
+class Rom_session_component : public Genode::Rpc_object<Genode::Rom_session>,
+                              private Rom_cache::Listener
 {
 	private:
 
 		File_system::Session &_fs;
+		Rom_cache            &_cache;
 
-		enum { PATH_MAX_LEN = 512 };
-		typedef Genode::Path<PATH_MAX_LEN> Path;
+		enum { PATH_MAX_LEN = Rom_cache::PATH_MAX_LEN };
+		typedef Rom_cache::Path Path;
 
 		/**
 		 * Name of requested file, interpreted at path into the file system
@@ -143,9 +492,10 @@ class Rom_session_component : public Genode::Rpc_object<Genode::Rom_session>
 		Path const _file_path;
 
 		/**
-		 * Handle of associated file
+		 * Cache entry holding the file content, or 0 if the file could not
+		 * be obtained
 		 */
-		File_system::File_handle _file_handle;
+		Rom_cache::Entry *_entry;
 
 		/**
 		 * Handle of currently watched compound directory
@@ -155,11 +505,6 @@ class Rom_session_component : public Genode::Rpc_object<Genode::Rom_session>
 		 */
 		File_system::Node_handle _compound_dir_handle;
 
-		/**
-		 * Dataspace exposed as ROM module to the client
-		 */
-		Genode::Ram_dataspace_capability _file_ds;
-
 		/**
 		 * Handler for ROM file changes
 		 */
@@ -194,6 +539,18 @@ class Rom_session_component : public Genode::Rpc_object<Genode::Rom_session>
 				Genode::Signal_transmitter(_sigh).submit();
 		}
 
+		/**
+		 * Listener interface, called by the main thread when the content of
+		 * the cache entry changed
+		 */
+		void content_changed()
+		{
+			Genode::Lock::Guard guard(_sigh_lock);
+
+			if (_sigh.valid())
+				Genode::Signal_transmitter(_sigh).submit();
+		}
+
 		/**
 		 * Open compound directory of specified file
 		 *
@@ -276,66 +633,33 @@ class Rom_session_component : public Genode::Rpc_object<Genode::Rom_session>
 		}
 
 		/**
-		 * Initialize '_file_ds' dataspace with file content
+		 * Obtain cache entry with the current file content
 		 */
 		void _update_dataspace()
 		{
-			using namespace File_system;
-
 			/*
-			 * On each repeated call of this function, the dataspace is
-			 * replaced with a new one that contains the most current file
-			 * content.
+			 * On each repeated call of this function, the entry is replaced
+			 * with one that contains the most current file content.
 			 */
-			if (_file_ds.valid()) {
-				env()->ram_session()->free(_file_ds);
-				_file_ds = Ram_dataspace_capability();
+			if (_entry) {
+				_cache.release(*_entry, *this);
+				_entry = 0;
 			}
 
-			/* close and then re-open the file */
-			if (_file_handle.valid())
-				_fs.close(_file_handle);
-
-			_file_handle = _open_file(_fs, _file_path);
+			_entry = _cache.acquire(_file_path, *this, [&] () {
+				return _open_file(_fs, _file_path); });
 
 			/*
 			 * If we got the file, we can stop paying attention to the
 			 * compound directory.
 			 */
-			if (_file_handle.valid() && _compound_dir_handle.valid())
+			if (_entry && _compound_dir_handle.valid()) {
 				_fs.close(_compound_dir_handle);
-
-			/* register for file changes */
-			if (_sigh.valid() && _file_handle.valid())
-				_fs.sigh(_file_handle, _sigh);
-
-			size_t const file_size = _file_handle.valid()
-			                       ? _fs.status(_file_handle).size : 0;
-
-			/* allocate new RAM dataspace according to file size */
-			if (file_size > 0) {
-				try {
-					_file_ds = env()->ram_session()->alloc(file_size); }
-				catch (...) {
-					PERR("couldn't allocate memory for file, empty result\n");
-					_file_ds = Ram_dataspace_capability();
-					return;
-				}
+				_compound_dir_handle = File_system::Node_handle();
 			}
 
-			if (!_file_ds.valid()) {
+			if (!_entry)
 				_register_for_compound_dir_changes();
-				return;
-			}
-
-			/* map dataspace locally */
-			void * const dst_addr = env()->rm_session()->attach(_file_ds);
-
-			/* read content from file */
-			read(_fs, _file_handle, dst_addr, file_size);
-
-			/* unmap dataspace */
-			env()->rm_session()->detach(dst_addr);
 		}
 
 	public:
@@ -344,20 +668,21 @@ class Rom_session_component : public Genode::Rpc_object<Genode::Rom_session>
 		 * Constructor
 		 *
 		 * \param fs        file-system session to read the file from
+		 * \param cache     cache of file content shared with other sessions
 		 * \param filename  requested file name
 		 * \param sig_rec   signal receiver used to get notified about changes
 		 *                  within the compound directory (in the case when
 		 *                  the requested file could not be found at session-
 		 *                  creation time)
 		 */
-		Rom_session_component(File_system::Session &fs, const char *file_path,
+		Rom_session_component(File_system::Session &fs, Rom_cache &cache,
+		                      const char *file_path,
 		                      Genode::Signal_receiver &sig_reg)
 		:
-			_fs(fs), _file_path(file_path), _file_handle(_open_file(_fs, _file_path)),
+			_fs(fs), _cache(cache), _file_path(file_path), _entry(0),
 			_dir_change_dispatcher(sig_reg, *this, &Rom_session_component::_dir_changed)
 		{
-			if (!_file_handle.valid())
-				_register_for_compound_dir_changes();
+			_update_dataspace();
 		}
 
 		/**
@@ -365,15 +690,11 @@ class Rom_session_component : public Genode::Rpc_object<Genode::Rom_session>
 		 */
 		~Rom_session_component()
 		{
-			/* close re-open the file */
-			if (_file_handle.valid())
-				_fs.close(_file_handle);
+			if (_entry)
+				_cache.release(*_entry, *this);
 
 			if (_compound_dir_handle.valid())
 				_fs.close(_compound_dir_handle);
-
-			/* close file */
-			Genode::env()->ram_session()->free(_file_ds);
 		}
 
 		/**
@@ -381,8 +702,11 @@ class Rom_session_component : public Genode::Rpc_object<Genode::Rom_session>
 		 */
 		Genode::Rom_dataspace_capability dataspace()
 		{
-			_update_dataspace();
-			Genode::Dataspace_capability ds = _file_ds;
+			if (!_entry || !_cache.current(*_entry))
+				_update_dataspace();
+
+			Genode::Dataspace_capability ds = _entry ? _entry->ds()
+			                                         : Genode::Dataspace_capability();
 			return Genode::static_cap_cast<Genode::Rom_dataspace>(ds);
 		}
 
@@ -390,8 +714,6 @@ class Rom_session_component : public Genode::Rpc_object<Genode::Rom_session>
 		{
 			Genode::Lock::Guard guard(_sigh_lock);
 			_sigh = sigh;
-			if (_file_handle.valid())
-				_fs.sigh(_file_handle, _sigh);
 		}
 };
 
@@ -401,6 +723,7 @@ class Rom_root : public Genode::Root_component<Rom_session_component>
 	private:
 
 		File_system::Session    &_fs;
+		Rom_cache               &_cache;
 		Genode::Signal_receiver &_sig_rec;
 
 		Rom_session_component *_create_session(const char *args)
@@ -413,7 +736,7 @@ class Rom_root : public Genode::Root_component<Rom_session_component>
 			PINF("connection for file '%s' requested\n", filename);
 
 			/* create new session for the requested file */
-			return new (md_alloc()) Rom_session_component(_fs, filename, _sig_rec);
+			return new (md_alloc()) Rom_session_component(_fs, _cache, filename, _sig_rec);
 		}
 
 	public:
@@ -424,14 +747,16 @@ class Rom_root : public Genode::Root_component<Rom_session_component>
 		 * \param  entrypoint  entrypoint to be used for ROM sessions
 		 * \param  md_alloc    meta-data allocator used for ROM sessions
 		 * \param  fs          file-system session
+		 * \param  cache       cache of file content
 		 */
 		Rom_root(Genode::Rpc_entrypoint  &entrypoint,
 		         Genode::Allocator       &md_alloc,
 		         File_system::Session    &fs,
+		         Rom_cache               &cache,
 		         Genode::Signal_receiver &sig_rec)
 		:
 			Genode::Root_component<Rom_session_component>(&entrypoint, &md_alloc),
-			_fs(fs), _sig_rec(sig_rec)
+			_fs(fs), _cache(cache), _sig_rec(sig_rec)
 		{ }
 };
 
@@ -451,12 +776,35 @@ int main(void)
 	static Sliced_heap sliced_heap(env()->ram_session(),
 	                               env()->rm_session());
 
-	/* receiver of directory-change signals */
+	/* receiver of directory-change and file-change signals */
 	static Signal_receiver sig_rec;
 
+	/*
+	 * Share content among sessions if the '<cache>' node is present, keep
+	 * unreferenced content up to its size
+	 */
+	bool            shared     = false;
+	Number_of_bytes cache_size = 0;
+	try {
+		Xml_node cache_node = config()->xml_node().sub_node("cache");
+		shared = true;
+		cache_node.attribute("size").value(&cache_size);
+	} catch (...) { }
+
+	/* enable or disable report of the memory saved by sharing content */
+	static Reporter reporter("rom_sharing");
+	try {
+		reporter.enabled(config()->xml_node().sub_node("report")
+		                                     .attribute("sharing")
+		                                     .has_value("yes"));
+	} catch (...) { }
+
+	static Rom_cache cache(fs, sig_rec, *env()->heap(), shared, cache_size,
+	                       reporter);
+
 	enum { STACK_SIZE = 8*1024 };
 	static Rpc_entrypoint ep(&cap, STACK_SIZE, "fs_rom_ep");
-	static Rom_root rom_root(ep, sliced_heap, fs, sig_rec);
+	static Rom_root rom_root(ep, sliced_heap, fs, cache, sig_rec);
 
 	/* announce server*/
 	env()->parent()->announce(ep.manage(&rom_root));
@@ -18,6 +18,9 @@
 #include <terminal_session/terminal_session.h>
 #include <log_session/log_session.h>
 
+/* interface to 'log_console' */
+extern "C" int stdout_write(const char *);
+
 namespace Terminal {
 
 	class Session_component;
@@ -49,8 +52,13 @@ class Buffered_output
 			/* append null termination */
 			_buf[_index] = 0;
 
-			/* flush buffered characters to LOG */
-			Genode::printf(_buf);
+			/*
+			 * Flush buffered characters to LOG, bypassing the formatting
+			 * and buffering of 'printf'. The LOG console passes the line
+			 * via the ring buffer of the LOG session if supported by the
+			 * LOG server.
+			 */
+			stdout_write(_buf);
 
 			/* reset */
 			_index = 0;
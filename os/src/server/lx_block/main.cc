@@ -0,0 +1,410 @@
+/*
+ * \brief  Block driver for a Linux host file or block device
+ * \author Genode Labs
+ * \date   2014-01-31
+ *
+ * Requests are passed to the host kernel via io_uring. Many requests are
+ * in flight at once, and the packet buffer of the session is registered
+ * with the kernel, which spares the kernel from pinning the pages of each
+ * request. Completions are signalled via an eventfd, which is watched by a
+ * dedicated thread. If the host kernel lacks io_uring, requests are
+ * processed synchronously.
+ */
+
+/*
+ * Copyright (C) 2014 Genode Labs GmbH
+ *
+ * This file is part of the Genode OS framework, which is distributed
+ * under the terms of the GNU General Public License version 2.
+ */
+
+/* Genode includes */
+#include <base/printf.h>
+#include <base/thread.h>
+#include <block/component.h>
+#include <block/driver.h>
+#include <os/config.h>
+#include <os/server.h>
+#include <util/volatile_object.h>
+
+/* Linux includes */
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <linux/fs.h>
+
+/* local includes */
+#include "uring.h"
+
+
+namespace Lx_block {
+
+	using namespace Genode;
+
+	struct Config;
+	class  Completion_thread;
+	class  Driver;
+}
+
+
+struct Lx_block::Config
+{
+	enum { MAX_QUEUE_DEPTH = Block::Driver::MAX_QUEUE_DEPTH };
+
+	char     file[256];
+	size_t   block_size;
+	unsigned queue_depth;
+	bool     direct;      /* bypass the page cache of the host */
+	bool     writeable;
+
+	Config() : block_size(512), queue_depth(64), direct(false), writeable(false)
+	{
+		file[0] = 0;
+
+		try {
+			Xml_node config = Genode::config()->xml_node();
+			try { config.attribute("file").value(file, sizeof(file)); } catch (...) { }
+			try { config.attribute("block_size").value(&block_size); } catch (...) { }
+			try { config.attribute("queue_depth").value(&queue_depth); } catch (...) { }
+			try { direct    = config.attribute("direct").has_value("yes");    } catch (...) { }
+			try { writeable = config.attribute("writeable").has_value("yes"); } catch (...) { }
+		} catch (...) { }
+
+		queue_depth = max(1U, min(queue_depth, (unsigned)MAX_QUEUE_DEPTH));
+	}
+};
+
+
+/**
+ * Thread forwarding completion events of the host kernel as signals
+ */
+class Lx_block::Completion_thread : public Thread<0x2000>
+{
+	private:
+
+		int const                 _fd;
+		Signal_context_capability _sigh;
+		bool volatile             _stop;
+
+	public:
+
+		Completion_thread(int fd, Signal_context_capability sigh)
+		: Thread<0x2000>("completion"), _fd(fd), _sigh(sigh), _stop(false)
+		{
+			start();
+		}
+
+		/**
+		 * Destructor, wakes up the thread via the eventfd and waits until
+		 * it returned
+		 */
+		~Completion_thread()
+		{
+			_stop = true;
+
+			Genode::uint64_t const wakeup = 1;
+			if (write(_fd, &wakeup, sizeof(wakeup)) == sizeof(wakeup))
+				join();
+		}
+
+		void entry()
+		{
+			while (!_stop) {
+				Genode::uint64_t events;
+				if (read(_fd, &events, sizeof(events)) == sizeof(events) && !_stop)
+					Signal_transmitter(_sigh).submit();
+			}
+		}
+};
+
+
+class Lx_block::Driver : public Block::Driver
+{
+	private:
+
+		typedef Block::Packet_descriptor Packet_descriptor;
+
+		/**
+		 * Request in flight
+		 *
+		 * Transfers completed partially by the host are continued with
+		 * the remainder.
+		 */
+		struct Request
+		{
+			bool   write;
+			char  *addr;
+			off_t  offset;
+			size_t remaining;
+		};
+
+		Config const   _config;
+		int            _fd;
+		Block::sector_t _blk_cnt;
+
+		Lazy_volatile_object<Uring>             _uring;
+		int                                     _event_fd;
+		Server::Signal_rpc_member<Driver>       _completion_dispatcher;
+		Lazy_volatile_object<Completion_thread> _completion_thread;
+
+		Request                  _request[MAX_QUEUE_DEPTH];
+		Ram_dataspace_capability _dma_ds;
+		char                    *_dma_base;
+		bool                     _fixed;  /* packet buffer is registered */
+
+		int _open()
+		{
+			int flags = (_config.writeable ? O_RDWR : O_RDONLY)
+			          | (_config.direct ? O_DIRECT : 0);
+
+			int fd = open(_config.file, flags);
+			if (fd < 0) {
+				PERR("could not open '%s' (errno=%d)", _config.file, errno);
+				throw Root::Unavailable();
+			}
+			return fd;
+		}
+
+		Block::sector_t _block_count()
+		{
+			struct stat st;
+			if (fstat(_fd, &st) != 0)
+				return 0;
+
+			Genode::uint64_t bytes = st.st_size;
+			if (S_ISBLK(st.st_mode) && ioctl(_fd, BLKGETSIZE64, &bytes) != 0)
+				return 0;
+
+			return bytes / _config.block_size;
+		}
+
+		/**
+		 * Submit (the remainder of) a request to the host kernel
+		 */
+		bool _submit(Tag tag)
+		{
+			Request const &r = _request[tag];
+
+			return _uring->submit([&] (io_uring_sqe &sqe) {
+				if (_fixed) {
+					sqe.opcode    = r.write ? IORING_OP_WRITE_FIXED : IORING_OP_READ_FIXED;
+					sqe.buf_index = 0;
+				} else
+					sqe.opcode    = r.write ? IORING_OP_WRITE : IORING_OP_READ;
+
+				sqe.fd        = _fd;
+				sqe.addr      = (addr_t)r.addr;
+				sqe.len       = r.remaining;
+				sqe.off       = r.offset;
+				sqe.user_data = tag;
+			});
+		}
+
+		void _handle_completions(unsigned)
+		{
+			_uring->for_each_completion([&] (io_uring_cqe const &cqe) {
+
+				Tag const tag = cqe.user_data;
+				Request  &r   = _request[tag];
+
+				if (cqe.res <= 0) {
+					PERR("%s of %zu bytes at %lld failed (res=%d)",
+					     r.write ? "write" : "read", r.remaining,
+					     (long long)r.offset, cqe.res);
+					session->complete(tag, false);
+					return;
+				}
+
+				r.addr      += cqe.res;
+				r.offset    += cqe.res;
+				r.remaining -= cqe.res;
+
+				if (!r.remaining)
+					session->complete(tag);
+				else if (!_submit(tag))
+					session->complete(tag, false);
+			});
+
+			_uring->flush();
+		}
+
+		/**
+		 * Process request synchronously if io_uring is not available
+		 */
+		void _process(Tag tag)
+		{
+			Request &r = _request[tag];
+
+			while (r.remaining) {
+				ssize_t res = r.write ? pwrite(_fd, r.addr, r.remaining, r.offset)
+				                      : pread (_fd, r.addr, r.remaining, r.offset);
+				if (res < 0 && errno == EINTR)
+					continue;
+				if (res <= 0)
+					break;
+
+				r.addr      += res;
+				r.offset    += res;
+				r.remaining -= res;
+			}
+
+			session->complete(tag, !r.remaining);
+		}
+
+	public:
+
+		Driver(Server::Entrypoint &ep)
+		:
+			_fd(_open()), _blk_cnt(_block_count()), _event_fd(-1),
+			_completion_dispatcher(ep, *this, &Driver::_handle_completions),
+			_dma_base(0), _fixed(false)
+		{
+			try {
+				_uring.construct(_config.queue_depth);
+
+				_event_fd = eventfd(0, 0);
+				if (_event_fd < 0 || !_uring->register_eventfd(_event_fd))
+					throw Uring::Setup_failed();
+
+				_completion_thread.construct(_event_fd, _completion_dispatcher);
+
+			} catch (Uring::Setup_failed) {
+				PWRN("io_uring unavailable, processing requests synchronously");
+				_uring.destruct();
+
+				if (_event_fd >= 0)
+					close(_event_fd);
+				_event_fd = -1;
+			}
+
+			PINF("'%s' with %llu blocks of %zu bytes%s",
+			     _config.file, (unsigned long long)_blk_cnt,
+			     _config.block_size, _config.direct ? ", direct I/O" : "");
+		}
+
+		~Driver()
+		{
+			/* stop the thread before it could signal a destructed dispatcher */
+			_completion_thread.destruct();
+			_uring.destruct();
+
+			if (_event_fd >= 0)
+				close(_event_fd);
+			close(_fd);
+		}
+
+
+		/*******************************
+		 **  Block::Driver interface  **
+		 *******************************/
+
+		size_t          block_size()  { return _config.block_size; }
+		Block::sector_t block_count() { return _blk_cnt; }
+
+		Block::Session::Operations ops()
+		{
+			Block::Session::Operations o;
+			o.set_operation(Packet_descriptor::READ);
+			if (_config.writeable)
+				o.set_operation(Packet_descriptor::WRITE);
+			return o;
+		}
+
+		unsigned queue_depth() {
+			return _uring.is_constructed() ? _uring->entries() : 1; }
+
+		void submit(Tag tag, Packet_descriptor &packet, char *buffer, addr_t)
+		{
+			bool const write = packet.operation() == Packet_descriptor::WRITE;
+			if (write && !_config.writeable)
+				throw Io_error();
+
+			Request &r = _request[tag];
+			r.write     = write;
+			r.offset    = packet.block_number()*_config.block_size;
+			r.remaining = packet.block_count()*_config.block_size;
+
+			/* a registered buffer is addressed via the mapping of the driver */
+			r.addr = _fixed ? _dma_base + packet.offset() : buffer;
+
+			if (!_uring.is_constructed()) {
+				_process(tag);
+				return;
+			}
+
+			if (!_submit(tag))
+				throw Request_congestion();
+		}
+
+		/**
+		 * Allocate packet buffer and register it with the host kernel
+		 */
+		Ram_dataspace_capability alloc_dma_buffer(size_t size)
+		{
+			_dma_ds   = env()->ram_session()->alloc(size);
+			_dma_base = env()->rm_session()->attach(_dma_ds);
+
+			if (_uring.is_constructed()) {
+				_fixed = _uring->register_buffer(_dma_base, size);
+				if (!_fixed)
+					PWRN("could not register packet buffer with io_uring");
+			}
+			return _dma_ds;
+		}
+
+		void free_dma_buffer(Ram_dataspace_capability ds)
+		{
+			if (_fixed)
+				_uring->unregister_buffers();
+			_fixed = false;
+
+			env()->rm_session()->detach(_dma_base);
+			env()->ram_session()->free(ds);
+		}
+
+		void sync()
+		{
+			if (fdatasync(_fd) != 0)
+				PERR("fdatasync failed (errno=%d)", errno);
+		}
+};
+
+
+struct Main
+{
+	Server::Entrypoint &ep;
+
+	struct Factory : Block::Driver_factory
+	{
+		Server::Entrypoint &ep;
+
+		Factory(Server::Entrypoint &ep) : ep(ep) { }
+
+		Block::Driver *create() {
+			return new (Genode::env()->heap()) Lx_block::Driver(ep); }
+
+		void destroy(Block::Driver *driver) {
+			Genode::destroy(Genode::env()->heap(),
+			                static_cast<Lx_block::Driver *>(driver)); }
+	} factory;
+
+	Block::Root root;
+
+	Main(Server::Entrypoint &ep)
+	: ep(ep), factory(ep), root(ep, Genode::env()->heap(), factory) {
+		Genode::env()->parent()->announce(ep.manage(root)); }
+};
+
+
+/************
+ ** Server **
+ ************/
+
+namespace Server {
+	char const *name()             { return "lx_block_ep";       }
+	size_t stack_size()            { return 2*1024*sizeof(long); }
+	void construct(Entrypoint &ep) { static Main server(ep);     }
+}
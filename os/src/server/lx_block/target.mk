@@ -0,0 +1,12 @@
+TARGET   = lx_block
+REQUIRES = linux
+SRC_CC   = main.cc
+LIBS     = base config server lx_hybrid
+
+#
+# The host headers, in particular 'linux/io_uring.h', are made available
+# by the 'lx_hybrid' library via 'HOST_INC_DIR', which is appended to the
+# include-search path. Adding '/usr/include' to 'INC_DIR' would give the
+# host headers precedence over the Genode headers.
+#
+INC_DIR += $(PRG_DIR)
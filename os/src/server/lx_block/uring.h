@@ -0,0 +1,216 @@
+/*
+ * \brief  Minimal interface to the io_uring of the Linux kernel
+ * \author Genode Labs
+ * \date   2014-01-31
+ */
+
+/*
+ * Copyright (C) 2014 Genode Labs GmbH
+ *
+ * This file is part of the Genode OS framework, which is distributed
+ * under the terms of the GNU General Public License version 2.
+ */
+
+#ifndef _URING_H_
+#define _URING_H_
+
+/* Genode includes */
+#include <base/exception.h>
+#include <util/noncopyable.h>
+#include <util/string.h>
+
+/* Linux includes */
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <linux/io_uring.h>
+
+
+/**
+ * Submission and completion rings shared with the kernel
+ *
+ * The rings are accessed via system calls directly. Submission entries
+ * are handed to the kernel one by one and must be obtained and submitted
+ * by the same thread.
+ */
+class Uring : Genode::Noncopyable
+{
+	public:
+
+		class Setup_failed : public Genode::Exception { };
+
+	private:
+
+		int _fd;
+
+		struct io_uring_params _params;
+
+		/* submission ring */
+		Genode::size_t _sq_size;
+		char          *_sq;
+		unsigned      *_sq_head;
+		unsigned      *_sq_tail;
+		unsigned       _sq_mask;
+		unsigned      *_sq_array;
+		io_uring_sqe  *_sqes;
+
+		/* completion ring, shares the mapping of the submission ring if
+		 * supported by the kernel */
+		Genode::size_t _cq_size;
+		char          *_cq;
+		unsigned      *_cq_head;
+		unsigned      *_cq_tail;
+		unsigned       _cq_mask;
+		io_uring_cqe  *_cqes;
+
+		bool _single_mmap() const {
+			return _params.features & IORING_FEAT_SINGLE_MMAP; }
+
+		char *_map(Genode::size_t size, off_t offset)
+		{
+			void *addr = mmap(0, size, PROT_READ | PROT_WRITE,
+			                  MAP_SHARED | MAP_POPULATE, _fd, offset);
+			if (addr == MAP_FAILED)
+				throw Setup_failed();
+			return (char *)addr;
+		}
+
+		int _register(unsigned opcode, void *arg, unsigned count) {
+			return syscall(__NR_io_uring_register, _fd, opcode, arg, count); }
+
+		void _unmap()
+		{
+			if (_sqes) munmap(_sqes, _params.sq_entries*sizeof(io_uring_sqe));
+			if (_cq && _cq != _sq) munmap(_cq, _cq_size);
+			if (_sq) munmap(_sq, _sq_size);
+		}
+
+	public:
+
+		/**
+		 * Constructor
+		 *
+		 * \param entries  number of submission entries
+		 *
+		 * \throw Setup_failed  if the kernel does not support io_uring
+		 */
+		Uring(unsigned entries) : _sq(0), _sqes(0), _cq(0)
+		{
+			Genode::memset(&_params, 0, sizeof(_params));
+
+			_fd = syscall(__NR_io_uring_setup, entries, &_params);
+			if (_fd < 0)
+				throw Setup_failed();
+
+			_sq_size = _params.sq_off.array + _params.sq_entries*sizeof(unsigned);
+			_cq_size = _params.cq_off.cqes  + _params.cq_entries*sizeof(io_uring_cqe);
+			if (_single_mmap())
+				_sq_size = _cq_size = Genode::max(_sq_size, _cq_size);
+
+			try {
+				_sq   = _map(_sq_size, IORING_OFF_SQ_RING);
+				_cq   = _single_mmap() ? _sq : _map(_cq_size, IORING_OFF_CQ_RING);
+				_sqes = (io_uring_sqe *)_map(_params.sq_entries*sizeof(io_uring_sqe),
+				                             IORING_OFF_SQES);
+			} catch (Setup_failed) {
+				_unmap();
+				close(_fd);
+				throw;
+			}
+
+			_sq_head  = (unsigned *)(_sq + _params.sq_off.head);
+			_sq_tail  = (unsigned *)(_sq + _params.sq_off.tail);
+			_sq_mask  = *(unsigned *)(_sq + _params.sq_off.ring_mask);
+			_sq_array = (unsigned *)(_sq + _params.sq_off.array);
+
+			_cq_head  = (unsigned *)(_cq + _params.cq_off.head);
+			_cq_tail  = (unsigned *)(_cq + _params.cq_off.tail);
+			_cq_mask  = *(unsigned *)(_cq + _params.cq_off.ring_mask);
+			_cqes     = (io_uring_cqe *)(_cq + _params.cq_off.cqes);
+		}
+
+		~Uring()
+		{
+			_unmap();
+			close(_fd);
+		}
+
+		unsigned entries() const { return _params.sq_entries; }
+
+		/**
+		 * Register buffer for fixed-buffer operations with index 0
+		 *
+		 * \return  false if the kernel refused to pin the buffer
+		 */
+		bool register_buffer(void *base, Genode::size_t size)
+		{
+			iovec iov = { base, size };
+			return _register(IORING_REGISTER_BUFFERS, &iov, 1) == 0;
+		}
+
+		void unregister_buffers() { _register(IORING_UNREGISTER_BUFFERS, 0, 0); }
+
+		/**
+		 * Let the kernel signal completions via the eventfd 'fd'
+		 */
+		bool register_eventfd(int fd) {
+			return _register(IORING_REGISTER_EVENTFD, &fd, 1) == 0; }
+
+		/**
+		 * Submit one request
+		 *
+		 * \param fill  functor called with the cleared submission entry
+		 *
+		 * \return  false if the submission ring is full
+		 */
+		template <typename FN>
+		bool submit(FN const &fill)
+		{
+			unsigned const tail = *_sq_tail;
+			if (tail - __atomic_load_n(_sq_head, __ATOMIC_ACQUIRE) >= _params.sq_entries)
+				return false;
+
+			unsigned const index = tail & _sq_mask;
+			io_uring_sqe &sqe = _sqes[index];
+			Genode::memset(&sqe, 0, sizeof(sqe));
+			fill(sqe);
+
+			_sq_array[index] = index;
+			__atomic_store_n(_sq_tail, tail + 1, __ATOMIC_RELEASE);
+
+			flush();
+			return true;
+		}
+
+		/**
+		 * Pass submission entries not yet consumed to the kernel
+		 *
+		 * Entries may remain in the ring if the kernel is short of
+		 * resources. They are passed again with the next call.
+		 */
+		void flush()
+		{
+			unsigned const pending = *_sq_tail - __atomic_load_n(_sq_head, __ATOMIC_ACQUIRE);
+			if (pending)
+				syscall(__NR_io_uring_enter, _fd, pending, 0, 0, 0, 0);
+		}
+
+		/**
+		 * Call 'fn' for each available completion
+		 */
+		template <typename FN>
+		void for_each_completion(FN const &fn)
+		{
+			for (unsigned head = *_cq_head;
+			     head != __atomic_load_n(_cq_tail, __ATOMIC_ACQUIRE); ) {
+
+				io_uring_cqe const cqe = _cqes[head & _cq_mask];
+				__atomic_store_n(_cq_head, ++head, __ATOMIC_RELEASE);
+
+				fn(cqe);
+			}
+		}
+};
+
+#endif /* _URING_H_ */
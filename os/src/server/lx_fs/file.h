@@ -8,21 +8,80 @@
 #ifndef _FILE_H_
 #define _FILE_H_
 
+/* Genode includes */
+#include <base/env.h>
+#include <base/rpc_server.h>
+#include <linux_dataspace/linux_dataspace.h>
+
 /* local includes */
 #include <node.h>
 #include <lx_util.h>
 
 
 namespace File_system {
+	class File_dataspace;
 	class File;
 }
 
 
+/**
+ * Dataspace referring to a host file
+ *
+ * Clients attach the dataspace by mapping the file descriptor obtained
+ * via the Linux-specific dataspace interface.
+ */
+class File_system::File_dataspace : public Rpc_object<Linux_dataspace>
+{
+	private:
+
+		int    const _fd;
+		size_t const _size;
+		bool   const _writable;
+
+	public:
+
+		File_dataspace(int fd, size_t size, bool writable)
+		: _fd(fd), _size(size), _writable(writable) { }
+
+		size_t size()      { return _size; }
+		addr_t phys_addr() { return 0; }
+		bool   writable()  { return _writable; }
+
+		Filename fname()
+		{
+			Filename name;
+			name.buf[0] = 0;
+			return name;
+		}
+
+		Untyped_capability fd()
+		{
+			typedef Untyped_capability::Dst Dst;
+			enum { DUMMY_LOCAL_NAME = 0 };
+			return Untyped_capability(Dst(_fd), DUMMY_LOCAL_NAME);
+		}
+};
+
+
 class File_system::File : public Node
 {
 	private:
 
-		int _fd;
+		int  _fd;
+		Mode _mode;
+
+		File_dataspace *_ds;
+		Rpc_entrypoint *_ds_ep;
+
+		void _release_dataspace()
+		{
+			if (!_ds)
+				return;
+
+			_ds_ep->dissolve(_ds);
+			destroy(env()->heap(), _ds);
+			_ds = 0;
+		}
 
 		unsigned long _inode(int dir, char const *name, bool create)
 		{
@@ -82,7 +141,7 @@ class File_system::File : public Node
 		     bool        create)
 		:
 			Node(_inode(dir, name, create)),
-			_fd(_open(dir, name, mode))
+			_fd(_open(dir, name, mode)), _mode(mode), _ds(0), _ds_ep(0)
 		{
 			Node::name(name);
 		}
@@ -90,11 +149,13 @@ class File_system::File : public Node
 		File(char const *path, Mode mode)
 		:
 			Node(_inode_path(path)),
-			_fd(_open_path(path, mode))
+			_fd(_open_path(path, mode)), _mode(mode), _ds(0), _ds_ep(0)
 		{
 			Node::name(basename(path));
 		}
 
+		~File() { _release_dataspace(); }
+
 		size_t read(char *dst, size_t len, seek_off_t seek_offset)
 		{
 			int ret = pread(_fd, dst, len, seek_offset);
@@ -133,6 +194,33 @@ class File_system::File : public Node
 
 			mark_as_updated();
 		}
+
+		/**
+		 * Return dataspace referring to the first 'size' bytes of the file
+		 *
+		 * The dataspace is managed by 'ep'. A dataspace handed out earlier
+		 * is replaced if it is too small or read-only. Mappings of the
+		 * replaced dataspace remain intact because they refer to the file
+		 * directly.
+		 */
+		Dataspace_capability dataspace(Rpc_entrypoint &ep, file_size_t size,
+		                               bool writable)
+		{
+			/* mappings of the host file require read access */
+			if (_mode == WRITE_ONLY || (writable && _mode != READ_WRITE))
+				throw Permission_denied();
+
+			size_t const ds_size = align_addr(size, 12);
+
+			if (_ds && _ds->size() >= ds_size && (_ds->writable() || !writable))
+				return _ds->cap();
+
+			_release_dataspace();
+
+			_ds    = new (env()->heap()) File_dataspace(_fd, ds_size, writable);
+			_ds_ep = &ep;
+			return static_cap_cast<Dataspace>(ep.manage(_ds));
+		}
 };
 
 #endif /* _FILE_H_ */
@@ -0,0 +1,156 @@
+/*
+ * \brief  Pool of threads performing file I/O on behalf of the entrypoint
+ * \author Genode Labs
+ * \date   2014-02-12
+ */
+
+/*
+ * Copyright (C) 2014 Genode Labs GmbH
+ *
+ * This file is part of the Genode OS framework, which is distributed
+ * under the terms of the GNU General Public License version 2.
+ */
+
+#ifndef _IO_POOL_H_
+#define _IO_POOL_H_
+
+/* Genode includes */
+#include <base/lock.h>
+#include <base/semaphore.h>
+#include <base/thread.h>
+#include <file_system/page_cache.h>
+#include <util/fifo.h>
+
+/* local includes */
+#include <node.h>
+
+namespace File_system {
+	struct Io_job;
+	class  Io_pool;
+}
+
+
+/**
+ * Packet operation executed by a worker of the pool
+ */
+struct File_system::Io_job : Fifo<Io_job>::Element
+{
+	/**
+	 * Interface for receiving completed jobs, called by the worker
+	 */
+	struct Owner { virtual void completed(Io_job &) = 0; };
+
+	Owner            *owner;
+	Packet_descriptor packet;
+	Node             *node;
+	char             *content;
+	bool              done;
+
+	/* cache used for accessing the node, or zero */
+	Page_cache         *cache;
+	Page_cache::Node_id node_id;
+
+	Io_job() : owner(0), node(0), content(0), done(false), cache(0), node_id(0) { }
+
+	bool write() const { return packet.operation() == Packet_descriptor::WRITE; }
+
+	void execute()
+	{
+		size_t     const length   = packet.length();
+		seek_off_t const position = packet.position();
+		size_t res_length = 0;
+
+		switch (packet.operation()) {
+
+		case Packet_descriptor::READ:
+			if (cache && position != (seek_off_t)(~0))
+				res_length = cache->read(node_id, content, length, position,
+					[&] (char *dst, size_t len, seek_off_t offset) {
+						return node->read(dst, len, offset); });
+			else
+				res_length = node->read(content, length, position);
+			break;
+
+		case Packet_descriptor::WRITE:
+			res_length = node->write(content, length, position);
+
+			/* invalidate after the write to drop content read meanwhile */
+			if (cache && position == (seek_off_t)(~0))
+				cache->invalidate(node_id);
+			else if (cache)
+				cache->invalidate(node_id, position, length);
+			break;
+		}
+
+		packet.length(res_length);
+		packet.succeeded(res_length > 0);
+	}
+};
+
+
+/**
+ * Worker threads processing jobs in the order of their submission
+ *
+ * A host system call blocks only the calling worker, so the entrypoint
+ * keeps serving other clients while a slow host device is accessed.
+ */
+class File_system::Io_pool
+{
+	private:
+
+		enum { STACK_SIZE = 4*1024*sizeof(long), MAX_WORKERS = 32 };
+
+		struct Worker : Thread<STACK_SIZE>
+		{
+			Io_pool &pool;
+
+			Worker(Io_pool &pool) : Thread<STACK_SIZE>("io_worker"), pool(pool)
+			{ start(); }
+
+			void entry()
+			{
+				for (;;) {
+					Io_job &job = pool._next_job();
+					job.execute();
+					job.owner->completed(job);
+				}
+			}
+		};
+
+		Lock         _lock;
+		Semaphore    _jobs_avail;
+		Fifo<Io_job> _jobs;
+
+		Worker  *_workers[MAX_WORKERS];
+		unsigned _num_workers;
+
+		Io_job &_next_job()
+		{
+			_jobs_avail.down();
+
+			Lock::Guard guard(_lock);
+			return *_jobs.dequeue();
+		}
+
+	public:
+
+		Io_pool(unsigned workers) : _num_workers(min(max(workers, 1U),
+		                                             (unsigned)MAX_WORKERS))
+		{
+			for (unsigned i = 0; i < _num_workers; i++)
+				_workers[i] = new (env()->heap()) Worker(*this);
+		}
+
+		unsigned num_workers() const { return _num_workers; }
+
+		void submit(Io_job &job)
+		{
+			{
+				Lock::Guard guard(_lock);
+				_jobs.enqueue(&job);
+			}
+			_jobs_avail.up();
+		}
+};
+
+#endif /* _IO_POOL_H_ */
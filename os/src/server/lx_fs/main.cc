@@ -12,16 +12,21 @@
  */
 
 /* Genode includes */
+#include <file_system/page_cache.h>
 #include <file_system_session/rpc_object.h>
 #include <root/component.h>
 #include <os/attached_rom_dataspace.h>
 #include <os/config.h>
+#include <os/reporter.h>
 #include <os/server.h>
 #include <os/session_policy.h>
+#include <timer_session/connection.h>
+#include <util/volatile_object.h>
 #include <util/xml_node.h>
 
 /* local includes */
 #include <directory.h>
+#include <io_pool.h>
 #include <node_handle_registry.h>
 
 
@@ -32,7 +37,8 @@ namespace File_system {
 }
 
 
-class File_system::Session_component : public Session_rpc_object
+class File_system::Session_component : public Session_rpc_object,
+                                        private Io_job::Owner
 {
 	private:
 
@@ -41,69 +47,129 @@ class File_system::Session_component : public Session_rpc_object
 		Directory            &_root;
 		Node_handle_registry  _handle_registry;
 		bool                  _writable;
+		Io_pool              &_pool;
+		Page_cache           *_cache;  /* zero if not configured */
 
 		Signal_rpc_member<Session_component> _process_packet_dispatcher;
 
+		/*
+		 * Ring of jobs in the order of the packet submission
+		 *
+		 * Jobs between '_head' and '_next' are executed or completed, jobs
+		 * between '_next' and '_tail' are waiting for their execution.
+		 */
+		unsigned const _num_jobs;
+		Io_job       **_jobs;
+		unsigned       _head, _next, _tail;
+
+		/* state shared with the workers */
+		Lock      _completion_lock;
+		unsigned  _running;
+		bool      _running_write;
+		bool      _closing;
+		Semaphore _drained;
+
+		Io_job &_job(unsigned i) { return *_jobs[i % _num_jobs]; }
+
 
 		/******************************
 		 ** Packet-stream processing **
 		 ******************************/
 
 		/**
-		 * Perform packet operation
-		 *
-		 * \return true on success, false on failure
+		 * Io_job::Owner interface, called by the worker
 		 */
-		void _process_packet_op(Packet_descriptor &packet, Node &node)
+		void completed(Io_job &job)
 		{
-			void     * const content = tx_sink()->packet_content(packet);
-			size_t     const length  = packet.length();
-			seek_off_t const offset  = packet.position();
+			Lock::Guard guard(_completion_lock);
 
-			if (!content || (packet.length() > packet.size())) {
-				packet.succeeded(false);
-				return;
-			}
+			job.done = true;
+			_running--;
+			_running_write = false;
+
+			if (_closing)
+				_drained.up();
+			else
+				Signal_transmitter(_process_packet_dispatcher).submit();
+		}
 
-			/* resulting length */
-			size_t res_length = 0;
+		bool _done(Io_job &job)
+		{
+			Lock::Guard guard(_completion_lock);
+			return job.done;
+		}
 
-			switch (packet.operation()) {
+		void _queue(Packet_descriptor const &packet)
+		{
+			Io_job &job = _job(_tail++);
 
-			case Packet_descriptor::READ:
-				res_length = node.read((char *)content, length, offset);
-				break;
+			job.owner   = this;
+			job.packet  = packet;
+			job.node    = 0;
+			job.content = tx_sink()->packet_content(packet);
+			job.done    = false;
 
-			case Packet_descriptor::WRITE:
-				res_length = node.write((char const *)content, length, offset);
-				break;
+			/* assume failure by default */
+			job.packet.succeeded(false);
+
+			if (!job.content || (packet.length() > packet.size())) {
+				job.done = true;
+				return;
 			}
 
-			packet.length(res_length);
-			packet.succeeded(res_length > 0);
+			try {
+				job.node = _handle_registry.lookup_and_lock(packet.handle());
+				job.node->unlock();
+			}
+			catch (Invalid_handle) {
+				PERR("Invalid_handle");
+				job.done = true;
+			}
 		}
 
-		void _process_packet()
+		/**
+		 * Start execution of waiting jobs
+		 *
+		 * Reads of files are executed concurrently, whereas a write waits
+		 * for all preceding jobs and is executed exclusively. Operations on
+		 * other nodes, e.g., reading a directory, are cheap and depend on
+		 * the node state shared with the RPC functions. They are executed
+		 * exclusively by the entrypoint.
+		 */
+		void _dispatch()
 		{
-			Packet_descriptor packet = tx_sink()->get_packet();
+			for (; _next != _tail; _next++) {
 
-			/* assume failure by default */
-			packet.succeeded(false);
+				Io_job &job = _job(_next);
+				if (job.done)
+					continue;
 
-			try {
-				Node *node = _handle_registry.lookup_and_lock(packet.handle());
-				Node_lock_guard guard(*node);
+				bool const file = dynamic_cast<File *>(job.node);
+				{
+					Lock::Guard guard(_completion_lock);
 
-				_process_packet_op(packet, *node);
-			}
-			catch (Invalid_handle)     { PERR("Invalid_handle");     }
-			catch (Size_limit_reached) { PERR("Size_limit_reached"); }
+					if (_running_write || ((job.write() || !file) && _running))
+						return;
 
-			/*
-			 * The 'acknowledge_packet' function cannot block because we
-			 * checked for 'ready_to_ack' in '_process_packets'.
-			 */
-			tx_sink()->acknowledge_packet(packet);
+					if (file) {
+						_running++;
+						_running_write = job.write();
+					}
+				}
+
+				if (file) {
+					job.cache   = _cache;
+					job.node_id = job.node->inode();
+					_pool.submit(job);
+					continue;
+				}
+
+				job.node->lock();
+				Node_lock_guard guard(*job.node);
+
+				job.execute();
+				job.done = true;
+			}
 		}
 
 		/**
@@ -112,24 +178,36 @@ class File_system::Session_component : public Session_rpc_object
 		 */
 		void _process_packets(unsigned)
 		{
-			while (tx_sink()->packet_avail()) {
+			for (bool progress = true; progress; ) {
+
+				progress = false;
+
+				while (tx_sink()->packet_avail() && _tail - _head < _num_jobs) {
+					_queue(tx_sink()->get_packet());
+					progress = true;
+				}
+
+				_dispatch();
 
 				/*
-				 * Make sure that the '_process_packet' function does not
-				 * block.
+				 * Acknowledge completed jobs in the order of submission
 				 *
-				 * If the acknowledgement queue is full, we defer packet
-				 * processing until the client processed pending
+				 * If the acknowledgement queue is full, we defer the
+				 * acknowledgement until the client processed pending
 				 * acknowledgements and thereby emitted a ready-to-ack
 				 * signal. Otherwise, the call of 'acknowledge_packet()'
-				 * in '_process_packet' would infinitely block the context
-				 * of the main thread. The main thread is however needed
-				 * for receiving any subsequent 'ready-to-ack' signals.
+				 * would infinitely block the context of the main thread.
+				 * The main thread is however needed for receiving any
+				 * subsequent 'ready-to-ack' signals.
 				 */
-				if (!tx_sink()->ready_to_ack())
-					return;
+				while (_head != _next && _done(_job(_head))) {
+
+					if (!tx_sink()->ready_to_ack())
+						return;
 
-				_process_packet();
+					tx_sink()->acknowledge_packet(_job(_head++).packet);
+					progress = true;
+				}
 			}
 		}
 
@@ -150,18 +228,31 @@ class File_system::Session_component : public Session_rpc_object
 		 * Constructor
 		 */
 		Session_component(size_t              tx_buf_size,
+		                  unsigned            tx_queue_size,
 		                  Server::Entrypoint &ep,
 		                  char const         *root_dir,
 		                  bool                writable,
-		                  Allocator          &md_alloc)
+		                  Allocator          &md_alloc,
+		                  Io_pool            &pool,
+		                  Page_cache         *cache)
 		:
-			Session_rpc_object(env()->ram_session()->alloc(tx_buf_size), ep.rpc_ep()),
+			Session_rpc_object(env()->ram_session()->alloc(tx_buf_size), ep.rpc_ep(),
+			                   tx_queue_size),
 			_ep(ep),
 			_md_alloc(md_alloc),
 			_root(*new (&_md_alloc) Directory(_md_alloc, root_dir, false)),
 			_writable(writable),
-			_process_packet_dispatcher(ep, *this, &Session_component::_process_packets)
+			_pool(pool),
+			_cache(cache),
+			_process_packet_dispatcher(ep, *this, &Session_component::_process_packets),
+			_num_jobs(max(tx_queue_size, 1U)),
+			_jobs((Io_job **)env()->heap()->alloc(_num_jobs*sizeof(Io_job *))),
+			_head(0), _next(0), _tail(0),
+			_running(0), _running_write(false), _closing(false)
 		{
+			for (unsigned i = 0; i < _num_jobs; i++)
+				_jobs[i] = new (env()->heap()) Io_job;
+
 			/*
 			 * Register '_process_packets' dispatch function as signal
 			 * handler for packet-avail and ready-to-ack signals.
@@ -175,6 +266,20 @@ class File_system::Session_component : public Session_rpc_object
 		 */
 		~Session_component()
 		{
+			/* wait for the workers to release the packet buffer */
+			unsigned running = 0;
+			{
+				Lock::Guard guard(_completion_lock);
+				_closing = true;
+				running  = _running;
+			}
+			while (running--)
+				_drained.down();
+
+			for (unsigned i = 0; i < _num_jobs; i++)
+				destroy(env()->heap(), _jobs[i]);
+			env()->heap()->free(_jobs, _num_jobs*sizeof(Io_job *));
+
 			Dataspace_capability ds = tx_sink()->dataspace();
 			env()->ram_session()->free(static_cap_cast<Ram_dataspace>(ds));
 			destroy(&_md_alloc, &_root);
@@ -294,6 +399,9 @@ class File_system::Session_component : public Session_rpc_object
 			File *file = _handle_registry.lookup_and_lock(file_handle);
 			Node_lock_guard file_guard(*file);
 			file->truncate(size);
+
+			if (_cache)
+				_cache->invalidate(file->inode());
 		}
 
 		void move(Dir_handle, Name const &, Dir_handle, Name const &)
@@ -312,6 +420,23 @@ class File_system::Session_component : public Session_rpc_object
 		 * use-case.
 		 */
 		void sync() { PWRN("sync() not implemented!"); }
+
+		Dataspace_capability dataspace(File_handle file_handle,
+		                               file_size_t size, bool writeable)
+		{
+			if (writeable && !_writable)
+				throw Permission_denied();
+
+			File *file = _handle_registry.lookup_and_lock(file_handle);
+			Node_lock_guard file_guard(*file);
+			Dataspace_capability ds = file->dataspace(_ep.rpc_ep(), size, writeable);
+
+			/* modifications via the dataspace bypass the invalidation */
+			if (writeable && _cache)
+				_cache->exclude(file->inode());
+
+			return ds;
+		}
 };
 
 
@@ -320,6 +445,8 @@ class File_system::Root : public Root_component<Session_component>
 	private:
 
 		Server::Entrypoint &_ep;
+		Io_pool            &_pool;
+		Page_cache         *_cache;
 
 	protected:
 
@@ -381,6 +508,8 @@ class File_system::Root : public Root_component<Session_component>
 				Arg_string::find_arg(args, "ram_quota"  ).ulong_value(0);
 			size_t tx_buf_size =
 				Arg_string::find_arg(args, "tx_buf_size").ulong_value(0);
+			unsigned tx_queue_size =
+				Arg_string::find_arg(args, "tx_queue_size").ulong_value(Session::TX_QUEUE_SIZE);
 
 			/*
 			 * Check if donated ram quota suffices for session data,
@@ -393,7 +522,8 @@ class File_system::Root : public Root_component<Session_component>
 				throw Root::Quota_exceeded();
 			}
 			return new (md_alloc())
-				Session_component(tx_buf_size, _ep, root_dir, writeable, *md_alloc());
+				Session_component(tx_buf_size, tx_queue_size, _ep, root_dir,
+				                  writeable, *md_alloc(), _pool, _cache);
 		}
 
 	public:
@@ -405,11 +535,14 @@ class File_system::Root : public Root_component<Session_component>
 		 * \param sig_rec     signal receiver used for handling the
 		 *                    data-flow signals of packet streams
 		 * \param md_alloc    meta-data allocator
+		 * \param pool        workers performing the packet I/O
+		 * \param cache       cache of file content, or zero
 		 */
-		Root(Server::Entrypoint &ep, Allocator &md_alloc)
+		Root(Server::Entrypoint &ep, Allocator &md_alloc, Io_pool &pool,
+		     Page_cache *cache)
 		:
 			Root_component<Session_component>(&ep.rpc_ep(), &md_alloc),
-			_ep(ep)
+			_ep(ep), _pool(pool), _cache(cache)
 		{ }
 };
 
@@ -423,10 +556,57 @@ struct File_system::Main
 	 */
 	Sliced_heap sliced_heap = { env()->ram_session(), env()->rm_session() };
 
-	Root fs_root = { ep, sliced_heap };
+	static unsigned num_workers()
+	{
+		unsigned workers = 4;
+		try { config()->xml_node().attribute("workers").value(&workers); }
+		catch (...) { }
+		return workers;
+	}
+
+	Io_pool io_pool = { num_workers() };
+
+	/*
+	 * Cache of file content shared by all sessions
+	 *
+	 * Files are identified by their inode numbers. The cache is not
+	 * informed about modifications by other host processes.
+	 */
+	Lazy_volatile_object<Page_cache> cache;
+
+	static Page_cache *construct_cache(Lazy_volatile_object<Page_cache> &cache)
+	{
+		try {
+			Number_of_bytes size = 0;
+			config()->xml_node().sub_node("cache").attribute("size").value(&size);
+			cache.construct(*env()->heap(), size);
+			return cache.operator -> ();
+		} catch (...) { return 0; }
+	}
+
+	Root fs_root = { ep, sliced_heap, io_pool, construct_cache(cache) };
+
+	/*
+	 * Periodic report of the cache statistics
+	 */
+	Reporter                         reporter { "page_cache" };
+	Lazy_volatile_object<Timer::Connection> timer;
+	Signal_rpc_member<Main>          report_dispatcher = { ep, *this, &Main::handle_report };
+
+	void handle_report(unsigned) { cache->report(reporter); }
 
 	Main(Server::Entrypoint &ep) : ep(ep)
 	{
+		try {
+			if (cache.is_constructed() && config()->xml_node().sub_node("cache")
+			                              .attribute("report").has_value("yes")) {
+				reporter.enabled(true);
+				timer.construct();
+				timer->sigh(report_dispatcher);
+				timer->trigger_periodic(1000*1000);
+			}
+		} catch (...) { }
+
 		env()->parent()->announce(ep.manage(fs_root));
 	}
 };
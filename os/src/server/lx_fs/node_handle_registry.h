@@ -34,22 +34,73 @@ namespace File_system {
 	template<> struct Handle_type<Symlink>   { typedef Symlink_handle Type; };
 
 
+	/**
+	 * Table of node handles
+	 *
+	 * Slots are allocated in blocks, which stay at their place when the
+	 * table grows because each slot hosts a listener that is referenced by
+	 * the node. Released slots are kept in a free list, which makes the
+	 * allocation and lookup of handles independent of the number of open
+	 * handles.
+	 */
 	class Node_handle_registry
 	{
 		private:
 
 			/* maximum number of open nodes per session */
-			enum { MAX_NODE_HANDLES = 128U };
+			enum { MAX_NODE_HANDLES = 16384U };
+
+			enum { SLOTS_PER_BLOCK = 64U };
+
+			struct Slot
+			{
+				Node *node;
+
+				/**
+				 * Each open node handle can act as a listener to be
+				 * informed about node changes.
+				 */
+				Listener listener;
+
+				int next_free;
+			};
+
+			struct Slot_block { Slot slot[SLOTS_PER_BLOCK]; };
 
 			Lock mutable _lock;
 
-			Node *_nodes[MAX_NODE_HANDLES];
+			Slot_block **_blocks;
+			unsigned     _max_blocks;  /* capacity of '_blocks' */
+			unsigned     _num_slots;   /* slots used at least once */
+			int          _free;        /* head of free list */
+
+			Slot       &_slot(int i)       { return _blocks[i / SLOTS_PER_BLOCK]->slot[i % SLOTS_PER_BLOCK]; }
+			Slot const &_slot(int i) const { return _blocks[i / SLOTS_PER_BLOCK]->slot[i % SLOTS_PER_BLOCK]; }
 
 			/**
-			 * Each open node handle can act as a listener to be informed about
-			 * node changes.
+			 * Add block of slots, enlarge block array if needed
 			 */
-			Listener _listeners[MAX_NODE_HANDLES];
+			void _grow()
+			{
+				unsigned const num_blocks = _num_slots / SLOTS_PER_BLOCK;
+
+				if (num_blocks == _max_blocks) {
+					unsigned const max_blocks = max(2*_max_blocks, 4U);
+
+					Slot_block **blocks = (Slot_block **)
+						env()->heap()->alloc(max_blocks*sizeof(Slot_block *));
+					for (unsigned i = 0; i < num_blocks; i++)
+						blocks[i] = _blocks[i];
+
+					if (_blocks)
+						env()->heap()->free(_blocks, _max_blocks*sizeof(Slot_block *));
+
+					_blocks     = blocks;
+					_max_blocks = max_blocks;
+				}
+
+				_blocks[num_blocks] = new (env()->heap()) Slot_block;
+			}
 
 			/**
 			 * Allocate node handle
@@ -60,26 +111,54 @@ namespace File_system {
 			{
 				Lock::Guard guard(_lock);
 
-				for (unsigned i = 0; i < MAX_NODE_HANDLES; i++)
-					if (!_nodes[i]) {
-						_nodes[i] = node;
-						return i;
-					}
+				int i = _free;
+				if (i >= 0) {
+					_free = _slot(i).next_free;
+				} else {
+					if (_num_slots == MAX_NODE_HANDLES)
+						throw Out_of_node_handles();
 
-				throw Out_of_node_handles();
+					try {
+						if (_num_slots % SLOTS_PER_BLOCK == 0)
+							_grow();
+					} catch (Allocator::Out_of_memory) {
+						throw Out_of_node_handles(); }
+
+					i = _num_slots++;
+				}
+
+				_slot(i).node = node;
+				return i;
 			}
 
 			bool _in_range(int handle) const
 			{
-				return ((handle >= 0) && (handle < MAX_NODE_HANDLES));
+				return ((handle >= 0) && ((unsigned)handle < _num_slots));
+			}
+
+			Node *_node(int handle) const
+			{
+				return _in_range(handle) ? _slot(handle).node : 0;
 			}
 
 		public:
 
 			Node_handle_registry()
+			: _blocks(0), _max_blocks(0), _num_slots(0), _free(-1) { }
+
+			~Node_handle_registry()
 			{
-				for (unsigned i = 0; i < MAX_NODE_HANDLES; i++)
-					_nodes[i] = 0;
+				for (unsigned i = 0; i < _num_slots; i++) {
+					Slot &slot = _slot(i);
+					if (slot.node && slot.listener.valid())
+						slot.node->remove_listener(&slot.listener);
+				}
+
+				for (unsigned i = 0; i < (_num_slots + SLOTS_PER_BLOCK - 1) / SLOTS_PER_BLOCK; i++)
+					destroy(env()->heap(), _blocks[i]);
+
+				if (_blocks)
+					env()->heap()->free(_blocks, _max_blocks*sizeof(Slot_block *));
 			}
 
 			template <typename NODE_TYPE>
@@ -96,13 +175,10 @@ namespace File_system {
 			{
 				Lock::Guard guard(_lock);
 
-				if (!_in_range(handle.value))
-					return;
-
 				/*
 				 * Notify listeners about the changed file.
 				 */
-				Node *node = dynamic_cast<Node *>(_nodes[handle.value]);
+				Node *node = _node(handle.value);
 				if (!node) { return; }
 
 				node->lock();
@@ -111,13 +187,15 @@ namespace File_system {
 				/*
 				 * De-allocate handle
 				 */
-				Listener &listener = _listeners[handle.value];
+				Slot &slot = _slot(handle.value);
 
-				if (listener.valid())
-					node->remove_listener(&listener);
+				if (slot.listener.valid())
+					node->remove_listener(&slot.listener);
 
-				_nodes[handle.value] = 0;
-				listener = Listener();
+				slot.node      = 0;
+				slot.listener  = Listener();
+				slot.next_free = _free;
+				_free          = handle.value;
 
 				node->unlock();
 			}
@@ -134,11 +212,8 @@ namespace File_system {
 			{
 				Lock::Guard guard(_lock);
 
-				if (!_in_range(handle.value))
-					throw Invalid_handle();
-
 				typedef typename Node_type<HANDLE_TYPE>::Type Node;
-				Node *node = dynamic_cast<Node *>(_nodes[handle.value]);
+				Node *node = dynamic_cast<Node *>(_node(handle.value));
 				if (!node)
 					throw Invalid_handle();
 
@@ -155,7 +230,7 @@ namespace File_system {
 					throw Invalid_handle();
 				}
 
-				return _nodes[h1.value] == _nodes[h2.value];
+				return _slot(h1.value).node == _slot(h2.value).node;
 			}
 
 			/**
@@ -165,10 +240,7 @@ namespace File_system {
 			{
 				Lock::Guard guard(_lock);
 
-				if (!_in_range(handle.value))
-					throw Invalid_handle();
-
-				Node *node = dynamic_cast<Node *>(_nodes[handle.value]);
+				Node *node = _node(handle.value);
 				if (!node) {
 					PDBG("Invalid_handle");
 					throw Invalid_handle();
@@ -177,7 +249,7 @@ namespace File_system {
 				node->lock();
 				Node_lock_guard node_lock_guard(*node);
 
-				Listener &listener = _listeners[handle.value];
+				Listener &listener = _slot(handle.value).listener;
 
 				/*
 				 * If there was already a handler registered for the node,
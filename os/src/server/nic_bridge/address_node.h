@@ -15,7 +15,6 @@
 #define _ADDRESS_NODE_H_
 
 /* Genode */
-#include <util/avl_tree.h>
 #include <util/list.h>
 #include <nic_session/nic_session.h>
 #include <net/netaddress.h>
@@ -30,12 +29,11 @@ namespace Net {
 
 	/**
 	 * An Address_node encapsulates a session-component and can be hold in
-	 * a list and/or avl-tree, whereby the network-address (MAC or IP)
+	 * a list and/or hash table, whereby the network-address (MAC or IP)
 	 * acts as a key.
 	 */
 	template <unsigned LEN>
-	class Address_node : public Genode::Avl_node<Address_node<LEN> >,
-	                     public Genode::List<Address_node<LEN> >::Element
+	class Address_node : public Genode::List<Address_node<LEN> >::Element
 	{
 		public:
 
@@ -45,6 +43,7 @@ namespace Net {
 
 			Address            _addr;       /* MAC or IP address  */
 			Session_component *_component;  /* client's component */
+			Address_node      *_hash_next;  /* next node in bucket */
 
 		public:
 
@@ -55,7 +54,7 @@ namespace Net {
 			 * \param component  pointer to client's session component.
 			 */
 			Address_node(Address addr, Session_component *component)
-			: _addr(addr), _component(component) { }
+			: _addr(addr), _component(component), _hash_next(0) { }
 
 
 			/***************
@@ -66,33 +65,20 @@ namespace Net {
 			Session_component *component() { return _component; }
 
 
-			/************************
-			 ** Avl node interface **
-			 ************************/
-
-			bool higher(Address_node *c)
-			{
-				using namespace Genode;
-
-				return (memcmp(&c->_addr.addr, &_addr.addr,
-				               sizeof(_addr.addr)) > 0);
-			}
-
 			/**
-			 * Find by address
+			 * Return FNV-1a hash of address
 			 */
-			Address_node *find_by_address(Address addr)
+			static unsigned hash(Address const &addr)
 			{
-				using namespace Genode;
+				unsigned h = 2166136261U;
+				for (unsigned i = 0; i < LEN; i++)
+					h = (h ^ addr.addr[i]) * 16777619U;
+				return h;
+			}
 
-				if (addr == _addr)
-					return this;
+			Address_node *hash_next() const { return _hash_next; }
 
-				bool side = memcmp(&addr.addr, _addr.addr,
-				                   sizeof(_addr.addr)) > 0;
-				Address_node *c = Avl_node<Address_node>::child(side);
-				return c ? c->find_by_address(addr) : 0;
-			}
+			void hash_next(Address_node *node) { _hash_next = node; }
 	};
 
 
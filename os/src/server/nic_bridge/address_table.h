@@ -0,0 +1,89 @@
+/*
+ * \brief  Thread-safe hash table of address nodes
+ * \author Genode Labs
+ * \date   2014-01-20
+ */
+
+/*
+ * Copyright (C) 2014 Genode Labs GmbH
+ *
+ * This file is part of the Genode OS framework, which is distributed
+ * under the terms of the GNU General Public License version 2.
+ */
+
+#ifndef _ADDRESS_TABLE_H_
+#define _ADDRESS_TABLE_H_
+
+/* Genode */
+#include <base/lock.h>
+#include <base/lock_guard.h>
+
+/**
+ * Lock-guarded hash table with chained buckets
+ *
+ * The lookup cost is independent of the number of clients as long as the
+ * number of clients stays in the order of the number of buckets.
+ */
+template <typename NT, unsigned BUCKETS_LOG2 = 8>
+class Address_table
+{
+	private:
+
+		enum { BUCKETS = 1 << BUCKETS_LOG2 };
+
+		Genode::Lock _lock;
+		NT          *_bucket[BUCKETS];
+
+		static unsigned _index(typename NT::Address const &addr) {
+			return NT::hash(addr) & (BUCKETS - 1); }
+
+	public:
+
+		Address_table() { Genode::memset(_bucket, 0, sizeof(_bucket)); }
+
+		void insert(NT *node)
+		{
+			Genode::Lock::Guard lock_guard(_lock);
+
+			NT *&head = _bucket[_index(node->addr())];
+			node->hash_next(head);
+			head = node;
+		}
+
+		void remove(NT *node)
+		{
+			Genode::Lock::Guard lock_guard(_lock);
+
+			NT *prev = 0;
+			NT *&head = _bucket[_index(node->addr())];
+			for (NT *n = head; n; prev = n, n = n->hash_next()) {
+				if (n != node)
+					continue;
+
+				if (prev)
+					prev->hash_next(n->hash_next());
+				else
+					head = n->hash_next();
+
+				node->hash_next(0);
+				return;
+			}
+		}
+
+		/**
+		 * Find node by address
+		 *
+		 * \return  node, or 0 if no node matches the address
+		 */
+		NT *find(typename NT::Address const &addr)
+		{
+			Genode::Lock::Guard lock_guard(_lock);
+
+			for (NT *n = _bucket[_index(addr)]; n; n = n->hash_next())
+				if (n->addr() == addr)
+					return n;
+			return 0;
+		}
+};
+
+#endif /* _ADDRESS_TABLE_H_ */
@@ -44,9 +44,7 @@ bool Session_component::handle_arp(Ethernet_frame *eth, Genode::size_t size)
 		 if (arp->src_ip() == arp->dst_ip())
 			return false;
 
-		Ipv4_address_node *node = Env::vlan()->ip_tree()->first();
-		if (node)
-			node = node->find_by_address(arp->dst_ip());
+		Ipv4_address_node *node = Env::vlan()->ip_table()->find(arp->dst_ip());
 		if (!node) {
 			arp->src_mac(Net::Env::nic()->mac());
 		}
@@ -80,15 +78,13 @@ bool Session_component::handle_ip(Ethernet_frame *eth, Genode::size_t size)
 void Session_component::finalize_packet(Ethernet_frame *eth,
                                                     Genode::size_t size)
 {
-	Mac_address_node *node = Env::vlan()->mac_tree()->first();
+	Mac_address_node *node = Env::vlan()->mac_table()->find(eth->dst());
 	if (node)
-		node = node->find_by_address(eth->dst());
-	if (node)
-		node->component()->send(eth, size);
+		node->component()->send(eth, size, _current_packet());
 	else {
 		/* set our MAC as sender */
 		eth->src(Net::Env::nic()->mac());
-		Net::Env::nic()->send(eth, size);
+		Net::Env::nic()->send(eth, size, _current_packet());
 	}
 }
 
@@ -96,7 +92,7 @@ void Session_component::finalize_packet(Ethernet_frame *eth,
 void Session_component::_free_ipv4_node()
 {
 	if (_ipv4_node) {
-		Env::vlan()->ip_tree()->remove(_ipv4_node);
+		Env::vlan()->ip_table()->remove(_ipv4_node);
 		destroy(this->guarded_allocator(), _ipv4_node);
 	}
 }
@@ -107,7 +103,7 @@ void Session_component::set_ipv4_address(Ipv4_packet::Ipv4_address ip_addr)
 	_free_ipv4_node();
 	_ipv4_node = new (this->guarded_allocator())
 		Ipv4_address_node(ip_addr, this);
-	Net::Env::vlan()->ip_tree()->insert(_ipv4_node);
+	Net::Env::vlan()->ip_table()->insert(_ipv4_node);
 }
 
 
@@ -117,16 +113,19 @@ Session_component::Session_component(Genode::Allocator          *allocator,
                                      Genode::size_t              rx_buf_size,
                                      Ethernet_frame::Mac_address vmac,
                                      Genode::Rpc_entrypoint     &ep,
+                                     unsigned                    offload,
                                      char                       *ip_addr)
-: Guarded_range_allocator(allocator, amount),
+: Guarded_range_allocator(allocator, amount,
+                          offload & ::Nic::Packet_descriptor::GSO_TCPV4),
   Tx_rx_communication_buffers(tx_buf_size, rx_buf_size),
   Session_rpc_object(Tx_rx_communication_buffers::tx_ds(),
                      Tx_rx_communication_buffers::rx_ds(),
-                     this->range_allocator(), ep),
+                     this->range_allocator(), ep,
+                     ::Nic::Session::DEFAULT_MTU, offload),
   _mac_node(vmac, this),
   _ipv4_node(0)
 {
-	Env::vlan()->mac_tree()->insert(&_mac_node);
+	Env::vlan()->mac_table()->insert(&_mac_node);
 	Env::vlan()->mac_list()->insert(&_mac_node);
 
 	/* static ip parsing */
@@ -154,7 +153,7 @@ Session_component::Session_component(Genode::Allocator          *allocator,
 
 
 Session_component::~Session_component() {
-	Env::vlan()->mac_tree()->remove(&_mac_node);
+	Env::vlan()->mac_table()->remove(&_mac_node);
 	Env::vlan()->mac_list()->remove(&_mac_node);
 	_free_ipv4_node();
 }
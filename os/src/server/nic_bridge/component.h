@@ -23,6 +23,7 @@
 #include <nic_session/connection.h>
 #include <net/ipv4.h>
 #include <base/allocator_guard.h>
+#include <base/allocator_avl.h>
 #include <os/session_policy.h>
 
 #include "address_node.h"
@@ -34,26 +35,39 @@ namespace Net {
 	/**
 	 * Helper class.
 	 *
+	 * Packets of sessions that accept large segments exceed the fixed
+	 * packet size of the 'Nic::Packet_allocator'. Their buffers are
+	 * managed by an AVL-based allocator instead.
 	 */
 	class Guarded_range_allocator
 	{
 		private:
 
 			Genode::Allocator_guard _guarded_alloc;
-			::Nic::Packet_allocator _range_alloc;
+			::Nic::Packet_allocator _packet_alloc;
+			Genode::Allocator_avl   _avl_alloc;
+			bool const              _large_packets;
 
 		public:
 
 			Guarded_range_allocator(Genode::Allocator *backing_store,
-			                        Genode::size_t     amount)
+			                        Genode::size_t     amount,
+			                        bool               large_packets)
 			: _guarded_alloc(backing_store, amount),
-			  _range_alloc(&_guarded_alloc) {}
+			  _packet_alloc(&_guarded_alloc),
+			  _avl_alloc(&_guarded_alloc),
+			  _large_packets(large_packets) {}
 
 			Genode::Allocator_guard *guarded_allocator() {
 				return &_guarded_alloc; }
 
-			Genode::Range_allocator *range_allocator() {
-				return static_cast<Genode::Range_allocator *>(&_range_alloc); }
+			Genode::Range_allocator *range_allocator()
+			{
+				if (_large_packets)
+					return &_avl_alloc;
+
+				return static_cast<Genode::Range_allocator *>(&_packet_alloc);
+			}
 	};
 
 
@@ -118,6 +132,7 @@ namespace Net {
 			 * \param rx_buf_size  buffer size for rx channel
 			 * \param vmac         virtual mac address
 			 * \param ep           entry point used for packet stream
+			 * \param offload      offload flags accepted for the session
 			 */
 			Session_component(Genode::Allocator          *allocator,
 			                  Genode::size_t              amount,
@@ -125,6 +140,7 @@ namespace Net {
 			                  Genode::size_t              rx_buf_size,
 			                  Ethernet_frame::Mac_address vmac,
 			                  Genode::Rpc_entrypoint     &ep,
+			                  unsigned                    offload,
 			                  char                       *ip_addr = 0);
 
 			~Session_component();
@@ -149,6 +165,8 @@ namespace Net {
 			Packet_stream_source< ::Nic::Session::Policy> * source() {
 				return _rx.source(); }
 
+			unsigned peer_offload() { return offload(); }
+
 			bool handle_arp(Ethernet_frame *eth,      Genode::size_t size);
 			bool handle_ip(Ethernet_frame *eth,       Genode::size_t size);
 			void finalize_packet(Ethernet_frame *eth, Genode::size_t size);
@@ -197,6 +215,18 @@ namespace Net {
 				size_t rx_buf_size =
 					Arg_string::find_arg(args, "rx_buf_size").ulong_value(0);
 
+				/*
+				 * Frames between clients never reach a wire, so we accept
+				 * all offloads and complete them only when forwarding to
+				 * a receiver that does not accept them.
+				 */
+				typedef ::Nic::Packet_descriptor Packet;
+				unsigned offload =
+					Arg_string::find_arg(args, "offload").ulong_value(0) &
+					(Packet::CSUM_PARTIAL | Packet::GSO_TCPV4);
+				if (!(offload & Packet::CSUM_PARTIAL))
+					offload &= ~Packet::GSO_TCPV4;
+
 				/* delete ram quota by the memory needed for the session */
 				size_t session_size = max((size_t)4096, sizeof(Session_component));
 				if (ram_quota < session_size)
@@ -222,6 +252,7 @@ namespace Net {
 					                                          rx_buf_size,
 					                                          _mac_alloc.alloc(),
 					                                          _ep,
+					                                          offload,
 					                                          ip_addr);
 				} catch(Mac_allocator::Alloc_failed) {
 					PWRN("Mac address allocation failed!");
@@ -37,6 +37,7 @@ class Net::Nic : public Net::Packet_handler
 		::Nic::Packet_allocator     _tx_block_alloc;
 		::Nic::Connection           _nic;
 		Ethernet_frame::Mac_address _mac;
+		unsigned                    _offload;  /* accepted by the uplink */
 
 	public:
 
@@ -56,6 +57,8 @@ class Net::Nic : public Net::Packet_handler
 		Packet_stream_source< ::Nic::Session::Policy> * source() {
 			return _nic.tx(); }
 
+		unsigned peer_offload() { return _offload; }
+
 		bool handle_arp(Ethernet_frame *eth,      Genode::size_t size);
 		bool handle_ip(Ethernet_frame *eth,       Genode::size_t size);
 		void finalize_packet(Ethernet_frame *eth, Genode::size_t size) {}
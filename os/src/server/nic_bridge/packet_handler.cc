@@ -12,6 +12,7 @@
  */
 
 #include <base/lock.h>
+#include <nic/offload.h>
 #include <net/arp.h>
 #include <net/dhcp.h>
 #include <net/ethernet.h>
@@ -29,19 +30,61 @@ static const bool verbose = true;
 
 void Packet_handler::_ready_to_submit(unsigned)
 {
+	::Nic::Packet_descriptor batch[RX_BATCH];
+
 	/* as long as packets are available, and we can ack them */
-	while (sink()->packet_avail()) {
-		_packet = sink()->get_packet();
-		if (!_packet.valid()) continue;
-		handle_ethernet(sink()->packet_content(_packet), _packet.size());
-
-		if (!sink()->ready_to_ack()) {
-			if (verbose)
-				PWRN("ack state FULL");
+	for (;;) {
+		unsigned const max = Genode::min((unsigned)RX_BATCH,
+		                                 sink()->ack_slots_free());
+		unsigned num = 0;
+		while (num < max && sink()->packet_avail())
+			batch[num++] = sink()->get_packet();
+
+		if (!num)
 			return;
+
+		for (unsigned i = 0; i < num; i++) {
+			_packet = batch[i];
+
+			/* ignore offloads not negotiated for the session */
+			_packet.restrict_offload(peer_offload());
+
+			if (_packet.valid())
+				handle_ethernet(sink()->packet_content(_packet), _packet.size());
 		}
 
-		sink()->acknowledge_packet(_packet);
+		for (unsigned i = 0; i < num; i++)
+			if (batch[i].valid())
+				sink()->acknowledge_packet(batch[i]);
+	}
+}
+
+
+void Packet_handler::submit(::Nic::Packet_descriptor const &packet)
+{
+	/* preserve the order of packets already queued */
+	if (!_backlog_count && source()->ready_to_submit()) {
+		source()->submit_packet(packet);
+		return;
+	}
+
+	if (_backlog_count == BACKLOG_SIZE) {
+		if (verbose)
+			PWRN("Packet dropped");
+		source()->release_packet(packet);
+		return;
+	}
+
+	_backlog[(_backlog_head + _backlog_count++) % BACKLOG_SIZE] = packet;
+}
+
+
+void Packet_handler::_flush_backlog()
+{
+	while (_backlog_count && source()->ready_to_submit()) {
+		source()->submit_packet(_backlog[_backlog_head]);
+		_backlog_head = (_backlog_head + 1) % BACKLOG_SIZE;
+		_backlog_count--;
 	}
 }
 
@@ -63,7 +106,7 @@ void Packet_handler::broadcast_to_clients(Ethernet_frame *eth, Genode::size_t si
 			Env::vlan()->mac_list()->first();
 		while (node) {
 			/* deliver packet */
-			node->component()->send(eth, size);
+			node->component()->send(eth, size, _packet);
 			node = node->next();
 		}
 	}
@@ -102,15 +145,69 @@ void Packet_handler::handle_ethernet(void* src, Genode::size_t size)
 }
 
 
-void Packet_handler::send(Ethernet_frame *eth, Genode::size_t size)
+namespace Net {
+
+	typedef Packet_stream_source< ::Nic::Session::Policy> Packet_source;
+
+	/**
+	 * Allocator of segments within the packet-stream source of a handler
+	 */
+	class Segment_alloc : public ::Nic::Segment_alloc
+	{
+		private:
+
+			Packet_handler          &_handler;
+			::Nic::Packet_descriptor _packet;
+
+		public:
+
+			Segment_alloc(Packet_handler &handler) : _handler(handler) { }
+
+			char *alloc(Genode::size_t size)
+			{
+				try {
+					_packet = _handler.source()->alloc_packet(size);
+					return _handler.source()->packet_content(_packet);
+				} catch (Packet_source::Packet_alloc_failed) {
+					return 0;
+				}
+			}
+
+			void submit() { _handler.submit(_packet); }
+	};
+}
+
+
+void Packet_handler::send(Ethernet_frame *eth, Genode::size_t size,
+                          ::Nic::Packet_descriptor const &meta)
 {
+	typedef ::Nic::Packet_descriptor Packet;
+
+	unsigned const offload  = meta.offload();
+	unsigned const accepted = peer_offload();
+
+	/* split large segment if the receiver cannot handle it */
+	if ((offload & Packet::GSO_TCPV4) && !(accepted & Packet::GSO_TCPV4)) {
+		Segment_alloc alloc(*this);
+		if (!::Nic::segment_tcpv4((char *)eth, size, meta, alloc) && verbose)
+			PWRN("Segmentation failed, packet dropped");
+		return;
+	}
+
 	try {
 		/* copy and submit packet */
-		Packet_descriptor packet  = source()->alloc_packet(size);
-		char             *content = source()->packet_content(packet);
+		Packet packet  = source()->alloc_packet(size);
+		char  *content = source()->packet_content(packet);
 		Genode::memcpy((void*)content, (void*)eth, size);
-		source()->submit_packet(packet);
-	} catch(Packet_stream_source< ::Nic::Session::Policy>::Packet_alloc_failed) {
+
+		/* complete checksum if the receiver cannot handle it */
+		if ((offload & Packet::CSUM_PARTIAL) && !(accepted & Packet::CSUM_PARTIAL))
+			::Nic::complete_checksum(content, size, meta);
+		else
+			packet.offload(meta);
+
+		submit(packet);
+	} catch(Packet_source::Packet_alloc_failed) {
 		if (verbose)
 			PWRN("Packet dropped");
 	}
@@ -118,7 +215,8 @@ void Packet_handler::send(Ethernet_frame *eth, Genode::size_t size)
 
 
 Packet_handler::Packet_handler()
-: _sink_ack(*Net::Env::receiver(), *this, &Packet_handler::_ack_avail),
+: _backlog_head(0), _backlog_count(0),
+  _sink_ack(*Net::Env::receiver(), *this, &Packet_handler::_ack_avail),
   _sink_submit(*Net::Env::receiver(), *this, &Packet_handler::_ready_to_submit),
   _source_ack(*Net::Env::receiver(), *this, &Packet_handler::_ready_to_ack),
   _source_submit(*Net::Env::receiver(), *this, &Packet_handler::_packet_avail)
@@ -30,9 +30,31 @@ namespace Net {
  */
 class Net::Packet_handler
 {
+	public:
+
+		enum {
+			RX_BATCH     = 32,  /* packets handled per iteration          */
+			BACKLOG_SIZE = 64,  /* packets waiting for the receiver's queue */
+		};
+
 	private:
 
-		Packet_descriptor _packet;
+		::Nic::Packet_descriptor _packet;
+
+		/*
+		 * Packets for the receiver of 'source()' that did not fit into its
+		 * submit queue. Queueing them instead of blocking in
+		 * 'submit_packet' prevents a slow receiver from stalling the
+		 * forwarding for all others.
+		 */
+		::Nic::Packet_descriptor _backlog[BACKLOG_SIZE];
+		unsigned                 _backlog_head;
+		unsigned                 _backlog_count;
+
+		/**
+		 * Submit queued packets as far as the submit queue permits
+		 */
+		void _flush_backlog();
 
 		/**
 		 * submit queue not empty anymore
@@ -42,10 +64,10 @@ class Net::Packet_handler
 		/**
 		 * acknoledgement queue not full anymore
 		 *
-		 * TODO: by now, we assume ACK and SUBMIT queue to be equally
-		 *       dimensioned. That's why we ignore this signal by now.
+		 * Packets are only fetched as long as they can be acknowledged,
+		 * so we resume the handling of pending packets.
 		 */
-		void _ack_avail(unsigned) { }
+		void _ack_avail(unsigned) { _ready_to_submit(0); }
 
 		/**
 		 * acknoledgement queue not empty anymore
@@ -54,11 +76,8 @@ class Net::Packet_handler
 
 		/**
 		 * submit queue not full anymore
-		 *
-		 * TODO: by now, we just drop packets that cannot be transferred
-		 *       to the other side, that's why we ignore this signal.
 		 */
-		void _packet_avail(unsigned) { }
+		void _packet_avail(unsigned) { _flush_backlog(); }
 
 	protected:
 
@@ -67,6 +86,12 @@ class Net::Packet_handler
 		Genode::Signal_dispatcher<Packet_handler> _source_ack;
 		Genode::Signal_dispatcher<Packet_handler> _source_submit;
 
+		/**
+		 * Return descriptor of the packet currently handled
+		 */
+		::Nic::Packet_descriptor const &_current_packet() const {
+			return _packet; }
+
 	public:
 
 		Packet_handler();
@@ -74,6 +99,11 @@ class Net::Packet_handler
 		virtual Packet_stream_sink< ::Nic::Session::Policy>   * sink()   = 0;
 		virtual Packet_stream_source< ::Nic::Session::Policy> * source() = 0;
 
+		/**
+		 * Return offload flags accepted by the receiver of 'source()'
+		 */
+		virtual unsigned peer_offload() = 0;
+
 
 		/**
 		 * Broadcasts ethernet frame to all clients,
@@ -85,13 +115,25 @@ class Net::Packet_handler
 		void inline broadcast_to_clients(Ethernet_frame *eth,
 		                                 Genode::size_t size);
 
+		/**
+		 * Submit packet allocated from 'source()'
+		 *
+		 * If the submit queue of the receiver is full, the packet is
+		 * queued until the receiver makes progress. If the backlog is
+		 * full as well, the packet is dropped.
+		 */
+		void submit(::Nic::Packet_descriptor const &packet);
+
 		/**
 		 * Send ethernet frame
 		 *
 		 * \param eth   ethernet frame to send.
 		 * \param size  ethernet frame's size.
+		 * \param meta  offload information of the frame, offloads not
+		 *              accepted by the receiver are completed in software
 		 */
-		void send(Ethernet_frame *eth, Genode::size_t size);
+		void send(Ethernet_frame *eth, Genode::size_t size,
+		          ::Nic::Packet_descriptor const &meta = ::Nic::Packet_descriptor());
 
 		/**
 		 * Handle an ethernet packet
@@ -92,6 +92,12 @@ namespace Nic {
 						               _tx.sink()->packet_content(packet_from_client),
 						               packet_size);
 
+						/*
+						 * The packet never leaves the loop, so offloaded work
+						 * is not performed but handed back to the client.
+						 */
+						packet_to_client.offload(packet_from_client);
+
 						_rx.source()->submit_packet(packet_to_client);
 
 					} catch (Session::Rx::Source::Packet_alloc_failed) {
@@ -120,18 +126,23 @@ namespace Nic {
 			 *                           rx block allocator
 			 * \param ep                 entry point used for packet stream
 			 *                           channels
+			 * \param mtu                maximum transmission unit
+			 * \param offload            accepted offload flags
 			 */
 			Session_component(Genode::size_t          tx_buf_size,
 			                  Genode::size_t          rx_buf_size,
 			                  Genode::Allocator      *rx_block_md_alloc,
-			                  Genode::Rpc_entrypoint &ep)
+			                  Genode::Rpc_entrypoint &ep,
+			                  Genode::size_t          mtu,
+			                  unsigned                offload)
 			:
 				Genode::Allocator_avl(rx_block_md_alloc),
 				Tx_rx_communication_buffers(tx_buf_size, rx_buf_size),
 				Thread("nic_packet_handler"),
 				Session_rpc_object(Tx_rx_communication_buffers::tx_ds(),
 				                   Tx_rx_communication_buffers::rx_ds(),
-				                   static_cast<Genode::Range_allocator *>(this), ep)
+				                   static_cast<Genode::Range_allocator *>(this), ep,
+				                   mtu, offload)
 			{
 				/* start packet-handling thread */
 				start();
@@ -159,6 +170,15 @@ namespace Nic {
 				size_t ram_quota   = Arg_string::find_arg(args, "ram_quota"  ).ulong_value(0);
 				size_t tx_buf_size = Arg_string::find_arg(args, "tx_buf_size").ulong_value(0);
 				size_t rx_buf_size = Arg_string::find_arg(args, "rx_buf_size").ulong_value(0);
+				size_t mtu         = Arg_string::find_arg(args, "mtu").ulong_value(Session::DEFAULT_MTU);
+
+				/* the loop-back device does not restrict the MTU on its own */
+				mtu = max((size_t)Session::MIN_MTU, min(mtu, (size_t)Session::MAX_MTU));
+
+				/* all offloads are accepted as packets never reach a wire */
+				unsigned offload = Arg_string::find_arg(args, "offload").ulong_value(0)
+				                 & (Packet_descriptor::CSUM_PARTIAL
+				                  | Packet_descriptor::GSO_TCPV4);
 
 				/* deplete ram quota by the memory needed for the session structure */
 				size_t session_size = max(4096UL, (unsigned long)sizeof(Session_component));
@@ -179,7 +199,8 @@ namespace Nic {
 				}
 
 				return new (md_alloc()) Session_component(tx_buf_size, rx_buf_size,
-				                                          env()->heap(), _channel_ep);
+				                                          env()->heap(), _channel_ep,
+				                                          mtu, offload);
 			}
 
 		public:
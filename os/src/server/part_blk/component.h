@@ -16,7 +16,9 @@
 
 #include <base/exception.h>
 #include <root/component.h>
+#include <util/fifo.h>
 #include <block_session/rpc_object.h>
+#include <block/scheduler.h>
 
 #include "partition_table.h"
 
@@ -30,7 +32,7 @@ namespace Block {
 
 
 class Block::Session_component : public Block::Session_rpc_object,
-                                 public List<Block::Session_component>::Element,
+                                 public Fifo<Block::Session_component>::Element,
                                  public Block_dispatcher
 {
 	private:
@@ -42,9 +44,14 @@ class Block::Session_component : public Block::Session_rpc_object,
 		Signal_dispatcher<Session_component> _sink_submit;
 		bool                                 _req_queue_full;
 		bool                                 _ack_queue_full;
-		Packet_descriptor                    _p_to_handle;
 		unsigned                             _p_in_fly;
 
+		/*
+		 * Requests of the client, adjacent requests are forwarded to the
+		 * back end as one request
+		 */
+		Scheduler                            _scheduler;
+
 		/**
 		 * Acknowledge a packet already handled
 		 */
@@ -64,29 +71,40 @@ class Block::Session_component : public Block::Session_rpc_object,
 			return p.block_number() + p.block_count() <= _partition->sectors; }
 
 		/**
-		 * Handle a single request
+		 * Queue a single request
 		 */
 		void _handle_packet(Packet_descriptor packet)
 		{
-			_p_to_handle = packet;
-			_p_to_handle.succeeded(false);
+			packet.succeeded(false);
 
 			/* ignore invalid packets */
-			if (!packet.valid() || !_range_check(_p_to_handle)) {
-				_ack_packet(_p_to_handle);
+			if (!packet.valid() || !_range_check(packet)) {
+				_ack_packet(packet);
 				return;
 			}
 
-			bool write   = _p_to_handle.operation() == Packet_descriptor::WRITE;
-			sector_t off = _p_to_handle.block_number() + _partition->lba;
-			size_t cnt   = _p_to_handle.block_count();
-			void* addr   = tx_sink()->packet_content(_p_to_handle);
+			_scheduler.enqueue(Scheduler::Request(packet,
+			                                      tx_sink()->packet_content(packet)));
+		}
+
+		/**
+		 * Forward a batch of requests to the back end
+		 *
+		 * \return  false if the back end is congested
+		 */
+		bool _forward(Scheduler::Batch batch, Scheduler::Request const &r)
+		{
+			bool write   = r.packet.operation() == Packet_descriptor::WRITE;
+			sector_t off = r.packet.block_number() + _partition->lba;
+			size_t cnt   = r.packet.block_count();
 			try {
-				Driver::driver().io(write, off, cnt, addr, *this, _p_to_handle);
+				Driver::driver().io(write, off, cnt, *this, batch);
 			} catch (Block::Session::Tx::Source::Packet_alloc_failed) {
 				_req_queue_full = true;
-				Session_component::wait_queue().insert(this);
+				Session_component::wait_queue().enqueue(this);
+				return false;
 			}
+			return true;
 		}
 
 		/**
@@ -98,13 +116,21 @@ class Block::Session_component : public Block::Session_rpc_object,
 
 			/*
 			 * as long as more packets are available, and we're able to ack
-			 * them, and the driver's request queue isn't full,
-			 * direct the packet request to the driver backend
+			 * them, take them out of the submit queue
 			 */
-			for (; !_req_queue_full && tx_sink()->packet_avail() &&
+			for (; !_scheduler.full() && tx_sink()->packet_avail() &&
 					 !_ack_queue_full; _p_in_fly++,
 					 _ack_queue_full = _p_in_fly >= tx_sink()->ack_slots_free())
 					_handle_packet(tx_sink()->get_packet());
+
+			/*
+			 * as long as the driver's request queue isn't full,
+			 * direct the packet requests to the driver backend
+			 */
+			while (!_req_queue_full
+			    && _scheduler.dispatch([&] (Scheduler::Batch batch,
+			                                Scheduler::Request const &r) {
+			           return _forward(batch, r); }));
 		}
 
 		/**
@@ -119,6 +145,7 @@ class Block::Session_component : public Block::Session_rpc_object,
 		 */
 		Session_component(Ram_dataspace_capability  rq_ds,
 		                  Partition                *partition,
+		                  Scheduler::Policy const  &policy,
 		                  Rpc_entrypoint           &ep,
 		                  Signal_receiver          &receiver)
 		: Session_rpc_object(rq_ds, ep),
@@ -129,43 +156,78 @@ class Block::Session_component : public Block::Session_rpc_object,
 		  _sink_submit(receiver, *this, &Session_component::_packet_avail),
 		  _req_queue_full(false),
 		  _ack_queue_full(false),
-		  _p_in_fly(0)
+		  _p_in_fly(0),
+		  _scheduler(Driver::driver().blk_size(), policy, false)
 		{
 			_tx.sigh_ready_to_ack(_sink_ack);
 			_tx.sigh_packet_avail(_sink_submit);
 		}
 
+		~Session_component()
+		{
+			Driver::driver().remove(*this);
+			wait_queue().remove(this);
+		}
+
 		Partition *partition() { return _partition; }
 
-		void dispatch(Packet_descriptor &request, Packet_descriptor &reply)
+		void fill(unsigned batch, void *dst)
 		{
-			if (request.operation() == Block::Packet_descriptor::READ) {
-				void *src =
-					Driver::driver().session().tx()->packet_content(reply);
-				Genode::size_t sz =
-					request.block_count() * Driver::driver().blk_size();
-				Genode::memcpy(tx_sink()->packet_content(request), src, sz);
-			}
-			request.succeeded(true);
-			_ack_packet(request);
+			size_t const blk_size = Driver::driver().blk_size();
+			char *d = (char *)dst;
+
+			_scheduler.for_each_member(batch, [&] (Scheduler::Request &r) {
+				size_t const sz = r.packet.block_count() * blk_size;
+				Genode::memcpy(d, r.buffer, sz);
+				d += sz;
+			});
+		}
+
+		void dispatch(unsigned batch, Packet_descriptor &reply)
+		{
+			size_t const blk_size = Driver::driver().blk_size();
+			char *src = (char *)
+				Driver::driver().session().tx()->packet_content(reply);
+
+			_scheduler.complete(batch, [&] (Scheduler::Request &r) {
+				size_t const sz = r.packet.block_count() * blk_size;
+				if (r.packet.operation() == Block::Packet_descriptor::READ
+				 && reply.succeeded())
+					Genode::memcpy(r.buffer, src, sz);
+				src += sz;
+
+				r.packet.succeeded(reply.succeeded());
+				_ack_packet(r.packet);
+			});
 
 			if (_ack_queue_full)
 				_packet_avail(0);
 		}
 
-		static List<Session_component>& wait_queue()
+		/**
+		 * Sessions waiting for resources of the back-end session
+		 */
+		static Fifo<Session_component>& wait_queue()
 		{
-			static List<Session_component> l;
-			return l;
+			static Fifo<Session_component> q;
+			return q;
 		}
 
+		/**
+		 * Resume waiting sessions in the order they started waiting
+		 *
+		 * A session that still exceeds its share is enqueued again at the
+		 * end of the queue, so each session is visited once per call.
+		 */
 		static void wake_up()
 		{
-			for (Session_component *c = wait_queue().first(); c; c = c->next())
-			{
-				wait_queue().remove(c);
+			unsigned waiting = 0;
+			for (Session_component *c = wait_queue().head(); c; c = c->next())
+				waiting++;
+
+			for (; waiting; waiting--) {
+				Session_component *c = wait_queue().dequeue();
 				c->_req_queue_full = false;
-				c->_handle_packet(c->_p_to_handle);
 				c->_packet_avail(0);
 			}
 		}
@@ -195,8 +257,27 @@ class Block::Root :
 {
 	private:
 
-		Rpc_entrypoint  &_ep;
-		Signal_receiver &_receiver;
+		Rpc_entrypoint    &_ep;
+		Signal_receiver   &_receiver;
+		Scheduler::Policy  _policy;
+
+		/*
+		 * Sessions are destroyed by the main thread, which executes the
+		 * signal handlers operating on the driver and the wait queue
+		 */
+		Session_component       *_destroy_pending;
+		Lock                     _destroyed;
+		Signal_dispatcher<Root>  _destroy_dispatcher;
+
+		void _handle_destroy(unsigned)
+		{
+			if (!_destroy_pending)
+				return;
+
+			Root_component::_destroy_session(_destroy_pending);
+			_destroy_pending = 0;
+			_destroyed.unlock();
+		}
 
 		long _partition_num(const char *session_label)
 		{
@@ -275,7 +356,18 @@ class Block::Root :
 			return new (md_alloc())
 				Session_component(ds_cap,
 				                  Partition_table::table().partition(num),
-				                  _ep, _receiver);
+				                  _policy, _ep, _receiver);
+		}
+
+		/**
+		 * Hand the session over to the main thread and wait until it is
+		 * destroyed
+		 */
+		void _destroy_session(Session_component *session)
+		{
+			_destroy_pending = session;
+			Signal_transmitter(_destroy_dispatcher).submit();
+			_destroyed.lock();
 		}
 
 	public:
@@ -285,8 +377,21 @@ class Block::Root :
 		:
 			Root_component(session_ep, md_alloc),
 			_ep(*session_ep),
-			_receiver(receiver)
-		{ }
+			_receiver(receiver),
+			_policy(128*1024, 16),
+			_destroy_pending(0),
+			_destroyed(Lock::LOCKED),
+			_destroy_dispatcher(receiver, *this, &Root::_handle_destroy)
+		{
+			try {
+				Xml_node config = Genode::config()->xml_node();
+				Number_of_bytes max_transfer = _policy.max_transfer;
+				try { config.attribute("max_transfer").value(&max_transfer); } catch (...) { }
+				try { config.attribute("deadline").value(&_policy.deadline); } catch (...) { }
+				_policy.max_transfer = min((size_t)max_transfer,
+				                           (size_t)Driver::BULK_SIZE);
+			} catch (...) { }
+		}
 };
 
 #endif /* _PART_BLK__COMPONENT_H_ */
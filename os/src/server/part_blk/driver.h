@@ -17,8 +17,7 @@
 #include <base/env.h>
 #include <base/allocator_avl.h>
 #include <base/signal.h>
-#include <base/tslab.h>
-#include <util/list.h>
+#include <util/bit_allocator.h>
 #include <block_session/connection.h>
 
 namespace Block {
@@ -29,75 +28,130 @@ namespace Block {
 
 class Block::Block_dispatcher
 {
+	private:
+
+		friend class Driver;
+
+		/*
+		 * Share of the back-end session occupied by the dispatcher,
+		 * accounted by the driver
+		 */
+		Genode::size_t _bulk_in_use;
+		unsigned       _requests;
+
 	public:
 
-		virtual void dispatch(Packet_descriptor&, Packet_descriptor&) = 0;
-};
+		Block_dispatcher() : _bulk_in_use(0), _requests(0) { }
 
+		virtual ~Block_dispatcher() { }
 
-bool operator== (const Block::Packet_descriptor& p1,
-                 const Block::Packet_descriptor& p2)
-{
-	return p1.operation()    == p2.operation()    &&
-	       p1.block_number() == p2.block_number() &&
-	       p1.block_count()  == p2.block_count();
-}
+		/**
+		 * Copy the payload of a write request into the back-end packet
+		 */
+		virtual void fill(unsigned request, void *dst) = 0;
+
+		/**
+		 * Complete request with the reply of the back-end session
+		 */
+		virtual void dispatch(unsigned request, Packet_descriptor &reply) = 0;
+};
 
 
 class Block::Driver
 {
 	public:
 
-	class Request : public Genode::List<Request>::Element
-	{
-		private:
+		enum {
+			MAX_REQUESTS = Session::TX_QUEUE_SIZE,
+			BULK_SIZE    = 4 * 1024 * 1024,
+		};
 
-			Block_dispatcher &_dispatcher;
-			Packet_descriptor _cli;
-			Packet_descriptor _srv;
+	private:
 
-		public:
+		/**
+		 * Request forwarded to the back-end session
+		 */
+		struct Request
+		{
+			Block_dispatcher *dispatcher;
+			unsigned          cli;   /* request id of the dispatcher */
+			Packet_descriptor srv;
+
+			Request() : dispatcher(0), cli(0) { }
+		};
+
+		/**
+		 * Meta data of a packet in the bulk buffer of the back-end session
+		 */
+		struct Tag { unsigned value; };
+
+		typedef Genode::Allocator_avl_tpl<Tag> Bulk_allocator;
+
+		Request                             _request[MAX_REQUESTS];
+		Genode::Bit_allocator<MAX_REQUESTS> _tags;
+		unsigned                            _busy;  /* dispatchers with requests */
+		Bulk_allocator                      _block_alloc;
+		Block::Connection                   _session;
+		Block::sector_t                     _blk_cnt;
+		Genode::size_t                      _blk_size;
+		Genode::Signal_dispatcher<Driver>   _source_ack;
+		Genode::Signal_dispatcher<Driver>   _source_submit;
 
-			Request(Block_dispatcher &d,
-			        Packet_descriptor &cli,
-			        Packet_descriptor &srv)
-			: _dispatcher(d), _cli(cli), _srv(srv) {}
+		void _ready_to_submit(unsigned);
 
-			bool handle(Packet_descriptor& reply)
-			{
-				bool ret =  reply == _srv;
-				if (ret) _dispatcher.dispatch(_cli, reply);
-				return ret;
-			}
-	};
+		/**
+		 * Return true if the dispatcher stays within its fair share
+		 *
+		 * The bulk buffer and the request tags of the back-end session
+		 * are split evenly among all dispatchers with outstanding requests.
+		 * A dispatcher without outstanding requests is always admitted.
+		 */
+		bool _fair(Block_dispatcher &d, Genode::size_t size) const
+		{
+			if (!d._requests)
+				return true;
 
-	private:
+			return d._bulk_in_use + size <= BULK_SIZE    / _busy
+			    && d._requests            <  MAX_REQUESTS / _busy;
+		}
+
+		void _account(Block_dispatcher &d, Genode::size_t size)
+		{
+			if (!d._requests++)
+				_busy++;
+			d._bulk_in_use += size;
+		}
+
+		void _unaccount(Block_dispatcher &d, Genode::size_t size)
+		{
+			d._bulk_in_use -= size;
+			if (!--d._requests)
+				_busy--;
+		}
 
-		enum { BLK_SZ = Session::TX_QUEUE_SIZE*sizeof(Request) };
+		void _complete(unsigned tag, Packet_descriptor &reply)
+		{
+			Request &r = _request[tag];
 
-		Genode::Tslab<Request, BLK_SZ>    _r_slab;
-		Genode::List<Request>             _r_list;
-		Genode::Allocator_avl             _block_alloc;
-		Block::Connection                 _session;
-		Block::sector_t                   _blk_cnt;
-		Genode::size_t                    _blk_size;
-		Genode::Signal_dispatcher<Driver> _source_ack;
-		Genode::Signal_dispatcher<Driver> _source_submit;
+			if (r.dispatcher) {
+				_unaccount(*r.dispatcher, r.srv.size());
+				r.dispatcher->dispatch(r.cli, reply);
+			}
 
-		void _ready_to_submit(unsigned);
+			r = Request();
+			_tags.free(tag);
+		}
 
 		void _ack_avail(unsigned)
 		{
 			/* check for acknowledgements */
 			while (_session.tx()->ack_avail()) {
 				Packet_descriptor p = _session.tx()->get_acked_packet();
-				for (Request *r = _r_list.first(); r; r = r->next()) {
-					if (r->handle(p)) {
-						_r_list.remove(r);
-						Genode::destroy(&_r_slab, r);
-						break;
-					}
-				}
+
+				/* match completion to request via the tag of the packet */
+				Tag *tag = _block_alloc.metadata((void *)p.offset());
+				if (tag)
+					_complete(tag->value, p);
 				_session.tx()->release_packet(p);
 			}
 
@@ -107,9 +161,9 @@ class Block::Driver
 	public:
 
 		Driver(Genode::Signal_receiver &receiver)
-		: _r_slab(Genode::env()->heap()),
+		: _busy(0),
 		  _block_alloc(Genode::env()->heap()),
-		  _session(&_block_alloc, 4 * 1024 * 1024),
+		  _session(&_block_alloc, BULK_SIZE),
 		  _source_ack(receiver, *this, &Driver::_ack_avail),
 		  _source_submit(receiver, *this, &Driver::_ready_to_submit)
 		{
@@ -129,27 +183,72 @@ class Block::Driver
 
 		static Driver& driver();
 
-		void io(bool write, sector_t nr, Genode::size_t cnt, void* addr,
-		        Block_dispatcher &dispatcher, Packet_descriptor& cli)
+		/**
+		 * Forward request to the back-end session
+		 *
+		 * \param cli  request id passed back to the dispatcher
+		 *
+		 * \throw Block::Session::Tx::Source::Packet_alloc_failed  if the
+		 *        request cannot be forwarded right now
+		 */
+		void io(bool write, sector_t nr, Genode::size_t cnt,
+		        Block_dispatcher &dispatcher, unsigned cli)
 		{
-			if (!_session.tx()->ready_to_submit())
-				throw Block::Session::Tx::Source::Packet_alloc_failed();
+			typedef Block::Session::Tx::Source::Packet_alloc_failed Alloc_failed;
+
+			Genode::size_t const size = _blk_size * cnt;
+
+			if (!_session.tx()->ready_to_submit() || !_fair(dispatcher, size))
+				throw Alloc_failed();
+
+			unsigned tag;
+			try { tag = _tags.alloc(); }
+			catch (Genode::Bit_allocator<MAX_REQUESTS>::Out_of_indices) {
+				throw Alloc_failed(); }
 
 			Block::Packet_descriptor::Opcode op = write
 			    ? Block::Packet_descriptor::WRITE
 			    : Block::Packet_descriptor::READ;
-			Genode::size_t size = _blk_size * cnt;
-			Packet_descriptor p(_session.dma_alloc_packet(size),
-			                    op,  nr, cnt);
-			Request *r = new (&_r_slab) Request(dispatcher, cli, p);
-			_r_list.insert(r);
+
+			Packet_descriptor p;
+			try {
+				p = Packet_descriptor(_session.dma_alloc_packet(size),
+				                      op,  nr, cnt);
+			} catch (Alloc_failed) {
+				_tags.free(tag);
+				throw;
+			}
+
+			Tag t = { tag };
+			_block_alloc.metadata((void *)p.offset(), t);
+
+			_request[tag].dispatcher = &dispatcher;
+			_request[tag].cli        = cli;
+			_request[tag].srv        = p;
+			_account(dispatcher, size);
 
 			if (write)
-				Genode::memcpy(_session.tx()->packet_content(p),
-				               addr, size);
+				dispatcher.fill(cli, _session.tx()->packet_content(p));
 
 			_session.tx()->submit_packet(p);
 		}
+
+		/**
+		 * Detach dispatcher from its outstanding requests
+		 *
+		 * The replies to the requests are dropped.
+		 */
+		void remove(Block_dispatcher &dispatcher)
+		{
+			for (unsigned i = 0; i < MAX_REQUESTS; i++) {
+				Request &r = _request[i];
+				if (r.dispatcher != &dispatcher)
+					continue;
+
+				_unaccount(dispatcher, r.srv.size());
+				r.dispatcher = 0;
+			}
+		}
 };
 
 #endif /* _PART_BLK__DRIVER_H_ */
@@ -436,6 +436,77 @@ namespace File_system {
 				}
 			}
 	};
+
+
+	/**
+	 * Hierarchy of chunks with a leaf size chosen at runtime
+	 */
+	class Chunk_store
+	{
+		public:
+
+			/* maximum size of the content, which is independent of the
+			 * leaf size */
+			static file_size_t max_size() { return 4096UL*128*64*64; }
+
+			virtual ~Chunk_store() { }
+
+			virtual file_size_t used_size() const = 0;
+			virtual void write(char const *src, size_t len, seek_off_t) = 0;
+			virtual void read(char *dst, size_t len, seek_off_t) const = 0;
+			virtual void truncate(file_size_t size) = 0;
+
+			/**
+			 * Create chunk store
+			 *
+			 * \param leaf_size  size of the leaf chunks, rounded down to
+			 *                   4, 16, 64, or 256 KiB
+			 */
+			static Chunk_store *create(Allocator &alloc, size_t leaf_size);
+	};
+
+
+	/**
+	 * Chunk store with four levels of which the leaves hold 'LEAF_SIZE' bytes
+	 *
+	 * The number of entries of the second level is adjusted to the leaf
+	 * size, so that all variants cover the same range.
+	 */
+	template <unsigned LEAF_SIZE>
+	class Chunk_store_tpl : public Chunk_store
+	{
+		private:
+
+			typedef Chunk<LEAF_SIZE>                           Level_3;
+			typedef Chunk_index<128*4096/LEAF_SIZE, Level_3> Level_2;
+			typedef Chunk_index<64, Level_2>                 Level_1;
+			typedef Chunk_index<64, Level_1>                 Level_0;
+
+			Level_0 _chunk;
+
+		public:
+
+			Chunk_store_tpl(Allocator &alloc) : _chunk(alloc, 0) { }
+
+			file_size_t used_size() const { return _chunk.used_size(); }
+
+			void write(char const *src, size_t len, seek_off_t seek_offset) {
+				_chunk.write(src, len, seek_offset); }
+
+			void read(char *dst, size_t len, seek_off_t seek_offset) const {
+				_chunk.read(dst, len, seek_offset); }
+
+			void truncate(file_size_t size) { _chunk.truncate(size); }
+	};
+
+
+	inline Chunk_store *Chunk_store::create(Allocator &alloc, size_t leaf_size)
+	{
+		if (leaf_size >= 256*1024) return new (&alloc) Chunk_store_tpl<256*1024>(alloc);
+		if (leaf_size >=  64*1024) return new (&alloc) Chunk_store_tpl< 64*1024>(alloc);
+		if (leaf_size >=  16*1024) return new (&alloc) Chunk_store_tpl< 16*1024>(alloc);
+		return new (&alloc) Chunk_store_tpl<4*1024>(alloc);
+	}
 };
 
 #endif /* _CHUNK_H_ */
@@ -7,6 +7,9 @@
 #ifndef _DIRECTORY_H_
 #define _DIRECTORY_H_
 
+/* Genode includes */
+#include <base/env.h>
+
 /* local includes */
 #include <node.h>
 #include <util.h>
@@ -19,21 +22,132 @@ namespace File_system {
 	{
 		private:
 
-			List<Node> _entries;
-			size_t     _num_entries;
+			enum { MIN_BUCKETS = 16 };
+
+			/*
+			 * The entries are protected by '_entries_lock' rather than the
+			 * node lock, so that path lookups only briefly hold the lock of
+			 * each traversed directory. No other lock is acquired while
+			 * holding '_entries_lock'.
+			 */
+			Lock mutable _entries_lock;
+
+			/* entries in creation order */
+			Node   *_first;
+			Node   *_last;
+			size_t  _num_entries;
+
+			unsigned long _next_seq;
+
+			/* hash index of the entries */
+			Node  **_buckets;
+			size_t  _num_buckets;
+
+			/* position of the last 'read', used for reading sequentially */
+			Node       *_cursor;
+			seek_off_t  _cursor_index;
+
+			static unsigned long _hash(char const *name, size_t len)
+			{
+				/* FNV-1a */
+				unsigned long h = 2166136261UL;
+				for (size_t i = 0; i < len; i++)
+					h = (h ^ (unsigned char)name[i])*16777619UL;
+				return h;
+			}
+
+			void _insert_into_bucket(Node *node)
+			{
+				Node *&bucket = _buckets[node->_hash % _num_buckets];
+				node->_hash_next = bucket;
+				bucket = node;
+			}
+
+			/**
+			 * Enlarge the hash index before adding an entry
+			 *
+			 * If the index cannot be enlarged, the hash chains just grow
+			 * longer.
+			 */
+			void _grow_index()
+			{
+				if (_num_entries < 2*_num_buckets)
+					return;
+
+				size_t const num_buckets = max((size_t)MIN_BUCKETS, 2*_num_buckets);
+
+				Node **buckets = 0;
+				if (!env()->heap()->alloc(num_buckets*sizeof(Node *), &buckets))
+					return;
+
+				if (_buckets)
+					env()->heap()->free(_buckets, _num_buckets*sizeof(Node *));
+
+				memset(buckets, 0, num_buckets*sizeof(Node *));
+				_buckets     = buckets;
+				_num_buckets = num_buckets;
+
+				for (Node *node = _first; node; node = node->_dir_next)
+					_insert_into_bucket(node);
+			}
+
+			Node *_lookup_unsynchronized(char const *name, size_t len) const
+			{
+				if (!_buckets)
+					return 0;
+
+				unsigned long const h = _hash(name, len);
+
+				for (Node *node = _buckets[h % _num_buckets]; node; node = node->_hash_next)
+					if (node->_hash == h && strlen(node->name()) == len
+					 && strcmp(node->name(), name, len) == 0)
+						return node;
+
+				return 0;
+			}
+
+			/**
+			 * Return entry at the specified index of the creation order
+			 */
+			Node *_entry_at(seek_off_t index)
+			{
+				Node      *node = _first;
+				seek_off_t i    = 0;
+
+				/* continue from the last position if possible */
+				if (_cursor && index >= _cursor_index) {
+					node = _cursor;
+					i    = _cursor_index;
+				}
+
+				for (; i < index && node; node = node->_dir_next, i++);
+
+				if (node) {
+					_cursor       = node;
+					_cursor_index = index;
+				}
+				return node;
+			}
 
 		public:
 
-			Directory(char const *name) : _num_entries(0) { Node::name(name); }
+			Directory(char const *name)
+			:
+				_first(0), _last(0), _num_entries(0), _next_seq(0),
+				_buckets(0), _num_buckets(0), _cursor(0), _cursor_index(0)
+			{ Node::name(name); }
+
+			~Directory()
+			{
+				if (_buckets)
+					env()->heap()->free(_buckets, _num_buckets*sizeof(Node *));
+			}
 
 			bool has_sub_node_unsynchronized(char const *name) const
 			{
-				Node const *sub_node = _entries.first();
-				for (; sub_node; sub_node = sub_node->next())
-					if (strcmp(sub_node->name(), name) == 0)
-						return true;
+				Lock::Guard guard(_entries_lock);
 
-				return false;
+				return _lookup_unsynchronized(name, strlen(name)) != 0;
 			}
 
 			void adopt_unsynchronized(Node *node)
@@ -41,16 +155,54 @@ namespace File_system {
 				/*
 				 * XXX inc ref counter
 				 */
-				_entries.insert(node);
-				_num_entries++;
+				{
+					Lock::Guard guard(_entries_lock);
+
+					_grow_index();
+
+					node->_dir_prev = _last;
+					node->_dir_next = 0;
+					if (_last) _last->_dir_next = node; else _first = node;
+					_last = node;
+
+					node->_seq  = _next_seq++;
+					node->_hash = _hash(node->name(), strlen(node->name()));
+					_num_entries++;
+
+					if (_buckets)
+						_insert_into_bucket(node);
+				}
 
 				mark_as_updated();
 			}
 
 			void discard_unsynchronized(Node *node)
 			{
-				_entries.remove(node);
-				_num_entries--;
+				{
+					Lock::Guard guard(_entries_lock);
+
+					/* keep the cursor pointing to the same index */
+					if (_cursor == node)
+						_cursor = node->_dir_next;
+					else if (_cursor && node->_seq < _cursor->_seq)
+						_cursor_index--;
+
+					Node *&prev_next = node->_dir_prev ? node->_dir_prev->_dir_next : _first;
+					Node *&next_prev = node->_dir_next ? node->_dir_next->_dir_prev : _last;
+					prev_next = node->_dir_next;
+					next_prev = node->_dir_prev;
+					node->_dir_prev = node->_dir_next = 0;
+
+					if (_buckets) {
+						Node **n = &_buckets[node->_hash % _num_buckets];
+						for (; *n && *n != node; n = &(*n)->_hash_next);
+						if (*n)
+							*n = node->_hash_next;
+					}
+					node->_hash_next = 0;
+
+					_num_entries--;
+				}
 
 				mark_as_updated();
 			}
@@ -85,11 +237,11 @@ namespace File_system {
 				 */
 
 				/* try to find entry that matches the first path element */
-				Node *sub_node = _entries.first();
-				for (; sub_node; sub_node = sub_node->next())
-					if ((strlen(sub_node->name()) == i) &&
-						(strcmp(sub_node->name(), path, i) == 0))
-						break;
+				Node *sub_node = 0;
+				{
+					Lock::Guard guard(_entries_lock);
+					sub_node = _lookup_unsynchronized(path, i);
+				}
 
 				if (!sub_node)
 					throw Lookup_failed();
@@ -182,9 +334,9 @@ namespace File_system {
 					return 0;
 				}
 
-				/* find list element */
-				Node *node = _entries.first();
-				for (unsigned i = 0; i < index && node; node = node->next(), i++);
+				Lock::Guard guard(_entries_lock);
+
+				Node *node = _entry_at(index);
 
 				/* index out of range */
 				if (!node)
@@ -208,6 +360,16 @@ namespace File_system {
 			}
 
 			size_t num_entries() const { return _num_entries; }
+
+			/**
+			 * Call 'fn' for each entry in creation order
+			 */
+			template <typename FN>
+			void for_each_entry_unsynchronized(FN const &fn)
+			{
+				for (Node *node = _first; node; node = node->_dir_next)
+					fn(*node);
+			}
 	};
 }
 
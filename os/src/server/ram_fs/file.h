@@ -9,6 +9,7 @@
 
 /* Genode includes */
 #include <base/allocator.h>
+#include <base/env.h>
 
 /* local includes */
 #include <node.h>
@@ -20,24 +21,133 @@ namespace File_system {
 	{
 		private:
 
-			typedef Chunk<4096>                     Chunk_level_3;
-			typedef Chunk_index<128, Chunk_level_3> Chunk_level_2;
-			typedef Chunk_index<64,  Chunk_level_2> Chunk_level_1;
-			typedef Chunk_index<64,  Chunk_level_1> Chunk_level_0;
-
-			Chunk_level_0 _chunk;
+			Allocator   &_alloc;
+			Chunk_store *_chunk;
 
 			file_size_t _length;
 
+			/*
+			 * Contiguous extent holding the beginning of the file
+			 *
+			 * Files larger than 'extent_threshold' and files mapped by a
+			 * client keep their content in a dataspace instead of the
+			 * chunks. Content beyond '_ds_size' resides in the chunks. The
+			 * extent is enlarged by moving the content to a larger
+			 * dataspace, which is no longer possible once the dataspace
+			 * was handed out to a client.
+			 */
+			Ram_dataspace_capability _ds;
+			char                    *_ds_base;
+			size_t                   _ds_size;
+			bool                     _ds_shared;
+
+			void _read_chunks(char *dst, size_t len, seek_off_t seek_offset)
+			{
+				file_size_t const chunk_used_size = _chunk->used_size();
+
+				file_size_t read_len = len;
+
+				if (seek_offset + read_len > chunk_used_size) {
+					if (chunk_used_size >= seek_offset)
+						read_len = chunk_used_size - seek_offset;
+					else
+						read_len = 0;
+				}
+
+				_chunk->read(dst, read_len, seek_offset);
+
+				/* add zero padding if needed */
+				if (read_len < len)
+					memset(dst + read_len, 0, len - read_len);
+			}
+
+			/**
+			 * Return number of bytes of the range that reside in the extent
+			 */
+			size_t _ds_part(size_t len, seek_off_t seek_offset) const
+			{
+				if (seek_offset >= _ds_size)
+					return 0;
+
+				return min(len, (size_t)(_ds_size - seek_offset));
+			}
+
+			/**
+			 * Move the whole content to a new extent of at least 'size' bytes
+			 *
+			 * \return  false if the dataspace could not be allocated
+			 */
+			bool _move_to_extent(file_size_t size)
+			{
+				size_t const ds_size = align_addr(max(size, _length), 12);
+
+				Ram_dataspace_capability ds;
+				char *ds_base = 0;
+				try {
+					ds      = env()->ram_session()->alloc(ds_size);
+					ds_base = env()->rm_session()->attach(ds);
+				} catch (...) {
+					if (ds.valid())
+						env()->ram_session()->free(ds);
+					return false;
+				}
+
+				size_t const ds_len = _ds_part(_length, 0);
+				memcpy(ds_base, _ds_base, ds_len);
+				_read_chunks(ds_base + ds_len, _length - ds_len, ds_len);
+				_chunk->truncate(0);
+
+				if (_ds.valid()) {
+					env()->rm_session()->detach(_ds_base);
+					env()->ram_session()->free(_ds);
+				}
+
+				_ds      = ds;
+				_ds_base = ds_base;
+				_ds_size = ds_size;
+				return true;
+			}
+
 		public:
 
+			/**
+			 * Size of the leaf chunks of files created subsequently
+			 */
+			static size_t &chunk_size()
+			{
+				static size_t size = 4096;
+				return size;
+			}
+
+			/**
+			 * File size at which the content is moved to an extent, or 0
+			 * to keep files in chunks unless mapped by a client
+			 */
+			static size_t &extent_threshold()
+			{
+				static size_t size = 0;
+				return size;
+			}
+
 			File(Allocator &alloc, char const *name)
-			: _chunk(alloc, 0), _length(0) { Node::name(name); }
+			:
+				_alloc(alloc), _chunk(Chunk_store::create(alloc, chunk_size())),
+				_length(0), _ds_base(0), _ds_size(0), _ds_shared(false)
+			{ Node::name(name); }
 
-			size_t read(char *dst, size_t len, seek_off_t seek_offset)
+			~File()
 			{
-				file_size_t const chunk_used_size = _chunk.used_size();
+				destroy(&_alloc, _chunk);
 
+				if (!_ds.valid())
+					return;
+
+				env()->rm_session()->detach(_ds_base);
+				env()->ram_session()->free(_ds);
+			}
+
+			size_t read(char *dst, size_t len, seek_off_t seek_offset)
+			{
 				if (seek_offset >= _length)
 					return 0;
 
@@ -50,20 +160,11 @@ namespace File_system {
 				if (seek_offset + len >= _length)
 					len = _length - seek_offset;
 
-				file_size_t read_len = len;
-
-				if (seek_offset + read_len > chunk_used_size) {
-					if (chunk_used_size >= seek_offset)
-						read_len = chunk_used_size - seek_offset;
-					else
-						read_len = 0;
-				}
+				size_t const ds_len = _ds_part(len, seek_offset);
+				memcpy(dst, _ds_base + seek_offset, ds_len);
 
-				_chunk.read(dst, read_len, seek_offset);
-
-				/* add zero padding if needed */
-				if (read_len < len)
-					memset(dst + read_len, 0, len - read_len);
+				if (len > ds_len)
+					_read_chunks(dst + ds_len, len - ds_len, seek_offset + ds_len);
 
 				return len;
 			}
@@ -71,35 +172,81 @@ namespace File_system {
 			size_t write(char const *src, size_t len, seek_off_t seek_offset)
 			{
 				if (seek_offset == (seek_off_t)(~0))
-					seek_offset = _chunk.used_size();
+					seek_offset = _length;
+
+				file_size_t const end = seek_offset + len;
 
-				if (seek_offset + len >= Chunk_level_0::SIZE)
+				if (end >= Chunk_store::max_size())
 					throw Size_limit_reached();
 
-				_chunk.write(src, len, (size_t)seek_offset);
+				/*
+				 * Enlarge the extent exponentially, so that the content is
+				 * moved a few times only. If no dataspace can be allocated,
+				 * the content beyond the extent is kept in chunks.
+				 */
+				if (extent_threshold() && end >= extent_threshold()
+				 && end > _ds_size && !_ds_shared)
+					_move_to_extent(min(max(end, 2*(file_size_t)_ds_size),
+					                    Chunk_store::max_size()));
+
+				size_t const ds_len = _ds_part(len, seek_offset);
+				memcpy(_ds_base + seek_offset, src, ds_len);
+
+				if (len > ds_len)
+					_chunk->write(src + ds_len, len - ds_len,
+					              (size_t)seek_offset + ds_len);
 
 				/*
 				 * Keep track of file length. We cannot use 'chunk.used_size()'
 				 * as file length because trailing zeros may by represented
 				 * by zero chunks, which do not contribute to 'used_size()'.
 				 */
-				_length = max(_length, seek_offset + len);
+				_length = max(_length, end);
 
 				mark_as_updated();
-				return 0;
+				return len;
 			}
 
 			file_size_t length() const { return _length; }
 
 			void truncate(file_size_t size)
 			{
-				if (size < _chunk.used_size())
-					_chunk.truncate(size);
+				/* let a later extension of the file read as zeros */
+				if (size < _length && size < _ds_size)
+					memset(_ds_base + size, 0,
+					       min((file_size_t)_ds_size, _length) - size);
+
+				if (size < _chunk->used_size())
+					_chunk->truncate(size);
 
 				_length = size;
 
 				mark_as_updated();
 			}
+
+			/**
+			 * Return dataspace holding the first 'size' bytes of the file
+			 *
+			 * \throw Size_limit_reached  dataspace was handed out already
+			 *                            but is smaller than 'size'
+			 * \throw No_space
+			 */
+			Dataspace_capability dataspace(file_size_t size)
+			{
+				if (size >= Chunk_store::max_size())
+					throw Size_limit_reached();
+
+				if (size > _ds_size) {
+					if (_ds_shared)
+						throw Size_limit_reached();
+
+					if (!_move_to_extent(size))
+						throw No_space();
+				}
+
+				_ds_shared = true;
+				return _ds;
+			}
 	};
 }
 
@@ -0,0 +1,1001 @@
+/*
+ * \brief  Persistence of the file system via a Block session
+ * \author Genode Labs
+ * \date   2014-02-10
+ *
+ * The block device holds a superblock and two regions. The active region
+ * contains a stream of records, which starts with a snapshot of the file
+ * system followed by the journal of subsequent modifications. Records are
+ * collected in a buffer and written asynchronously. If the journal outgrows
+ * the snapshot or the region is exhausted, a new snapshot is written to the
+ * other region, which becomes the active one by updating the superblock.
+ */
+
+/*
+ * Copyright (C) 2014 Genode Labs GmbH
+ *
+ * This file is part of the Genode OS framework, which is distributed
+ * under the terms of the GNU General Public License version 2.
+ */
+
+#ifndef _JOURNAL_H_
+#define _JOURNAL_H_
+
+/* Genode includes */
+#include <base/allocator_avl.h>
+#include <block_session/connection.h>
+#include <os/config.h>
+#include <os/reporter.h>
+#include <os/server.h>
+#include <timer_session/connection.h>
+
+/* local includes */
+#include <directory.h>
+
+namespace File_system { class Journal; }
+
+
+class File_system::Journal
+{
+	public:
+
+		/**
+		 * Persistence parameters as defined by the '<persistence>' node
+		 */
+		struct Config
+		{
+			/* records are written when the buffer is half full */
+			size_t buffer_size;
+
+			/* interval of writing records regardless of the buffer level */
+			unsigned flush_interval_ms;
+
+			/* wait for the device after each operation */
+			bool strict;
+
+			bool report;
+
+			Config(Xml_node node)
+			: buffer_size(256*1024), flush_interval_ms(1000), strict(false),
+			  report(false)
+			{
+				Number_of_bytes buffer = buffer_size;
+				try { node.attribute("buffer").value(&buffer); } catch (...) { }
+				buffer_size = max((size_t)64*1024, (size_t)buffer);
+
+				try { node.attribute("flush_interval_ms").value(&flush_interval_ms); } catch (...) { }
+				try { strict = node.attribute("durability").has_value("strict"); } catch (...) { }
+				try { report = node.attribute("report").has_value("yes"); } catch (...) { }
+			}
+		};
+
+	private:
+
+		typedef Genode::uint32_t   uint32_t;
+		typedef Genode::uint64_t   uint64_t;
+		typedef Block::sector_t    sector_t;
+		typedef Block::Packet_descriptor Block_packet;
+
+		enum {
+			MAGIC       = 0x4c4e4a52, /* "RJNL" */
+			VERSION     = 1,
+			MAX_PAYLOAD = 64*1024,    /* larger writes are split */
+			MAX_PACKET  = 128*1024,
+		};
+
+		enum Type { CREATE = 1, WRITE, TRUNCATE, UNLINK, MOVE };
+
+		enum Node_type { FILE = 1, DIRECTORY, SYMLINK };
+
+		struct Superblock
+		{
+			uint32_t magic;
+			uint32_t version;
+			uint64_t generation;
+			uint64_t root;        /* inode number of the root directory */
+			uint32_t region;      /* active region, 0 or 1 */
+			uint32_t checksum;
+		} __attribute__((packed));
+
+		struct Header
+		{
+			uint32_t magic;
+			uint32_t type;
+			uint64_t generation;
+			uint64_t seq;
+			uint32_t length;      /* payload in bytes */
+			uint32_t checksum;    /* of header and payload */
+		} __attribute__((packed));
+
+		struct Create   { uint64_t parent, id; uint32_t type; } __attribute__((packed));
+		struct Write    { uint64_t id, offset; }               __attribute__((packed));
+		struct Truncate { uint64_t id, size; }                 __attribute__((packed));
+		struct Unlink   { uint64_t parent; }                   __attribute__((packed));
+		struct Move     { uint64_t from, to; uint32_t from_len; } __attribute__((packed));
+
+		class Snapshot_too_large { };
+
+		/**
+		 * Map of inode numbers to nodes, used while replaying
+		 */
+		class Node_map
+		{
+			private:
+
+				enum { BUCKETS = 4096 };
+
+				struct Entry
+				{
+					unsigned long id;
+					Node         *node;
+					Entry        *next;
+				};
+
+				Entry *_bucket[BUCKETS];
+
+			public:
+
+				Node_map() { memset(_bucket, 0, sizeof(_bucket)); }
+
+				~Node_map()
+				{
+					for (unsigned i = 0; i < BUCKETS; i++)
+						while (Entry *e = _bucket[i]) {
+							_bucket[i] = e->next;
+							destroy(env()->heap(), e);
+						}
+				}
+
+				void insert(unsigned long id, Node *node)
+				{
+					Entry *e = new (env()->heap()) Entry;
+					e->id   = id;
+					e->node = node;
+					e->next = _bucket[id % BUCKETS];
+					_bucket[id % BUCKETS] = e;
+				}
+
+				Node *lookup(unsigned long id)
+				{
+					for (Entry *e = _bucket[id % BUCKETS]; e; e = e->next)
+						if (e->id == id)
+							return e->node;
+					return 0;
+				}
+
+				void remove(unsigned long id)
+				{
+					for (Entry **e = &_bucket[id % BUCKETS]; *e; e = &(*e)->next)
+						if ((*e)->id == id) {
+							Entry *old = *e;
+							*e = old->next;
+							destroy(env()->heap(), old);
+							return;
+						}
+				}
+
+				/**
+				 * Remove node and, if it is a directory, all nodes below
+				 */
+				void remove_subtree(Node &node)
+				{
+					remove(node.inode());
+
+					Directory *dir = dynamic_cast<Directory *>(&node);
+					if (dir)
+						dir->for_each_entry_unsynchronized([&] (Node &sub_node) {
+							remove_subtree(sub_node); });
+				}
+		};
+
+		Config const _config;
+		Directory   &_root;
+
+		Allocator_avl     _block_alloc;
+		Block::Connection _block;
+		sector_t          _blk_cnt;
+		size_t            _blk_size;
+		sector_t          _region_blocks;
+
+		Timer::Connection _timer;
+		Reporter          _reporter;
+
+		/* state of the active region */
+		uint64_t    _generation;
+		unsigned    _region;
+		uint64_t    _seq;
+		file_size_t _pos;          /* end of the stream           */
+		file_size_t _snapshot;     /* size of the initial snapshot */
+
+		/*
+		 * Buffer holding the stream from '_buf_start' up to '_pos'
+		 *
+		 * After submitting the buffered records, only the last partial
+		 * block is kept, which is written again with the next records.
+		 */
+		char       *_buf;
+		file_size_t _buf_start;
+		file_size_t _flushed;
+
+		unsigned _writes_in_flight;
+		bool     _compacting;
+		bool     _failed;
+
+		/* statistics */
+		unsigned long _replay_ms;
+		unsigned long _replayed_records;
+		unsigned long _compactions;
+
+		Server::Signal_rpc_member<Journal> _ack_dispatcher;
+		Server::Signal_rpc_member<Journal> _timer_dispatcher;
+
+		Block::Session::Tx::Source &_source() { return *_block.tx(); }
+
+		static uint32_t _checksum(uint32_t h, void const *data, size_t len)
+		{
+			/* FNV-1a */
+			unsigned char const *p = (unsigned char const *)data;
+			for (size_t i = 0; i < len; i++)
+				h = (h ^ p[i])*16777619U;
+			return h;
+		}
+
+		sector_t _region_base(unsigned region) const {
+			return 1 + region*_region_blocks; }
+
+		file_size_t _region_size() const { return _region_blocks*_blk_size; }
+
+		file_size_t _block_floor(file_size_t offset) const {
+			return offset - offset % _blk_size; }
+
+		file_size_t _block_ceil(file_size_t offset) const {
+			return _block_floor(offset + _blk_size - 1); }
+
+
+		/****************
+		 ** Block I/O  **
+		 ****************/
+
+		void _handle_ack(Block_packet const &packet)
+		{
+			if (packet.operation() == Block_packet::WRITE) {
+				_writes_in_flight--;
+				if (!packet.succeeded()) {
+					PERR("journal write at block %llu failed",
+					     (unsigned long long)packet.block_number());
+					_failed = true;
+				}
+			}
+			_source().release_packet(packet);
+		}
+
+		void _handle_acks(unsigned)
+		{
+			while (_source().ack_avail())
+				_handle_ack(_source().get_acked_packet());
+		}
+
+		/**
+		 * Receive the acknowledgements of all writes synchronously
+		 */
+		void _wait_for_writes()
+		{
+			if (!_writes_in_flight)
+				return;
+
+			_block.tx_channel()->sigh_ack_avail(_source().sigh_ack_avail());
+
+			while (_writes_in_flight)
+				_handle_ack(_source().get_acked_packet());
+
+			_block.tx_channel()->sigh_ack_avail(_ack_dispatcher);
+		}
+
+		Block_packet _alloc_packet(size_t size)
+		{
+			for (;;) {
+				try { return _block.dma_alloc_packet(size); }
+				catch (Block::Session::Tx::Source::Packet_alloc_failed) { }
+
+				if (!_writes_in_flight)
+					throw Block::Session::Tx::Source::Packet_alloc_failed();
+
+				_wait_for_writes();
+			}
+		}
+
+		/**
+		 * Submit write of whole blocks without waiting for its completion
+		 */
+		void _submit_write(sector_t block, char const *src, size_t size)
+		{
+			while (size) {
+				size_t const len = min(size, (size_t)MAX_PACKET);
+
+				Block_packet const raw = _alloc_packet(len);
+				memcpy(_source().packet_content(raw), src, len);
+
+				_writes_in_flight++;
+				_source().submit_packet(Block_packet(raw, Block_packet::WRITE,
+				                                     block, len / _blk_size));
+				block += len / _blk_size;
+				src   += len;
+				size  -= len;
+			}
+		}
+
+		/**
+		 * Read or write blocks synchronously
+		 *
+		 * \return  false on failure
+		 */
+		bool _io(bool write, sector_t block, char *buf, size_t size)
+		{
+			_wait_for_writes();
+
+			_block.tx_channel()->sigh_ack_avail(_source().sigh_ack_avail());
+
+			bool ok = true;
+			while (size && ok) {
+				size_t const len = min(size, (size_t)MAX_PACKET);
+
+				Block_packet const raw = _block.dma_alloc_packet(len);
+				if (write)
+					memcpy(_source().packet_content(raw), buf, len);
+
+				_source().submit_packet(Block_packet(raw,
+					write ? Block_packet::WRITE : Block_packet::READ,
+					block, len / _blk_size));
+
+				Block_packet const packet = _source().get_acked_packet();
+				ok = packet.succeeded();
+				if (ok && !write)
+					memcpy(buf, _source().packet_content(packet), len);
+				_source().release_packet(packet);
+
+				block += len / _blk_size;
+				buf   += len;
+				size  -= len;
+			}
+
+			_block.tx_channel()->sigh_ack_avail(_ack_dispatcher);
+			return ok;
+		}
+
+		bool _write_superblock()
+		{
+			char * const block = (char *)env()->heap()->alloc(_blk_size);
+			memset(block, 0, _blk_size);
+
+			Superblock &sb = *(Superblock *)block;
+			sb.magic      = MAGIC;
+			sb.version    = VERSION;
+			sb.generation = _generation;
+			sb.root       = _root.inode();
+			sb.region     = _region;
+			sb.checksum   = _checksum(2166136261U, &sb, sizeof(sb) - sizeof(uint32_t));
+
+			bool const ok = _io(true, 0, block, _blk_size);
+			_block.sync();
+
+			env()->heap()->free(block, _blk_size);
+			return ok;
+		}
+
+
+		/*************************
+		 ** Writing the stream **
+		 *************************/
+
+		/**
+		 * Write buffered records
+		 *
+		 * Because the last partial block is written again by the next
+		 * flush, the writes of the previous flush must be complete.
+		 */
+		void _flush()
+		{
+			if (_pos == _flushed || _failed)
+				return;
+
+			_wait_for_writes();
+
+			file_size_t const end = _block_ceil(_pos);
+			_submit_write(_region_base(_region) + _buf_start / _blk_size,
+			              _buf, end - _buf_start);
+			_flushed = _pos;
+
+			/* keep the last partial block */
+			file_size_t const tail = _block_floor(_pos);
+			memmove(_buf, _buf + (tail - _buf_start), _pos - tail);
+			memset(_buf + (_pos - tail), 0, _config.buffer_size - (_pos - tail));
+			_buf_start = tail;
+		}
+
+		void _append_bytes(void const *data, size_t len)
+		{
+			char const *src = (char const *)data;
+
+			while (len) {
+				if (_pos - _buf_start == _config.buffer_size)
+					_flush();
+
+				size_t const n = min(len, (size_t)(_config.buffer_size - (_pos - _buf_start)));
+				memcpy(_buf + (_pos - _buf_start), src, n);
+				_pos += n;
+				src  += n;
+				len  -= n;
+			}
+		}
+
+		/**
+		 * Append record consisting of a fixed part and a variable part
+		 */
+		void _append(Type type, void const *fixed, size_t fixed_len,
+		             void const *var, size_t var_len)
+		{
+			if (_failed)
+				return;
+
+			size_t const length = fixed_len + var_len;
+
+			/*
+			 * Compact the stream if the region is exhausted or the journal
+			 * outgrew the snapshot. The snapshot written by the compaction
+			 * already contains the modification to be recorded.
+			 */
+			file_size_t const end = _pos + sizeof(Header) + length;
+			if (!_compacting && (end > _region_size()
+			 || end - _snapshot > max(_snapshot, _region_size()/4))) {
+				_compact();
+				return;
+			}
+
+			if (_pos + sizeof(Header) + length > _region_size())
+				throw Snapshot_too_large();
+
+			Header h;
+			h.magic      = MAGIC;
+			h.type       = type;
+			h.generation = _generation;
+			h.seq        = _seq++;
+			h.length     = length;
+			h.checksum   = 0;
+
+			uint32_t sum = _checksum(2166136261U, &h, sizeof(h));
+			sum = _checksum(sum, fixed, fixed_len);
+			h.checksum = _checksum(sum, var, var_len);
+
+			_append_bytes(&h, sizeof(h));
+			_append_bytes(fixed, fixed_len);
+			_append_bytes(var, var_len);
+
+			if (_pos - _buf_start >= _config.buffer_size/2)
+				_flush();
+		}
+
+		static uint32_t _node_type(Node &node)
+		{
+			if (dynamic_cast<Directory *>(&node)) return DIRECTORY;
+			if (dynamic_cast<Symlink   *>(&node)) return SYMLINK;
+			return FILE;
+		}
+
+		void _record_create(Directory &parent, Node &node)
+		{
+			Create c;
+			c.parent = parent.inode();
+			c.id     = node.inode();
+			c.type   = _node_type(node);
+			_append(CREATE, &c, sizeof(c), node.name(), strlen(node.name()));
+		}
+
+		void _record_write(Node &node, char const *data, size_t len,
+		                   seek_off_t offset)
+		{
+			while (len) {
+				size_t const n = min(len, (size_t)MAX_PAYLOAD);
+
+				Write w;
+				w.id     = node.inode();
+				w.offset = offset;
+				_append(WRITE, &w, sizeof(w), data, n);
+
+				data   += n;
+				offset += n;
+				len    -= n;
+			}
+		}
+
+		/**
+		 * Record the content of a directory including all sub directories
+		 */
+		void _record_tree(Directory &dir, char *buf)
+		{
+			dir.for_each_entry_unsynchronized([&] (Node &node) {
+
+				_record_create(dir, node);
+
+				if (File *file = dynamic_cast<File *>(&node)) {
+					file_size_t const length = file->length();
+
+					for (file_size_t offset = 0; offset < length; ) {
+						size_t const n = file->read(buf, MAX_PAYLOAD, offset);
+
+						/* skip holes */
+						bool zero = true;
+						for (size_t i = 0; zero && i < n; i++)
+							zero = !buf[i];
+
+						if (!zero || offset + n == length)
+							_record_write(node, buf, n, offset);
+						offset += n;
+					}
+				}
+
+				if (Symlink *symlink = dynamic_cast<Symlink *>(&node)) {
+					symlink->read(buf, MAX_PAYLOAD, 0);
+					_record_write(node, buf, symlink->length(), 0);
+				}
+
+				if (Directory *sub_dir = dynamic_cast<Directory *>(&node))
+					_record_tree(*sub_dir, buf);
+			});
+		}
+
+		/**
+		 * Write snapshot of the file system to the inactive region
+		 */
+		void _compact()
+		{
+			_flush();
+			_wait_for_writes();
+
+			unsigned    const old_region     = _region;
+			uint64_t    const old_generation = _generation;
+
+			_region     = !_region;
+			_generation = _generation + 1;
+			_seq        = 0;
+			_pos = _buf_start = _flushed = 0;
+			memset(_buf, 0, _config.buffer_size);
+
+			_compacting = true;
+
+			char * const buf = (char *)env()->heap()->alloc(MAX_PAYLOAD);
+			try {
+				_record_tree(_root, buf);
+			} catch (Snapshot_too_large) {
+				PERR("snapshot exceeds region of %llu bytes, persistence disabled",
+				     (unsigned long long)_region_size());
+				_failed = true;
+			}
+			env()->heap()->free(buf, MAX_PAYLOAD);
+
+			_compacting = false;
+
+			_flush();
+			_wait_for_writes();
+			_block.sync();
+
+			if (_failed || !_write_superblock()) {
+				_region     = old_region;
+				_generation = old_generation;
+				_failed     = true;
+				return;
+			}
+
+			_snapshot = _pos;
+			_compactions++;
+			report();
+		}
+
+
+		/***************
+		 ** Replaying **
+		 ***************/
+
+		/**
+		 * Apply record to the file system
+		 *
+		 * \return  false if the record is inconsistent with the file system
+		 */
+		bool _apply(Node_map &map, Header const &h, char const *payload)
+		{
+			switch (h.type) {
+
+			case CREATE:
+				{
+					if (h.length < sizeof(Create)) return false;
+					Create const &c = *(Create const *)payload;
+
+					Directory *parent = dynamic_cast<Directory *>(map.lookup(c.parent));
+					if (!parent) return false;
+
+					char name[MAX_NAME_LEN];
+					strncpy(name, payload + sizeof(c),
+					        min(sizeof(name), (size_t)(h.length - sizeof(c) + 1)));
+
+					if (parent->has_sub_node_unsynchronized(name))
+						return false;
+
+					/* reproduce the inode number of the node */
+					unsigned long const count = Node::inode_count();
+					Node::inode_count() = c.id - 1;
+
+					Node *node = 0;
+					switch (c.type) {
+					case FILE:      node = new (env()->heap()) File(*env()->heap(), name); break;
+					case DIRECTORY: node = new (env()->heap()) Directory(name); break;
+					case SYMLINK:   node = new (env()->heap()) Symlink(name); break;
+					}
+					Node::inode_count() = max(count, (unsigned long)c.id);
+
+					if (!node) return false;
+
+					parent->adopt_unsynchronized(node);
+					map.insert(c.id, node);
+					return true;
+				}
+
+			case WRITE:
+				{
+					if (h.length < sizeof(Write)) return false;
+					Write const &w = *(Write const *)payload;
+
+					Node *node = map.lookup(w.id);
+					if (!node) return false;
+
+					node->write(payload + sizeof(w), h.length - sizeof(w), w.offset);
+					return true;
+				}
+
+			case TRUNCATE:
+				{
+					if (h.length < sizeof(Truncate)) return false;
+					Truncate const &t = *(Truncate const *)payload;
+
+					File *file = dynamic_cast<File *>(map.lookup(t.id));
+					if (!file) return false;
+
+					file->truncate(t.size);
+					return true;
+				}
+
+			case UNLINK:
+				{
+					if (h.length < sizeof(Unlink)) return false;
+					Unlink const &u = *(Unlink const *)payload;
+
+					Directory *parent = dynamic_cast<Directory *>(map.lookup(u.parent));
+					if (!parent) return false;
+
+					char name[MAX_NAME_LEN];
+					strncpy(name, payload + sizeof(u),
+					        min(sizeof(name), (size_t)(h.length - sizeof(u) + 1)));
+
+					try {
+						Node *node = parent->lookup_and_lock(name);
+						node->unlock();
+
+						/*
+						 * Nodes below an unlinked directory are no longer
+						 * reachable and must not be referenced by later
+						 * records.
+						 */
+						parent->discard_unsynchronized(node);
+						map.remove_subtree(*node);
+						destroy(env()->heap(), node);
+					} catch (Lookup_failed) { return false; }
+					return true;
+				}
+
+			case MOVE:
+				{
+					if (h.length < sizeof(Move)) return false;
+					Move const &m = *(Move const *)payload;
+
+					size_t const names_len = h.length - sizeof(m);
+					if (m.from_len > names_len) return false;
+
+					Directory *from = dynamic_cast<Directory *>(map.lookup(m.from));
+					Directory *to   = dynamic_cast<Directory *>(map.lookup(m.to));
+					if (!from || !to) return false;
+
+					char from_name[MAX_NAME_LEN], to_name[MAX_NAME_LEN];
+					strncpy(from_name, payload + sizeof(m),
+					        min(sizeof(from_name), (size_t)m.from_len + 1));
+					strncpy(to_name, payload + sizeof(m) + m.from_len,
+					        min(sizeof(to_name), names_len - m.from_len + 1));
+
+					try {
+						Node *node = from->lookup_and_lock(from_name);
+						node->unlock();
+
+						from->discard_unsynchronized(node);
+						node->name(to_name);
+						to->adopt_unsynchronized(node);
+					} catch (Lookup_failed) { return false; }
+					return true;
+				}
+			}
+			return false;
+		}
+
+		/**
+		 * Restore the file system from the active region
+		 */
+		void _replay()
+		{
+			enum {
+				MAX_RECORD = sizeof(Header) + sizeof(Write) + MAX_PAYLOAD,
+				WINDOW     = 4*MAX_PAYLOAD,
+			};
+
+			/* the map is too large for the stack of the entrypoint */
+			Node_map &map = *new (env()->heap()) Node_map;
+			map.insert(_root.inode(), &_root);
+
+			char * const window = (char *)env()->heap()->alloc(WINDOW);
+
+			/* stream offset of 'window', always block aligned */
+			file_size_t window_start = 0;
+			size_t      window_len   = 0;
+			file_size_t pos          = 0;
+
+			for (;;) {
+
+				size_t avail = window_start + window_len - pos;
+
+				/* make the next record available in the window */
+				if (avail < MAX_RECORD && window_start + window_len < _region_size()) {
+
+					file_size_t const start = _block_floor(pos);
+					size_t      const keep  = window_start + window_len - start;
+					memmove(window, window + (start - window_start), keep);
+					window_start = start;
+
+					size_t const read_len =
+						min((file_size_t)_block_floor(WINDOW - keep),
+						    _region_size() - (window_start + keep));
+
+					if (!_io(false, _region_base(_region) + (window_start + keep) / _blk_size,
+					         window + keep, read_len)) {
+						PERR("reading journal failed");
+						window_len = keep;
+						break;
+					}
+					window_len = keep + read_len;
+					avail      = window_start + window_len - pos;
+				}
+
+				if (avail < sizeof(Header))
+					break;
+
+				Header h;
+				memcpy(&h, window + (pos - window_start), sizeof(h));
+
+				if (h.magic != MAGIC || h.generation != _generation || h.seq != _seq
+				 || h.length > MAX_RECORD - sizeof(Header)
+				 || avail < sizeof(h) + h.length)
+					break;
+
+				char const * const payload = window + (pos - window_start) + sizeof(h);
+
+				uint32_t const checksum = h.checksum;
+				h.checksum = 0;
+				if (_checksum(_checksum(2166136261U, &h, sizeof(h)), payload, h.length) != checksum)
+					break;
+
+				if (!_apply(map, h, payload))
+					PWRN("journal record %llu of type %u is inconsistent",
+					     (unsigned long long)h.seq, h.type);
+
+				pos += sizeof(h) + h.length;
+				_seq++;
+				_replayed_records++;
+			}
+
+			/* continue the stream after the last valid record */
+			_pos = _flushed = pos;
+			_buf_start = _block_floor(pos);
+			memset(_buf, 0, _config.buffer_size);
+			memcpy(_buf, window + (_buf_start - window_start), pos - _buf_start);
+
+			env()->heap()->free(window, WINDOW);
+			destroy(env()->heap(), &map);
+		}
+
+		/**
+		 * Read superblock
+		 *
+		 * \return  false if the device holds no valid file system
+		 */
+		bool _read_superblock()
+		{
+			char * const block = (char *)env()->heap()->alloc(_blk_size);
+
+			bool valid = _io(false, 0, block, _blk_size);
+
+			Superblock const &sb = *(Superblock const *)block;
+			valid = valid && sb.magic == MAGIC && sb.version == VERSION && sb.region < 2
+			     && sb.checksum == _checksum(2166136261U, &sb, sizeof(sb) - sizeof(uint32_t));
+
+			if (valid) {
+				_generation = sb.generation;
+				_region     = sb.region;
+
+				if (sb.root != _root.inode())
+					PWRN("inode number of root directory changed");
+			}
+
+			env()->heap()->free(block, _blk_size);
+			return valid;
+		}
+
+		void _handle_timer(unsigned) { _flush(); }
+
+		size_t _block_buf_size() const {
+			return 2*_config.buffer_size + 2*MAX_PACKET; }
+
+	public:
+
+		/**
+		 * Constructor
+		 *
+		 * Restores the content of the file system from the block device if
+		 * the device holds a file system.
+		 */
+		Journal(Server::Entrypoint &ep, Directory &root, Config const &config)
+		:
+			_config(config), _root(root),
+			_block_alloc(env()->heap()),
+			_block(&_block_alloc, _block_buf_size()),
+			_blk_cnt(0), _blk_size(0), _region_blocks(0),
+			_reporter("ram_fs"),
+			_generation(0), _region(0), _seq(0), _pos(0), _snapshot(0),
+			_buf((char *)env()->heap()->alloc(_config.buffer_size)),
+			_buf_start(0), _flushed(0),
+			_writes_in_flight(0), _compacting(false), _failed(false),
+			_replay_ms(0), _replayed_records(0), _compactions(0),
+			_ack_dispatcher(ep, *this, &Journal::_handle_acks),
+			_timer_dispatcher(ep, *this, &Journal::_handle_timer)
+		{
+			Block::Session::Operations ops;
+			_block.info(&_blk_cnt, &_blk_size, &ops);
+			_region_blocks = _blk_cnt > 1 ? (_blk_cnt - 1)/2 : 0;
+
+			_block.tx_channel()->sigh_ack_avail(_ack_dispatcher);
+
+			if (!ops.supported(Block_packet::WRITE) || _blk_size < sizeof(Superblock)
+			 || _config.buffer_size % _blk_size || _region_size() < 2*MAX_PACKET) {
+				PERR("block device unsuitable for persistence");
+				_failed = true;
+				return;
+			}
+
+			_reporter.enabled(_config.report);
+
+			if (_config.flush_interval_ms && !_config.strict) {
+				_timer.sigh(_timer_dispatcher);
+				_timer.trigger_periodic(_config.flush_interval_ms*1000);
+			}
+
+			unsigned long const start_ms = _timer.elapsed_ms();
+
+			if (_read_superblock()) {
+				_replay();
+				_replay_ms = _timer.elapsed_ms() - start_ms;
+
+				PINF("restored %lu records (%llu bytes) in %lu ms",
+				     _replayed_records, (unsigned long long)_pos, _replay_ms);
+				_snapshot = _pos;
+			} else {
+				PINF("initializing persistent storage of %llu bytes",
+				     (unsigned long long)_region_size());
+				_generation = 0;
+				_region     = 1;
+				_compact();
+			}
+
+			report();
+		}
+
+		~Journal()
+		{
+			sync();
+			env()->heap()->free(_buf, _config.buffer_size);
+		}
+
+		/**
+		 * Return true if the file system was restored from the device
+		 */
+		bool restored() const { return _replayed_records > 0; }
+
+		/**
+		 * Write snapshot, e.g., after adding content not recorded
+		 */
+		void snapshot() { if (!_failed) _compact(); }
+
+		void created(Directory &parent, Node &node)
+		{
+			try { _record_create(parent, node); }
+			catch (Snapshot_too_large) { }
+		}
+
+		void written(Node &node, char const *data, size_t len, seek_off_t offset)
+		{
+			try { _record_write(node, data, len, offset); }
+			catch (Snapshot_too_large) { }
+		}
+
+		void truncated(File &file, file_size_t size)
+		{
+			Truncate t;
+			t.id   = file.inode();
+			t.size = size;
+			try { _append(TRUNCATE, &t, sizeof(t), 0, 0); }
+			catch (Snapshot_too_large) { }
+		}
+
+		void unlinked(Directory &parent, char const *name)
+		{
+			Unlink u;
+			u.parent = parent.inode();
+			try { _append(UNLINK, &u, sizeof(u), name, strlen(name)); }
+			catch (Snapshot_too_large) { }
+		}
+
+		void moved(Directory &from, char const *from_name,
+		           Directory &to,   char const *to_name)
+		{
+			char names[2*MAX_NAME_LEN];
+
+			Move m;
+			m.from     = from.inode();
+			m.to       = to.inode();
+			m.from_len = min(strlen(from_name), (size_t)MAX_NAME_LEN);
+
+			size_t const to_len = min(strlen(to_name), (size_t)MAX_NAME_LEN);
+			memcpy(names, from_name, m.from_len);
+			memcpy(names + m.from_len, to_name, to_len);
+
+			try { _append(MOVE, &m, sizeof(m), names, m.from_len + to_len); }
+			catch (Snapshot_too_large) { }
+		}
+
+		/**
+		 * Complete an operation, which waits for the device in strict mode
+		 */
+		void operation_done() { if (_config.strict) sync(); }
+
+		/**
+		 * Write all records and wait for the device
+		 */
+		void sync()
+		{
+			_flush();
+			_wait_for_writes();
+			_block.sync();
+		}
+
+		void report()
+		{
+			if (!_reporter.is_enabled())
+				return;
+
+			Reporter::Xml_generator xml(_reporter, [&] () {
+				xml.attribute("replay_ms",   (long)_replay_ms);
+				xml.attribute("records",     (long)_replayed_records);
+				xml.attribute("journal",     (long)(_pos - _snapshot));
+				xml.attribute("snapshot",    (long)_snapshot);
+				xml.attribute("capacity",    (long)_region_size());
+				xml.attribute("generation",  (long)_generation);
+				xml.attribute("compactions", (long)_compactions);
+				if (_failed)
+					xml.attribute("failed", "yes");
+			});
+		}
+};
+
+#endif /* _JOURNAL_H_ */
@@ -18,10 +18,12 @@
 #include <os/config.h>
 #include <os/server.h>
 #include <os/session_policy.h>
+#include <util/volatile_object.h>
 #include <util/xml_node.h>
 
 /* local includes */
 #include <directory.h>
+#include <journal.h>
 #include <node_handle_registry.h>
 
 
@@ -39,6 +41,7 @@ namespace File_system {
 			Directory            &_root;
 			Node_handle_registry  _handle_registry;
 			bool                  _writable;
+			Journal              *_journal;  /* zero if not persistent */
 
 			Signal_rpc_member<Session_component> _process_packet_dispatcher;
 
@@ -73,8 +76,19 @@ namespace File_system {
 					break;
 
 				case Packet_descriptor::WRITE:
-					res_length = node.write((char const *)content, length, offset);
-					break;
+					{
+						/* resolve append position for the journal */
+						seek_off_t at = offset;
+						File *file = dynamic_cast<File *>(&node);
+						if (file && at == (seek_off_t)(~0))
+							at = file->length();
+
+						res_length = node.write((char const *)content, length, offset);
+
+						if (_journal && res_length)
+							_journal->written(node, (char const *)content, res_length, at);
+						break;
+					}
 				}
 
 				packet.length(res_length);
@@ -97,6 +111,14 @@ namespace File_system {
 				catch (Invalid_handle)     { PERR("Invalid_handle");     }
 				catch (Size_limit_reached) { PERR("Size_limit_reached"); }
 
+				/*
+				 * In strict mode, a write must be on the device before it
+				 * is acknowledged. Reads leave the device alone.
+				 */
+				if (_journal && packet.operation() == Packet_descriptor::WRITE
+				 && packet.succeeded())
+					_journal->operation_done();
+
 				/*
 				 * The 'acknowledge_packet' function cannot block because we
 				 * checked for 'ready_to_ack' in '_process_packets'.
@@ -125,7 +147,7 @@ namespace File_system {
 					 * for receiving any subsequent 'ready-to-ack' signals.
 					 */
 					if (!tx_sink()->ready_to_ack())
-						return;
+						break;
 
 					_process_packet();
 				}
@@ -147,13 +169,16 @@ namespace File_system {
 			/**
 			 * Constructor
 			 */
-			Session_component(size_t tx_buf_size, Server::Entrypoint &ep,
-			                  Directory &root, bool writable)
+			Session_component(size_t tx_buf_size, unsigned tx_queue_size,
+			                  Server::Entrypoint &ep,
+			                  Directory &root, bool writable, Journal *journal)
 			:
-				Session_rpc_object(env()->ram_session()->alloc(tx_buf_size), ep.rpc_ep()),
+				Session_rpc_object(env()->ram_session()->alloc(tx_buf_size), ep.rpc_ep(),
+				                   tx_queue_size),
 				_ep(ep),
 				_root(root),
 				_writable(writable),
+				_journal(journal),
 				_process_packet_dispatcher(ep, *this, &Session_component::_process_packets)
 			{
 				/*
@@ -204,13 +229,18 @@ namespace File_system {
 						                    File(*env()->heap(), name.string());
 
 						dir->adopt_unsynchronized(file);
+
+						if (_journal) {
+							_journal->created(*dir, *file);
+							_journal->operation_done();
+						}
 					}
 					catch (Allocator::Out_of_memory) { throw No_space(); }
 				}
 
 				File *file = dir->lookup_and_lock_file(name.string());
 				Node_lock_guard file_guard(*file);
-				return _handle_registry.alloc(file);
+				return _handle_registry.alloc(file, mode);
 			}
 
 			Symlink_handle symlink(Dir_handle dir_handle, Name const &name, bool create)
@@ -234,6 +264,11 @@ namespace File_system {
 						                    Symlink(name.string());
 
 						dir->adopt_unsynchronized(symlink);
+
+						if (_journal) {
+							_journal->created(*dir, *symlink);
+							_journal->operation_done();
+						}
 					}
 					catch (Allocator::Out_of_memory) { throw No_space(); }
 				}
@@ -270,7 +305,13 @@ namespace File_system {
 						throw Node_already_exists();
 
 					try {
-						parent->adopt_unsynchronized(new (env()->heap()) Directory(name));
+						Directory * const dir = new (env()->heap()) Directory(name);
+						parent->adopt_unsynchronized(dir);
+
+						if (_journal) {
+							_journal->created(*parent, *dir);
+							_journal->operation_done();
+						}
 					} catch (Allocator::Out_of_memory) {
 						throw No_space();
 					}
@@ -349,6 +390,11 @@ namespace File_system {
 
 				node->unlock();
 				destroy(env()->heap(), node);
+
+				if (_journal) {
+					_journal->unlinked(*dir, name.string());
+					_journal->operation_done();
+				}
 			}
 
 			void truncate(File_handle file_handle, file_size_t size)
@@ -359,6 +405,11 @@ namespace File_system {
 				File *file = _handle_registry.lookup_and_lock(file_handle);
 				Node_lock_guard file_guard(*file);
 				file->truncate(size);
+
+				if (_journal) {
+					_journal->truncated(*file, size);
+					_journal->operation_done();
+				}
 			}
 
 			void move(Dir_handle from_dir_handle, Name const &from_name,
@@ -378,13 +429,23 @@ namespace File_system {
 
 				Node *node = from_dir->lookup_and_lock(from_name.string());
 				Node_lock_guard node_guard(*node);
-				node->name(to_name.string());
 
-				if (!_handle_registry.refer_to_same_node(from_dir_handle, to_dir_handle)) {
-					Directory *to_dir = _handle_registry.lookup_and_lock(to_dir_handle);
+				/*
+				 * The node is re-added to the directory because the name is
+				 * the key of the directory index.
+				 */
+				Directory *to_dir = from_dir;
+
+				if (_handle_registry.refer_to_same_node(from_dir_handle, to_dir_handle)) {
+					from_dir->discard_unsynchronized(node);
+					node->name(to_name.string());
+					from_dir->adopt_unsynchronized(node);
+				} else {
+					to_dir = _handle_registry.lookup_and_lock(to_dir_handle);
 					Node_lock_guard to_dir_guard(*to_dir);
 
 					from_dir->discard_unsynchronized(node);
+					node->name(to_name.string());
 					to_dir->adopt_unsynchronized(node);
 
 					/*
@@ -397,6 +458,11 @@ namespace File_system {
 					to_dir->notify_listeners();
 				}
 
+				if (_journal) {
+					_journal->moved(*from_dir, from_name.string(), *to_dir, to_name.string());
+					_journal->operation_done();
+				}
+
 				from_dir->mark_as_updated();
 				from_dir->notify_listeners();
 
@@ -409,7 +475,29 @@ namespace File_system {
 				_handle_registry.sigh(node_handle, sigh);
 			}
 
-			void sync() { }
+			void sync() { if (_journal) _journal->sync(); }
+
+			Dataspace_capability dataspace(File_handle file_handle,
+			                               file_size_t size, bool writeable)
+			{
+				bool const handle_writable =
+					_handle_registry.mode(file_handle) == READ_WRITE;
+
+				if (writeable && !(_writable && handle_writable))
+					throw Permission_denied();
+
+				/*
+				 * The RAM dataspace of the file cannot be handed out
+				 * read-only. Let clients without write access fall back to
+				 * reading the file.
+				 */
+				if (!_writable || !handle_writable)
+					return Dataspace_capability();
+
+				File *file = _handle_registry.lookup_and_lock(file_handle);
+				Node_lock_guard file_guard(*file);
+				return file->dataspace(size);
+			}
 	};
 
 
@@ -419,6 +507,7 @@ namespace File_system {
 
 			Server::Entrypoint &_ep;
 			Directory          &_root_dir;
+			Journal            *_journal;
 
 		protected:
 
@@ -485,6 +574,8 @@ namespace File_system {
 					Arg_string::find_arg(args, "ram_quota"  ).ulong_value(0);
 				size_t tx_buf_size =
 					Arg_string::find_arg(args, "tx_buf_size").ulong_value(0);
+				unsigned tx_queue_size =
+					Arg_string::find_arg(args, "tx_queue_size").ulong_value(Session::TX_QUEUE_SIZE);
 
 				/*
 				 * Check if donated ram quota suffices for session data,
@@ -497,7 +588,8 @@ namespace File_system {
 					throw Root::Quota_exceeded();
 				}
 				return new (md_alloc())
-					Session_component(tx_buf_size, _ep, *session_root_dir, writeable);
+					Session_component(tx_buf_size, tx_queue_size, _ep,
+					                  *session_root_dir, writeable, _journal);
 			}
 
 		public:
@@ -513,8 +605,14 @@ namespace File_system {
 			:
 				Root_component<Session_component>(&ep.rpc_ep(), &md_alloc),
 				_ep(ep),
-				_root_dir(root_dir)
+				_root_dir(root_dir),
+				_journal(0)
 			{ }
+
+			/**
+			 * Record modifications of the file system in 'journal'
+			 */
+			void journal(Journal *journal) { _journal = journal; }
 	};
 
 	struct Main;
@@ -633,13 +731,49 @@ struct File_system::Main
 
 	Root fs_root = { ep, sliced_heap, root_dir };
 
+	Lazy_volatile_object<Journal> journal;
+
 	Main(Server::Entrypoint &ep) : ep(ep)
 	{
-		/* preload RAM file system with content as declared in the config */
+		/* apply storage parameters before creating any file */
 		try {
-			Xml_node content = config()->xml_node().sub_node("content");
-			preload_content(*env()->heap(), content, root_dir); }
+			Xml_node config = Genode::config()->xml_node();
+
+			Number_of_bytes chunk_size = File::chunk_size();
+			try { config.attribute("chunk_size").value(&chunk_size); }
+			catch (Xml_node::Nonexistent_attribute) { }
+			File::chunk_size() = chunk_size;
+
+			Number_of_bytes extent_threshold = File::extent_threshold();
+			try { config.attribute("extent_threshold").value(&extent_threshold); }
+			catch (Xml_node::Nonexistent_attribute) { }
+			File::extent_threshold() = extent_threshold;
+		} catch (...) { }
+
+		/* restore file system from block device */
+		try {
+			Xml_node persistence = config()->xml_node().sub_node("persistence");
+			journal.construct(ep, root_dir, Journal::Config(persistence));
+			fs_root.journal(journal.operator -> ());
+		}
 		catch (Xml_node::Nonexistent_sub_node) { }
+		catch (Parent::Service_denied) {
+			PERR("block session unavailable, file system is not persistent"); }
+
+		/*
+		 * Preload RAM file system with content as declared in the config
+		 *
+		 * A restored file system already contains the content.
+		 */
+		if (!journal.is_constructed() || !journal->restored()) {
+			try {
+				Xml_node content = config()->xml_node().sub_node("content");
+				preload_content(*env()->heap(), content, root_dir); }
+			catch (Xml_node::Nonexistent_sub_node) { }
+
+			if (journal.is_constructed())
+				journal->snapshot();
+		}
 
 		env()->parent()->announce(ep.manage(fs_root));
 	}
@@ -50,7 +50,9 @@ namespace File_system {
 	};
 
 
-	class Node : public List<Node>::Element
+	class Directory;
+
+	class Node
 	{
 		public:
 
@@ -58,6 +60,18 @@ namespace File_system {
 
 		private:
 
+			friend class Directory;
+
+			/*
+			 * Membership in the parent directory, which keeps its entries
+			 * in creation order and in a hash index keyed by name
+			 */
+			Node          *_dir_prev;
+			Node          *_dir_next;
+			Node          *_hash_next;
+			unsigned long  _hash;
+			unsigned long  _seq;
+
 			Lock                _lock;
 			int                 _ref_count;
 			Name                _name;
@@ -68,16 +82,26 @@ namespace File_system {
 			/**
 			 * Generate unique inode number
 			 */
-			static unsigned long _unique_inode()
-			{
-				static unsigned long inode_count;
-				return ++inode_count;
-			}
+			static unsigned long _unique_inode() { return ++inode_count(); }
 
 		public:
 
+			/**
+			 * Inode number assigned most recently
+			 *
+			 * Restoring nodes from persistent storage sets the counter to
+			 * reproduce the original inode numbers.
+			 */
+			static unsigned long &inode_count()
+			{
+				static unsigned long count;
+				return count;
+			}
+
 			Node()
-			: _ref_count(0), _inode(_unique_inode()), _modified(false)
+			:
+				_dir_prev(0), _dir_next(0), _hash_next(0), _hash(0), _seq(0),
+				_ref_count(0), _inode(_unique_inode()), _modified(false)
 			{ _name[0] = 0; }
 
 			virtual ~Node()
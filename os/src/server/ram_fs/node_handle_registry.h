@@ -45,6 +45,11 @@ namespace File_system {
 
 			Node *_nodes[MAX_NODE_HANDLES];
 
+			/**
+			 * Access mode requested when opening the node
+			 */
+			Mode _modes[MAX_NODE_HANDLES];
+
 			/**
 			 * Each open node handle can act as a listener to be informed about
 			 * node changes.
@@ -56,13 +61,14 @@ namespace File_system {
 			 *
 			 * \throw Out_of_node_handles
 			 */
-			int _alloc(Node *node)
+			int _alloc(Node *node, Mode mode)
 			{
 				Lock::Guard guard(_lock);
 
 				for (unsigned i = 0; i < MAX_NODE_HANDLES; i++)
 					if (!_nodes[i]) {
 						_nodes[i] = node;
+						_modes[i] = mode;
 						return i;
 					}
 
@@ -78,15 +84,33 @@ namespace File_system {
 
 			Node_handle_registry()
 			{
-				for (unsigned i = 0; i < MAX_NODE_HANDLES; i++)
+				for (unsigned i = 0; i < MAX_NODE_HANDLES; i++) {
 					_nodes[i] = 0;
+					_modes[i] = STAT_ONLY;
+				}
 			}
 
 			template <typename NODE_TYPE>
-			typename Handle_type<NODE_TYPE>::Type alloc(NODE_TYPE *node)
+			typename Handle_type<NODE_TYPE>::Type alloc(NODE_TYPE *node,
+			                                            Mode mode = STAT_ONLY)
 			{
 				typedef typename Handle_type<NODE_TYPE>::Type Handle;
-				return Handle(_alloc(node));
+				return Handle(_alloc(node, mode));
+			}
+
+			/**
+			 * Return access mode of node handle
+			 *
+			 * \throw Invalid_handle
+			 */
+			Mode mode(Node_handle handle) const
+			{
+				Lock::Guard guard(_lock);
+
+				if (!_in_range(handle.value) || !_nodes[handle.value])
+					throw Invalid_handle();
+
+				return _modes[handle.value];
 			}
 
 			/**
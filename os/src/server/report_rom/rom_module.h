@@ -31,6 +31,7 @@ namespace Rom {
 
 	typedef Genode::List<Module> Module_list;
 	typedef Genode::List<Reader> Reader_list;
+	typedef Genode::List<Buffer> Buffer_list;
 }
 
 
@@ -43,6 +44,35 @@ struct Rom::Reader : Reader_list::Element
 };
 
 
+/**
+ * Copy of one version of the content of a ROM module shared by ROM clients
+ *
+ * The dataspace of the buffer is handed out to the ROM clients directly.
+ * The content of a buffer is never modified while a ROM client refers to
+ * it.
+ */
+class Rom::Buffer : public Buffer_list::Element
+{
+	private:
+
+		friend class Module;
+
+		Attached_ram_dataspace _ds;
+
+		size_t        _size    = 0;
+		unsigned long _version = 0;
+		unsigned      _users   = 0;
+
+		Buffer(size_t capacity) : _ds(Genode::env()->ram_session(), capacity) { }
+
+	public:
+
+		Genode::Dataspace_capability ds() const { return _ds.cap(); }
+
+		unsigned long version() const { return _version; }
+};
+
+
 /**
  * A Rom::Module gets created as soon as either a ROM client or a Report client
  * refers to it.
@@ -79,18 +109,32 @@ struct Rom::Module : Module_list::Element
 		Writer const mutable * _writer = 0;
 
 		/**
-		 * Dataspace used as backing store
+		 * Backing store of the current content
 		 *
-		 * The buffer for the content is not allocated from the heap to
-		 * allow for the immediate release of the underlying backing store when
-		 * the module gets destructed.
+		 * The backing store is never handed out to ROM clients. So clients
+		 * that modify a shared buffer cannot affect the content obtained
+		 * by other clients later on.
 		 */
 		Lazy_volatile_object<Attached_ram_dataspace> _ds;
 
+		size_t _size = 0;
+
 		/**
-		 * Content size, which may less than the capacilty of '_ds'.
+		 * Buffers shared by readers
+		 *
+		 * The current content is copied into a buffer when a reader asks
+		 * for a shared buffer for the first time. All readers of this
+		 * version use the same buffer. Besides the buffers referred to by
+		 * readers, one unused buffer is kept for the next version. Buffers
+		 * are destroyed as soon as possible to allow for the immediate
+		 * release of the underlying backing store.
 		 */
-		size_t _size = 0;
+		Buffer_list _buffers;
+
+		/**
+		 * Version of the current content, incremented on each change
+		 */
+		unsigned long _version = 0;
 
 		void _notify_readers() const
 		{
@@ -145,28 +189,95 @@ struct Rom::Module : Module_list::Element
 
 		bool _is_in_use() const { return _readers.first() || _writer; }
 
+		/**
+		 * Return true if 'len' bytes at 'src' equal the current content
+		 */
+		bool _unchanged(char const *src, size_t len) const
+		{
+			if (!_size)
+				return len == 0;
+
+			return _size == len
+			    && Genode::memcmp(_ds->local_addr<char>(), src, len) == 0;
+		}
+
+		/**
+		 * Destroy unused buffers except for the largest one
+		 */
+		void _destroy_unused_buffers()
+		{
+			Buffer *spare = 0;
+			for (Buffer *b = _buffers.first(), *next = 0; b; b = next) {
+				next = b->next();
+
+				if (b->_users)
+					continue;
+
+				Buffer *victim = b;
+				if (!spare || spare->_ds.size() < b->_ds.size()) {
+					victim = spare;
+					spare  = b;
+				}
+
+				if (victim) {
+					_buffers.remove(victim);
+					Genode::destroy(Genode::env()->heap(), victim);
+				}
+			}
+		}
+
+		/**
+		 * Return unused buffer with a capacity of at least 'len' bytes
+		 */
+		Buffer &_unused_buffer(size_t len)
+		{
+			for (Buffer *b = _buffers.first(); b; b = b->next())
+				if (!b->_users && b->_ds.size() >= len)
+					return *b;
+
+			Buffer *b = new (Genode::env()->heap()) Buffer(len);
+			_buffers.insert(b);
+			return *b;
+		}
+
 	public:
 
+		~Module()
+		{
+			while (Buffer *b = _buffers.first()) {
+				_buffers.remove(b);
+				Genode::destroy(Genode::env()->heap(), b);
+			}
+		}
+
 		/**
 		 * Assign new content to the ROM module
 		 *
-		 * Called by report service when a new report comes in.
+		 * Called by report service when a new report comes in. If the
+		 * content is unchanged, the readers are not notified.
 		 */
 		void write_content(char const * const src, size_t const src_len)
 		{
+			if (_unchanged(src, src_len))
+				return;
+
 			_size = 0;
 
 			/* realloc backing store if needed */
-			if (!_ds.is_constructed() || _ds->size() < src_len)
+			if (src_len && (!_ds.is_constructed() || _ds->size() < src_len))
 				_ds.construct(Genode::env()->ram_session(), src_len);
 
 			/* copy content into backing store */
 			_size = src_len;
-			Genode::memcpy(_ds->local_addr<char>(), src, _size);
+			if (_size)
+				Genode::memcpy(_ds->local_addr<char>(), src, _size);
+
+			_version++;
+
+			_destroy_unused_buffers();
 
 			/* notify ROM clients that access the module */
-			for (Reader const *r = _readers.first(); r; r = r->next())
-				r->notify_module_changed();
+			_notify_readers();
 		}
 
 		/**
@@ -177,11 +288,12 @@ struct Rom::Module : Module_list::Element
 		/**
 		 * Read content of ROM module
 		 *
-		 * Called by ROM service when a dataspace is obtained by the client.
+		 * Called by ROM service when a dataspace is obtained by a client
+		 * that does not share the content with other clients.
 		 */
 		size_t read_content(char *dst, size_t dst_len) const
 		{
-			if (!_ds.is_constructed())
+			if (!_size)
 				return 0;
 
 			if (dst_len < _size)
@@ -191,6 +303,59 @@ struct Rom::Module : Module_list::Element
 			return _size;
 		}
 
+		/**
+		 * Obtain shared buffer holding the current content
+		 *
+		 * Called by ROM service when a dataspace is obtained by a client
+		 * that shares the content with other clients. The buffer must be
+		 * released via 'release' once the client requests a new version.
+		 *
+		 * \return  buffer, or 0 if the module is empty
+		 */
+		Buffer const *acquire()
+		{
+			if (!_size)
+				return 0;
+
+			for (Buffer *b = _buffers.first(); b; b = b->next())
+				if (b->_version == _version) {
+					b->_users++;
+					return b;
+				}
+
+			Buffer &buffer = _unused_buffer(_size);
+
+			char * const dst = buffer._ds.local_addr<char>();
+			Genode::memcpy(dst, _ds->local_addr<char>(), _size);
+
+			/*
+			 * Clear the rest of an older version in a reused buffer, which
+			 * is visible to the readers mapping the dataspace. Beyond the
+			 * size of the old version, the buffer is zeroed already.
+			 */
+			if (buffer._size > _size)
+				Genode::memset(dst + _size, 0, buffer._size - _size);
+
+			buffer._size    = _size;
+			buffer._version = _version;
+			buffer._users++;
+			return &buffer;
+		}
+
+		/**
+		 * Drop reference to a buffer obtained via 'acquire'
+		 */
+		void release(Buffer const &buffer)
+		{
+			for (Buffer *b = _buffers.first(); b; b = b->next())
+				if (b == &buffer)
+					b->_users--;
+
+			_destroy_unused_buffers();
+		}
+
+		unsigned long version() const { return _version; }
+
 		size_t size() const { return _size; }
 };
 
@@ -25,7 +25,7 @@ namespace Rom {
 
 struct Rom::Registry_for_reader
 {
-	virtual Module const &lookup(Reader const &reader, Module::Name const &name) = 0;
+	virtual Module &lookup(Reader const &reader, Module::Name const &name) = 0;
 
 	virtual void release(Reader const &reader, Module const &module) = 0;
 };
@@ -101,7 +101,7 @@ struct Rom::Registry : Registry_for_reader, Registry_for_writer, Genode::Noncopy
 			return _release(writer, module);
 		}
 
-		Module const &lookup(Reader const &reader, Module::Name const &name) override
+		Module &lookup(Reader const &reader, Module::Name const &name) override
 		{
 			return _lookup(reader, name);
 		}
@@ -37,8 +37,21 @@ class Rom::Session_component : public Genode::Rpc_object<Genode::Rom_session>,
 	private:
 
 		Registry_for_reader &_registry;
-		Module        const &_module;
+		Module              &_module;
 
+		/**
+		 * True if the client shares the content with other clients
+		 */
+		bool const _shared;
+
+		/**
+		 * Shared buffer of the module handed out to the client, or 0
+		 */
+		Buffer const *_buffer = 0;
+
+		/**
+		 * Private copy of the content if the client does not share it
+		 */
 		Lazy_volatile_object<Genode::Attached_ram_dataspace> _ds;
 
 		Genode::Signal_context_capability _sigh;
@@ -46,13 +59,17 @@ class Rom::Session_component : public Genode::Rpc_object<Genode::Rom_session>,
 	public:
 
 		Session_component(Registry_for_reader &registry,
-		                  Rom::Module::Name const &name)
+		                  Rom::Module::Name const &name, bool shared)
 		:
-			_registry(registry), _module(_registry.lookup(*this, name))
+			_registry(registry), _module(_registry.lookup(*this, name)),
+			_shared(shared)
 		{ }
 
 		~Session_component()
 		{
+			if (_buffer)
+				_module.release(*_buffer);
+
 			_registry.release(*this, _module);
 		}
 
@@ -60,15 +77,33 @@ class Rom::Session_component : public Genode::Rpc_object<Genode::Rom_session>,
 		{
 			using namespace Genode;
 
-			/* replace dataspace by new one */
-			/* XXX we could keep the old dataspace if the size fits */
-			_ds.construct(env()->ram_session(), _module.size());
+			if (!_shared) {
 
-			/* fill dataspace content with report contained in module */
-			_module.read_content(_ds->local_addr<char>(), _ds->size());
+				/* replace dataspace by new one */
+				/* XXX we could keep the old dataspace if the size fits */
+				_ds.construct(env()->ram_session(), _module.size());
+
+				/* fill dataspace content with report contained in module */
+				_module.read_content(_ds->local_addr<char>(), _ds->size());
+
+				/* cast RAM into ROM dataspace capability */
+				Dataspace_capability ds_cap = static_cap_cast<Dataspace>(_ds->cap());
+
+				return static_cap_cast<Rom_dataspace>(ds_cap);
+			}
+
+			/* replace buffer by the one holding the current version */
+			if (!_buffer || _buffer->version() != _module.version()) {
+
+				if (_buffer)
+					_module.release(*_buffer);
+
+				_buffer = _module.acquire();
+			}
 
 			/* cast RAM into ROM dataspace capability */
-			Dataspace_capability ds_cap = static_cap_cast<Dataspace>(_ds->cap());
+			Dataspace_capability ds_cap = _buffer ? _buffer->ds()
+			                                      : Dataspace_capability();
 
 			return static_cap_cast<Rom_dataspace>(ds_cap);
 		}
@@ -99,9 +134,9 @@ class Rom::Root : public Genode::Root_component<Session_component>
 		typedef Rom::Module::Name Label;
 
 		/**
-		 * Determine module name for label according to the configured policy
+		 * Determine policy node for label
 		 */
-		Rom::Module::Name _module_name(Label const &label) const
+		Xml_node _policy(Label const &label) const
 		{
 			try {
 				for (Xml_node node = _config.sub_node("policy");
@@ -112,9 +147,7 @@ class Rom::Root : public Genode::Root_component<Session_component>
 					 || !node.attribute("label").has_value(label.string()))
 					 	continue;
 
-					char report[Rom::Module::Name::capacity()];
-					node.attribute("report").value(report, sizeof(report));
-					return Rom::Module::Name(report);
+					return node;
 				}
 			} catch (Xml_node::Nonexistent_sub_node) { }
 
@@ -132,8 +165,17 @@ class Rom::Root : public Genode::Root_component<Session_component>
 			char label[Label::capacity()];
 			Arg_string::find_arg(args, "label").string(label, sizeof(label), "");
 
+			Xml_node policy = _policy(Label(label));
+
+			char report[Rom::Module::Name::capacity()];
+			policy.attribute("report").value(report, sizeof(report));
+
+			bool shared = false;
+			try { shared = policy.attribute("share").has_value("yes"); }
+			catch (Xml_node::Nonexistent_attribute) { }
+
 			return new (md_alloc())
-				Session_component(_registry, _module_name(Label(label)));
+				Session_component(_registry, Rom::Module::Name(report), shared);
 		}
 
 	public:
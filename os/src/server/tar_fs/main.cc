@@ -159,11 +159,13 @@ namespace File_system {
 			/**
 			 * Constructor
 			 */
-			Session_component(size_t tx_buf_size, Rpc_entrypoint &ep,
+			Session_component(size_t tx_buf_size, unsigned tx_queue_size,
+			                  Rpc_entrypoint &ep,
 			                  Signal_receiver &sig_rec,
 			                  Directory &root)
 			:
-				Session_rpc_object(env()->ram_session()->alloc(tx_buf_size), ep),
+				Session_rpc_object(env()->ram_session()->alloc(tx_buf_size), ep,
+				                   tx_queue_size),
 				_root(root),
 				_process_packet_dispatcher(sig_rec, *this,
 				                           &Session_component::_process_packets)
@@ -500,6 +502,8 @@ namespace File_system {
 					Arg_string::find_arg(args, "ram_quota"  ).ulong_value(0);
 				size_t tx_buf_size =
 					Arg_string::find_arg(args, "tx_buf_size").ulong_value(0);
+				unsigned tx_queue_size =
+					Arg_string::find_arg(args, "tx_queue_size").ulong_value(Session::TX_QUEUE_SIZE);
 
 				/*
 				 * Check if donated ram quota suffices for session data,
@@ -512,7 +516,7 @@ namespace File_system {
 					throw Root::Quota_exceeded();
 				}
 				return new (md_alloc())
-					Session_component(tx_buf_size, _channel_ep, _sig_rec,
+					Session_component(tx_buf_size, tx_queue_size, _channel_ep, _sig_rec,
 					                  *session_root_dir);
 			}
 
@@ -22,6 +22,8 @@
 #include <base/env.h>
 #include <base/printf.h>
 #include <os/config.h>
+#include <os/reporter.h>
+#include <os/rom_content_registry.h>
 
 
 /**
@@ -31,9 +33,16 @@ class Rom_session_component : public Genode::Rpc_object<Genode::Rom_session>
 {
 	private:
 
+		Genode::Rom_content_registry &_registry;
+
 		const char *_tar_addr, *_filename, *_file_addr;
 		Genode::size_t _file_size, _tar_size;
-		Genode::Ram_dataspace_capability _file_ds;
+
+		/**
+		 * File content, shared with other sessions requesting identical
+		 * content if sharing is enabled
+		 */
+		Genode::Rom_content_registry::Content *_content;
 
 		enum {
 			/* length of on data block in tar */
@@ -44,31 +53,9 @@ class Rom_session_component : public Genode::Rpc_object<Genode::Rom_session>
 		};
 
 		/**
-		 * Copy file content into dataspace
-		 *
-		 * \param dst  destination dataspace
+		 * Obtain dataspace containing the content of the archived file
 		 */
-		void _copy_content_to_dataspace(Genode::Dataspace_capability dst)
-		{
-			using namespace Genode;
-
-			/* map dataspace locally */
-			char *dst_addr = env()->rm_session()->attach(dst);
-			Dataspace_client dst_client(dst);
-
-			/* copy content */
-			size_t dst_ds_size   = Dataspace_client(dst).size();
-			size_t bytes_to_copy = min(_file_size, dst_ds_size);
-			memcpy(dst_addr, _file_addr, bytes_to_copy);
-
-			/* unmap dataspace */
-			env()->rm_session()->detach(dst_addr);
-		}
-
-		/**
-		 * Initialize dataspace containing the content of the archived file
-		 */
-		Genode::Ram_dataspace_capability _init_file_ds()
+		Genode::Rom_content_registry::Content *_init_content()
 		{
 			bool file_found = false;
 
@@ -115,22 +102,16 @@ class Rom_session_component : public Genode::Rpc_object<Genode::Rom_session>
 
 			if (!file_found) {
 				PERR("couldn't find file '%s', empty result", _filename);
-				return Genode::Ram_dataspace_capability();
+				return 0;
 			}
 
-			/* try to allocate memory for file */
-			Genode::Ram_dataspace_capability file_ds;
+			/* get content of file copied into dataspace unless present */
 			try {
-				file_ds = Genode::env()->ram_session()->alloc(_file_size);
-
-				/* get content of file copied into dataspace and return */
-				_copy_content_to_dataspace(file_ds);
-			} catch (...) {
+				return &_registry.acquire(_file_addr, _file_size); }
+			catch (...) {
 				PERR("couldn't allocate memory for file, empty result\n");
-				return file_ds;
+				return 0;
 			}
-
-			return file_ds;
 		}
 
 	public:
@@ -138,32 +119,35 @@ class Rom_session_component : public Genode::Rpc_object<Genode::Rom_session>
 		/**
 		 * Constructor scans and seeks to file
 		 *
+		 * \param  registry  registry of file content shared by sessions
 		 * \param  tar_addr  local address to tar archive
 		 * \param  tar_size  size of tar archive in bytes
 		 * \param  filename  name of the requested file
 		 */
-		Rom_session_component(const char *tar_addr, unsigned tar_size,
+		Rom_session_component(Genode::Rom_content_registry &registry,
+		                      const char *tar_addr, unsigned tar_size,
 		                      const char *filename)
 		:
+			_registry(registry),
 			_tar_addr(tar_addr), _filename(filename), _file_addr(0), _file_size(0),
 			_tar_size(tar_size),
-			_file_ds(_init_file_ds())
+			_content(_init_content())
 		{
-			if (!_file_ds.valid())
+			if (!_content)
 				throw Genode::Root::Invalid_args();
 		}
 
 		/**
 		 * Destructor
 		 */
-		~Rom_session_component() { Genode::env()->ram_session()->free(_file_ds); }
+		~Rom_session_component() { _registry.release(*_content); }
 
 		/**
 		 * Return dataspace with content of file
 		 */
 		Genode::Rom_dataspace_capability dataspace()
 		{
-			Genode::Dataspace_capability ds = _file_ds;
+			Genode::Dataspace_capability ds = _content->ds();
 			return Genode::static_cap_cast<Genode::Rom_dataspace>(ds);
 		}
 
@@ -178,6 +162,9 @@ class Rom_root : public Genode::Root_component<Rom_session_component>
 		char    *_tar_addr;
 		unsigned _tar_size;
 
+		Genode::Rom_content_registry _registry;
+		Genode::Reporter            &_reporter;
+
 		Rom_session_component *_create_session(const char *args)
 		{
 			enum { FILENAME_MAX_LEN = 128 };
@@ -187,7 +174,17 @@ class Rom_root : public Genode::Root_component<Rom_session_component>
 			PINF("connection for file '%s' requested\n", filename);
 
 			/* create new session for the requested file */
-			return new (md_alloc()) Rom_session_component(_tar_addr, _tar_size, filename);
+			Rom_session_component *session = new (md_alloc())
+				Rom_session_component(_registry, _tar_addr, _tar_size, filename);
+
+			_registry.report(_reporter);
+			return session;
+		}
+
+		void _destroy_session(Rom_session_component *session)
+		{
+			Genode::destroy(md_alloc(), session);
+			_registry.report(_reporter);
 		}
 
 	public:
@@ -199,13 +196,17 @@ class Rom_root : public Genode::Root_component<Rom_session_component>
 		 * \param  md_alloc    meta-data allocator used for ROM sessions
 		 * \param  tar_base    local address of tar archive
 		 * \param  tar_size    size of tar archive in bytes
+		 * \param  sharing     share identical files among sessions
+		 * \param  reporter    report of the memory saved by sharing files
 		 */
 		Rom_root(Genode::Rpc_entrypoint *entrypoint,
 		         Genode::Allocator      *md_alloc,
-		         char *tar_addr, Genode::size_t tar_size)
+		         char *tar_addr, Genode::size_t tar_size,
+		         bool sharing, Genode::Reporter &reporter)
 		:
 			Genode::Root_component<Rom_session_component>(entrypoint, md_alloc),
-			_tar_addr(tar_addr), _tar_size(tar_size)
+			_tar_addr(tar_addr), _tar_size(tar_size),
+			_registry(*Genode::env()->heap(), sharing), _reporter(reporter)
 		{ }
 };
 
@@ -217,10 +218,14 @@ int main(void)
 	/* read name of tar archive from config */
 	enum { TAR_FILENAME_MAX_LEN = 64 };
 	static char tar_filename[TAR_FILENAME_MAX_LEN];
+	bool sharing = false;
 	try {
 		Xml_node archive_node =
 			config()->xml_node().sub_node("archive");
 		archive_node.attribute("name").value(tar_filename, sizeof(tar_filename));
+
+		try { sharing = archive_node.attribute("sharing").has_value("yes"); }
+		catch (...) { }
 	} catch (...) {
 		PERR("Could not read 'filename' argument from config");
 		return -1;
@@ -247,9 +252,18 @@ int main(void)
 	static Sliced_heap sliced_heap(env()->ram_session(),
 	                               env()->rm_session());
 
+	/* enable or disable report of the memory saved by sharing files */
+	static Reporter reporter("rom_sharing");
+	try {
+		reporter.enabled(config()->xml_node().sub_node("report")
+		                                     .attribute("sharing")
+		                                     .has_value("yes"));
+	} catch (...) { }
+
 	enum { STACK_SIZE = 8*1024 };
 	static Rpc_entrypoint ep(&cap, STACK_SIZE, "tar_rom_ep");
-	static Rom_root rom_root(&ep, &sliced_heap, tar_base, tar_size);
+	static Rom_root rom_root(&ep, &sliced_heap, tar_base, tar_size, sharing,
+	                         reporter);
 
 	/* announce server*/
 	env()->parent()->announce(ep.manage(&rom_root));
@@ -13,13 +13,15 @@
 
 #include <base/env.h>
 #include <base/rpc_server.h>
-#include <base/sleep.h>
+#include <base/signal.h>
 #include <root/component.h>
 #include <util/string.h>
+#include <os/attached_ram_dataspace.h>
 
 #include <terminal_session/connection.h>
 #include <cap_session/connection.h>
 #include <log_session/log_session.h>
+#include <log_session/log_buffer.h>
 
 
 namespace Genode {
@@ -28,25 +30,46 @@ namespace Genode {
 	{
 		public:
 
-			enum { LABEL_LEN = 64 };
+			enum { LABEL_LEN = 64, RING_BUFFER_SIZE = 4096 };
 
 		private:
 
 			char                  _label[LABEL_LEN];
 			Terminal::Connection *_terminal;
 
-		public:
+			/*
+			 * Lock for synchronizing the output of the entrypoint and the
+			 * main thread, which consumes the ring buffers
+			 */
+			Lock &_output_lock;
 
-			/**
-			 * Constructor
+			/*
+			 * Ring buffer for writing messages without RPC
 			 */
-			Termlog_component(const char *label, Terminal::Connection *terminal)
-			: _terminal(terminal) { snprintf(_label, LABEL_LEN, "[%s] ", label); }
+			Attached_ram_dataspace _ring_ds;
+			Log_buffer             _ring;
 
+			Signal_dispatcher<Termlog_component> _ring_dispatcher;
 
-			/*****************
-			 ** Log session **
-			 *****************/
+			/**
+			 * Output content of ring buffer, called with '_output_lock' held
+			 */
+			void _drain_ring()
+			{
+				char line[String::MAX_SIZE];
+				_ring.drain(line, sizeof(line), [&] (char const *string, size_t len) {
+					if (len)
+						_output(string, len); });
+			}
+
+			/**
+			 * Signal handler called by the main thread
+			 */
+			void _handle_ring(unsigned)
+			{
+				Lock::Guard guard(_output_lock);
+				_drain_ring();
+			}
 
 			/**
 			 * Write a log-message to the terminal.
@@ -54,15 +77,8 @@ namespace Genode {
 			 * The following function's code is a modified variant of the one in:
 			 * 'base/src/core/include/log_session_component.h'
 			 */
-			size_t write(String const &string_buf)
+			void _output(char const *string, int len)
 			{
-				if (!(string_buf.is_valid_string())) {
-					PERR("corrupted string");
-					return 0;
-				}
-
-				char const *string = string_buf.string();
-				int len = strlen(string);
 
 				/*
 				 * Heuristic: The Log console implementation flushes
@@ -77,7 +93,7 @@ namespace Genode {
 					char buf[5];
 					strncpy(buf, string, 5);
 					_terminal->write(buf, len);
-					return len;
+					return;
 				}
 
 				_terminal->write(_label, strlen(_label));
@@ -86,9 +102,55 @@ namespace Genode {
 				/* if last character of string was not a line break, add one */
 				if ((len > 0) && (string[len - 1] != '\n'))
 					_terminal->write("\n", 1);
+			}
+
+		public:
+
+			/**
+			 * Constructor
+			 */
+			Termlog_component(const char *label, Terminal::Connection *terminal,
+			                  Lock &output_lock, Signal_receiver &sig_rec)
+			:
+				_terminal(terminal), _output_lock(output_lock),
+				_ring_ds(env()->ram_session(), RING_BUFFER_SIZE),
+				_ring(_ring_ds.local_addr<void>(), _ring_ds.size()),
+				_ring_dispatcher(sig_rec, *this, &Termlog_component::_handle_ring)
+			{
+				snprintf(_label, LABEL_LEN, "[%s] ", label);
+				_ring.reset();
+			}
+
+
+			/*****************
+			 ** Log session **
+			 *****************/
+
+			size_t write(String const &string_buf)
+			{
+				if (!(string_buf.is_valid_string())) {
+					PERR("corrupted string");
+					return 0;
+				}
+
+				char const *string = string_buf.string();
+				int len = strlen(string);
+
+				Lock::Guard guard(_output_lock);
+
+				/* preserve the order of messages written via the ring buffer */
+				_drain_ring();
+
+				/* an empty string is used by the client to flush the ring buffer */
+				if (len)
+					_output(string, len);
 
 				return len;
 			}
+
+			Dataspace_capability ring_buffer() { return _ring_ds.cap(); }
+
+			Signal_context_capability ring_buffer_sigh() { return _ring_dispatcher; }
 	};
 
 
@@ -97,6 +159,8 @@ namespace Genode {
 		private:
 
 			Terminal::Connection *_terminal;
+			Lock                  _output_lock;
+			Signal_receiver      &_sig_rec;
 
 		protected:
 
@@ -109,7 +173,8 @@ namespace Genode {
 					Arg_string::find_arg(args, "ram_quota"  ).ulong_value(0);
 
 				/* delete ram quota by the memory needed for the session */
-				size_t session_size = max((size_t)4096, sizeof(Termlog_component));
+				size_t session_size = max((size_t)4096, sizeof(Termlog_component))
+				                    + Termlog_component::RING_BUFFER_SIZE;
 				if (ram_quota < session_size)
 					throw Root::Quota_exceeded();
 
@@ -118,7 +183,8 @@ namespace Genode {
 				Arg label_arg = Arg_string::find_arg(args, "label");
 				label_arg.string(label_buf, sizeof(label_buf), "");
 
-				return new (md_alloc()) Termlog_component(label_buf, _terminal);
+				return new (md_alloc()) Termlog_component(label_buf, _terminal,
+				                                          _output_lock, _sig_rec);
 			}
 
 		public:
@@ -128,11 +194,13 @@ namespace Genode {
 			 *
 			 * \param session_ep  entry point for managing cpu session objects
 			 * \param md_alloc    meta-data allocator to be used by root component
+			 * \param sig_rec     signal receiver used for ring-buffer
+			 *                    notifications
 			 */
 			Termlog_root(Rpc_entrypoint *session_ep, Allocator *md_alloc,
-			         Terminal::Connection *terminal)
+			         Terminal::Connection *terminal, Signal_receiver &sig_rec)
 			: Root_component<Termlog_component>(session_ep, md_alloc),
-			  _terminal(terminal) { }
+			  _terminal(terminal), _sig_rec(sig_rec) { }
 	};
 }
 
@@ -146,22 +214,30 @@ int main(int argc, char **argv)
 	 */
 	static Terminal::Connection terminal;
 
+	/*
+	 * Receiver of the notifications about messages in ring buffers
+	 */
+	static Signal_receiver sig_rec;
+
 	/*
 	 * Initialize server entry point
 	 */
 	enum { STACK_SIZE = 4096 };
 	static Cap_connection cap;
 	static Rpc_entrypoint ep(&cap, STACK_SIZE, "termlog_ep");
-	static Termlog_root termlog_root(&ep, env()->heap(), &terminal);
+	static Termlog_root termlog_root(&ep, env()->heap(), &terminal, sig_rec);
 
 	/*
 	 * Announce services
 	 */
 	env()->parent()->announce(ep.manage(&termlog_root));
 
-	/**
-	 * Got to sleep forever
+	/*
+	 * Output messages of ring buffers
 	 */
-	sleep_forever();
+	for (;;) {
+		Signal s = sig_rec.wait_for_signal();
+		static_cast<Signal_dispatcher_base *>(s.context())->dispatch(s.num());
+	}
 	return 0;
 }
@@ -0,0 +1,145 @@
+/*
+ * \brief  Test and microbenchmark of the hierarchical bitmap allocators
+ * \author Genode Labs
+ * \date   2014-01-08
+ *
+ * Both 'Genode::Bit_allocator' and 'Nic::Packet_allocator' are filled to 95%
+ * of their capacity. Afterwards, the cost of freeing and re-allocating single
+ * entries is measured.
+ */
+
+/*
+ * Copyright (C) 2014 Genode Labs GmbH
+ *
+ * This file is part of the Genode OS framework, which is distributed
+ * under the terms of the GNU General Public License version 2.
+ */
+
+/* Genode includes */
+#include <base/env.h>
+#include <base/printf.h>
+#include <util/bit_allocator.h>
+#include <nic/packet_allocator.h>
+#include <timer_session/connection.h>
+
+using namespace Genode;
+
+enum {
+	ENTRIES   = 64*1024,
+	OCCUPANCY = 95,           /* in percent */
+	ROUNDS    = 1000*1000,
+};
+
+
+/**
+ * Pseudo-random sequence used for picking entries to free
+ */
+static unsigned random()
+{
+	static unsigned seed = 93186752;
+	seed = seed * 1103515245 + 12345;
+	return seed >> 8;
+}
+
+
+struct Test_failed { };
+
+
+static void check(bool condition, char const *msg)
+{
+	if (condition)
+		return;
+
+	PERR("%s", msg);
+	throw Test_failed();
+}
+
+
+static void print_result(char const *name, unsigned long ms)
+{
+	unsigned long const ns_per_round = (ms * 1000 * 1000) / ROUNDS;
+	printf("%s: %u rounds at %u%% occupancy took %lu ms (%lu ns per alloc/free)\n",
+	       name, (unsigned)ROUNDS, (unsigned)OCCUPANCY, ms, ns_per_round);
+}
+
+
+static void test_bit_allocator(Timer::Session &timer)
+{
+	static Bit_allocator<ENTRIES> alloc;
+	static addr_t used[ENTRIES];
+
+	unsigned const num_used = (ENTRIES * OCCUPANCY) / 100;
+	for (unsigned i = 0; i < num_used; i++)
+		used[i] = alloc.alloc();
+
+	/* entries are handed out in ascending order */
+	check(used[num_used - 1] == num_used - 1, "unexpected allocation order");
+
+	unsigned long const start_ms = timer.elapsed_ms();
+	for (unsigned i = 0; i < ROUNDS; i++) {
+		unsigned const victim = random() % num_used;
+		alloc.free(used[victim]);
+		used[victim] = alloc.alloc();
+	}
+	print_result("Bit_allocator", timer.elapsed_ms() - start_ms);
+
+	/* allocate remaining entries, the next allocation must fail */
+	for (unsigned i = num_used; i < ENTRIES; i++)
+		alloc.alloc();
+
+	bool exhausted = false;
+	try { alloc.alloc(); }
+	catch (Bit_allocator<ENTRIES>::Out_of_indices) { exhausted = true; }
+	check(exhausted, "allocation from full Bit_allocator succeeded");
+}
+
+
+static void test_packet_allocator(Timer::Session &timer)
+{
+	enum { PACKET_SIZE = Nic::Packet_allocator::DEFAULT_PACKET_SIZE };
+
+	static void *used[ENTRIES];
+
+	Nic::Packet_allocator alloc(env()->heap());
+
+	/* the packet allocator manages offsets only, the base is arbitrary */
+	check(alloc.add_range(0x1000, ENTRIES*PACKET_SIZE) == 0,
+	      "add_range failed");
+
+	unsigned const num_used = (ENTRIES * OCCUPANCY) / 100;
+	for (unsigned i = 0; i < num_used; i++)
+		check(alloc.alloc(PACKET_SIZE, &used[i]), "packet allocation failed");
+
+	unsigned long const start_ms = timer.elapsed_ms();
+	for (unsigned i = 0; i < ROUNDS; i++) {
+		unsigned const victim = random() % num_used;
+		alloc.free(used[victim]);
+		alloc.alloc(PACKET_SIZE, &used[victim]);
+	}
+	print_result("Nic::Packet_allocator", timer.elapsed_ms() - start_ms);
+
+	for (unsigned i = num_used; i < ENTRIES; i++)
+		check(alloc.alloc(PACKET_SIZE, &used[i]), "packet allocation failed");
+
+	void *addr = 0;
+	check(!alloc.alloc(PACKET_SIZE, &addr),
+	      "allocation from full Packet_allocator succeeded");
+}
+
+
+int main(int, char **)
+{
+	printf("--- bit_tree test started ---\n");
+
+	static Timer::Connection timer;
+
+	try {
+		test_bit_allocator(timer);
+		test_packet_allocator(timer);
+	} catch (Test_failed) {
+		return -1;
+	}
+
+	printf("--- bit_tree test finished ---\n");
+	return 0;
+}
@@ -0,0 +1,3 @@
+TARGET = test-bit_tree
+SRC_CC = main.cc
+LIBS   = base
@@ -26,28 +26,28 @@ class Driver : public Block::Driver
 
 		enum { MAX_REQUESTS = 5 };
 
-		typedef Ring_buffer<Block::Packet_descriptor, MAX_REQUESTS,
+		typedef Ring_buffer<Tag, MAX_REQUESTS + 1,
 		                    Ring_buffer_unsynchronized> Req_buffer;
 
 		Genode::size_t                    _number;
 		Genode::size_t                    _size;
+		Block::Scheduler::Policy          _policy;
 		Req_buffer                        _packets;
 		Genode::Ram_dataspace_capability  _blk_ds;
 		unsigned char                    *_blk_buf;
 
 	public:
 
-		Driver(Genode::size_t number, Genode::size_t size)
-		: _number(number), _size(size),
+		Driver(Genode::size_t number, Genode::size_t size,
+		       Block::Scheduler::Policy const &policy)
+		: _number(number), _size(size), _policy(policy),
 		  _blk_ds(Genode::env()->ram_session()->alloc(number*size)),
 		  _blk_buf(Genode::env()->rm_session()->attach(_blk_ds)) {}
 
 		void handler(unsigned)
 		{
-			while (!_packets.empty()) {
-				Block::Packet_descriptor p = _packets.get();
-				session->ack_packet(p);
-			}
+			while (!_packets.empty())
+				session->complete(_packets.get());
 		}
 
 
@@ -66,29 +66,24 @@ class Driver : public Block::Driver
 			return ops;
 		}
 
-		void read(Block::sector_t           block_number,
-		          Genode::size_t            block_count,
-		          char                     *buffer,
-		          Block::Packet_descriptor &packet)
-		{
-			if (!_packets.avail_capacity())
-				throw Block::Driver::Request_congestion();
+		unsigned queue_depth() { return MAX_REQUESTS; }
 
-			Genode::memcpy((void*)buffer, &_blk_buf[block_number*_size],
-			               block_count * _size);
-			_packets.add(packet);
-		}
+		Block::Scheduler::Policy scheduling() { return _policy; }
 
-		void write(Block::sector_t           block_number,
-		           Genode::size_t            block_count,
-		           const char               *buffer,
-		           Block::Packet_descriptor &packet)
+		void submit(Tag                       tag,
+		            Block::Packet_descriptor &packet,
+		            char                     *buffer,
+		            Genode::addr_t)
 		{
-			if (!_packets.avail_capacity())
-				throw Block::Driver::Request_congestion();
-			Genode::memcpy(&_blk_buf[block_number*_size],
-			               (void*)buffer, block_count * _size);
-			_packets.add(packet);
+			unsigned char *blocks = &_blk_buf[packet.block_number()*_size];
+			Genode::size_t const size = packet.block_count() * _size;
+
+			if (packet.operation() == Block::Packet_descriptor::READ)
+				Genode::memcpy(buffer, blocks, size);
+			else
+				Genode::memcpy(blocks, buffer, size);
+
+			_packets.add(tag);
 		}
 };
 
@@ -105,14 +100,20 @@ struct Main
 		{
 			Genode::size_t blk_nr = 1024;
 			Genode::size_t blk_sz = 512;
+			Block::Scheduler::Policy policy;
 
 			try {
-				Genode::config()->xml_node().attribute("sectors").value(&blk_nr);
-				Genode::config()->xml_node().attribute("block_size").value(&blk_sz);
+				Genode::Xml_node config = Genode::config()->xml_node();
+				Genode::Number_of_bytes max_transfer = 0;
+				try { config.attribute("sectors").value(&blk_nr); } catch (...) { }
+				try { config.attribute("block_size").value(&blk_sz); } catch (...) { }
+				try { config.attribute("max_transfer").value(&max_transfer); } catch (...) { }
+				try { config.attribute("deadline").value(&policy.deadline); } catch (...) { }
+				policy.max_transfer = max_transfer;
 			}
 			catch (...) { }
 
-			driver = new (Genode::env()->heap()) Driver(blk_nr, blk_sz);
+			driver = new (Genode::env()->heap()) Driver(blk_nr, blk_sz, policy);
 		}
 
 		Block::Driver *create() { return driver; }
@@ -15,6 +15,7 @@
 #include <base/allocator_avl.h>
 #include <nic_session/connection.h>
 #include <nic/packet_allocator.h>
+#include <nic/size_class_packet_allocator.h>
 #include <timer_session/connection.h>
 
 using namespace Genode;
@@ -167,6 +168,8 @@ int main(int, char **)
 
 	bool config_test_roundtrip = true;
 	bool config_test_batch     = true;
+	bool config_test_jumbo     = true;
+	bool config_test_offload   = true;
 
 	if (config_test_roundtrip) {
 		printf("-- test roundtrip two times (packet offsets should be the same) --\n");
@@ -184,6 +187,50 @@ int main(int, char **)
 		batch_packets(&nic, NUM_PACKETS);
 	}
 
+	if (config_test_jumbo) {
+		printf("-- test jumbo frames with size-class packet allocation --\n");
+		enum { MTU = Nic::Session::MAX_MTU };
+		Nic::Size_class_packet_allocator tx_block_alloc(env()->heap(), MTU);
+		Nic::Connection nic(&tx_block_alloc, BUF_SIZE, BUF_SIZE, MTU);
+
+		if (nic.mtu() != MTU) {
+			PERR("unexpected MTU %zd", nic.mtu());
+			return -1;
+		}
+		if (!single_packet_roundtrip(&nic, 'c', 60)
+		 || !single_packet_roundtrip(&nic, 'd', Nic::Session::frame_size(MTU))) {
+			PERR("jumbo-frame roundtrip failed");
+			return -1;
+		}
+	}
+
+	if (config_test_offload) {
+		printf("-- test preservation of offload flags --\n");
+		typedef Nic::Packet_descriptor Packet;
+		Allocator_avl tx_block_alloc(env()->heap());
+		Nic::Connection nic(&tx_block_alloc, BUF_SIZE, BUF_SIZE,
+		                    Nic::Session::DEFAULT_MTU, Packet::CSUM_PARTIAL);
+
+		if (!(nic.offload() & Packet::CSUM_PARTIAL)) {
+			PERR("checksum offload not accepted");
+			return -1;
+		}
+
+		Packet tx_packet = nic.tx()->alloc_packet(100);
+		tx_packet.csum_partial(34, 16);
+		nic.tx()->submit_packet(tx_packet);
+		nic.tx()->release_packet(nic.tx()->get_acked_packet());
+
+		Packet rx_packet = nic.rx()->get_packet();
+		if (!(rx_packet.offload() & Packet::CSUM_PARTIAL)
+		 || rx_packet.csum_start() != 34 || rx_packet.csum_offset() != 16) {
+			PERR("offload information got lost");
+			return -1;
+		}
+		nic.rx()->acknowledge_packet(rx_packet);
+		printf("offload flags preserved\n");
+	}
+
 	printf("--- finished NIC loop-back test ---\n");
 	return 0;
 }